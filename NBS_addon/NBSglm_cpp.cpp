@@ -1,20 +1,222 @@
-#include <Eigen/Dense>
-#include <vector>
-#include <string>
-#include <cmath>
+/**
+ * NBSglm_cpp.cpp - MEX implementation of NBSglm_smn with on-demand permutations
+ *
+ * Usage in MATLAB:
+ *   test_stat  = NBSglm_cpp(GLM)
+ *   [test_stat, df_effect] = NBSglm_cpp(GLM)
+ *   perm_stats = NBSglm_cpp(GLM, n_perms, seed)
+ *   perm_stats = NBSglm_cpp(GLM, n_perms, seed, 'closed_form')
+ *   t_stats    = NBSglm_cpp('subsets', Y, ids_sampled, test_type)
+ *   t_stats    = NBSglm_cpp('subsets', Y, ids_sampled, test_type, sizes)
+ *   gt_stats   = NBSglm_cpp('stream', Y_file, X, contrasts, test, ind_nuisance, chunk_size)
+ *
+ * Inputs:
+ *   GLM     - Structure prepared by NBSglm_setup_smn (X, y, contrast, test, n_GLMs,
+ *             n_observations, n_predictors, ind_nuisance). GLM.contrast may hold one
+ *             contrast per row (n_contrasts x n_predictors); all of them share one fit
+ *             of the data and of every permutation
+ *   n_perms - Number of permuted statistics to generate (one block of the stream)
+ *   seed    - Seed of the permutation generator; the same seed returns the same block
+ *   'closed_form' - Compute the block from sufficient statistics when the design
+ *             allows it (onesample intercept or two group ttest, no nuisance, and
+ *             score and intercept correlation designs): one
+ *             GEMM for all permutations instead of one solve per permutation. Same
+ *             permutations as without the flag, equal to rounding. Other designs
+ *             ignore the flag.
+ *   Y           - Brain data of all subjects (n_var x n_subjects, double)
+ *   ids_sampled - Subject ids of each repetition as drawn by draw_repetition_ids.m
+ *                 (n_ids x n_reps)
+ *   test_type   - 't', 'pt' or 't2'
+ *   sizes       - Increasing sample sizes (n_subs_subset units) of a nested sweep,
+ *                 each using the first sizes(k) subjects of every group of a column
+ *   Y_file      - Column store of Y with one column per subject (write_column_store.m)
+ *   X           - Design matrix of all subjects (n_subjects x n_predictors)
+ *   contrasts   - One contrast per row (n_contrasts x n_predictors)
+ *   test        - 'onesample', 'ttest' or 'ftest'
+ *   ind_nuisance - 1-based nuisance predictors, [] for none
+ *   chunk_size  - Subjects read from the store at a time
+ *
+ * Outputs:
+ *   test_stat  - Test statistic for each GLM (n_contrasts x n_GLMs)
+ *   df_effect  - Numerator degrees of freedom of the F statistic of each contrast
+ *                (1 x n_contrasts), [] for t-tests. It only depends on the design, so
+ *                a GLM with no columns in y returns it without fitting any data
+ *   perm_stats - Test statistics under the null (n_GLMs x n_perms x n_contrasts), one
+ *                column per permutation, following the permute_signal.m rules:
+ *                  - onesample without nuisance: random sign flips
+ *                  - other tests without nuisance: shuffle the observations
+ *                  - with nuisance: shuffle residuals and add the nuisance fit back
+ *                    (Freedman & Lane), followed by sign flips for onesample
+ *   t_stats    - Test statistic of every variable in every repetition (n_var x n_reps),
+ *                from the sums over the sampled subjects (prisme/subset_stats.hpp)
+ *                instead of one GLM fit per repetition. With sizes the result is
+ *                n_var x numel(sizes) x n_reps, every subject is added to the sums once
+ *   gt_stats   - Full sample statistic of every contrast (n_contrasts x n_var), from
+ *                one pass over the store that accumulates Z'Y and the sums of squares
+ *                (prisme/streaming_glm.hpp). Memory does not grow with the subjects.
+ *
+ * The design is factorized once per call, so every permutation in a block only pays
+ * for the solve against the permuted data. The GLM itself lives in prisme::GlmDesign
+ * (prisme_core/include/prisme/glm.hpp).
+ */
+
+#include "mex.h"
+#include "prisme/column_store.hpp"
+#include "prisme/glm.hpp"
+#include "prisme/streaming_glm.hpp"
+#include "prisme/subset_stats.hpp"
+
 #include <algorithm>
-#include <mex.h>
+#include <cmath>
+#include <cstdint>
+#include <exception>
+#include <string>
+#include <vector>
+
+// t_stats = NBSglm_cpp('subsets', Y, ids_sampled, test_type, [sizes])
+void subset_stats(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[]) {
+    if ((nrhs != 4 && nrhs != 5) || nlhs != 1) {
+        mexErrMsgIdAndTxt("NBSglm_cpp:invalidNumInputs",
+                          "Usage: t_stats = NBSglm_cpp('subsets', Y, ids_sampled, test_type, [sizes])");
+    }
+    if (!mxIsDouble(prhs[1]) || mxIsComplex(prhs[1]) || !mxIsDouble(prhs[2]) || !mxIsChar(prhs[3])) {
+        mexErrMsgIdAndTxt("NBSglm_cpp:invalidInput", "Y and ids_sampled must be real double, test_type a char");
+    }
+    const size_t n_var = mxGetM(prhs[1]);
+    const size_t n_ids = mxGetM(prhs[2]);
+    const size_t n_reps = mxGetN(prhs[2]);
+    char test_type[64];
+    mxGetString(prhs[3], test_type, sizeof(test_type));
+
+    std::vector<size_t> sizes;
+    if (nrhs == 5) {
+        if (!mxIsDouble(prhs[4])) {
+            mexErrMsgIdAndTxt("NBSglm_cpp:invalidInput", "sizes must be double");
+        }
+        const double* sizes_ptr = mxGetPr(prhs[4]);
+        for (size_t k = 0; k < mxGetNumberOfElements(prhs[4]); k++) {
+            if (sizes_ptr[k] < 1 || sizes_ptr[k] != std::floor(sizes_ptr[k])) {
+                mexErrMsgIdAndTxt("NBSglm_cpp:invalidInput", "sizes must be positive integers");
+            }
+            sizes.push_back(static_cast<size_t>(sizes_ptr[k]));
+        }
+        const mwSize dims[3] = {n_var, sizes.size(), n_reps};
+        plhs[0] = mxCreateNumericArray(3, dims, mxDOUBLE_CLASS, mxREAL);
+    } else {
+        plhs[0] = mxCreateDoubleMatrix(n_var, n_reps, mxREAL);
+    }
+
+    std::string error;
+    try {
+        prisme::span<const double> Y(mxGetPr(prhs[1]), mxGetNumberOfElements(prhs[1]));
+        prisme::span<const double> ids(mxGetPr(prhs[2]), mxGetNumberOfElements(prhs[2]));
+        prisme::span<double> t_stats(mxGetPr(plhs[0]), mxGetNumberOfElements(plhs[0]));
+        if (nrhs == 5) {
+            prisme::nested_subset_t_stats(Y, n_var, ids, n_ids, sizes, prisme::parse_subset_design(test_type),
+                                          t_stats);
+        } else {
+            prisme::subset_t_stats(Y, n_var, ids, n_ids, prisme::parse_subset_design(test_type), t_stats);
+        }
+    } catch (const std::exception& e) {
+        error = e.what();
+    }
+    if (!error.empty()) {
+        mexErrMsgIdAndTxt("NBSglm_cpp:invalidInput", "%s", error.c_str());
+    }
+}
+
+// gt_stats = NBSglm_cpp('stream', Y_file, X, contrasts, test, ind_nuisance, chunk_size)
+void streaming_stats(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[]) {
+    if (nrhs != 7 || nlhs != 1) {
+        mexErrMsgIdAndTxt("NBSglm_cpp:invalidNumInputs",
+                          "Usage: gt_stats = NBSglm_cpp('stream', Y_file, X, contrasts, test, ind_nuisance, "
+                          "chunk_size)");
+    }
+    if (!mxIsChar(prhs[1]) || !mxIsDouble(prhs[2]) || !mxIsDouble(prhs[3]) || !mxIsChar(prhs[4])) {
+        mexErrMsgIdAndTxt("NBSglm_cpp:invalidInput", "Y_file and test must be char, X and contrasts double");
+    }
+    char* path_chars = mxArrayToString(prhs[1]);
+    const std::string path(path_chars);
+    mxFree(path_chars);
+    char test[64];
+    mxGetString(prhs[4], test, sizeof(test));
+
+    const int n_observations = static_cast<int>(mxGetM(prhs[2]));
+    const int n_predictors = static_cast<int>(mxGetN(prhs[2]));
+    const size_t n_contrasts = mxGetM(prhs[3]);
+    if (mxGetN(prhs[3]) != static_cast<size_t>(n_predictors)) {
+        mexErrMsgIdAndTxt("NBSglm_cpp:invalidInput", "contrasts must have one column per predictor");
+    }
+    std::vector<int> ind_nuisance;
+    if (!mxIsEmpty(prhs[5])) {
+        const double* nuisance_ptr = mxGetPr(prhs[5]);
+        for (size_t i = 0; i < mxGetNumberOfElements(prhs[5]); i++) {
+            ind_nuisance.push_back(static_cast<int>(nuisance_ptr[i]) - 1);
+        }
+    }
+    const double chunk_size = mxGetScalar(prhs[6]);
+    if (chunk_size < 1 || chunk_size != std::floor(chunk_size)) {
+        mexErrMsgIdAndTxt("NBSglm_cpp:invalidInput", "chunk_size must be a positive integer");
+    }
+
+    std::string error;
+    try {
+        const prisme::MappedColumnStore store(path);
+        const size_t n_var = store.info().n_rows;
+        prisme::StreamingGlm glm({mxGetPr(prhs[2]), mxGetNumberOfElements(prhs[2])}, n_observations, n_predictors,
+                                 n_var);
+        prisme::stream_column_store(store, {&glm}, static_cast<size_t>(chunk_size));
+
+        plhs[0] = mxCreateDoubleMatrix(n_contrasts, n_var, mxREAL);
+        const double* contrasts = mxGetPr(prhs[3]);
+        double* out = mxGetPr(plhs[0]);
+        std::vector<double> contrast(n_predictors);
+        std::vector<double> stats(n_var);
+        for (size_t c = 0; c < n_contrasts; c++) {
+            for (int p = 0; p < n_predictors; p++) {
+                contrast[p] = contrasts[p * n_contrasts + c];
+            }
+            glm.compute_test_stat(contrast, prisme::parse_glm_test(test), ind_nuisance, stats);
+            for (size_t e = 0; e < n_var; e++) {
+                out[e * n_contrasts + c] = stats[e];
+            }
+        }
+    } catch (const std::exception& e) {
+        error = e.what();
+    }
+    if (!error.empty()) {
+        mexErrMsgIdAndTxt("NBSglm_cpp:invalidInput", "%s", error.c_str());
+    }
+}
 
 // MEX gateway function for MATLAB interface
 void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[]) {
+    if (nrhs > 0 && mxIsChar(prhs[0])) {
+        char mode[16];
+        mxGetString(prhs[0], mode, sizeof(mode));
+        if (std::string(mode) == "subsets") {
+            subset_stats(nlhs, plhs, nrhs, prhs);
+        } else if (std::string(mode) == "stream") {
+            streaming_stats(nlhs, plhs, nrhs, prhs);
+        } else {
+            mexErrMsgIdAndTxt("NBSglm_cpp:invalidInput", "Unknown mode '%s'", mode);
+        }
+        return;
+    }
+
     // Validate inputs
-    if (nrhs != 1) {
-        mexErrMsgTxt("One input required: GLM structure");
+    if (nrhs != 1 && nrhs != 3 && nrhs != 4) {
+        mexErrMsgIdAndTxt("NBSglm_cpp:invalidNumInputs",
+                          "One, three or four inputs required: GLM structure, [n_perms, seed, ['closed_form']]");
     }
-    if (nlhs != 1) {
-        mexErrMsgTxt("One output required: test_stat");
+    if (nlhs > 2 || (nlhs == 2 && nrhs != 1)) {
+        mexErrMsgIdAndTxt("NBSglm_cpp:invalidNumOutputs",
+                          "Outputs are test_stat and optionally df_effect, or perm_stats");
     }
-    
+    if (!mxIsStruct(prhs[0])) {
+        mexErrMsgIdAndTxt("NBSglm_cpp:invalidInput", "GLM must be a structure");
+    }
+
     // Extract fields from the MATLAB structure
     mxArray *X_field = mxGetField(prhs[0], 0, "X");
     mxArray *y_field = mxGetField(prhs[0], 0, "y");
@@ -24,136 +226,103 @@ void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[]) {
     mxArray *n_observations_field = mxGetField(prhs[0], 0, "n_observations");
     mxArray *n_predictors_field = mxGetField(prhs[0], 0, "n_predictors");
     mxArray *ind_nuisance_field = mxGetField(prhs[0], 0, "ind_nuisance");
-    
-    // Convert MATLAB arrays to Eigen matrices for efficient computation
-    double *X_ptr = mxGetPr(X_field);
-    double *y_ptr = mxGetPr(y_field);
-    double *contrast_ptr = mxGetPr(contrast_field);
-    
+
+    if (!X_field || !y_field || !contrast_field || !test_field || !n_GLMs_field ||
+        !n_observations_field || !n_predictors_field) {
+        mexErrMsgIdAndTxt("NBSglm_cpp:invalidInput",
+                          "GLM must be prepared by NBSglm_setup_smn");
+    }
+    if (!mxIsDouble(X_field) || !mxIsDouble(y_field) || !mxIsDouble(contrast_field)) {
+        mexErrMsgIdAndTxt("NBSglm_cpp:invalidInput", "GLM.X, GLM.y and GLM.contrast must be double");
+    }
+
     int n_observations = (int)mxGetScalar(n_observations_field);
     int n_predictors = (int)mxGetScalar(n_predictors_field);
     int n_GLMs = (int)mxGetScalar(n_GLMs_field);
-    
-    // Create Eigen matrices from MATLAB data
-    Eigen::Map<Eigen::MatrixXd> X(X_ptr, n_observations, n_predictors);
-    Eigen::Map<Eigen::MatrixXd> y(y_ptr, n_observations, n_GLMs);
-    Eigen::Map<Eigen::VectorXd> contrast(contrast_ptr, n_predictors);
-    
-    // Create output array
-    plhs[0] = mxCreateDoubleMatrix(1, n_GLMs, mxREAL);
-    double *test_stat_ptr = mxGetPr(plhs[0]);
-    Eigen::Map<Eigen::VectorXd> test_stat(test_stat_ptr, n_GLMs);
-    
+    size_t n_contrasts = mxGetNumberOfElements(contrast_field) == static_cast<size_t>(n_predictors)
+                             ? 1
+                             : mxGetM(contrast_field);
+
     // Get test type
     char test_type[64];
     mxGetString(test_field, test_type, sizeof(test_type));
-    std::string test(test_type);
-    
-    // Compute beta (regression coefficients)
-    Eigen::MatrixXd beta = X.colPivHouseholderQr().solve(y);
-    
-    // Round beta to remove numerical issues (equivalent to MATLAB's round to 14 decimals)
-    beta = (beta * 1e14).array().round() / 1e14;
-    
-    // Compute test statistic based on test type
-    if (test == "onesample" || test == "ttest") {
-        // Compute residuals
-        Eigen::MatrixXd resid = y - X * beta;
-        
-        // Mean squared error
-        Eigen::VectorXd mse = resid.colwise().squaredNorm() / (n_observations - n_predictors);
-        
-        // Standard error using contrast
-        double contrast_term = contrast.transpose() * (X.transpose() * X).inverse() * contrast;
-        Eigen::VectorXd se = (mse.array() * contrast_term).sqrt();
-        
-        // Prevent division by zero
-        for (int i = 0; i < se.size(); i++) {
-            if (se(i) < 1e-15) se(i) = 1e-15;
+
+    // Extract nuisance indices
+    std::vector<int> ind_nuisance;
+    if (ind_nuisance_field && !mxIsEmpty(ind_nuisance_field)) {
+        int n_nuisance = (int)mxGetNumberOfElements(ind_nuisance_field);
+        double *nuisance_ptr = mxGetPr(ind_nuisance_field);
+        for (int i = 0; i < n_nuisance; i++) {
+            ind_nuisance.push_back((int)nuisance_ptr[i] - 1); // Convert to 0-based indexing
         }
-        
-        // Compute t-statistic
-        test_stat = (contrast.transpose() * beta).array() / se.array();
-    }
-    else if (test == "ftest") {
-        // Initialize vectors for sums of squares
-        Eigen::VectorXd sse = Eigen::VectorXd::Zero(n_GLMs);
-        Eigen::VectorXd ssr = Eigen::VectorXd::Zero(n_GLMs);
-        
-        // Get mean of y for each column
-        Eigen::VectorXd y_mean = y.colwise().mean();
-        
-        // Sum of squares due to error
-        sse = (y - X * beta).colwise().squaredNorm();
-        
-        // Sum of squares due to regression
-        for (int i = 0; i < n_GLMs; i++) {
-            Eigen::VectorXd fitted = X * beta.col(i);
-            Eigen::VectorXd mean_vec = Eigen::VectorXd::Constant(n_observations, y_mean(i));
-            ssr(i) = (fitted - mean_vec).squaredNorm();
+    }
+
+    int n_perms = 0;
+    uint64_t seed = 0;
+    bool closed_form = false;
+    if (nrhs == 4) {
+        char option[16];
+        if (!mxIsChar(prhs[3]) || mxGetString(prhs[3], option, sizeof(option)) != 0 ||
+            std::string(option) != "closed_form") {
+            mexErrMsgIdAndTxt("NBSglm_cpp:invalidInput", "The fourth input must be 'closed_form'");
         }
-        
-        // Check if nuisance predictors are present
-        if (mxIsEmpty(ind_nuisance_field)) {
-            test_stat = (ssr.array() / (n_predictors - 1)) / (sse.array() / (n_observations - n_predictors));
+        closed_form = true;
+    }
+    if (nrhs >= 3) {
+        double n_perms_input = mxGetScalar(prhs[1]);
+        if (n_perms_input < 0 || n_perms_input != std::floor(n_perms_input)) {
+            mexErrMsgIdAndTxt("NBSglm_cpp:invalidInput", "n_perms must be a non-negative integer");
         }
-        else {
-            // Extract nuisance indices
-            int n_nuisance = (int)mxGetNumberOfElements(ind_nuisance_field);
-            double *nuisance_ptr = mxGetPr(ind_nuisance_field);
-            std::vector<int> ind_nuisance(n_nuisance);
-            for (int i = 0; i < n_nuisance; i++) {
-                ind_nuisance[i] = (int)nuisance_ptr[i] - 1; // Convert to 0-based indexing
-            }
-            
-            // Create reduced model design matrix
-            Eigen::MatrixXd X_new(n_observations, n_nuisance + 1);
-            X_new.col(0) = Eigen::VectorXd::Ones(n_observations);
-            for (int i = 0; i < n_nuisance; i++) {
-                X_new.col(i + 1) = X.col(ind_nuisance[i]);
-            }
-            
-            // Check rank of X_new
-            Eigen::ColPivHouseholderQR<Eigen::MatrixXd> qr(X_new);
-            int rankx = qr.rank();
-            
-            // Remove column of ones if rank deficient
-            int v = 0;
-            Eigen::MatrixXd X_reduced;
-            if (rankx < n_nuisance + 1) {
-                X_reduced = Eigen::MatrixXd(n_observations, n_nuisance);
-                for (int i = 0; i < n_nuisance; i++) {
-                    X_reduced.col(i) = X.col(ind_nuisance[i]);
+        n_perms = static_cast<int>(n_perms_input);
+        seed = static_cast<uint64_t>(mxGetScalar(prhs[2]));
+    }
+
+    if (nrhs == 1) {
+        plhs[0] = mxCreateDoubleMatrix(n_contrasts, n_GLMs, mxREAL);
+    } else {
+        const mwSize dims[3] = {static_cast<mwSize>(n_GLMs), static_cast<mwSize>(n_perms), n_contrasts};
+        plhs[0] = mxCreateNumericArray(3, dims, mxDOUBLE_CLASS, mxREAL);
+    }
+
+    std::string error;
+    try {
+        prisme::GlmDesign design({mxGetPr(X_field), mxGetNumberOfElements(X_field)}, n_observations, n_predictors,
+                                 {mxGetPr(contrast_field), mxGetNumberOfElements(contrast_field)},
+                                 prisme::parse_glm_test(test_type), ind_nuisance);
+        prisme::span<const double> y(mxGetPr(y_field), mxGetNumberOfElements(y_field));
+
+        prisme::span<double> out(mxGetPr(plhs[0]), mxGetNumberOfElements(plhs[0]));
+
+        if (nrhs == 1 && n_contrasts > 1) {
+            // GlmDesign returns n_GLMs x n_contrasts, one row per contrast in MATLAB
+            std::vector<double> stats(static_cast<size_t>(n_GLMs) * n_contrasts);
+            design.compute_test_stat(y, n_GLMs, stats);
+            for (size_t c = 0; c < n_contrasts; c++) {
+                for (int g = 0; g < n_GLMs; g++) {
+                    out[g * n_contrasts + c] = stats[c * n_GLMs + g];
                 }
-                v = (int)contrast.count(); // Number of non-zero elements in contrast
-            }
-            else {
-                X_reduced = X_new;
-                v = (int)contrast.count() - 1;
             }
-            
-            // Compute reduced model regression
-            Eigen::MatrixXd b_red = X_reduced.colPivHouseholderQr().solve(y);
-            
-            // Compute reduced model sums of squares
-            Eigen::VectorXd sse_red = (y - X_reduced * b_red).colwise().squaredNorm();
-            Eigen::VectorXd ssr_red = Eigen::VectorXd::Zero(n_GLMs);
-            
-            for (int i = 0; i < n_GLMs; i++) {
-                Eigen::VectorXd fitted = X_reduced * b_red.col(i);
-                Eigen::VectorXd mean_vec = Eigen::VectorXd::Constant(n_observations, y_mean(i));
-                ssr_red(i) = (fitted - mean_vec).squaredNorm();
+        } else if (nrhs == 1) {
+            design.compute_test_stat(y, n_GLMs, out);
+        } else if (closed_form && design.has_closed_form_permutations()) {
+            design.generate_closed_form_permutations(y, n_GLMs, n_perms, seed, out);
+        } else {
+            design.generate_permutations(y, n_GLMs, n_perms, seed, out);
+        }
+
+        if (nlhs == 2) {
+            if (prisme::parse_glm_test(test_type) == prisme::GlmTest::FTest) {
+                const std::vector<double> df_effect = design.f_effect_df();
+                plhs[1] = mxCreateDoubleMatrix(1, df_effect.size(), mxREAL);
+                std::copy(df_effect.begin(), df_effect.end(), mxGetPr(plhs[1]));
+            } else {
+                plhs[1] = mxCreateDoubleMatrix(0, 0, mxREAL);
             }
-            
-            // Compute F-statistic
-            test_stat = ((ssr.array() - ssr_red.array()) / v) / (sse.array() / (n_observations - n_predictors));
         }
+    } catch (const std::exception& e) {
+        error = e.what();
     }
-    
-    // Replace NaN values with zero
-    for (int i = 0; i < n_GLMs; i++) {
-        if (std::isnan(test_stat(i))) {
-            test_stat(i) = 0;
-        }
+    if (!error.empty()) {
+        mexErrMsgIdAndTxt("NBSglm_cpp:invalidInput", "%s", error.c_str());
     }
-}
\ No newline at end of file
+}
@@ -9,7 +9,8 @@ function GLM = NBSglm_setup_smn(GLM)
 % - GLM (struct): A structure that must contain the following fields:
 %     - GLM.X:            n×p design matrix, where p is the number of predictors.
 %     - GLM.y:            n×M data matrix, with each column representing a separate GLM.
-%     - GLM.contrast:     1×p contrast vector (logical or binary indicator).
+%     - GLM.contrast:     1×p contrast vector (logical or binary indicator), or a c×p
+%                         matrix with one contrast per row for NBSglm_cpp.
 %     - GLM.test:         Type of test (e.g., 'onesample', 'ttest', 'ftest').
 %     - (Optional) GLM.exchange: n×1 vector specifying exchange blocks for repeated measures.
 %
@@ -18,7 +19,8 @@ function GLM = NBSglm_setup_smn(GLM)
 %     - GLM.n_predictors: Number of predictors (including intercept).
 %     - GLM.n_GLMs:       Number of independent GLMs (number of columns in GLM.y).
 %     - GLM.n_observations: Number of observations (number of rows in GLM.y).
-%     - GLM.ind_nuisance: Indices of nuisance predictors (where contrast is false).
+%     - GLM.ind_nuisance: Indices of nuisance predictors (where contrast is false, in
+%                         every row of a contrast matrix).
 %     - If GLM.exchange is present:
 %         - GLM.blks:       Unique exchange blocks.
 %         - GLM.n_blks:     Number of exchange blocks.
@@ -36,13 +38,19 @@ function GLM = NBSglm_setup_smn(GLM)
 % 4. If nuisance predictors are found, regress them out of GLM.y to obtain residuals.
 %
 % **Notes**
-% - Assumes that GLM.contrast is a logical or binary vector.
+% - Assumes that GLM.contrast is a logical or binary vector, or a matrix whose rows
+%   are zero on the same predictors (NBSglm_cpp rejects any other).
 % - If no nuisance predictors are identified, the nuisance regression step is skipped.
 % 
 % **Date**: March 2025
 
-%Number of predictors (including intercept)
-GLM.n_predictors = length(GLM.contrast);
+%Number of predictors (including intercept), one column per predictor in a
+%contrast matrix
+if size(GLM.contrast,1) > 1
+    GLM.n_predictors = size(GLM.contrast,2);
+else
+    GLM.n_predictors = length(GLM.contrast);
+end
 
 %Number of independent GLM's to fit
 GLM.n_GLMs = size(GLM.y,2);
@@ -51,7 +59,11 @@ GLM.n_GLMs = size(GLM.y,2);
 GLM.n_observations = size(GLM.y,1);
 
 %Determine nuisance predictors not in contrast
-GLM.ind_nuisance = find(~GLM.contrast);
+if size(GLM.contrast,1) > 1
+    GLM.ind_nuisance = find(~any(GLM.contrast,1));
+else
+    GLM.ind_nuisance = find(~GLM.contrast);
+end
 
 if isfield(GLM,'exchange')
     %Set up exchange blocks
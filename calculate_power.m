@@ -77,10 +77,15 @@ function calculate_power(varargin)
     [Params.gt_data_dir, Params.gt_output] = setup_gt_directory(Params);
     Params.save_directory = create_power_output_directory(Params);
     
+    loaded_gt_path = '';
+    gt_data = [];
+
     for i = 1:length(rep_files)
         % Load a single repetition data file
         rep_file_path = fullfile(rep_files(i).folder, rep_files(i).name);
+        compact_result_journal(rep_file_path);
         rep_data = load(rep_file_path);
+        rep_data = load_column_store_fields(rep_data, rep_file_path);
         
         
         % Meta-data from the file encompassing everything
@@ -112,36 +117,79 @@ function calculate_power(varargin)
                 'network_level_stats_std');
    
     
-        for j = 1:numel(method_list)
-            method = method_list{j};
-            method_data = rep_data.(method);
-    
-            gt_filename = construct_gt_filename(rep_data.meta_data, Params.gt_output);
-            gt_fullpath = fullfile(Params.gt_data_dir, gt_filename);
-          
+        % Ground truth is shared by every method of the file, and often by the next files
+        gt_filename = construct_gt_filename(rep_data.meta_data, Params.gt_output);
+        gt_fullpath = fullfile(Params.gt_data_dir, gt_filename);
+
+        if ~strcmp(gt_fullpath, loaded_gt_path)
             if exist(gt_filename, 'file')
                 gt_data = load(gt_fullpath);
+                loaded_gt_path = gt_fullpath;
             else
                 error(['GT file %s not found. Please either set the correct name with Params.output or check if the ' ...
                     'file is missing\n'], gt_filename);
             end
-    
-            matching_datasets_check(rep_data.meta_data, gt_data.meta_data)
-     
-            stat_level = get_stat_level_from_file(rep_data, method);
-            
-            gt_brain_data = extract_gt_brain_data(gt_data, stat_level);
-    
-            PowerRes = summarize_tprs('calculate_tpr', method_data, gt_brain_data, Params, method, ...
-                file_type, meta_data);
-            eval([method ' = PowerRes;']);  % creates a variable named after the method
-            
-            save(file_name, method, '-append');
-    
         end
 
+        matching_datasets_check(rep_data.meta_data, gt_data.meta_data)
+
+        if exist('power_aggregate_cpp', 'file') == 3
+            % All methods in one pass
+            power_results = aggregate_method_power(rep_data, method_list, gt_data, Params, file_type);
+        else
+            power_results = struct();
+            for j = 1:numel(method_list)
+                method = method_list{j};
+                method_data = rep_data.(method);
+
+                stat_level = get_stat_level_from_file(rep_data, method);
+                
+                gt_brain_data = extract_gt_brain_data(gt_data, stat_level);
+        
+                power_results.(method) = summarize_tprs('calculate_tpr', method_data, gt_brain_data, Params, ...
+                    method, file_type, meta_data);
+            end
+        end
+
+        save(file_name, '-struct', 'power_results', '-append');
+
         fprintf('Finished power calculation for file %s \n', file_name);
     
     end
 
-end
\ No newline at end of file
+end
+
+function power_results = aggregate_method_power(rep_data, method_list, gt_data, Params, file_type)
+    % Builds the input of power_aggregate_cpp for every method of a results file
+    if isstring(Params.pthresh_second_level)
+        alpha = str2double(Params.pthresh_second_level);
+    else
+        alpha = Params.pthresh_second_level;
+    end
+
+    methods = struct('level', {}, 'sig_prob', {}, 'sig_prob_neg', {}, 'positives', {}, ...
+        'negatives', {}, 'n_reps', {});
+    for j = 1:numel(method_list)
+        method_data = rep_data.(method_list{j});
+
+        methods(j).level = get_stat_level_from_file(rep_data, method_list{j});
+        switch file_type
+            case 'full_file'
+                methods(j).sig_prob = method_data.sig_prob;
+                methods(j).sig_prob_neg = method_data.sig_prob_neg;
+                methods(j).n_reps = size(method_data.sig_prob, 2);
+            case 'compact_file'
+                methods(j).positives = full(method_data.positives);
+                methods(j).negatives = full(method_data.negatives);
+                methods(j).n_reps = rep_data.meta_data.n_repetitions;
+        end
+    end
+
+    power_res = power_aggregate_cpp(methods, double(gt_data.edge_level_stats), ...
+        double(gt_data.network_level_stats), alpha, Params.tpr_dthresh);
+
+    power_results = struct();
+    for j = 1:numel(method_list)
+        power_results.(method_list{j}) = power_res(j);
+    end
+end
@@ -0,0 +1,40 @@
+function append_stage_profile(profile_file, source, first_rep, last_rep, stages)
+%% append_stage_profile
+% **Description**
+% Appends the stage times of one batch of repetitions to a stage profile file.
+% The CSV format is shared with the prisme_power runner (stage_profile.hpp):
+%   source,first_repetition,last_repetition,stage,calls,wall_time,cpu_time,bytes_allocated,permutations
+% Values MATLAB cannot measure are written as NaN.
+%
+% **Inputs**
+% - `profile_file` (string): File from get_stage_profile_file.
+% - `source` (string): Writer of the rows, e.g. 'matlab'.
+% - `first_rep`, `last_rep` (int): Repetitions of the batch.
+% - `stages` (struct array): Fields `stage`, `calls`, `wall_time`, `cpu_time`,
+%   `bytes_allocated` and `permutations`, one element per stage.
+%
+% **Notes**
+% - The profile can be summarized with readtable and groupsummary, e.g. the
+%   total wall time per stage of a study.
+
+    is_new = ~isfile(profile_file);
+    fid = fopen(profile_file, 'a');
+    if fid < 0
+        error('Could not open %s', profile_file);
+    end
+    cleanup = onCleanup(@() fclose(fid));
+
+    if is_new
+        fprintf(fid, ['source,first_repetition,last_repetition,stage,calls,wall_time,cpu_time,' ...
+            'bytes_allocated,permutations\n']);
+    end
+    for s = 1:numel(stages)
+        if stages(s).calls == 0
+            continue;
+        end
+        fprintf(fid, '%s,%d,%d,%s,%d,%.9g,%.9g,%.17g,%.17g\n', source, first_rep, last_rep, ...
+            stages(s).stage, stages(s).calls, stages(s).wall_time, stages(s).cpu_time, ...
+            stages(s).bytes_allocated, stages(s).permutations);
+    end
+
+end
@@ -10,53 +10,49 @@ function compact_file_append_sol_struct(RP, output_file, all_pvals, all_pvals_ne
     edge_mean_squared_error = temp_data.edge_mean_squared_error;
     network_mean_squared_error = temp_data.network_mean_squared_error;
     
-    max_existing_rep = max(cellfun(@(method_name) RP.existing_repetitions.(method_name), ...
-                    RP.all_full_stat_type_names));
-
-    % Update edge and network statistics for repetitions that might be new
-    for i_cell = 1:numel(current_batch)
-        i = current_batch{i_cell}; % Actual repetition index
-
-
-        % Only update if this repetition is new for at least one method
-        if i > max_existing_rep
-            % For Welford's algorithm, we need to track count
-            n = i;  % Current repetition number serves as count
-            
-            % Update sum
-            edge_level_stats = edge_level_stats + edge_stats_all{i_cell};
-            network_level_stats = network_level_stats + cluster_stats_all{i_cell};
-
-            if i == 1
-                continue;
-            end
-
-
-            % Calculate delta from old mean
-            old_mean_edge = edge_level_stats / (n - 1);
-            old_mean_network = network_level_stats / (n - 1);
-            
-            delta_edge = edge_stats_all{i_cell} - old_mean_edge;
-            delta_network = cluster_stats_all{i_cell} - old_mean_network;          
-            
-            % Update mean squared error using Welford's formula
-            new_mean_edge = edge_level_stats / n;
-            new_mean_network = network_level_stats / n;
-            
-            delta2_edge = edge_stats_all{i_cell} - new_mean_edge;
-            delta2_network = cluster_stats_all{i_cell} - new_mean_network;
-            
-            edge_mean_squared_error = edge_mean_squared_error + delta_edge .* delta2_edge;
-            network_mean_squared_error = network_mean_squared_error + delta_network .* delta2_network;
+    file_info = whos('-file', output_file);
+    if ismember('stats_n_folded', {file_info.name})
+        % Repetitions already in the sums and M2, saved with them: a batch whose
+        % stats were saved but not journaled before a crash is not folded twice
+        stats_n_folded = getfield(load(output_file, 'stats_n_folded'), 'stats_n_folded');
+    else
+        % Files created before the count was stored fold every repetition new for a method
+        stats_n_folded = max(cellfun(@(method_name) RP.existing_repetitions.(method_name), ...
+                        RP.all_full_stat_type_names));
+    end
 
-        end
+    % Repetitions of this batch that are not in the running moments yet
+    new_cells = find(cellfun(@(i) i > stats_n_folded, current_batch));
+
+    if ~isempty(new_cells)
+        % The file stores sums and Welford's M2 of the folded repetitions
+        edge_acc = running_stats_from_file(edge_level_stats, edge_mean_squared_error, stats_n_folded);
+        network_acc = running_stats_from_file(network_level_stats, network_mean_squared_error, stats_n_folded);
+
+        % Fold the whole batch in one pass and merge it into the running moments
+        edge_acc = accumulate_running_stats(edge_acc, ...
+            cell2mat(cellfun(@(x) x(:), edge_stats_all(new_cells), 'UniformOutput', false)));
+        network_acc = accumulate_running_stats(network_acc, ...
+            cell2mat(cellfun(@(x) x(:), cluster_stats_all(new_cells), 'UniformOutput', false)));
+
+        edge_level_stats = edge_acc.mean * edge_acc.n;
+        network_level_stats = network_acc.mean * network_acc.n;
+        edge_mean_squared_error = edge_acc.m2;
+        network_mean_squared_error = network_acc.m2;
+        stats_n_folded = edge_acc.n;
     end
     
-    % Save back to file - only the existing fields
+    % Save back to file - the folded count goes in the same save as the sums
     save(output_file, 'edge_level_stats', 'network_level_stats', ...
-        'edge_mean_squared_error', 'network_mean_squared_error', '-append');
+        'edge_mean_squared_error', 'network_mean_squared_error', 'stats_n_folded', '-append');
     
     %% Save method stuff
+    if check_if_result_journal(RP)
+        append_batch_to_result_journal(RP, output_file, all_pvals, all_pvals_neg, method_timing_all, ...
+            current_batch);
+        return;
+    end
+
     for stat_id = 1:length(RP.all_full_stat_type_names)
         method_name = RP.all_full_stat_type_names{stat_id};
     
@@ -136,4 +132,64 @@ function compact_file_append_sol_struct(RP, output_file, all_pvals, all_pvals_ne
     end
 
 
+end
+
+function acc = running_stats_from_file(stats_sum, mean_squared_error, n_done)
+    % Running moments accumulator from the sum and M2 kept in compact files
+    acc = init_running_stats(numel(stats_sum));
+    acc.n = n_done;
+    if n_done > 0
+        acc.mean = stats_sum(:) / n_done;
+        acc.m2 = mean_squared_error(:);
+    end
+end
+
+function append_batch_to_result_journal(RP, output_file, all_pvals, all_pvals_neg, method_timing_all, ...
+    current_batch)
+    % One journal record per method and new repetition, written in a single append
+
+    method_names = {};
+    repetitions = [];
+    times = [];
+    positives = {};
+    negatives = {};
+
+    for stat_id = 1:length(RP.all_full_stat_type_names)
+        method_name = RP.all_full_stat_type_names{stat_id};
+
+        existing_reps = RP.existing_repetitions.(method_name);
+        reps_to_save = current_batch(cellfun(@(x) x > existing_reps, current_batch));
+
+        for i_cell = 1:numel(reps_to_save)
+            i = reps_to_save{i_cell};  % repetition index
+            j = find(cellfun(@(x) isequal(x, i), current_batch));  % index in current_batch
+
+            method_names{end + 1} = method_name; %#ok<AGROW>
+            repetitions(end + 1) = i; %#ok<AGROW>
+            positives{end + 1} = significance_indicator(all_pvals{j}.(method_name), ...
+                RP.pthresh_second_level); %#ok<AGROW>
+            negatives{end + 1} = significance_indicator(all_pvals_neg{j}.(method_name), ...
+                RP.pthresh_second_level); %#ok<AGROW>
+
+            if isfield(method_timing_all{j}, method_name)
+                times(end + 1) = method_timing_all{j}.(method_name); %#ok<AGROW>
+            else
+                times(end + 1) = 0; %#ok<AGROW>
+            end
+        end
+    end
+
+    if ~isempty(method_names)
+        result_journal_cpp('append', get_result_journal_file(output_file), method_names, ...
+            repetitions, times, positives, negatives);
+    end
+
+end
+
+function sig_prob = significance_indicator(p_values, pthresh)
+    % Same thresholding as the method struct update above
+    sig_prob = 1 - p_values;  % Higher value = more significant
+    sig_prob(sig_prob < (1 - pthresh)) = 0;  % Zero out non-significant values
+    sig_prob(sig_prob > (1 - pthresh)) = 1; % One for significant
+    sig_prob = double(reshape(full(sig_prob), [], 1));
 end
\ No newline at end of file
@@ -0,0 +1,72 @@
+function compact_result_journal(output_file)
+%% compact_result_journal
+% Folds the result journal of a compact results file into its method structs and
+% meta_data.method_current_rep, then resets the journal. Does nothing if the file
+% has no journal.
+%
+% Inputs:
+%   - output_file: Results .mat file.
+%
+% Notes:
+%   - The journal generation is stored in meta_data.journal_generation together
+%     with the method structs. If MATLAB stops between that save and the journal
+%     reset, the next call sees the generation and only resets the journal, so
+%     repetitions are never counted twice.
+%
+% Dependencies:
+%   - result_journal_cpp (MEX)
+
+    journal_file = get_result_journal_file(output_file);
+    if ~exist(journal_file, 'file')
+        return;
+    end
+
+    journal = result_journal_cpp('read', journal_file);
+
+    temp_data = load(output_file, 'meta_data');
+    meta_data = temp_data.meta_data;
+
+    already_compacted = isfield(meta_data, 'journal_generation') && ...
+        meta_data.journal_generation == journal.generation;
+
+    if ~already_compacted && journal.n_records > 0
+        file_info = whos('-file', output_file);
+        file_vars = {file_info.name};
+
+        compacted = struct();
+        for m = 1:numel(journal.methods)
+            journaled = journal.methods(m);
+            method_name = journaled.name;
+
+            if ismember(method_name, file_vars)
+                loaded_data = load(output_file, method_name);
+                method_struct = loaded_data.(method_name);
+            else
+                method_struct = struct();
+                method_struct.total_time = 0;
+                method_struct.positives = zeros(numel(journaled.positives), 1);
+                method_struct.negatives = zeros(numel(journaled.negatives), 1);
+                method_struct.total_calculations = 0;
+            end
+
+            method_struct.positives = method_struct.positives + journaled.positives;
+            method_struct.negatives = method_struct.negatives + journaled.negatives;
+            method_struct.total_calculations = method_struct.total_calculations + journaled.total_calculations;
+            method_struct.total_time = method_struct.total_time + journaled.total_time;
+            compacted.(method_name) = method_struct;
+
+            if ~isfield(meta_data.method_current_rep, method_name) || ...
+                    meta_data.method_current_rep.(method_name) < journaled.max_repetition
+                meta_data.method_current_rep.(method_name) = journaled.max_repetition;
+            end
+        end
+
+        % Method structs and generation in a single save
+        meta_data.journal_generation = journal.generation;
+        compacted.meta_data = meta_data;
+        save(output_file, '-struct', 'compacted', '-append');
+    end
+
+    result_journal_cpp('reset', journal_file);
+
+end
@@ -2,9 +2,8 @@ function complete_file_append_sol_struct(RP, output_file, all_pvals, all_pvals_n
                 edge_stats_all, cluster_stats_all, method_timing_all, current_batch)
 
     %% Save edge and network level stuff
-    temp_data = load(output_file, 'edge_level_stats', 'network_level_stats');
-    edge_level_stats = temp_data.edge_level_stats;
-    network_level_stats = temp_data.network_level_stats;
+    file_info = whos('-file', output_file);
+    use_column_store = ~ismember('edge_level_stats', {file_info.name});
 
     % Get min existing repetition across all methods for edge/network stats
     min_existing_rep = inf;
@@ -13,19 +12,38 @@ function complete_file_append_sol_struct(RP, output_file, all_pvals, all_pvals_n
         min_existing_rep = min(min_existing_rep, RP.existing_repetitions.(method_name));
     end
     
-    % Update edge and network statistics for repetitions that might be new
-    for i_cell = 1:numel(current_batch)
-        i = current_batch{i_cell};  % Actual repetition index
-        
-        % Only update if this repetition is new for at least one method
-        if i > min_existing_rep
-            edge_level_stats(:, i) = edge_stats_all{i_cell};
-            network_level_stats(:, i) = cluster_stats_all{i_cell};
+    if use_column_store
+        % Column store: write only the new repetition columns
+        edge_store_file = get_column_store_file(output_file, 'edge_level_stats');
+        network_store_file = get_column_store_file(output_file, 'network_level_stats');
+
+        for i_cell = 1:numel(current_batch)
+            i = current_batch{i_cell};  % Actual repetition index
+
+            if i > min_existing_rep
+                write_column_store(edge_store_file, i, edge_stats_all{i_cell});
+                write_column_store(network_store_file, i, cluster_stats_all{i_cell});
+            end
+        end
+    else
+        temp_data = load(output_file, 'edge_level_stats', 'network_level_stats');
+        edge_level_stats = temp_data.edge_level_stats;
+        network_level_stats = temp_data.network_level_stats;
+
+        % Update edge and network statistics for repetitions that might be new
+        for i_cell = 1:numel(current_batch)
+            i = current_batch{i_cell};  % Actual repetition index
+            
+            % Only update if this repetition is new for at least one method
+            if i > min_existing_rep
+                edge_level_stats(:, i) = edge_stats_all{i_cell};
+                network_level_stats(:, i) = cluster_stats_all{i_cell};
+            end
         end
+        
+        save(output_file, 'edge_level_stats', 'network_level_stats', '-append');
     end
     
-    save(output_file, 'edge_level_stats', 'network_level_stats', '-append');
-    
     %% Define sig_threashold
     save_threshold = RP.save_significance_thresh;
 
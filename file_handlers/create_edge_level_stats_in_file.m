@@ -1,10 +1,20 @@
-function create_edge_level_stats_in_file(file_path, file_type, n_var, n_repetitions, edge_groups, n_networks)
+function create_edge_level_stats_in_file(file_path, file_type, n_var, n_repetitions, edge_groups, n_networks, ...
+    use_column_store)
+% With use_column_store, full files keep their per-repetition stats in column
+% store files that are created on the first write, so nothing is added here.
 
+    if nargin < 7
+        use_column_store = false;
+    end
 
     switch file_type
         
         case 'full_file'
 
+            if use_column_store
+                return;
+            end
+
             edge_level_stats = NaN(n_var, n_repetitions);
             network_level_stats = NaN(n_networks, 1);
 
@@ -17,9 +27,11 @@ function create_edge_level_stats_in_file(file_path, file_type, n_var, n_repetiti
 
             edge_mean_squared_error = zeros(n_var, 1);
             network_mean_squared_error = zeros(n_networks, 1);
+            % Repetitions in the sums and M2, written with them
+            stats_n_folded = 0;
 
             save(file_path, 'edge_level_stats', 'network_level_stats', ...
-                'edge_mean_squared_error', 'network_mean_squared_error', '-append');
+                'edge_mean_squared_error', 'network_mean_squared_error', 'stats_n_folded', '-append');
 
         otherwise
             error('File type not supported')
@@ -0,0 +1,110 @@
+function study_dir = export_runner_study(RP, X, Y)
+%% export_runner_study
+% **Description**
+% Writes the data and parameters of the current test and subsample size to a study
+% directory for the prisme_power command-line runner (prisme_core/apps). The runner
+% computes the pending repetitions of the supported C++ methods without MATLAB and
+% appends them to the result journal of the compact results file, which is folded
+% into the file by the next check_calculation_status or calculate_power call.
+%
+% **Inputs**
+% - `RP` (struct): Configuration after setup_benchmarking and check_calculation_status,
+%   with `native_runner_dir`, `existing_repetitions` and `ids_sampled`.
+% - `X` (matrix): Design matrix of all subjects, used by 'r' tests.
+% - `Y` (matrix): Brain data matrix (features x subjects).
+%
+% **Outputs**
+% - `study_dir` (string): Directory with Y, X, mask, edge_groups and ids_sampled
+%   column stores (.pcol) and study.cfg.
+%
+% **Notes**
+% - Only edge-level data is supported. Methods the runner does not implement are
+%   left out of the study and remain pending for MATLAB.
+% - The runner draws its own permutations, seeded per repetition from the exported
+%   seed, so results match the MATLAB path in distribution but not bit for bit.
+% - edge_level_stats and network_level_stats of the results file are not updated.
+%
+% **Dependencies**
+% - column_store_cpp (MEX)
+% - get_result_journal_file.m
+% - get_stage_profile_file.m, check_if_stage_profile.m
+
+    runner_methods = {'Size_cpp', 'Fast_TFCE_cpp', 'Constrained_cpp_FWER', 'Constrained_cpp_FDR', ...
+        'Parametric_FWER', 'Parametric_FDR'};
+
+    if ~strcmp(RP.variable_type, 'edge')
+        error('The native runner only supports edge-level data');
+    end
+
+    methods = RP.all_full_stat_type_names(ismember(RP.all_full_stat_type_names, runner_methods));
+    skipped = setdiff(RP.all_full_stat_type_names, runner_methods);
+    if ~isempty(skipped)
+        fprintf('Not exported, compute in MATLAB: %s\n', strjoin(skipped, ', '));
+    end
+
+    [~, output_file] = create_and_check_rep_file(RP.save_directory, RP.output, RP.test_name, ...
+        RP.test_type, RP.n_subs_subset, RP.testing, RP.ground_truth);
+    [~, study_name, ~] = fileparts(output_file);
+    study_dir = fullfile(RP.native_runner_dir, study_name);
+    if ~exist(study_dir, 'dir')
+        mkdir(study_dir);
+    end
+
+    % Regression tests gather the design rows of each repetition
+    if strcmp(RP.test_type, 'r')
+        design = 'subject';
+        X_export = X;
+    else
+        design = 'repetition';
+        X_export = RP.X_rep;
+    end
+
+    write_store(study_dir, 'Y', double(Y));
+    write_store(study_dir, 'X', double(X_export));
+    write_store(study_dir, 'mask', find(RP.mask));
+    write_store(study_dir, 'edge_groups', double(RP.edge_groups(RP.mask)));
+    write_store(study_dir, 'ids_sampled', double(RP.ids_sampled));
+
+    if isfield(RP, 'permutation_block_size')
+        permutation_block_size = RP.permutation_block_size;
+    else
+        permutation_block_size = 0;
+    end
+    closed_form_permutations = isfield(RP, 'closed_form_permutations') && RP.closed_form_permutations;
+
+    fid = fopen(fullfile(study_dir, 'study.cfg'), 'w');
+    if fid < 0
+        error('Could not write %s', fullfile(study_dir, 'study.cfg'));
+    end
+    fprintf(fid, '# %s, %d subjects per repetition\n', RP.test_name, RP.n_subs_subset);
+    fprintf(fid, 'test = %s\n', RP.nbs_test_stat);
+    fprintf(fid, 'design = %s\n', design);
+    fprintf(fid, 'contrast = %s\n', strtrim(sprintf('%.17g ', RP.nbs_contrast)));
+    fprintf(fid, 'n_nodes = %d\n', size(RP.mask, 1));
+    fprintf(fid, 'thresh = %.17g\n', RP.tthresh_first_level);
+    fprintf(fid, 'alpha = %.17g\n', RP.pthresh_second_level);
+    fprintf(fid, 'n_perms = %d\n', RP.n_perms);
+    fprintf(fid, 'permutation_block_size = %d\n', permutation_block_size);
+    fprintf(fid, 'closed_form_permutations = %d\n', closed_form_permutations);
+    fprintf(fid, 'n_repetitions = %d\n', RP.n_repetitions);
+    fprintf(fid, 'methods = %s\n', strjoin(methods, ', '));
+    for m = 1:numel(methods)
+        fprintf(fid, 'existing.%s = %d\n', methods{m}, RP.existing_repetitions.(methods{m}));
+    end
+    fprintf(fid, 'journal_file = %s\n', get_result_journal_file(output_file));
+    if check_if_stage_profile(RP)
+        fprintf(fid, 'stage_profile_file = %s\n', get_stage_profile_file(output_file));
+    end
+    fprintf(fid, 'batch_size = %d\n', RP.batch_size);
+    fprintf(fid, 'seed = %d\n', randi(intmax('int32')));
+    fclose(fid);
+
+    fprintf('Exported %s, run: prisme_power %s\n', study_dir, study_dir);
+
+end
+
+function write_store(study_dir, name, values)
+    store_file = fullfile(study_dir, [name '.pcol']);
+    column_store_cpp('create', store_file, size(values, 1), 'double');
+    column_store_cpp('append', store_file, values);
+end
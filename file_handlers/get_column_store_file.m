@@ -0,0 +1,8 @@
+function store_file = get_column_store_file(output_file, variable_name)
+% Column store file holding variable_name for a results file. It sits next to the
+% .mat file, so the pair can be moved together.
+
+    [file_dir, file_name, ~] = fileparts(output_file);
+    store_file = fullfile(file_dir, [file_name '_' variable_name '.pcol']);
+
+end
@@ -0,0 +1,7 @@
+function journal_file = get_result_journal_file(output_file)
+% Result journal of a results file, kept next to the .mat file.
+
+    [file_dir, file_name, ~] = fileparts(output_file);
+    journal_file = fullfile(file_dir, [file_name '_journal.prj']);
+
+end
@@ -0,0 +1,7 @@
+function profile_file = get_stage_profile_file(output_file)
+% Stage profile of a results file, kept next to the .mat file.
+
+    [file_dir, file_name, ~] = fileparts(output_file);
+    profile_file = fullfile(file_dir, [file_name '_stages.csv']);
+
+end
@@ -0,0 +1,20 @@
+function file_data = load_column_store_fields(file_data, file_path)
+% Adds the variables kept in column store files to data loaded from a results
+% file, so readers see the same fields as with a .mat only file. Repetitions not
+% written yet are NaN columns up to meta_data.n_repetitions, as in the .mat file.
+
+    if ~isfield(file_data, 'meta_data') || ~isfield(file_data.meta_data, 'column_store')
+        return;
+    end
+
+    store_variables = file_data.meta_data.column_store;
+    for i = 1:numel(store_variables)
+        columns = read_column_store(get_column_store_file(file_path, store_variables{i}));
+        if isfield(file_data.meta_data, 'n_repetitions') && ~isempty(columns) && ...
+                size(columns, 2) < file_data.meta_data.n_repetitions
+            columns(:, end + 1:file_data.meta_data.n_repetitions) = NaN;
+        end
+        file_data.(store_variables{i}) = columns;
+    end
+
+end
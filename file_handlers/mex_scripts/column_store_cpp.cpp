@@ -0,0 +1,199 @@
+/**
+ * column_store_cpp.cpp - MEX reader/writer for the PRISME columnar binary store
+ *
+ * A column store file is a fixed 64 byte header followed by contiguous columns of
+ * n_rows values each (double or single, column-major like MATLAB). Columns are
+ * only ever appended or overwritten in place, so adding a repetition costs the
+ * size of that repetition and not the size of the file. The header is rewritten
+ * after the column data, which means an interrupted write leaves the previous
+ * columns valid.
+ *
+ * Usage in MATLAB:
+ *   column_store_cpp('create', path, n_rows, class_name)
+ *   n_cols = column_store_cpp('append', path, columns)
+ *   n_cols = column_store_cpp('write', path, first_col, columns)
+ *   columns = column_store_cpp('read', path)
+ *   columns = column_store_cpp('read', path, col_idx)
+ *   info = column_store_cpp('info', path)
+ *
+ * Inputs:
+ *   path - File name of the store
+ *   n_rows - Number of values per column (e.g. number of edges)
+ *   class_name - 'double' or 'single' (default: 'double')
+ *   columns - n_rows x k matrix of the store class
+ *   first_col - 1-based column where columns are written; the store grows if needed
+ *               and skipped columns are NaN filled
+ *   col_idx - 1-based indices of the columns to read (default: all)
+ *
+ * Outputs:
+ *   n_cols - Number of columns in the store after the write
+ *   columns - n_rows x numel(col_idx) matrix, read through a read-only memory map
+ *   info - Struct with n_rows, n_cols, class and header_bytes. With header_bytes as
+ *          offset, memmapfile gives zero-copy access to the columns from MATLAB
+ *
+ * The format lives in prisme_core/include/prisme/column_store.hpp.
+ */
+
+#include "mex.h"
+#include "matrix.h"
+#include "prisme/column_store.hpp"
+
+#include <cstdint>
+#include <exception>
+#include <string>
+#include <vector>
+
+std::string get_string(const mxArray* arr, const char* name) {
+    if (!mxIsChar(arr)) {
+        mexErrMsgIdAndTxt("MATLAB:column_store:invalidInput", "%s must be a character array", name);
+    }
+    char* chars = mxArrayToString(arr);
+    std::string value(chars);
+    mxFree(chars);
+    return value;
+}
+
+prisme::StoreClass get_store_class(const mxArray* columns) {
+    if (mxIsDouble(columns) && !mxIsComplex(columns)) {
+        return prisme::StoreClass::Double;
+    }
+    if (mxIsSingle(columns) && !mxIsComplex(columns)) {
+        return prisme::StoreClass::Single;
+    }
+    mexErrMsgIdAndTxt("MATLAB:column_store:invalidInput", "columns must be a real double or single matrix");
+    return prisme::StoreClass::Double;
+}
+
+prisme::StoreInfo get_info(const std::string& path) {
+    std::string error;
+    prisme::StoreInfo info{0, 0, prisme::StoreClass::Double};
+    try {
+        info = prisme::read_column_store_info(path);
+    } catch (const std::exception& e) {
+        error = e.what();
+    }
+    if (!error.empty()) {
+        mexErrMsgIdAndTxt("MATLAB:column_store:ioError", "%s", error.c_str());
+    }
+    return info;
+}
+
+// Main MEX function
+void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[]) {
+    if (nrhs < 2) {
+        mexErrMsgIdAndTxt("MATLAB:column_store:invalidNumInputs",
+                "At least two inputs required: command, path");
+    }
+
+    const std::string command = get_string(prhs[0], "command");
+    const std::string path = get_string(prhs[1], "path");
+    std::string error;
+
+    if (command == "create") {
+        if (nrhs < 3 || nrhs > 4) {
+            mexErrMsgIdAndTxt("MATLAB:column_store:invalidNumInputs",
+                    "create requires path, n_rows and optionally class_name");
+        }
+        prisme::StoreClass store_class = prisme::StoreClass::Double;
+        if (nrhs == 4) {
+            const std::string name = get_string(prhs[3], "class_name");
+            if (name == "single") {
+                store_class = prisme::StoreClass::Single;
+            } else if (name != "double") {
+                mexErrMsgIdAndTxt("MATLAB:column_store:invalidInput", "class_name must be 'double' or 'single'");
+            }
+        }
+        try {
+            prisme::create_column_store(path, static_cast<uint64_t>(mxGetScalar(prhs[2])), store_class);
+        } catch (const std::exception& e) {
+            error = e.what();
+        }
+        if (!error.empty()) {
+            mexErrMsgIdAndTxt("MATLAB:column_store:ioError", "%s", error.c_str());
+        }
+
+    } else if (command == "append" || command == "write") {
+        const bool append = command == "append";
+        if (nrhs != (append ? 3 : 4)) {
+            mexErrMsgIdAndTxt("MATLAB:column_store:invalidNumInputs",
+                    append ? "append requires path and columns" : "write requires path, first_col and columns");
+        }
+        const mxArray* columns = prhs[append ? 2 : 3];
+        const prisme::StoreClass store_class = get_store_class(columns);
+
+        uint64_t first_col = 0;
+        if (!append) {
+            double first = mxGetScalar(prhs[2]);
+            if (first < 1) {
+                mexErrMsgIdAndTxt("MATLAB:column_store:invalidInput", "first_col must be a positive index");
+            }
+            first_col = static_cast<uint64_t>(first) - 1;
+        }
+
+        uint64_t n_cols = 0;
+        try {
+            n_cols = prisme::write_store_columns(path, first_col, mxGetData(columns), mxGetM(columns),
+                                                 mxGetN(columns), store_class, append);
+        } catch (const std::exception& e) {
+            error = e.what();
+        }
+        if (!error.empty()) {
+            mexErrMsgIdAndTxt("MATLAB:column_store:ioError", "%s", error.c_str());
+        }
+        plhs[0] = mxCreateDoubleScalar(static_cast<double>(n_cols));
+
+    } else if (command == "read") {
+        if (nrhs > 3) {
+            mexErrMsgIdAndTxt("MATLAB:column_store:invalidNumInputs",
+                    "read requires path and optionally col_idx");
+        }
+        const prisme::StoreInfo info = get_info(path);
+
+        std::vector<uint64_t> col_idx;
+        if (nrhs == 3) {
+            const mxArray* idx = prhs[2];
+            if (!mxIsDouble(idx)) {
+                mexErrMsgIdAndTxt("MATLAB:column_store:invalidInput", "col_idx must be a double vector");
+            }
+            const double* idx_data = mxGetPr(idx);
+            for (size_t i = 0; i < mxGetNumberOfElements(idx); i++) {
+                if (idx_data[i] < 1 || idx_data[i] > static_cast<double>(info.n_cols)) {
+                    mexErrMsgIdAndTxt("MATLAB:column_store:invalidInput",
+                            "col_idx must be between 1 and %llu", (unsigned long long)info.n_cols);
+                }
+                col_idx.push_back(static_cast<uint64_t>(idx_data[i]) - 1);
+            }
+        } else {
+            for (uint64_t c = 0; c < info.n_cols; c++) {
+                col_idx.push_back(c);
+            }
+        }
+
+        plhs[0] = mxCreateNumericMatrix(info.n_rows, col_idx.size(),
+                info.store_class == prisme::StoreClass::Single ? mxSINGLE_CLASS : mxDOUBLE_CLASS, mxREAL);
+        try {
+            prisme::read_store_columns(path, info, col_idx, mxGetData(plhs[0]));
+        } catch (const std::exception& e) {
+            error = e.what();
+        }
+        if (!error.empty()) {
+            mexErrMsgIdAndTxt("MATLAB:column_store:ioError", "%s", error.c_str());
+        }
+
+    } else if (command == "info") {
+        const prisme::StoreInfo info = get_info(path);
+        const char* fields[] = {"n_rows", "n_cols", "class", "header_bytes"};
+        plhs[0] = mxCreateStructMatrix(1, 1, 4, fields);
+        mxSetField(plhs[0], 0, "n_rows", mxCreateDoubleScalar(static_cast<double>(info.n_rows)));
+        mxSetField(plhs[0], 0, "n_cols", mxCreateDoubleScalar(static_cast<double>(info.n_cols)));
+        mxSetField(plhs[0], 0, "class", mxCreateString(prisme::store_class_name(info.store_class)));
+        mxSetField(plhs[0], 0, "header_bytes",
+                   mxCreateDoubleScalar(static_cast<double>(prisme::column_store_header_bytes)));
+
+    } else {
+        mexErrMsgIdAndTxt("MATLAB:column_store:invalidCommand",
+                "Unknown command '%s'. Use create, append, write, read or info", command.c_str());
+    }
+
+    (void)nlhs;
+}
@@ -0,0 +1,148 @@
+/**
+ * result_cache_cpp.cpp - MEX content-addressed cache of edge stats and permutation blocks
+ *
+ * Results of a repetition are stored under the hash of everything they depend on
+ * (dataset, sampled ids, design, contrast, seed), so a later run over the same
+ * inputs reads them back instead of computing them again. Entries are one file per
+ * key in the cache directory; the least recently used ones are evicted once the
+ * directory exceeds max_bytes. Workers may share the directory.
+ *
+ * Usage in MATLAB:
+ *   key = result_cache_cpp('key', part_1, part_2, ...)
+ *   [values, found] = result_cache_cpp('get', cache_dir, key)
+ *   result_cache_cpp('put', cache_dir, key, values, max_bytes)
+ *
+ * Inputs:
+ *   part_i - Numeric, logical or char arrays (or keys) the result depends on. Their
+ *            class, size and contents are hashed, in order
+ *   cache_dir - Directory of the cache, created if needed
+ *   key - Key returned by the 'key' command
+ *   values - Full real double matrix to store
+ *   max_bytes - Size budget of the cache directory
+ *
+ * Outputs:
+ *   key - 32 character hex string
+ *   values - The stored matrix, [] if key is not cached
+ *   found - True if key is cached
+ *
+ * The format lives in prisme_core/include/prisme/result_cache.hpp.
+ */
+
+#include "mex.h"
+#include "matrix.h"
+#include "prisme/result_cache.hpp"
+
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <limits>
+#include <string>
+
+std::string get_string(const mxArray* arr, const char* name) {
+    if (!mxIsChar(arr)) {
+        mexErrMsgIdAndTxt("MATLAB:result_cache:invalidInput", "%s must be a character array", name);
+    }
+    char* chars = mxArrayToString(arr);
+    std::string value(chars);
+    mxFree(chars);
+    return value;
+}
+
+// Class, dimensions and raw contents, so [1 2] and int32([1 2]) or [1; 2] differ
+void hash_part(prisme::ContentHash& hash, const mxArray* part, int index) {
+    if ((!mxIsNumeric(part) && !mxIsLogical(part) && !mxIsChar(part)) || mxIsSparse(part) || mxIsComplex(part)) {
+        mexErrMsgIdAndTxt("MATLAB:result_cache:invalidInput",
+                "Key part %d must be a full real numeric, logical or char array", index);
+    }
+    hash.update(std::string(mxGetClassName(part)));
+    const mwSize n_dims = mxGetNumberOfDimensions(part);
+    const mwSize* dims = mxGetDimensions(part);
+    for (mwSize d = 0; d < n_dims; d++) {
+        const uint64_t dim = dims[d];
+        hash.update(&dim, sizeof(dim));
+    }
+    hash.update(mxGetData(part), mxGetNumberOfElements(part) * mxGetElementSize(part));
+}
+
+// Main MEX function
+void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[]) {
+    if (nrhs < 1) {
+        mexErrMsgIdAndTxt("MATLAB:result_cache:invalidNumInputs", "A command is required: key, get or put");
+    }
+
+    const std::string command = get_string(prhs[0], "command");
+    std::string error;
+
+    if (command == "key") {
+        prisme::ContentHash hash;
+        for (int i = 1; i < nrhs; i++) {
+            hash_part(hash, prhs[i], i);
+        }
+        plhs[0] = mxCreateString(hash.hex().c_str());
+
+    } else if (command == "get") {
+        if (nrhs != 3) {
+            mexErrMsgIdAndTxt("MATLAB:result_cache:invalidNumInputs", "get requires cache_dir and key");
+        }
+        const std::string directory = get_string(prhs[1], "cache_dir");
+        const std::string key = get_string(prhs[2], "key");
+
+        prisme::CachedMatrix entry;
+        bool found = false;
+        try {
+            // Reads never evict, the budget does not apply
+            const prisme::ResultCache cache(directory, std::numeric_limits<uint64_t>::max());
+            found = cache.get(key, entry);
+        } catch (const std::exception& e) {
+            error = e.what();
+        }
+        if (!error.empty()) {
+            mexErrMsgIdAndTxt("MATLAB:result_cache:ioError", "%s", error.c_str());
+        }
+
+        if (found) {
+            plhs[0] = mxCreateDoubleMatrix(static_cast<mwSize>(entry.n_rows), static_cast<mwSize>(entry.n_cols),
+                                           mxREAL);
+            if (!entry.values.empty()) {
+                std::memcpy(mxGetPr(plhs[0]), entry.values.data(), entry.values.size() * sizeof(double));
+            }
+        } else {
+            plhs[0] = mxCreateDoubleMatrix(0, 0, mxREAL);
+        }
+        if (nlhs > 1) {
+            plhs[1] = mxCreateLogicalScalar(found);
+        }
+
+    } else if (command == "put") {
+        if (nrhs != 5) {
+            mexErrMsgIdAndTxt("MATLAB:result_cache:invalidNumInputs",
+                    "put requires cache_dir, key, values and max_bytes");
+        }
+        const std::string directory = get_string(prhs[1], "cache_dir");
+        const std::string key = get_string(prhs[2], "key");
+        const mxArray* values = prhs[3];
+        if (!mxIsDouble(values) || mxIsSparse(values) || mxIsComplex(values)) {
+            mexErrMsgIdAndTxt("MATLAB:result_cache:invalidInput", "values must be a full real double matrix");
+        }
+        if (!mxIsDouble(prhs[4]) || mxGetNumberOfElements(prhs[4]) != 1 || mxGetScalar(prhs[4]) < 1) {
+            mexErrMsgIdAndTxt("MATLAB:result_cache:invalidInput", "max_bytes must be a positive scalar");
+        }
+        const uint64_t max_bytes = static_cast<uint64_t>(mxGetScalar(prhs[4]));
+
+        try {
+            prisme::ResultCache cache(directory, max_bytes);
+            // mxGetN folds trailing dimensions, entries are stored as 2-D
+            cache.put(key, prisme::span<const double>(mxGetPr(values), mxGetNumberOfElements(values)),
+                      mxGetM(values), mxGetN(values));
+        } catch (const std::exception& e) {
+            error = e.what();
+        }
+        if (!error.empty()) {
+            mexErrMsgIdAndTxt("MATLAB:result_cache:ioError", "%s", error.c_str());
+        }
+
+    } else {
+        mexErrMsgIdAndTxt("MATLAB:result_cache:invalidCommand",
+                "Unknown command '%s'. Use key, get or put", command.c_str());
+    }
+}
@@ -0,0 +1,170 @@
+/**
+ * result_journal_cpp.cpp - MEX append-only journal of per-method repetition results
+ *
+ * Each batch appends one record per method and repetition (significance indicators
+ * stored sparsely, timing and repetition index) instead of loading and re-saving the
+ * method structs of the results file. Records carry a CRC32 and the journal header
+ * keeps the end of the last complete batch, which is only moved after the batch is
+ * written: an interrupted append is simply not part of the journal. The journal is
+ * folded into the results file by compact_result_journal.m and then reset.
+ *
+ * Usage in MATLAB:
+ *   result_journal_cpp('append', journal_file, method_names, repetitions, times, positives, negatives)
+ *   journal = result_journal_cpp('read', journal_file)
+ *   result_journal_cpp('reset', journal_file)
+ *
+ * Inputs:
+ *   journal_file - File name of the journal, created on the first append
+ *   method_names - Cell array with the method of each record
+ *   repetitions - Repetition index of each record
+ *   times - Computation time of each record
+ *   positives - Cell array with the positive effect significance vector of each record
+ *   negatives - Cell array with the negative effect significance vector of each record
+ *
+ * Outputs:
+ *   journal - Struct with fields
+ *     generation - Incremented by every reset, used to make compaction idempotent
+ *     n_records - Number of valid records
+ *     methods - Struct array with name, positives, negatives (sums over repetitions),
+ *               total_calculations, total_time and max_repetition. If a repetition was
+ *               journaled more than once for a method, only its last record counts
+ *
+ * The format lives in prisme_core/include/prisme/result_journal.hpp.
+ */
+
+#include "mex.h"
+#include "matrix.h"
+#include "prisme/result_journal.hpp"
+
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <string>
+#include <vector>
+
+mxArray* make_column(const std::vector<double>& values) {
+    mxArray* column = mxCreateDoubleMatrix(values.size(), 1, mxREAL);
+    if (!values.empty()) {
+        std::memcpy(mxGetPr(column), values.data(), values.size() * sizeof(double));
+    }
+    return column;
+}
+
+std::string get_string(const mxArray* arr, const char* name) {
+    if (!mxIsChar(arr)) {
+        mexErrMsgIdAndTxt("MATLAB:result_journal:invalidInput", "%s must be a character array", name);
+    }
+    char* chars = mxArrayToString(arr);
+    std::string value(chars);
+    mxFree(chars);
+    return value;
+}
+
+prisme::span<const double> as_span(const mxArray* arr) {
+    return {mxGetPr(arr), mxGetNumberOfElements(arr)};
+}
+
+// Main MEX function
+void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[]) {
+    if (nrhs < 2) {
+        mexErrMsgIdAndTxt("MATLAB:result_journal:invalidNumInputs",
+                "At least two inputs required: command, journal_file");
+    }
+
+    const std::string command = get_string(prhs[0], "command");
+    const std::string path = get_string(prhs[1], "journal_file");
+    std::string error;
+
+    if (command == "append") {
+        if (nrhs != 7) {
+            mexErrMsgIdAndTxt("MATLAB:result_journal:invalidNumInputs",
+                    "append requires journal_file, method_names, repetitions, times, positives and negatives");
+        }
+        const mxArray* names = prhs[2];
+        const mxArray* positives = prhs[5];
+        const mxArray* negatives = prhs[6];
+        const size_t n_records = mxGetNumberOfElements(prhs[3]);
+
+        if (!mxIsCell(names) || !mxIsCell(positives) || !mxIsCell(negatives) ||
+            !mxIsDouble(prhs[3]) || !mxIsDouble(prhs[4]) ||
+            mxGetNumberOfElements(names) != n_records || mxGetNumberOfElements(prhs[4]) != n_records ||
+            mxGetNumberOfElements(positives) != n_records || mxGetNumberOfElements(negatives) != n_records) {
+            mexErrMsgIdAndTxt("MATLAB:result_journal:invalidInput",
+                    "method_names, positives and negatives must be cells and repetitions, times doubles, "
+                    "all with one entry per record");
+        }
+
+        const double* repetitions = mxGetPr(prhs[3]);
+        const double* times = mxGetPr(prhs[4]);
+
+        std::vector<unsigned char> batch;
+        for (size_t r = 0; r < n_records; r++) {
+            const mxArray* pos = mxGetCell(positives, r);
+            const mxArray* neg = mxGetCell(negatives, r);
+            if (!pos || !neg || !mxIsDouble(pos) || !mxIsDouble(neg) || mxIsSparse(pos) || mxIsSparse(neg) ||
+                mxGetNumberOfElements(pos) != mxGetNumberOfElements(neg)) {
+                mexErrMsgIdAndTxt("MATLAB:result_journal:invalidInput",
+                        "positives and negatives of record %d must be full double vectors of the same size",
+                        static_cast<int>(r + 1));
+            }
+            prisme::encode_journal_record(batch, get_string(mxGetCell(names, r), "method_names"),
+                                          static_cast<uint32_t>(repetitions[r]), times[r], as_span(pos),
+                                          as_span(neg));
+        }
+
+        try {
+            prisme::append_journal_batch(path, batch);
+        } catch (const std::exception& e) {
+            error = e.what();
+        }
+        if (!error.empty()) {
+            mexErrMsgIdAndTxt("MATLAB:result_journal:ioError", "%s", error.c_str());
+        }
+
+    } else if (command == "read") {
+        prisme::JournalSummary journal;
+        try {
+            journal = prisme::read_journal(path);
+        } catch (const std::exception& e) {
+            error = e.what();
+        }
+        if (!error.empty()) {
+            mexErrMsgIdAndTxt("MATLAB:result_journal:ioError", "%s", error.c_str());
+        }
+
+        const std::vector<prisme::JournalMethodSummary>& methods = journal.methods;
+        const char* method_fields[] = {"name", "positives", "negatives", "total_calculations",
+                                       "total_time", "max_repetition"};
+        mxArray* method_array = mxCreateStructMatrix(1, methods.size(), 6, method_fields);
+        for (size_t m = 0; m < methods.size(); m++) {
+            mxSetField(method_array, m, "name", mxCreateString(methods[m].name.c_str()));
+            mxSetField(method_array, m, "positives", make_column(methods[m].positives));
+            mxSetField(method_array, m, "negatives", make_column(methods[m].negatives));
+            mxSetField(method_array, m, "total_calculations", mxCreateDoubleScalar(methods[m].total_calculations));
+            mxSetField(method_array, m, "total_time", mxCreateDoubleScalar(methods[m].total_time));
+            mxSetField(method_array, m, "max_repetition", mxCreateDoubleScalar(methods[m].max_repetition));
+        }
+
+        const char* fields[] = {"generation", "n_records", "methods"};
+        plhs[0] = mxCreateStructMatrix(1, 1, 3, fields);
+        mxSetField(plhs[0], 0, "generation", mxCreateDoubleScalar(static_cast<double>(journal.generation)));
+        mxSetField(plhs[0], 0, "n_records", mxCreateDoubleScalar(static_cast<double>(journal.n_records)));
+        mxSetField(plhs[0], 0, "methods", method_array);
+
+    } else if (command == "reset") {
+        try {
+            prisme::reset_journal(path);
+        } catch (const std::exception& e) {
+            error = e.what();
+        }
+        if (!error.empty()) {
+            mexErrMsgIdAndTxt("MATLAB:result_journal:ioError", "%s", error.c_str());
+        }
+
+    } else {
+        mexErrMsgIdAndTxt("MATLAB:result_journal:invalidCommand",
+                "Unknown command '%s'. Use append, read or reset", command.c_str());
+    }
+
+    (void)nlhs;
+}
@@ -0,0 +1,54 @@
+function [columns, store_map] = read_column_store(store_file, col_idx)
+% Reads a column store through memmapfile. Only the requested columns are
+% copied; store_map gives zero-copy access to every column as
+% store_map.Data.columns. A missing store has no columns yet.
+%
+% Inputs:
+%   - store_file: Column store file (see get_column_store_file).
+%   - col_idx: Columns to read, default all of them.
+%
+% Outputs:
+%   - columns: n_rows x numel(col_idx) matrix.
+%   - store_map: memmapfile of the store, [] when the store has no columns.
+
+    store_map = [];
+
+    if ~exist(store_file, 'file')
+        columns = zeros(0, 0);
+        return;
+    end
+
+    % Header: magic (8 bytes), version, class id (uint32), n_rows, n_cols (uint64)
+    fid = fopen(store_file, 'r');
+    magic = fread(fid, 8, '*uint8')';
+    header = fread(fid, 2, 'uint32=>double');
+    sizes = fread(fid, 2, 'uint64=>double');
+    fclose(fid);
+
+    if ~strcmp(char(magic(1:7)), 'PRSMCOL')
+        error('%s is not a column store file', store_file);
+    end
+
+    if header(2) == 2
+        store_class = 'single';
+    else
+        store_class = 'double';
+    end
+    n_rows = sizes(1);
+    n_cols = sizes(2);
+
+    if n_cols == 0
+        columns = zeros(n_rows, 0, store_class);
+        return;
+    end
+
+    store_map = memmapfile(store_file, 'Offset', 64, ...
+        'Format', {store_class, [n_rows, n_cols], 'columns'}, 'Repeat', 1);
+
+    if nargin < 2
+        columns = store_map.Data.columns;
+    else
+        columns = store_map.Data.columns(:, col_idx);
+    end
+
+end
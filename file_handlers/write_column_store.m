@@ -0,0 +1,15 @@
+function n_cols = write_column_store(store_file, first_col, columns)
+% Writes columns into a column store starting at column first_col. Only the new
+% columns are written; the store is created on the first write with the row
+% count and class of columns.
+%
+% Dependencies:
+% - column_store_cpp (MEX)
+
+    if ~exist(store_file, 'file')
+        column_store_cpp('create', store_file, size(columns, 1), class(columns));
+    end
+
+    n_cols = column_store_cpp('write', store_file, first_col, columns);
+
+end
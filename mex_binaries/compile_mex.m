@@ -26,7 +26,15 @@ source_files = {
     'statistical_methods/mex_scripts/sparse_size_pval_cpp.cpp', ...
     'statistical_methods/mex_scripts/sparse_tfce_cpp.cpp', ...
     'statistical_methods/mex_scripts/exact_tfce_cpp.cpp', ...
-    '/statistical_methods/mex_scripts/traditional_tfce_cpp.cpp'
+    '/statistical_methods/mex_scripts/traditional_tfce_cpp.cpp', ...
+    'statistical_methods/mex_scripts/unflatten_cpp.cpp', ...
+    'statistical_methods/mex_scripts/flatten_cpp.cpp', ...
+    'NBS_addon/NBSglm_cpp.cpp', ...
+    'file_handlers/mex_scripts/column_store_cpp.cpp', ...
+    'file_handlers/mex_scripts/result_journal_cpp.cpp', ...
+    'file_handlers/mex_scripts/result_cache_cpp.cpp', ...
+    'power_calculator_tools/mex_scripts/welford_accumulate_cpp.cpp', ...
+    'power_calculator_tools/mex_scripts/power_aggregate_cpp.cpp'
 };
 
 % Print header
@@ -53,7 +61,8 @@ for i = 1:length(source_files)
         [~, base_name, ~] = fileparts(source_files{i});
         
         fprintf('Compiling %s -> %s...\n', source_files{i}, base_name);
-        mex(source_path);
+        extra_flags = get_compile_flags(base_name);
+        mex(extra_flags{:}, source_path);
         
         fprintf('✓ Successfully compiled %s\n', base_name);
     catch ME
@@ -101,6 +110,54 @@ function clean_binary_directory(binary_dir)
     end
 end
 
+%% Helper function with the extra compiler flags of each source
+function extra_flags = get_compile_flags(base_name)
+    extra_flags = {};
+
+    % Kernels are thin adapters over prisme_core, whose sources are compiled in.
+    % The statistical kernels carry stage timers (stage_profile.cpp), the graph
+    % kernels keep their scratch buffers in a per-thread workspace (workspace.cpp) and
+    % take edge variables through the node pairs of the mask (edge_index.cpp).
+    switch base_name
+        case {'apply_tfce_cpp', 'exact_tfce_cpp', 'sparse_tfce_cpp', 'traditional_tfce_cpp'}
+            core_sources = {'tfce.cpp', 'edge_index.cpp', 'workspace.cpp', 'stage_profile.cpp'};
+        case {'size_pval_cpp', 'sparse_size_pval_cpp'}
+            core_sources = {'cluster_size.cpp', 'edge_index.cpp', 'workspace.cpp', 'stage_profile.cpp'};
+        case {'unflatten_cpp', 'flatten_cpp'}
+            core_sources = {'edge_index.cpp', 'workspace.cpp'};
+        case 'constrained_pval_cpp'
+            core_sources = {'constrained.cpp', 'stage_profile.cpp'};
+        case 'NBSglm_cpp'
+            core_sources = {'column_store.cpp', 'glm.cpp', 'stage_profile.cpp', 'streaming_glm.cpp', ...
+                'subset_stats.cpp'};
+        case 'column_store_cpp'
+            core_sources = {'column_store.cpp'};
+        case 'result_journal_cpp'
+            core_sources = {'result_journal.cpp'};
+        case 'result_cache_cpp'
+            core_sources = {'result_cache.cpp'};
+        otherwise
+            return;
+    end
+
+    core_dir = fullfile('..', 'prisme_core');
+    extra_flags = [{'-output', base_name, ['-I' fullfile(core_dir, 'include')], ...
+        'CXXFLAGS=$CXXFLAGS -std=c++17'}, fullfile(core_dir, 'src', core_sources)];
+
+    if strcmp(base_name, 'NBSglm_cpp')
+        % Eigen is header only, EIGEN_DIR overrides the usual install locations
+        eigen_dirs = {getenv('EIGEN_DIR'), '/usr/include/eigen3', ...
+            '/usr/local/include/eigen3', '/opt/homebrew/include/eigen3'};
+        for j = 1:length(eigen_dirs)
+            if ~isempty(eigen_dirs{j}) && isfolder(fullfile(eigen_dirs{j}, 'Eigen'))
+                extra_flags{end + 1} = ['-I' eigen_dirs{j}];
+                return;
+            end
+        end
+        fprintf('  Eigen not found, set EIGEN_DIR to the Eigen include directory\n');
+    end
+end
+
 %% Helper function to list compiled binaries
 function list_binaries(binary_dir)
     fprintf('Compiled MEX binaries:\n');
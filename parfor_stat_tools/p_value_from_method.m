@@ -22,6 +22,9 @@ function [pvals_rep, pvals_rep_neg] = p_value_from_method(STATS, GLM_stats)
 %   3. If permutation-based, load precomputed permutation data.
 %   4. Dynamically call run_method to compute p-values for the positive effect.
 %   5. Similarly, compute p-values for the negative effect by negating the test statistics.
+%      Permutation-based methods with update_null_two_tailed instead build both
+%      nulls from one read of the permutations (init_null, update_null_two_tailed,
+%      pvals_from_null), so the permutations are not processed twice.
 %
 % Author: Fabricio Cravo | Date: March 2025
       
@@ -39,7 +42,20 @@ function [pvals_rep, pvals_rep_neg] = p_value_from_method(STATS, GLM_stats)
         perm_data.permuted_network_data = [];
     end
 
-    
+    if method_instance.permutation_based && ismethod(method_instance, 'update_null_two_tailed')
+        null_acc = method_instance.init_null('statistical_parameters', STATS, ...
+            'edge_stats', edge_stats_rep, 'network_stats', cluster_stats_rep, ...
+            'glm_parameters', GLM_stats.parameters);
+        null_acc_neg = method_instance.init_null('statistical_parameters', STATS, ...
+            'edge_stats', -edge_stats_rep, 'network_stats', -cluster_stats_rep, ...
+            'glm_parameters', GLM_stats.parameters);
+        [null_acc, null_acc_neg] = method_instance.update_null_two_tailed(null_acc, null_acc_neg, ...
+            perm_data.permuted_data);
+        pvals_rep = method_instance.pvals_from_null(null_acc);
+        pvals_rep_neg = method_instance.pvals_from_null(null_acc_neg);
+        return;
+    end
+
     % Dynamically call the method from './statistical_methods/'
     % Positive effect pvalues
     pvals_rep = run_method(STATS.statistic_type, 'statistical_parameters', STATS, ...
@@ -0,0 +1,80 @@
+function [pvals_all, pvals_neg_all, elapsed_all] = p_values_from_permutation_stream(method_runs, GLM_stats)
+%% p_values_from_permutation_stream
+% Computes p-values for several permutation-based methods from a single pass over
+% the permutation stream of a repetition. Each block of permutations is generated
+% once, handed to every method's null accumulator (positive and negative effects),
+% and discarded.
+%
+% Inputs:
+%   - method_runs: Cell array of STATS structures, one per method, with the fields
+%                  statistic_type and submethods already set.
+%   - GLM_stats: Structure with edge_stats, cluster_stats, parameters and perm_stream
+%                (see create_permutation_stream).
+%
+% Outputs:
+%   - pvals_all: Cell array with the positive effect p-values of each method.
+%   - pvals_neg_all: Cell array with the negative effect p-values of each method.
+%   - elapsed_all: Time spent in each method (accumulator updates included), the
+%                  permutation generation itself is not attributed to any method.
+%
+% Workflow:
+%   1. Initialize the positive and negative null accumulators of every method.
+%   2. For each block of the stream, generate the permuted edge stats and update
+%      every accumulator (the negative side receives the negated block). Methods
+%      with update_null_two_tailed build both sides from one read of the block.
+%   3. Convert each accumulator into p-values.
+%
+% Dependencies:
+%   - next_permutation_block.m
+
+    n_methods = numel(method_runs);
+    method_instances = cell(1, n_methods);
+    null_acc = cell(1, n_methods);
+    null_acc_neg = cell(1, n_methods);
+    elapsed_all = zeros(1, n_methods);
+
+    edge_stats = GLM_stats.edge_stats;
+    cluster_stats = GLM_stats.cluster_stats;
+    perm_stream = GLM_stats.perm_stream;
+
+    for m = 1:n_methods
+        method_start_time = tic;
+        STATS = method_runs{m};
+        method_instances{m} = feval(STATS.statistic_type);
+
+        null_acc{m} = method_instances{m}.init_null('statistical_parameters', STATS, ...
+            'edge_stats', edge_stats, 'network_stats', cluster_stats, ...
+            'glm_parameters', GLM_stats.parameters);
+        null_acc_neg{m} = method_instances{m}.init_null('statistical_parameters', STATS, ...
+            'edge_stats', -edge_stats, 'network_stats', -cluster_stats, ...
+            'glm_parameters', GLM_stats.parameters);
+
+        elapsed_all(m) = elapsed_all(m) + toc(method_start_time);
+    end
+
+    for i_block = 1:perm_stream.n_blocks
+        permuted_block = next_permutation_block(perm_stream, i_block);
+
+        for m = 1:n_methods
+            method_start_time = tic;
+            if ismethod(method_instances{m}, 'update_null_two_tailed')
+                [null_acc{m}, null_acc_neg{m}] = method_instances{m}.update_null_two_tailed( ...
+                    null_acc{m}, null_acc_neg{m}, permuted_block);
+            else
+                null_acc{m} = method_instances{m}.update_null(null_acc{m}, permuted_block);
+                null_acc_neg{m} = method_instances{m}.update_null(null_acc_neg{m}, -permuted_block);
+            end
+            elapsed_all(m) = elapsed_all(m) + toc(method_start_time);
+        end
+    end
+
+    pvals_all = cell(1, n_methods);
+    pvals_neg_all = cell(1, n_methods);
+    for m = 1:n_methods
+        method_start_time = tic;
+        pvals_all{m} = method_instances{m}.pvals_from_null(null_acc{m});
+        pvals_neg_all{m} = method_instances{m}.pvals_from_null(null_acc_neg{m});
+        elapsed_all(m) = elapsed_all(m) + toc(method_start_time);
+    end
+
+end
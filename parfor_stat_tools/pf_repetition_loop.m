@@ -1,5 +1,5 @@
-function [edge_stats, cluster_stats, pvals_method, pvals_method_neg, method_timing] = ...
-    pf_repetition_loop(rep_id, X_subs, Y_subs, STATS, UI)
+function [edge_stats, cluster_stats, pvals_method, pvals_method_neg, method_timing, stage_timing] = ...
+    pf_repetition_loop(rep_id, X_subs, Y_subs, STATS, UI, edge_stats, cache_key)
 %% pf_repetition_loop
 % Description:
 % Executes a single repetition of the benchmarking loop by computing GLM
@@ -12,12 +12,22 @@ function [edge_stats, cluster_stats, pvals_method, pvals_method_neg, method_timi
 % - Y_subs (matrix): Brain data matrix (features × subjects) for the subset.
 % - RPc (parallel.pool.Constant): Constant-wrapped configuration structure.
 % - UI (struct): Structure containing NBS test configuration parameters.
+% - edge_stats (row vector, optional): Edge statistics computed for the whole
+%   batch by process_repetition_batches. If given, the GLM is not fit again.
+% - cache_key (char, optional): Result cache key of the repetition from
+%   process_repetition_batches. With STATS.result_cache, the edge statistics and
+%   permutations are read from the cache when present and stored otherwise.
 %
 % Outputs:
 % - edge_stats (matrix): GLM-derived edge-level statistics.
 % - cluster_stats (matrix or struct): Cluster-level statistics computed via NBS.
 % - pvals_method (struct): Struct containing positive p-values for each method.
 % - pvals_method_neg (struct): Struct containing negative p-values for each method.
+% - method_timing (struct): Time of each full method name.
+% - stage_timing (struct): Wall time of the `glm_fit`, `permutation_generation`
+%   and `methods` stages, and the number of `permutations` generated
+%   (streamed permutations are generated inside the methods stage, permutations
+%   read from the result cache are not counted).
 %
 % Workflow:
 % 1. Compute GLM statistics and permutation-based null distributions by calling
@@ -25,10 +35,18 @@ function [edge_stats, cluster_stats, pvals_method, pvals_method_neg, method_timi
 % 2. Extract edge and cluster statistics from the GLM output.
 % 3. For each statistical method skip computation if the current repetition
 % is already computed. Otherwise, compute p-values using p_value_from_method and store the results.
+% 4. When permutations are streamed (STATS.permutation_block_size > 0), the
+% permutation-based methods are deferred and evaluated together by
+% p_values_from_permutation_stream, so every permutation block is generated once.
 %
 % Dependencies:
 % - glm_and_perm_computation.m
+% - generate_permutation_for_repetition.m
 % - p_value_from_method.m
+% - check_if_permutation_stream.m
+% - create_permutation_stream.m
+% - p_values_from_permutation_stream.m
+% - result_cache_cpp (MEX, with the result cache)
 %
 % Notes:
 % - Negative p-values (pvals_method_neg) are computed for legacy reasons; currently,
@@ -38,9 +56,53 @@ function [edge_stats, cluster_stats, pvals_method, pvals_method_neg, method_timi
 % Author: Fabricio Cravo  
 % Date: March 2025
 
-    % Compute GLM and permutation
-    [GLM_stats, ~, ~] = glm_and_perm_computation( ...
-        X_subs, Y_subs, STATS, UI, STATS.is_permutation_based);
+    % Streamed permutations are generated on demand instead of materialized here
+    use_stream = check_if_permutation_stream(STATS);
+
+    stage_timing = struct('glm_fit', 0, 'permutation_generation', 0, 'methods', 0, 'permutations', 0);
+
+    if nargin < 6
+        edge_stats = [];
+    end
+    if nargin < 7
+        cache_key = '';
+    end
+    use_cache = ~isempty(cache_key) && isfield(STATS, 'result_cache');
+
+    % Compute GLM, permutations are timed on their own
+    stage_start_time = tic;
+    edge_stats_cached = false;
+    if use_cache
+        edge_stats_key = result_cache_cpp('key', cache_key, 'edge_stats');
+        [cached, edge_stats_cached] = result_cache_cpp('get', STATS.result_cache.directory, edge_stats_key);
+        if edge_stats_cached
+            edge_stats = cached;
+        end
+    end
+    [GLM_stats, GLM, ~] = glm_and_perm_computation(X_subs, Y_subs, STATS, UI, false, edge_stats);
+    if use_cache && ~edge_stats_cached
+        % Stored in the orientation glm_and_perm_computation takes them
+        result_cache_cpp('put', STATS.result_cache.directory, edge_stats_key, double(GLM_stats.edge_stats'), ...
+            STATS.result_cache.max_bytes);
+    end
+    stage_timing.glm_fit = toc(stage_start_time);
+
+    if STATS.is_permutation_based && ~use_stream
+        stage_start_time = tic;
+        [GLM_stats.perm_data, perm_cached] = repetition_permutations(GLM, STATS, cache_key, use_cache);
+        stage_timing.permutation_generation = toc(stage_start_time);
+        if ~perm_cached
+            stage_timing.permutations = STATS.n_perms;
+        end
+    end
+
+    if use_stream
+        if use_cache
+            GLM_stats.perm_stream = create_permutation_stream(GLM, STATS, cache_key);
+        else
+            GLM_stats.perm_stream = create_permutation_stream(GLM, STATS);
+        end
+    end
 
      % Assign computed statistics
     edge_stats = GLM_stats.edge_stats;
@@ -51,6 +113,9 @@ function [edge_stats, cluster_stats, pvals_method, pvals_method_neg, method_timi
     pvals_method_neg = struct();
 
     method_timing = struct();
+
+    % Permutation-based methods deferred to the permutation stream
+    stream_runs = {};
     
     % Compute p-values for each statistical method
     for stat_id = 1:length(STATS.all_cluster_stat_types)
@@ -95,6 +160,11 @@ function [edge_stats, cluster_stats, pvals_method, pvals_method_neg, method_timi
         
             STATS.submethods = struct();  % Just for consistency
         end
+
+        if use_stream && method_instance.permutation_based
+            stream_runs{end + 1} = STATS; %#ok<AGROW>
+            continue;
+        end
         
         method_start_time = tic;
 
@@ -102,30 +172,77 @@ function [edge_stats, cluster_stats, pvals_method, pvals_method_neg, method_timi
 
         method_elapsed_time = toc(method_start_time);
         
-        %% Assign pvals to results
-        if isstruct(pvals) && isstruct(pvals_neg)
-            submethods = fieldnames(pvals);
-            for i = 1:numel(submethods)
-                name = [STATS.statistic_type '_' submethods{i}];
-                pvals_method.(name) = pvals.(submethods{i});
-                pvals_method_neg.(name) = pvals_neg.(submethods{i});
+        [pvals_method, pvals_method_neg, method_timing] = assign_method_results(pvals_method, ...
+            pvals_method_neg, method_timing, STATS, pvals, pvals_neg, method_elapsed_time);
+        stage_timing.methods = stage_timing.methods + method_elapsed_time;
+    end
 
-                % Assign the same timing to each submethod that actually ran
-                if submethods_struct.(submethods{i})
-                    method_timing.(name) = method_elapsed_time;
-                end
-            end
-        elseif ~isstruct(pvals) && ~isstruct(pvals_neg)
-            % Simple vector case
-            pvals_method.(STATS.statistic_type) = pvals;
-            pvals_method_neg.(STATS.statistic_type) = pvals_neg;
+    % One pass over the permutation stream for all deferred methods
+    if ~isempty(stream_runs)
+        stage_start_time = tic;
+        [pvals_all, pvals_neg_all, elapsed_all] = p_values_from_permutation_stream(stream_runs, GLM_stats);
+        stage_timing.methods = stage_timing.methods + toc(stage_start_time);
+        stage_timing.permutations = STATS.n_perms;
 
-            % Store timing for the method
-            method_timing.(STATS.statistic_type) = method_elapsed_time;
-        else
-            error("Mismatch between pvals and pvals_neg: one is a struct and the other is not.");
+        for m = 1:numel(stream_runs)
+            [pvals_method, pvals_method_neg, method_timing] = assign_method_results(pvals_method, ...
+                pvals_method_neg, method_timing, stream_runs{m}, pvals_all{m}, pvals_neg_all{m}, ...
+                elapsed_all(m));
         end
     end
-    
  
 end
+
+function [perm_data, cached] = repetition_permutations(GLM, STATS, cache_key, use_cache)
+    %% Permutations of one repetition, from the result cache when it holds them
+    cached = false;
+    if use_cache
+        directory = STATS.result_cache.directory;
+        perm_key = result_cache_cpp('key', cache_key, 'permutations', STATS.n_perms);
+        % Network averages also depend on the edge groups
+        network_key = result_cache_cpp('key', cache_key, 'network_permutations', STATS.n_perms, ...
+            double(STATS.edge_groups), logical(STATS.mask));
+        [permuted_data, found] = result_cache_cpp('get', directory, perm_key);
+        if found
+            [permuted_network_data, cached] = result_cache_cpp('get', directory, network_key);
+        end
+        if cached
+            perm_data = struct('permuted_data', permuted_data, 'permuted_network_data', permuted_network_data);
+            return;
+        end
+    end
+
+    perm_data = generate_permutation_for_repetition(GLM, STATS);
+    if use_cache
+        max_bytes = STATS.result_cache.max_bytes;
+        result_cache_cpp('put', directory, perm_key, perm_data.permuted_data, max_bytes);
+        result_cache_cpp('put', directory, network_key, perm_data.permuted_network_data, max_bytes);
+    end
+end
+
+function [pvals_method, pvals_method_neg, method_timing] = assign_method_results(pvals_method, ...
+    pvals_method_neg, method_timing, STATS, pvals, pvals_neg, method_elapsed_time)
+    %% Assign pvals to results
+    if isstruct(pvals) && isstruct(pvals_neg)
+        submethods = fieldnames(pvals);
+        for i = 1:numel(submethods)
+            name = [STATS.statistic_type '_' submethods{i}];
+            pvals_method.(name) = pvals.(submethods{i});
+            pvals_method_neg.(name) = pvals_neg.(submethods{i});
+
+            % Assign the same timing to each submethod that actually ran
+            if STATS.submethods.(submethods{i})
+                method_timing.(name) = method_elapsed_time;
+            end
+        end
+    elseif ~isstruct(pvals) && ~isstruct(pvals_neg)
+        % Simple vector case
+        pvals_method.(STATS.statistic_type) = pvals;
+        pvals_method_neg.(STATS.statistic_type) = pvals_neg;
+
+        % Store timing for the method
+        method_timing.(STATS.statistic_type) = method_elapsed_time;
+    else
+        error("Mismatch between pvals and pvals_neg: one is a struct and the other is not.");
+    end
+end
@@ -49,6 +49,24 @@ network_based_tests('test_hcp_fc.mat')
 %% Test inference type from data
 data_inference_from_contrast_test()
 
+%% Test column store round trip
+column_store_test()
+
+%% Test result journal compaction
+result_journal_test()
+
+%% Test result cache keys and eviction
+result_cache_test()
+
+%% Test streaming moments accumulator
+running_stats_test()
+
+%% Test F-test degrees of freedom
+ftest_df_effect_test()
+
+%% Test several contrasts in one GLM call
+multiple_contrasts_test()
+
 %% Test power calculator
 % I am going to depracate this power test 
 % I need to rewrite it as a full pipeline 
@@ -0,0 +1,66 @@
+function acc = accumulate_running_stats(acc, new_data)
+%% accumulate_running_stats
+% Folds a batch of columns into a streaming moments accumulator, or merges two
+% accumulators (e.g. built by different workers) with Chan's parallel formula.
+%
+% Inputs:
+%   - acc: Accumulator from init_running_stats.
+%   - new_data: n_rows x k matrix with one column per repetition, or a second
+%               accumulator.
+%
+% Outputs:
+%   - acc: Updated accumulator. Sample variance is acc.m2 / (acc.n - 1).
+%
+% Notes:
+%   - Uses welford_accumulate_cpp when compiled. The MATLAB fallback handles the
+%     moments but not quantile sketches.
+
+    if exist('welford_accumulate_cpp', 'file') == 3
+        acc = welford_accumulate_cpp(acc, double(new_data));
+        return;
+    end
+
+    if isfield(acc, 'p2_p')
+        error('Quantile sketches require the compiled welford_accumulate_cpp MEX.');
+    end
+
+    if isstruct(new_data)
+        batch = new_data;
+    else
+        % Moments of the batch, merged below like a second accumulator
+        batch = struct();
+        batch.n = size(new_data, 2);
+        batch.mean = mean(new_data, 2);
+        deviation = new_data - batch.mean;
+        batch.m2 = sum(deviation.^2, 2);
+        if isfield(acc, 'm3')
+            batch.m3 = sum(deviation.^3, 2);
+            batch.m4 = sum(deviation.^4, 2);
+        end
+    end
+
+    if batch.n == 0
+        return;
+    end
+    if acc.n == 0
+        acc = batch;
+        return;
+    end
+
+    na = acc.n;
+    nb = batch.n;
+    n = na + nb;
+    delta = batch.mean - acc.mean;
+
+    if isfield(acc, 'm3')
+        acc.m4 = acc.m4 + batch.m4 + delta.^4 * na * nb * (na^2 - na * nb + nb^2) / n^3 + ...
+            6 * delta.^2 .* (na^2 * batch.m2 + nb^2 * acc.m2) / n^2 + ...
+            4 * delta .* (na * batch.m3 - nb * acc.m3) / n;
+        acc.m3 = acc.m3 + batch.m3 + delta.^3 * na * nb * (na - nb) / n^2 + ...
+            3 * delta .* (na * batch.m2 - nb * acc.m2) / n;
+    end
+    acc.m2 = acc.m2 + batch.m2 + delta.^2 * na * nb / n;
+    acc.mean = acc.mean + delta * nb / n;
+    acc.n = n;
+
+end
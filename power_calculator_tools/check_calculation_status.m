@@ -87,6 +87,9 @@ function [existing_repetitions, ids_sampled, meta_data] = check_calculation_stat
     
     if existence
 
+        % Fold results journaled by a previous (possibly interrupted) run
+        compact_result_journal(file_path);
+
         try
             loaded_data = load(file_path, 'meta_data');
     
@@ -124,7 +127,8 @@ function [existing_repetitions, ids_sampled, meta_data] = check_calculation_stat
                     n_additional_reps = required_reps - length(ids_sampled);
                     
                     % Draw only the additional repetitions needed
-                    new_ids = draw_repetition_ids(RP, 'n_reps', n_additional_reps);
+                    new_ids = draw_repetition_ids(RP, 'n_reps', n_additional_reps, ...
+                        'first_rep', size(ids_sampled, 2) + 1);
                     
                     % Append the new IDs to the existing ones
                     ids_sampled = [ids_sampled, new_ids];           
@@ -162,12 +166,18 @@ function [existing_repetitions, ids_sampled, meta_data] = check_calculation_stat
             meta_data.method_current_rep.(method_name) = 0;
         end
 
+        % Per-repetition stats go to column store files next to the results file
+        use_column_store = check_if_column_store(RP);
+        if use_column_store
+            meta_data.column_store = {'edge_level_stats', 'network_level_stats'};
+        end
+
         % Save initialized file
         if ~RP.test_disable_save
             meta_data = create_meta_data_file(file_path, meta_data, RP, ids_sampled, existing_repetitions);
 
             create_edge_level_stats_in_file(file_path, RP.subsample_file_type, ...
-                RP.n_var, RP.n_repetitions, RP.edge_groups, RP.n_networks)
+                RP.n_var, RP.n_repetitions, RP.edge_groups, RP.n_networks, use_column_store)
 
             fprintf('Initialized results file with repetition IDs: %s\n', file_path);
         end
@@ -0,0 +1,26 @@
+function use_batch_stats = check_if_batch_edge_stats(RP, Y)
+%% check_if_batch_edge_stats
+% **Description**
+% Determines whether the edge statistics of a whole batch are computed in one
+% `NBSglm_cpp('subsets', ...)` call instead of one GLM fit per repetition.
+%
+% **Inputs**
+% - `RP` (struct): Configuration structure containing:
+%   * `batch_edge_stats` (logical, optional): Requested mode, default false.
+%   * `test_type` (string): Only the `'t'`, `'pt'` and `'t2'` designs reduce to
+%     sums over the sampled subjects.
+%   * `ground_truth` (logical): The ground truth fits all subjects once.
+% - `Y` (matrix): Brain data, the MEX function reads double data only.
+%
+% **Outputs**
+% - `use_batch_stats` (logical): True if the batch path can be used.
+%
+% **Notes**
+% - Needs the compiled `NBSglm_cpp` MEX file, without it every repetition is fit.
+% - The statistics match the GLM to rounding, not bit for bit.
+
+    use_batch_stats = isfield(RP, 'batch_edge_stats') && RP.batch_edge_stats && ...
+        ismember(RP.test_type, {'t', 'pt', 't2'}) && ~RP.ground_truth && isa(Y, 'double') && ...
+        exist('NBSglm_cpp', 'file') == 3;
+
+end
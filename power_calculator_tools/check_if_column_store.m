@@ -0,0 +1,19 @@
+function use_column_store = check_if_column_store(RP)
+%% check_if_column_store
+% **Description**
+% Determines whether per-repetition edge and network statistics of a new results
+% file are written to column store files (.pcol) instead of the .mat file.
+%
+% **Inputs**
+% - `RP` (struct): Configuration structure containing:
+%   * `use_column_store` (logical, optional): Requested storage, default false.
+%   * `subsample_file_type` (string): Only 'full_file' keeps one column per repetition.
+%   * `ground_truth` (logical): Ground truth files hold a single repetition.
+%
+% **Outputs**
+% - `use_column_store` (logical): True if the column store should be used.
+
+    use_column_store = isfield(RP, 'use_column_store') && RP.use_column_store && ...
+        strcmp(RP.subsample_file_type, 'full_file') && ~RP.ground_truth;
+
+end
@@ -0,0 +1,23 @@
+function use_native_runner = check_if_native_runner(RP)
+%% check_if_native_runner
+% **Description**
+% Determines whether pending repetitions are exported for the prisme_power
+% command-line runner instead of being computed in MATLAB.
+%
+% **Inputs**
+% - `RP` (struct): Configuration structure containing:
+%   * `native_runner_dir` (string, optional): Export directory, default '' (disabled).
+%   * `use_result_journal`, `subsample_file_type`: The runner writes to the result
+%     journal of compact files only.
+%
+% **Outputs**
+% - `use_native_runner` (logical): True if the study should be exported.
+
+    use_native_runner = isfield(RP, 'native_runner_dir') && ~isempty(RP.native_runner_dir);
+
+    if use_native_runner && ~check_if_result_journal(RP)
+        error(['native_runner_dir requires subsample_file_type = ''compact_file'' ' ...
+            'and use_result_journal = true']);
+    end
+
+end
@@ -0,0 +1,22 @@
+function use_nested = check_if_nested_subsets(RP)
+%% check_if_nested_subsets
+% **Description**
+% Determines whether the sample sizes of `list_of_nsubset` use nested subject
+% subsets (n = 20 within 40 within 80 ...) drawn once per repetition.
+%
+% **Inputs**
+% - `RP` (struct): Configuration structure containing:
+%   * `nested_subsets` (logical, optional): Requested mode, default false.
+%   * `ground_truth` (logical): The ground truth uses every subject.
+%
+% **Outputs**
+% - `use_nested` (logical): True if the repetition IDs of all sizes come from one
+%   draw for the largest size.
+%
+% **Notes**
+% - Only applies to new results files. Files that already hold repetition IDs
+%   keep them, including the ones drawn without nesting.
+
+    use_nested = isfield(RP, 'nested_subsets') && RP.nested_subsets && ~RP.ground_truth;
+
+end
@@ -0,0 +1,35 @@
+function use_stream = check_if_permutation_stream(STATS)
+%% check_if_permutation_stream
+% Determines whether the permutations of a repetition can be streamed in blocks
+% instead of being materialized as a full n_var x n_perms matrix.
+%
+% Inputs:
+% - STATS: Struct with fields is_permutation_based, permutation_block_size and
+%   all_cluster_stat_types.
+%
+% Outputs:
+% - use_stream (logical): True if streaming is enabled and every permutation-based
+%   method implements the null accumulator interface (init_null, update_null and
+%   pvals_from_null).
+%
+% Notes:
+% - A single permutation-based method without the interface requires the full
+%   matrix, in which case the legacy materialized path is used for all methods.
+
+    use_stream = false;
+
+    if ~STATS.is_permutation_based || STATS.permutation_block_size <= 0
+        return;
+    end
+
+    for i = 1:length(STATS.all_cluster_stat_types)
+        method_instance = feval(STATS.all_cluster_stat_types{i});
+        
+        if method_instance.permutation_based && ~ismethod(method_instance, 'update_null')
+            return;
+        end
+    end
+
+    use_stream = true;
+
+end
@@ -0,0 +1,20 @@
+function use_result_cache = check_if_result_cache(RP)
+%% check_if_result_cache
+% **Description**
+% Determines whether the edge statistics and permutations of every repetition are
+% read from and written to the content-addressed result cache.
+%
+% **Inputs**
+% - `RP` (struct): Configuration structure containing:
+%   * `result_cache_dir` (string, optional): Cache directory, '' disables the cache.
+%
+% **Outputs**
+% - `use_result_cache` (logical): True if the result cache should be used.
+%
+% **Notes**
+% - Needs the compiled `result_cache_cpp` MEX file, without it nothing is cached.
+
+    use_result_cache = isfield(RP, 'result_cache_dir') && ~isempty(RP.result_cache_dir) && ...
+        exist('result_cache_cpp', 'file') == 3;
+
+end
@@ -0,0 +1,18 @@
+function use_result_journal = check_if_result_journal(RP)
+%% check_if_result_journal
+% **Description**
+% Determines whether method results of a batch are appended to the result journal
+% instead of being merged into the method structs of the results file.
+%
+% **Inputs**
+% - `RP` (struct): Configuration structure containing:
+%   * `use_result_journal` (logical, optional): Requested storage, default false.
+%   * `subsample_file_type` (string): The journal holds compact file results.
+%
+% **Outputs**
+% - `use_result_journal` (logical): True if the result journal should be used.
+
+    use_result_journal = isfield(RP, 'use_result_journal') && RP.use_result_journal && ...
+        strcmp(RP.subsample_file_type, 'compact_file');
+
+end
@@ -0,0 +1,21 @@
+function use_shared_store = check_if_shared_data_store(RP)
+%% check_if_shared_data_store
+% **Description**
+% Determines whether parallel workers read the sampled subject columns of Y from a
+% single memory-mapped column store instead of receiving a copy per repetition.
+%
+% **Inputs**
+% - `RP` (struct): Configuration structure containing:
+%   * `shared_data_store` (logical, optional): Requested mode, default false.
+%   * `parallel` (logical): Serial runs index Y in place already.
+%
+% **Outputs**
+% - `use_shared_store` (logical): True if Y should be written to a shared store.
+%
+% **Notes**
+% - Needs the compiled `column_store_cpp` MEX file, without it the copies are kept.
+
+    use_shared_store = isfield(RP, 'shared_data_store') && RP.shared_data_store && RP.parallel && ...
+        exist('column_store_cpp', 'file') == 3;
+
+end
@@ -0,0 +1,18 @@
+function record_stage_profile = check_if_stage_profile(RP)
+%% check_if_stage_profile
+% **Description**
+% Determines whether the stage times of each batch are appended to the stage
+% profile file of the results file.
+%
+% **Inputs**
+% - `RP` (struct): Configuration structure containing:
+%   * `record_stage_profile` (logical, optional): Requested profiling, default false.
+%   * `test_disable_save` (logical): Nothing is written in test runs.
+%
+% **Outputs**
+% - `record_stage_profile` (logical): True if stage times should be recorded.
+
+    record_stage_profile = isfield(RP, 'record_stage_profile') && RP.record_stage_profile && ...
+        ~RP.test_disable_save;
+
+end
@@ -0,0 +1,55 @@
+function perm_stream = create_permutation_stream(GLM, STATS, cache_key)
+%% create_permutation_stream
+% Describes the on-demand permutations of one repetition. Instead of holding the
+% full n_var x n_perms matrix, the stream is consumed in blocks of at most
+% STATS.permutation_block_size columns with next_permutation_block, so peak memory
+% is O(n_var * block_size).
+%
+% Inputs:
+% - GLM: Fitted GLM structure from NBSglm_setup_smn.
+% - STATS: Struct with fields n_perms, permutation_block_size and optionally
+%   closed_form_permutations, and result_cache when cache_key is given.
+% - cache_key (char, optional): Result cache key of the repetition.
+%
+% Outputs:
+% - perm_stream: Struct with fields:
+%       GLM: GLM used to regenerate the permutations.
+%       n_perms: Total number of permutations in the stream.
+%       block_size: Maximum number of permutation columns per block.
+%       n_blocks: Number of blocks needed to cover n_perms.
+%       seed: Seed of the stream, block i is generated from seed + i.
+%       use_cpp: True if the NBSglm_cpp MEX is available.
+%       closed_form: True if NBSglm_cpp computes the blocks in closed form where
+%       the design allows it (onesample and two group ttest without nuisance,
+%       score and intercept correlation designs).
+%       cache (with cache_key): Struct with the directory, max_bytes and key of
+%       the cached blocks, see next_permutation_block.
+%
+% Notes:
+% - With NBSglm_cpp the same seed always yields the same blocks. The MATLAB
+%   fallback uses the global random stream, as generate_permutation_for_repetition.
+% - With a cache key the seed is derived from it instead of drawn, so a block that
+%   was evicted from the cache is regenerated exactly (with NBSglm_cpp).
+
+    perm_stream = struct();
+    perm_stream.GLM = GLM;
+    perm_stream.n_perms = STATS.n_perms;
+    perm_stream.block_size = min(STATS.permutation_block_size, STATS.n_perms);
+    perm_stream.n_blocks = ceil(STATS.n_perms / max(perm_stream.block_size, 1));
+    perm_stream.use_cpp = exist('NBSglm_cpp', 'file') == 3;
+    perm_stream.closed_form = isfield(STATS, 'closed_form_permutations') && STATS.closed_form_permutations;
+
+    if nargin < 3 || isempty(cache_key)
+        perm_stream.seed = randi(intmax('int32'));
+        return;
+    end
+
+    % The first 28 bits of the key, seed + n_blocks stays below intmax('int32')
+    perm_stream.seed = hex2dec(cache_key(1:7));
+    perm_stream.cache = struct('directory', STATS.result_cache.directory, ...
+        'max_bytes', STATS.result_cache.max_bytes, ...
+        'key', result_cache_cpp('key', cache_key, 'permutation_stream', perm_stream.n_perms, ...
+            perm_stream.block_size, perm_stream.seed, double(perm_stream.use_cpp), ...
+            double(perm_stream.closed_form)));
+
+end
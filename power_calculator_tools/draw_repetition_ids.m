@@ -13,6 +13,12 @@ function ids_sampled = draw_repetition_ids(RP, varargin)
 %   * `n_repetitions` – number of repetitions.
 %   * `test_type` – type of test ('t', 't2', 'pt', 'r', etc.).
 %   * `ground_truth` – if true, all subject IDs are used.
+%   * `nested_ids` (optional) – draw for the largest size of a nested sweep, set
+%     by `run_benchmarking`. The ids are then the first `n_subs_subset` subjects
+%     of each group of its columns instead of a new draw.
+% - `n_reps` (name-value, optional): Number of repetitions (default: `n_repetitions`).
+% - `first_rep` (name-value, optional): First repetition, selects the columns of
+%   `nested_ids` when repetition IDs are expanded (default: 1).
 %
 % **Outputs**
 % - `ids_sampled` (matrix): Subject indices for each repetition. Size is 
@@ -28,14 +34,18 @@ function ids_sampled = draw_repetition_ids(RP, varargin)
 % **Notes**
 % - For `pt`, sampled indices are doubled with an offset to represent both time points.
 % - Sampling is random and without replacement (via `randperm`).
+% - A prefix of a random permutation is itself a uniform draw, so nested ids have
+%   the distribution of independent draws at every size.
 %
 % **Author**: Fabricio Cravo  
 % **Date**: March 2025
 
     p = inputParser;
     p.addParameter('n_reps', 0);
+    p.addParameter('first_rep', 1);
     p.parse(varargin{:});
     n_reps = p.Results.n_reps;
+    first_rep = p.Results.first_rep;
 
 
     if RP.ground_truth
@@ -46,6 +56,19 @@ function ids_sampled = draw_repetition_ids(RP, varargin)
     if n_reps == 0
         n_reps = RP.n_repetitions;
     end
+
+    % Nested sweep: first n_subs_subset subjects of each group of the largest draw
+    if isfield(RP, 'nested_ids')
+        reps = first_rep:(first_rep + n_reps - 1);
+        if ismember(RP.test_type, {'pt', 't2'})
+            n_max = size(RP.nested_ids, 1) / 2;
+            rows = [1:RP.n_subs_subset, n_max + (1:RP.n_subs_subset)];
+        else
+            rows = 1:RP.n_subs_subset;
+        end
+        ids_sampled = RP.nested_ids(rows, reps);
+        return;
+    end
     
     for r=1:n_reps
         
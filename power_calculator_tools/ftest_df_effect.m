@@ -0,0 +1,40 @@
+function df_effect = ftest_df_effect(GLM)
+%% ftest_df_effect
+% Description:
+% Numerator degrees of freedom of the F statistic of a GLM set up by
+% NBSglm_setup_smn. With the compiled NBSglm_cpp they come from the C++ design,
+% which fits the F statistics; otherwise they follow NBSglm_smn: the predictors
+% beyond the intercept, or the tested predictors beyond the reduced model.
+%
+% Inputs:
+% - GLM (struct): GLM structure from NBSglm_setup_smn with test 'ftest'.
+%
+% Outputs:
+% - df_effect (scalar): Numerator degrees of freedom of the F statistic.
+
+    if exist('NBSglm_cpp', 'file') == 3
+        % The df only depend on the design, no data is fit
+        GLM.y = zeros(GLM.n_observations, 0);
+        GLM.n_GLMs = 0;
+        [~, df_effect] = NBSglm_cpp(GLM);
+        return;
+    end
+
+    df_effect = matlab_df_effect(GLM);
+
+end
+
+
+function df_effect = matlab_df_effect(GLM)
+    if isempty(GLM.ind_nuisance)
+        df_effect = GLM.n_predictors - 1;
+        return;
+    end
+
+    % The reduced model drops its column of ones when the nuisance already spans it
+    X_new = [ones(GLM.n_observations, 1), GLM.X(:, GLM.ind_nuisance)];
+    df_effect = nnz(GLM.contrast) - 1;
+    if rank(X_new) < size(X_new, 2)
+        df_effect = nnz(GLM.contrast);
+    end
+end
@@ -1,5 +1,5 @@
 function [GLM_stats, GLM, STATS] = ...
-    glm_and_perm_computation(X_rep, Y_rep, STATS, UI, is_permutation_based)
+    glm_and_perm_computation(X_rep, Y_rep, STATS, UI, is_permutation_based, edge_stats)
 %% glm_and_perm_computation
 % Description:
 % Fits a general linear model (GLM) to the data and computes permutation‐based
@@ -14,6 +14,8 @@ function [GLM_stats, GLM, STATS] = ...
 %   mask, and edge_groups.
 % - UI (struct): Structure containing NBS parameters (design, contrast, etc.).
 % - is_permutation_based (logical): Flag indicating whether to generate permutation data.
+% - edge_stats (row vector, optional): Precomputed edge statistics of this design,
+%   e.g. from NBSglm_cpp('subsets', ...). The GLM is then only set up, not fit.
 %
 % Outputs:
 % - GLM_stats (struct): Structure containing edge and cluster statistics, and various GLM parameters.
@@ -37,6 +39,7 @@ function [GLM_stats, GLM, STATS] = ...
 % - unflatten_matrix.m
 % - get_network_average.m
 % - generate_permutation_for_repetition.m
+% - ftest_df_effect.m
 %
 % Notes:
 % - The computed edge and network statistics (= cluster) are transposed before storage.
@@ -56,7 +59,9 @@ function [GLM_stats, GLM, STATS] = ...
     
     % Find GLM and edge_stats
     GLM = NBSglm_setup_smn(nbs.GLM);
-    edge_stats = GLM_fit(GLM);
+    if nargin < 6 || isempty(edge_stats)
+        edge_stats = GLM_fit(GLM);
+    end
 
     % Compute network-based statistics
     flat_edge_groups = flat_matrix(STATS.edge_groups, STATS.mask);
@@ -77,10 +82,14 @@ function [GLM_stats, GLM, STATS] = ...
     GLM_stats.parameters.n_predictors = GLM.n_predictors;
     GLM_stats.parameters.n_GLMs = GLM.n_GLMs;
     GLM_stats.parameters.n_observations = GLM.n_observations;
+    if strcmp(GLM.test, 'ftest')
+        GLM_stats.parameters.df_effect = ftest_df_effect(GLM);
+    end
     
     % Generate precomputed permutations if required
     if is_permutation_based
         GLM_stats.perm_data = generate_permutation_for_repetition(GLM, STATS);
     end
 
-end
\ No newline at end of file
+end
+
@@ -0,0 +1,36 @@
+function acc = init_running_stats(n_rows, varargin)
+%% init_running_stats
+% Creates an empty streaming moments accumulator for accumulate_running_stats.
+%
+% Inputs:
+%   - n_rows: Number of statistics tracked (e.g. edges or networks).
+%   - 'higher_moments' (optional): Also track M3 and M4 (skewness, kurtosis). Default false.
+%   - 'quantile' (optional): Probability of a P-square quantile sketch per row,
+%                            [] for no sketch. Default [].
+%
+% Outputs:
+%   - acc: Struct with n, mean, m2 and the optional m3, m4, p2_p, p2_heights,
+%          p2_positions fields.
+
+    p = inputParser;
+    addParameter(p, 'higher_moments', false);
+    addParameter(p, 'quantile', []);
+    parse(p, varargin{:});
+
+    acc = struct();
+    acc.n = 0;
+    acc.mean = zeros(n_rows, 1);
+    acc.m2 = zeros(n_rows, 1);
+
+    if p.Results.higher_moments
+        acc.m3 = zeros(n_rows, 1);
+        acc.m4 = zeros(n_rows, 1);
+    end
+
+    if ~isempty(p.Results.quantile)
+        acc.p2_p = p.Results.quantile;
+        acc.p2_heights = zeros(n_rows, 5);
+        acc.p2_positions = zeros(n_rows, 5);
+    end
+
+end
@@ -0,0 +1,227 @@
+/**
+ * power_aggregate_cpp.cpp - MEX power (TPR/FPR) aggregation of all methods of a results file
+ *
+ * Counts the significant repetitions of every method (straight from the sparse
+ * sig_prob matrices of full files, or the running counts of compact files) and
+ * turns them into true and false positive rates against the ground truth effect
+ * maps, which are passed once and shared by all methods. Results match
+ * summarize_tprs('calculate_tpr', ...) method by method.
+ *
+ * Usage in MATLAB:
+ *   power_res = power_aggregate_cpp(methods, gt_edge, gt_network, alpha, tpr_dthresh)
+ *
+ * Inputs:
+ *   methods - Struct array, one element per method, with fields
+ *             level - 'variable', 'network' or 'whole_brain'
+ *             sig_prob, sig_prob_neg - Significance probabilities (variables x repetitions,
+ *                                      sparse or full) of full files, [] for compact files
+ *             positives, negatives - Significant repetition counts of compact files
+ *             n_reps - Number of repetitions the rates are computed over
+ *   gt_edge - Ground truth effect of each variable (edge_level_stats of the GT file)
+ *   gt_network - Ground truth effect of each network (network_level_stats of the GT file)
+ *   alpha - Significance level, a repetition counts if sig_prob > 1 - alpha
+ *   tpr_dthresh - Effect size threshold of the ground truth
+ *
+ * Outputs:
+ *   power_res - Struct array with positives_total, positives_total_neg, tpr and fpr
+ *               for each method, in percent of n_reps
+ */
+
+#include "mex.h"
+#include "matrix.h"
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <string>
+#include <vector>
+
+enum class StatLevel { Variable, Network, WholeBrain };
+
+// Significant repetitions per row of a sig_prob matrix
+std::vector<double> count_significant(const mxArray* sig_prob, double threshold) {
+    const size_t n_rows = mxGetM(sig_prob);
+    const size_t n_cols = mxGetN(sig_prob);
+    std::vector<double> counts(n_rows, 0.0);
+    const double* values = mxGetPr(sig_prob);
+
+    if (mxIsSparse(sig_prob)) {
+        // Only stored entries can exceed a positive threshold
+        const mwIndex* ir = mxGetIr(sig_prob);
+        const mwIndex* jc = mxGetJc(sig_prob);
+        for (size_t k = 0; k < jc[n_cols]; k++) {
+            if (values[k] > threshold) {
+                counts[ir[k]] += 1;
+            }
+        }
+        if (threshold < 0) {
+            // Implicit zeros are significant as well
+            for (size_t c = 0; c < n_cols; c++) {
+                std::vector<bool> stored(n_rows, false);
+                for (mwIndex k = jc[c]; k < jc[c + 1]; k++) {
+                    stored[ir[k]] = true;
+                }
+                for (size_t r = 0; r < n_rows; r++) {
+                    if (!stored[r]) {
+                        counts[r] += 1;
+                    }
+                }
+            }
+        }
+    } else {
+        for (size_t c = 0; c < n_cols; c++) {
+            const double* column = values + c * n_rows;
+            for (size_t r = 0; r < n_rows; r++) {
+                counts[r] += column[r] > threshold ? 1.0 : 0.0;
+            }
+        }
+    }
+    return counts;
+}
+
+std::vector<double> get_vector(const mxArray* arr) {
+    const double* data = mxGetPr(arr);
+    return std::vector<double>(data, data + mxGetNumberOfElements(arr));
+}
+
+StatLevel parse_level(const mxArray* level_arr, size_t m) {
+    if (!level_arr || !mxIsChar(level_arr)) {
+        mexErrMsgIdAndTxt("MATLAB:power_aggregate:invalidInput", "methods(%d).level must be a string",
+                static_cast<int>(m + 1));
+    }
+    char* chars = mxArrayToString(level_arr);
+    const std::string level(chars);
+    mxFree(chars);
+    if (level == "variable") {
+        return StatLevel::Variable;
+    }
+    if (level == "network") {
+        return StatLevel::Network;
+    }
+    if (level == "whole_brain") {
+        return StatLevel::WholeBrain;
+    }
+    mexErrMsgIdAndTxt("MATLAB:power_aggregate:invalidInput", "Stat level %s not supported", level.c_str());
+    return StatLevel::Variable;
+}
+
+const mxArray* get_field(const mxArray* methods, size_t m, const char* name) {
+    const mxArray* field = mxGetField(methods, m, name);
+    if (field && !mxIsEmpty(field) && !mxIsDouble(field)) {
+        mexErrMsgIdAndTxt("MATLAB:power_aggregate:invalidInput", "methods(%d).%s must be double",
+                static_cast<int>(m + 1), name);
+    }
+    return field && !mxIsEmpty(field) ? field : nullptr;
+}
+
+// Rates in the shape of the ground truth, NaN where the effect class does not apply
+mxArray* rates_from_counts(const std::vector<double>& positives, const std::vector<double>& negatives,
+                           const mxArray* gt, double tpr_dthresh, double n_reps, bool false_positives) {
+    const size_t n = mxGetNumberOfElements(gt);
+    if (positives.size() != n || negatives.size() != n) {
+        mexErrMsgIdAndTxt("MATLAB:power_aggregate:invalidDimensions",
+                "Method results and ground truth have different sizes");
+    }
+    const double* effect = mxGetPr(gt);
+    mxArray* rates = mxCreateDoubleMatrix(mxGetM(gt), mxGetN(gt), mxREAL);
+    double* out = mxGetPr(rates);
+
+    for (size_t i = 0; i < n; i++) {
+        bool is_pos = effect[i] > tpr_dthresh;
+        bool is_neg = effect[i] < -tpr_dthresh;
+        // False positives look at the complement, negative effects are assigned last
+        if (false_positives) {
+            is_pos = !is_pos;
+            is_neg = !is_neg;
+        }
+        double value = std::numeric_limits<double>::quiet_NaN();
+        if (is_pos) {
+            value = positives[i];
+        }
+        if (is_neg) {
+            value = negatives[i];
+        }
+        out[i] = value * 100 / n_reps;
+    }
+    return rates;
+}
+
+mxArray* make_column(const std::vector<double>& values) {
+    mxArray* column = mxCreateDoubleMatrix(values.size(), 1, mxREAL);
+    if (!values.empty()) {
+        std::memcpy(mxGetPr(column), values.data(), values.size() * sizeof(double));
+    }
+    return column;
+}
+
+// Main MEX function
+void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[]) {
+    if (nrhs != 5) {
+        mexErrMsgIdAndTxt("MATLAB:power_aggregate:invalidNumInputs",
+                "Five inputs required: methods, gt_edge, gt_network, alpha, tpr_dthresh");
+    }
+    const mxArray* methods = prhs[0];
+    const mxArray* gt_edge = prhs[1];
+    const mxArray* gt_network = prhs[2];
+    if (!mxIsStruct(methods) || !mxIsDouble(gt_edge) || !mxIsDouble(gt_network)) {
+        mexErrMsgIdAndTxt("MATLAB:power_aggregate:invalidInput",
+                "methods must be a struct array and the ground truth maps double arrays");
+    }
+    const double alpha = mxGetScalar(prhs[3]);
+    const double tpr_dthresh = mxGetScalar(prhs[4]);
+    const size_t n_methods = mxGetNumberOfElements(methods);
+
+    // Whole brain effect: any nonzero network effect, shared by all whole brain methods
+    bool whole_brain_effect = false;
+    const double* network_effect = mxGetPr(gt_network);
+    for (size_t i = 0; i < mxGetNumberOfElements(gt_network); i++) {
+        whole_brain_effect = whole_brain_effect || network_effect[i] > 0 || network_effect[i] < 0;
+    }
+
+    const char* fields[] = {"positives_total", "positives_total_neg", "tpr", "fpr"};
+    plhs[0] = mxCreateStructMatrix(1, n_methods, 4, fields);
+
+    for (size_t m = 0; m < n_methods; m++) {
+        const StatLevel level = parse_level(mxGetField(methods, m, "level"), m);
+        const mxArray* sig_prob = get_field(methods, m, "sig_prob");
+        const mxArray* sig_prob_neg = get_field(methods, m, "sig_prob_neg");
+        const mxArray* n_reps_arr = get_field(methods, m, "n_reps");
+        if (!n_reps_arr) {
+            mexErrMsgIdAndTxt("MATLAB:power_aggregate:invalidInput", "methods(%d).n_reps is missing",
+                    static_cast<int>(m + 1));
+        }
+        const double n_reps = mxGetScalar(n_reps_arr);
+
+        std::vector<double> positives;
+        std::vector<double> negatives;
+        if (sig_prob && sig_prob_neg) {
+            positives = count_significant(sig_prob, 1 - alpha);
+            negatives = count_significant(sig_prob_neg, 1 - alpha);
+        } else {
+            const mxArray* pos = get_field(methods, m, "positives");
+            const mxArray* neg = get_field(methods, m, "negatives");
+            if (!pos || !neg) {
+                mexErrMsgIdAndTxt("MATLAB:power_aggregate:invalidInput",
+                        "methods(%d) needs sig_prob and sig_prob_neg or positives and negatives",
+                        static_cast<int>(m + 1));
+            }
+            positives = get_vector(pos);
+            negatives = get_vector(neg);
+        }
+
+        mxSetField(plhs[0], m, "positives_total", make_column(positives));
+        mxSetField(plhs[0], m, "positives_total_neg", make_column(negatives));
+
+        if (level == StatLevel::WholeBrain) {
+            // All repetitions count as true positives if there is an effect, false otherwise
+            const double total = positives.empty() ? 0 : positives[0];
+            mxSetField(plhs[0], m, "tpr", mxCreateDoubleScalar(total * (whole_brain_effect ? 1 : 0) * 100 / n_reps));
+            mxSetField(plhs[0], m, "fpr", mxCreateDoubleScalar(total * (whole_brain_effect ? 0 : 1) * 100 / n_reps));
+        } else {
+            const mxArray* gt = level == StatLevel::Variable ? gt_edge : gt_network;
+            mxSetField(plhs[0], m, "tpr", rates_from_counts(positives, negatives, gt, tpr_dthresh, n_reps, false));
+            mxSetField(plhs[0], m, "fpr", rates_from_counts(positives, negatives, gt, tpr_dthresh, n_reps, true));
+        }
+    }
+
+    (void)nlhs;
+}
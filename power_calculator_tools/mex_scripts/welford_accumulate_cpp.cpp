@@ -0,0 +1,281 @@
+/**
+ * welford_accumulate_cpp.cpp - MEX streaming moments of edge and network statistics
+ *
+ * Keeps a running count, mean and sum of squared deviations (M2) per row, and
+ * optionally the third and fourth central moment sums (M3, M4) and a P-square
+ * quantile sketch. A whole batch of columns is folded in one pass, and two
+ * accumulators built on different workers are merged with Chan's parallel formula
+ * (Pebay's extension for M3 and M4).
+ *
+ * Usage in MATLAB:
+ *   acc = welford_accumulate_cpp(acc, columns)
+ *   acc = welford_accumulate_cpp(acc_a, acc_b)
+ *
+ * Inputs:
+ *   acc - Accumulator struct (see init_running_stats.m) with fields
+ *         n - Number of columns folded so far
+ *         mean, m2 - n_rows x 1
+ *         m3, m4 - n_rows x 1, only if higher moments are tracked
+ *         p2_p, p2_heights, p2_positions - quantile probability and the n_rows x 5
+ *         marker heights and positions, only if a quantile sketch is tracked
+ *   columns - n_rows x k double matrix, one column per repetition
+ *   acc_b - Second accumulator. Quantile sketches cannot be merged, so when either
+ *           accumulator has a sketch, one of the two must still be empty
+ *
+ * Outputs:
+ *   acc - Updated accumulator with the same fields. The sample variance is
+ *         m2 / (n - 1), skewness sqrt(n) * m3 / m2^1.5 and kurtosis n * m4 / m2^2
+ */
+
+#include "mex.h"
+#include "matrix.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <string>
+#include <vector>
+
+struct Accumulator {
+    double n = 0;
+    size_t n_rows = 0;
+    std::vector<double> mean;
+    std::vector<double> m2;
+    bool higher = false;
+    std::vector<double> m3;
+    std::vector<double> m4;
+    bool sketch = false;
+    double p2_p = 0.5;
+    std::vector<double> p2_heights;     // n_rows x 5, column-major
+    std::vector<double> p2_positions;   // n_rows x 5, column-major
+};
+
+// Pebay's single observation update of all tracked moments of row r
+inline void fold_value(Accumulator& acc, size_t r, double x, double n_new) {
+    const double n_old = n_new - 1;
+    const double delta = x - acc.mean[r];
+    const double delta_n = delta / n_new;
+    const double term1 = delta * delta_n * n_old;
+    acc.mean[r] += delta_n;
+    if (acc.higher) {
+        const double delta_n2 = delta_n * delta_n;
+        acc.m4[r] += term1 * delta_n2 * (n_new * n_new - 3 * n_new + 3) + 6 * delta_n2 * acc.m2[r] -
+                     4 * delta_n * acc.m3[r];
+        acc.m3[r] += term1 * delta_n * (n_new - 2) - 3 * delta_n * acc.m2[r];
+    }
+    acc.m2[r] += term1;
+}
+
+// P-square update (Jain and Chlamtac, 1985) of row r with its count-th observation
+void fold_sketch(Accumulator& acc, size_t r, double x, double count) {
+    const size_t R = acc.n_rows;
+    double* q = &acc.p2_heights[0];
+    double* pos = &acc.p2_positions[0];
+    auto Q = [&](int i) -> double& { return q[r + i * R]; };
+    auto P = [&](int i) -> double& { return pos[r + i * R]; };
+
+    // The first five observations initialize the markers
+    if (count <= 5) {
+        int k = static_cast<int>(count) - 1;
+        Q(k) = x;
+        for (int i = k; i > 0 && Q(i) < Q(i - 1); i--) {
+            std::swap(Q(i), Q(i - 1));
+        }
+        P(k) = count;
+        return;
+    }
+
+    int k;
+    if (x < Q(0)) {
+        Q(0) = x;
+        k = 0;
+    } else if (x >= Q(4)) {
+        Q(4) = std::max(Q(4), x);
+        k = 3;
+    } else {
+        k = 0;
+        while (k < 3 && x >= Q(k + 1)) {
+            k++;
+        }
+    }
+    for (int i = k + 1; i < 5; i++) {
+        P(i) += 1;
+    }
+
+    const double p = acc.p2_p;
+    const double increments[5] = {0, p / 2, p, (1 + p) / 2, 1};
+    for (int i = 1; i <= 3; i++) {
+        const double desired = 1 + (count - 1) * increments[i];
+        const double d = desired - P(i);
+        if ((d >= 1 && P(i + 1) - P(i) > 1) || (d <= -1 && P(i - 1) - P(i) < -1)) {
+            const double s = d > 0 ? 1 : -1;
+            // Parabolic prediction, linear if it would break the marker order
+            double candidate = Q(i) + s / (P(i + 1) - P(i - 1)) *
+                ((P(i) - P(i - 1) + s) * (Q(i + 1) - Q(i)) / (P(i + 1) - P(i)) +
+                 (P(i + 1) - P(i) - s) * (Q(i) - Q(i - 1)) / (P(i) - P(i - 1)));
+            if (!(Q(i - 1) < candidate && candidate < Q(i + 1))) {
+                const int j = i + static_cast<int>(s);
+                candidate = Q(i) + s * (Q(j) - Q(i)) / (P(j) - P(i));
+            }
+            Q(i) = candidate;
+            P(i) += s;
+        }
+    }
+}
+
+// Folds k columns of n_rows values; rows are independent, so the inner loop vectorizes
+void fold_columns(Accumulator& acc, const double* columns, size_t k) {
+    for (size_t c = 0; c < k; c++) {
+        const double* column = columns + c * acc.n_rows;
+        const double n_new = acc.n + 1;
+        for (size_t r = 0; r < acc.n_rows; r++) {
+            fold_value(acc, r, column[r], n_new);
+        }
+        if (acc.sketch) {
+            for (size_t r = 0; r < acc.n_rows; r++) {
+                fold_sketch(acc, r, column[r], n_new);
+            }
+        }
+        acc.n = n_new;
+    }
+}
+
+// Chan et al. pairwise merge of b into a
+void merge(Accumulator& a, const Accumulator& b) {
+    if (b.n == 0) {
+        return;
+    }
+    if (a.n == 0) {
+        a = b;
+        return;
+    }
+
+    const double na = a.n;
+    const double nb = b.n;
+    const double n = na + nb;
+    for (size_t r = 0; r < a.n_rows; r++) {
+        const double delta = b.mean[r] - a.mean[r];
+        const double delta2 = delta * delta;
+        if (a.higher) {
+            a.m4[r] += b.m4[r] + delta2 * delta2 * na * nb * (na * na - na * nb + nb * nb) / (n * n * n) +
+                       6 * delta2 * (na * na * b.m2[r] + nb * nb * a.m2[r]) / (n * n) +
+                       4 * delta * (na * b.m3[r] - nb * a.m3[r]) / n;
+            a.m3[r] += b.m3[r] + delta2 * delta * na * nb * (na - nb) / (n * n) +
+                       3 * delta * (na * b.m2[r] - nb * a.m2[r]) / n;
+        }
+        a.m2[r] += b.m2[r] + delta2 * na * nb / n;
+        a.mean[r] += delta * nb / n;
+    }
+    a.n = n;
+}
+
+bool has_field(const mxArray* s, const char* name) {
+    return mxGetField(s, 0, name) != nullptr;
+}
+
+std::vector<double> get_vector(const mxArray* s, const char* name, size_t expected) {
+    const mxArray* field = mxGetField(s, 0, name);
+    if (!field || !mxIsDouble(field) || mxGetNumberOfElements(field) != expected) {
+        mexErrMsgIdAndTxt("MATLAB:welford_accumulate:invalidInput",
+                "Accumulator field %s must be a double array with %d elements", name, static_cast<int>(expected));
+    }
+    const double* data = mxGetPr(field);
+    return std::vector<double>(data, data + expected);
+}
+
+Accumulator read_accumulator(const mxArray* s) {
+    if (!mxIsStruct(s) || !has_field(s, "n") || !has_field(s, "mean") || !has_field(s, "m2")) {
+        mexErrMsgIdAndTxt("MATLAB:welford_accumulate:invalidInput",
+                "Accumulator must be a struct with fields n, mean and m2");
+    }
+    Accumulator acc;
+    acc.n = mxGetScalar(mxGetField(s, 0, "n"));
+    acc.n_rows = mxGetNumberOfElements(mxGetField(s, 0, "mean"));
+    acc.mean = get_vector(s, "mean", acc.n_rows);
+    acc.m2 = get_vector(s, "m2", acc.n_rows);
+    acc.higher = has_field(s, "m3") && has_field(s, "m4");
+    if (acc.higher) {
+        acc.m3 = get_vector(s, "m3", acc.n_rows);
+        acc.m4 = get_vector(s, "m4", acc.n_rows);
+    }
+    acc.sketch = has_field(s, "p2_p");
+    if (acc.sketch) {
+        acc.p2_p = mxGetScalar(mxGetField(s, 0, "p2_p"));
+        if (!(acc.p2_p > 0 && acc.p2_p < 1)) {
+            mexErrMsgIdAndTxt("MATLAB:welford_accumulate:invalidInput", "p2_p must be between 0 and 1");
+        }
+        acc.p2_heights = get_vector(s, "p2_heights", acc.n_rows * 5);
+        acc.p2_positions = get_vector(s, "p2_positions", acc.n_rows * 5);
+    }
+    return acc;
+}
+
+mxArray* make_array(const std::vector<double>& values, size_t m, size_t n) {
+    mxArray* arr = mxCreateDoubleMatrix(m, n, mxREAL);
+    if (!values.empty()) {
+        std::memcpy(mxGetPr(arr), values.data(), values.size() * sizeof(double));
+    }
+    return arr;
+}
+
+mxArray* write_accumulator(const Accumulator& acc) {
+    std::vector<const char*> fields = {"n", "mean", "m2"};
+    if (acc.higher) {
+        fields.push_back("m3");
+        fields.push_back("m4");
+    }
+    if (acc.sketch) {
+        fields.push_back("p2_p");
+        fields.push_back("p2_heights");
+        fields.push_back("p2_positions");
+    }
+    mxArray* s = mxCreateStructMatrix(1, 1, static_cast<int>(fields.size()), fields.data());
+    mxSetField(s, 0, "n", mxCreateDoubleScalar(acc.n));
+    mxSetField(s, 0, "mean", make_array(acc.mean, acc.n_rows, 1));
+    mxSetField(s, 0, "m2", make_array(acc.m2, acc.n_rows, 1));
+    if (acc.higher) {
+        mxSetField(s, 0, "m3", make_array(acc.m3, acc.n_rows, 1));
+        mxSetField(s, 0, "m4", make_array(acc.m4, acc.n_rows, 1));
+    }
+    if (acc.sketch) {
+        mxSetField(s, 0, "p2_p", mxCreateDoubleScalar(acc.p2_p));
+        mxSetField(s, 0, "p2_heights", make_array(acc.p2_heights, acc.n_rows, 5));
+        mxSetField(s, 0, "p2_positions", make_array(acc.p2_positions, acc.n_rows, 5));
+    }
+    return s;
+}
+
+// Main MEX function
+void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[]) {
+    if (nrhs != 2) {
+        mexErrMsgIdAndTxt("MATLAB:welford_accumulate:invalidNumInputs",
+                "Two inputs required: acc and columns, or two accumulators");
+    }
+
+    Accumulator acc = read_accumulator(prhs[0]);
+
+    if (mxIsStruct(prhs[1])) {
+        Accumulator other = read_accumulator(prhs[1]);
+        if (other.n_rows != acc.n_rows || other.higher != acc.higher) {
+            mexErrMsgIdAndTxt("MATLAB:welford_accumulate:invalidInput",
+                    "Accumulators must have the same number of rows and tracked moments");
+        }
+        if ((acc.sketch || other.sketch) && acc.n > 0 && other.n > 0) {
+            mexErrMsgIdAndTxt("MATLAB:welford_accumulate:invalidInput",
+                    "Quantile sketches cannot be merged; fold the batch into one of the accumulators instead");
+        }
+        merge(acc, other);
+    } else {
+        const mxArray* columns = prhs[1];
+        if (!mxIsDouble(columns) || mxIsComplex(columns) || mxIsSparse(columns)) {
+            mexErrMsgIdAndTxt("MATLAB:welford_accumulate:invalidInput", "columns must be a full real double matrix");
+        }
+        if (mxGetM(columns) != acc.n_rows && mxGetNumberOfElements(columns) > 0) {
+            mexErrMsgIdAndTxt("MATLAB:welford_accumulate:invalidInput",
+                    "columns must have %d rows", static_cast<int>(acc.n_rows));
+        }
+        fold_columns(acc, mxGetPr(columns), mxGetNumberOfElements(columns) > 0 ? mxGetN(columns) : 0);
+    }
+
+    plhs[0] = write_accumulator(acc);
+    (void)nlhs;
+}
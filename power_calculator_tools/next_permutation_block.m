@@ -0,0 +1,54 @@
+function permuted_block = next_permutation_block(perm_stream, i_block)
+%% next_permutation_block
+% Generates block i_block of a permutation stream created by 
+% create_permutation_stream.
+%
+% Inputs:
+% - perm_stream: Stream descriptor from create_permutation_stream.
+% - i_block: Index of the block (1 to perm_stream.n_blocks).
+%
+% Outputs:
+% - permuted_block: Matrix (n_var x b) of permuted edge stats, where b is
+%   block_size except for the last block.
+%
+% Notes:
+% - With a cached stream (perm_stream.cache) the block is read from the result
+%   cache when present, and stored after it is generated otherwise.
+
+    if isfield(perm_stream, 'cache')
+        block_key = result_cache_cpp('key', perm_stream.cache.key, i_block);
+        [permuted_block, found] = result_cache_cpp('get', perm_stream.cache.directory, block_key);
+        if ~found
+            permuted_block = generate_block(perm_stream, i_block);
+            result_cache_cpp('put', perm_stream.cache.directory, block_key, double(permuted_block), ...
+                perm_stream.cache.max_bytes);
+        end
+        return;
+    end
+
+    permuted_block = generate_block(perm_stream, i_block);
+
+end
+
+function permuted_block = generate_block(perm_stream, i_block)
+    %% Block i_block of the stream from its seed (or the global stream without the MEX)
+    first_perm = (i_block - 1) * perm_stream.block_size + 1;
+    n_block = min(perm_stream.block_size, perm_stream.n_perms - first_perm + 1);
+
+    if perm_stream.use_cpp
+        if perm_stream.closed_form
+            permuted_block = NBSglm_cpp(perm_stream.GLM, n_block, perm_stream.seed + i_block, 'closed_form');
+        else
+            permuted_block = NBSglm_cpp(perm_stream.GLM, n_block, perm_stream.seed + i_block);
+        end
+        return;
+    end
+
+    permuted_block = zeros(perm_stream.GLM.n_GLMs, n_block);
+    for i = 1:n_block
+        permuted_GL = perm_stream.GLM;
+        permuted_GL.y = permute_signal(perm_stream.GLM);
+        permuted_block(:, i) = GLM_fit(permuted_GL);
+    end
+
+end
@@ -11,6 +11,13 @@ function process_repetition_batches(X, Y, RP, UI)
 % - `Y` (matrix): Brain connectivity data (edges × subjects).
 % - `RP` (struct): Configuration structure for benchmarking, includes:
 %   * `parallel` – use parallel execution (logical).
+%   * `shared_Y_file` (optional) – column store holding `Y`, set by `run_benchmarking`
+%     with `shared_data_store`. Workers then read their subject columns from it.
+%   * `batch_edge_stats` (optional) – compute the edge statistics of a batch in one
+%     call (see `check_if_batch_edge_stats`).
+%   * `result_cache_dir`, `result_cache_max_gb` (optional) – content-addressed cache
+%     of the edge statistics and permutations of every repetition (see
+%     `check_if_result_cache`).
 %   * `test_type`, `X_rep`, `batch_size`, `max_rep_pending`, etc.
 % - `UI` (struct): Structure with NBS test configuration (see `setup_benchmarking`).
 % - `RP.ids_sampled` (matrix): Subsampled subject indices (columns = repetitions).
@@ -19,9 +26,15 @@ function process_repetition_batches(X, Y, RP, UI)
 % 1. Split repetition IDs into batches of size `batch_size`.
 % 2. For each batch:
 %    - Subsample `X` and `Y` for each repetition.
+%    - With `batch_edge_stats`, compute the edge statistics of every repetition
+%      from the sums over its sampled subjects (`NBSglm_cpp('subsets', ...)`), or
+%      read them from the nested sweep of `run_benchmarking` (`RP.nested_edge_stats`).
+%    - With the result cache, hash the inputs of every repetition into its key.
 %    - Preallocate output containers (`pvals`, `stats`, etc.).
 %    - Execute `pf_repetition_loop` using either serial or parallel execution.
 %    - Save results incrementally via `save_incremental_results`.
+%    - With `RP.record_stage_profile`, append the stage times of the batch to the
+%      stage profile next to the results file.
 %
 % Outputs:
 % - Results are saved to disk in batches; no in-memory output is returned.
@@ -31,16 +44,49 @@ function process_repetition_batches(X, Y, RP, UI)
 % - `initialize_global_pvals.m`
 % - `pf_repetition_loop.m`
 % - `save_incremental_results.m`
+% - `check_if_stage_profile.m`
+% - `check_if_batch_edge_stats.m`
+% - `check_if_result_cache.m`
+% - `append_stage_profile.m`
 %
 % Notes:
 % - For test type `'r'`, `X` is subsampled; otherwise, `RP.X_rep` is reused.
 % - `RP` is passed as a `parallel.pool.Constant`(RPc) in parallel mode.
+% - With `RP.shared_Y_file` only the subject ids of a repetition are sent to the
+%   worker, which gathers those columns of `Y` from the memory-mapped store. The
+%   pages of the store are shared by every worker on the node.
+% - The batched edge statistics are one pair of matrix products for all
+%   repetitions of a batch. The GLM is still set up per repetition for the
+%   permutations, only its fit on the observed data is skipped.
+% - A repetition key hashes the data, its subject ids, design, contrast and tests.
+%   `Y` is hashed once per call. Adding a method to a finished study then reads the
+%   edge statistics and permutations of every repetition back from the cache, so
+%   it only costs the time of the new method.
 %
 % Author: Fabricio Cravo  
 % Date: March 2025
    
     batches_indexes = split_into_batches(RP.existing_repetitions, RP.max_rep_pending, RP.batch_size);
 
+    shared_Y_file = '';
+    if isfield(RP, 'shared_Y_file')
+        shared_Y_file = RP.shared_Y_file;
+    end
+
+    batch_edge_stats = check_if_batch_edge_stats(RP, Y);
+
+    use_result_cache = check_if_result_cache(RP);
+    if use_result_cache
+        dataset_key = result_cache_cpp('key', Y);
+    end
+
+    record_stage_profile = check_if_stage_profile(RP);
+    if record_stage_profile
+        [~, output_file] = create_and_check_rep_file(RP.save_directory, RP.output, RP.test_name, ...
+            RP.test_type, RP.n_subs_subset, RP.testing, RP.ground_truth);
+        profile_file = get_stage_profile_file(output_file);
+    end
+
     for i_bat = 1:numel(batches_indexes)
         batch = batches_indexes{i_bat};
         batch_size = numel(batches_indexes{i_bat});
@@ -48,29 +94,54 @@ function process_repetition_batches(X, Y, RP, UI)
         % Prealocate variables
         X_subs = cell(1, batch_size);
         Y_subs = cell(1, batch_size);
+        sub_ids = cell(1, batch_size);
+        rep_keys = repmat({''}, 1, batch_size);
 
         all_pvals = initialize_global_pvals(RP, batch_size);
         all_pvals_neg = initialize_global_pvals(RP, batch_size);
 
         method_timing_all = initialize_method_timming(RP, batch_size);
+        stage_timing_all = cell(1, batch_size);
 
         edge_stats_all = cell(1, batch_size);
         cluster_stats_all = cell(1, batch_size);
         
         % Prepare sub samples for this batch
+        subsample_start_time = tic;
         for j = 1:batch_size
             rep_id = batch{j};
         
             rep_sub_ids = RP.ids_sampled(:, rep_id);
-            Y_subs{j} = Y(:, rep_sub_ids);
+            sub_ids{j} = rep_sub_ids;
+            if isempty(shared_Y_file)
+                Y_subs{j} = Y(:, rep_sub_ids);
+            end
         
             if strcmp(RP.test_type, 'r')
                 X_subs{j} = X(rep_sub_ids, :);
             else
                 X_subs{j} = RP.X_rep;
             end
+
+            if use_result_cache
+                rep_keys{j} = repetition_cache_key(dataset_key, rep_sub_ids, X_subs{j}, RP, UI);
+            end
             
         end
+        subsample_time = toc(subsample_start_time);
+
+        % Edge statistics of all repetitions of the batch, one column each
+        batch_glm_time = 0;
+        edge_stats_batch = cell(1, batch_size);
+        if batch_edge_stats
+            batch_glm_start_time = tic;
+            t_stats = nested_batch_edge_stats(RP, [batch{:}]);
+            if isempty(t_stats)
+                t_stats = NBSglm_cpp('subsets', Y, RP.ids_sampled(:, [batch{:}]), RP.test_type);
+            end
+            edge_stats_batch = num2cell(t_stats', 2)';
+            batch_glm_time = toc(batch_glm_start_time);
+        end
 
         % Create empty STATS structure
         STATS = struct();
@@ -90,6 +161,17 @@ function process_repetition_batches(X, Y, RP, UI)
         STATS.all_submethods = RP.all_submethods;
         STATS.all_cluster_stat_types = RP.all_cluster_stat_types;
         STATS.is_permutation_based = RP.is_permutation_based; 
+        if isfield(RP, 'permutation_block_size')
+            STATS.permutation_block_size = RP.permutation_block_size;
+        else
+            STATS.permutation_block_size = 0;
+        end
+        STATS.closed_form_permutations = isfield(RP, 'closed_form_permutations') && ...
+            RP.closed_form_permutations;
+        if use_result_cache
+            STATS.result_cache = struct('directory', RP.result_cache_dir, ...
+                'max_bytes', result_cache_max_bytes(RP));
+        end
         STATS.thresh = RP.tthresh_first_level;
         STATS.alpha = RP.pthresh_second_level;
 
@@ -100,8 +182,11 @@ function process_repetition_batches(X, Y, RP, UI)
             for j = 1:batch_size
             rep_id = batch{j};
             
-            [edge_stats_all{j}, cluster_stats_all{j}, all_pvals{j}, all_pvals_neg{j}, method_timing_all{j}] = ...
-                pf_repetition_loop(rep_id, X_subs{j}, Y_subs{j}, STATSc.Value, UI);
+            Y_rep = repetition_brain_data(Y_subs{j}, shared_Y_file, sub_ids{j});
+            
+            [edge_stats_all{j}, cluster_stats_all{j}, all_pvals{j}, all_pvals_neg{j}, method_timing_all{j}, ...
+                stage_timing_all{j}] = pf_repetition_loop(rep_id, X_subs{j}, Y_rep, STATSc.Value, UI, ...
+                edge_stats_batch{j}, rep_keys{j});
     
             end
     
@@ -110,8 +195,11 @@ function process_repetition_batches(X, Y, RP, UI)
             parfor j = 1:batch_size
             rep_id = batch{j};
             
-            [edge_stats_all{j}, cluster_stats_all{j}, all_pvals{j}, all_pvals_neg{j}, method_timing_all{j}] = ...
-                pf_repetition_loop(rep_id, X_subs{j}, Y_subs{j}, STATSc.Value, UI);
+            Y_rep = repetition_brain_data(Y_subs{j}, shared_Y_file, sub_ids{j});
+            
+            [edge_stats_all{j}, cluster_stats_all{j}, all_pvals{j}, all_pvals_neg{j}, method_timing_all{j}, ...
+                stage_timing_all{j}] = pf_repetition_loop(rep_id, X_subs{j}, Y_rep, STATSc.Value, UI, ...
+                edge_stats_batch{j}, rep_keys{j});
           
             end
 
@@ -121,15 +209,100 @@ function process_repetition_batches(X, Y, RP, UI)
         check_pval_output_data(RP, all_pvals, all_pvals_neg);
         
         % Save
+        save_start_time = tic;
         if ~RP.test_disable_save
             save_incremental_results(RP, all_pvals, all_pvals_neg, ...
                                     edge_stats_all, cluster_stats_all, method_timing_all, batch)
         end
+        save_time = toc(save_start_time);
+
+        if record_stage_profile
+            append_stage_profile(profile_file, 'matlab', batch{1}, batch{end}, ...
+                batch_stages(stage_timing_all, subsample_time, batch_glm_time, save_time, Y_subs));
+        end
         fprintf('Repetition %d completed \n', batch{end});
 
     end 
 
+    % Fold the journaled batches into the results file
+    if check_if_result_journal(RP) && ~RP.test_disable_save
+        [~, output_file] = create_and_check_rep_file(RP.save_directory, RP.output, RP.test_name, ...
+            RP.test_type, RP.n_subs_subset, RP.testing, RP.ground_truth);
+        compact_result_journal(output_file);
+    end
+
     
   
 end
 
+function t_stats = nested_batch_edge_stats(RP, reps)
+    %% Edge statistics of the batch from the nested sweep, [] if its ids are not the nested ones
+    t_stats = [];
+    if ~isfield(RP, 'nested_edge_stats') || any(reps > size(RP.nested_ids, 2))
+        return;
+    end
+    % Results files drawn before nesting keep their own ids
+    if ismember(RP.test_type, {'pt', 't2'})
+        n_max = size(RP.nested_ids, 1) / 2;
+        rows = [1:RP.n_subs_subset, n_max + (1:RP.n_subs_subset)];
+    else
+        rows = 1:RP.n_subs_subset;
+    end
+    if ~isequal(RP.ids_sampled(:, reps), RP.nested_ids(rows, reps))
+        return;
+    end
+    t_stats = reshape(RP.nested_edge_stats(:, RP.nested_sizes == RP.n_subs_subset, reps), [], numel(reps));
+end
+
+function key = repetition_cache_key(dataset_key, rep_sub_ids, X_rep, RP, UI)
+    %% Result cache key of one repetition: everything its GLM fit depends on
+    test_stat = '';
+    if isfield(UI, 'test') && isfield(UI.test, 'ui')
+        test_stat = UI.test.ui;
+    end
+    exchange = '';
+    if isfield(UI, 'exchange') && isfield(UI.exchange, 'ui')
+        exchange = UI.exchange.ui;
+    end
+    key = result_cache_cpp('key', dataset_key, double(rep_sub_ids), X_rep, double(RP.nbs_contrast), ...
+        char(RP.test_type), char(test_stat), exchange);
+end
+
+function max_bytes = result_cache_max_bytes(RP)
+    %% Size budget of the result cache directory, 10 GB by default
+    max_gb = 10;
+    if isfield(RP, 'result_cache_max_gb')
+        max_gb = RP.result_cache_max_gb;
+    end
+    max_bytes = max_gb * 1e9;
+end
+
+function Y_rep = repetition_brain_data(Y_sub, shared_Y_file, rep_sub_ids)
+    %% Subsampled Y of one repetition, gathered from the shared store when there is one
+    if isempty(shared_Y_file)
+        Y_rep = Y_sub;
+    else
+        Y_rep = column_store_cpp('read', shared_Y_file, rep_sub_ids);
+    end
+end
+
+function stages = batch_stages(stage_timing_all, subsample_time, batch_glm_time, save_time, Y_subs)
+    %% Stage rows of one batch, summed over its repetitions
+    % Per-repetition stages are wall times of the workers, CPU time is not measured
+    timing = [stage_timing_all{:}];
+    n_reps = numel(timing);
+    subsample_bytes = sum(cellfun(@(y) numel(y) * 8, Y_subs));
+
+    stages = [ ...
+        stage_row('subsample', 1, subsample_time, subsample_bytes, 0), ...
+        stage_row('glm_fit', n_reps, batch_glm_time + sum([timing.glm_fit]), NaN, 0), ...
+        stage_row('permutation_generation', sum([timing.permutation_generation] > 0), ...
+            sum([timing.permutation_generation]), NaN, sum([timing.permutations])), ...
+        stage_row('methods', n_reps, sum([timing.methods]), NaN, 0), ...
+        stage_row('io', 1, save_time, NaN, 0)];
+end
+
+function row = stage_row(stage, calls, wall_time, bytes_allocated, permutations)
+    row = struct('stage', stage, 'calls', calls, 'wall_time', wall_time, 'cpu_time', NaN, ...
+        'bytes_allocated', bytes_allocated, 'permutations', permutations);
+end
@@ -30,14 +30,46 @@ function run_benchmarking(RP, Y, X)
 % - `draw_repetition_ids.m`
 % - `check_calculation_status.m`
 % - `process_repetition_batches.m`
+% - `export_runner_study.m` (when `native_runner_dir` is set)
+% - `write_column_store.m` (when `shared_data_store` is set)
+% - `check_if_nested_subsets.m`
 %
 % **Notes**
 % - Updates `RP` with fields like `existing_repetitions` and `max_rep_pending`.
 % - Skips processing if no repetitions are pending for a method.
+% - With `shared_data_store`, Y is written once to a temporary column store that
+%   parallel workers map read-only (`RP.shared_Y_file`). It is deleted on return.
+% - With `nested_subsets`, the subjects of each repetition are drawn once for the
+%   largest size (`RP.nested_ids`), and every size uses the first subjects of that
+%   draw. Power curves then compare the sizes on the same subjects.
+% - With `nested_subsets` and `batch_edge_stats`, the edge statistics of all sizes
+%   are computed in one sweep before the loop (`RP.nested_edge_stats`, n_var x
+%   n_sizes x n_repetitions) and every size reads its own.
 %
 % **Author**: Fabricio Cravo  
 % **Date**: March 2025
 
+    % Parallel workers gather their subject columns from one mapped copy of Y
+    if check_if_shared_data_store(RP)
+        RP.shared_Y_file = [tempname '.pcol'];
+        write_column_store(RP.shared_Y_file, 1, Y);
+        cleanup_shared_Y = onCleanup(@() delete(RP.shared_Y_file)); %#ok<NASGU>
+    end
+
+    % Nested sweep: one draw per repetition, smaller sizes take its first subjects
+    if check_if_nested_subsets(RP)
+        RP_largest = RP;
+        RP_largest.n_subs_subset = max([RP.list_of_nsubset{:}]);
+        RP.nested_ids = draw_repetition_ids(RP_largest);
+
+        % Edge statistics of every size in one pass over the nested draw, each
+        % subject is added to the sums once per repetition
+        if check_if_batch_edge_stats(RP, Y)
+            RP.nested_sizes = unique([RP.list_of_nsubset{:}]);
+            RP.nested_edge_stats = NBSglm_cpp('subsets', Y, RP.nested_ids, RP.test_type, RP.nested_sizes);
+        end
+    end
+
     for id_nsub_list = 1:length(RP.list_of_nsubset)
         RP.n_subs_subset = RP.list_of_nsubset{id_nsub_list};
         RP = set_n_subs_subset(RP);
@@ -68,6 +100,12 @@ function run_benchmarking(RP, Y, X)
             continue;
         end
 
+        % Pending repetitions go to the command-line runner instead
+        if check_if_native_runner(RP)
+            export_runner_study(RP, X, Y);
+            continue;
+        end
+
         fprintf('Computing repetitions for test "%s", subsample size %d: %s\n', ...
                 RP.test_name, RP.n_subs_subset, jsonencode(num_pending_per_method));
 
@@ -56,6 +56,11 @@ function save_incremental_results(RP, all_pvals, all_pvals_neg, ...
     end
     
     %% Update repetition calculations in meta_data
+    % Journaled results update meta_data when the journal is compacted
+    if check_if_result_journal(RP)
+        return;
+    end
+
     temp_data = load(output_file, 'meta_data');
            
     % Update meta_data with existing data
@@ -18,7 +18,9 @@ function p_uncorr = tcdf_computation(GLM, edge_stats__target)
             p_uncorr = tcdf(-edge_stats__target, df);
     
         case 'ftest'
-            error('F-test currently not supported.');
+            % Upper tail of the F distribution, df_effect is set with the GLM
+            df = GLM.n_observations - GLM.n_predictors;
+            p_uncorr = fcdf(edge_stats__target, GLM.df_effect, df, 'upper');
     
         otherwise
             error('Invalid GLM test type: %s', GLM.test);
@@ -58,7 +58,16 @@ function unflat_matrix = unflatten_matrix(mask, varargin)
         % Standard legacy unflatten stategy
         otherwise
 
-            unflat_matrix = @(x) roi_roi_unflat(x, mask);
+            % The MEX keeps the node pairs of the mask between calls. It needs each
+            % node pair once and off the diagonal, as the upper triangle masks are.
+            if exist('unflatten_cpp', 'file') == 3 && ismatrix(mask) && ...
+                    size(mask, 1) == size(mask, 2) && ~any(diag(mask)) && ~any(any(mask & mask'))
+                mask_index = find(mask);
+                n_nodes = size(mask, 1);
+                unflat_matrix = @(x) unflatten_cpp(double(x(:)), mask_index, n_nodes);
+            else
+                unflat_matrix = @(x) roi_roi_unflat(x, mask);
+            end
 
     end
 
@@ -0,0 +1,95 @@
+/**
+ * prisme_power.cpp - Command-line power calculation runner
+ *
+ * Computes the pending repetitions of a study exported by export_runner_study.m
+ * without MATLAB and journals them next to the compact results file. The next
+ * MATLAB run (or calculate_power) folds the journal into the results file.
+ *
+ * Usage:
+ *   prisme_power <study_dir> [--threads N] [--journal FILE] [--profile FILE] [--seed S] [--reps N]
+ *
+ * Options override the matching study.cfg keys (n_threads, journal_file,
+ * stage_profile_file, seed and n_repetitions). The stage profile rows of the
+ * study load have repetition 0.
+ */
+
+#include "prisme/power_runner.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <exception>
+#include <string>
+
+namespace {
+
+void print_usage() {
+    std::fprintf(stderr,
+                 "Usage: prisme_power <study_dir> [--threads N] [--journal FILE] [--profile FILE] [--seed S] "
+                 "[--reps N]\n");
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    if (argc < 2 || std::string(argv[1]) == "--help") {
+        print_usage();
+        return argc < 2 ? 1 : 0;
+    }
+
+    const std::string study_dir = argv[1];
+    try {
+        prisme::RunnerConfig config = prisme::read_runner_config(study_dir + "/study.cfg");
+
+        for (int i = 2; i < argc; i++) {
+            const std::string option = argv[i];
+            if (i + 1 >= argc) {
+                print_usage();
+                return 1;
+            }
+            const std::string value = argv[++i];
+            if (option == "--threads") {
+                config.n_threads = std::max(std::atoi(value.c_str()), 1);
+            } else if (option == "--journal") {
+                config.journal_file = value;
+            } else if (option == "--profile") {
+                config.stage_profile_file = value;
+            } else if (option == "--seed") {
+                config.seed = std::strtoull(value.c_str(), nullptr, 10);
+            } else if (option == "--reps") {
+                config.n_repetitions = std::atoi(value.c_str());
+            } else {
+                print_usage();
+                return 1;
+            }
+        }
+
+        prisme::StageProfile load_profile;
+        prisme::Study study;
+        {
+            prisme::ProfileScope profile_scope(&load_profile);
+            study = prisme::load_study(study_dir, config);
+        }
+        if (!config.stage_profile_file.empty()) {
+            prisme::append_stage_profile(config.stage_profile_file, "prisme_power", 0, 0, load_profile);
+        }
+        std::printf("Study %s: %zu variables, %zu subjects, %zu observations per repetition\n",
+                    study_dir.c_str(), study.n_var, study.n_subjects, study.n_observations);
+
+        const auto start = std::chrono::steady_clock::now();
+        const int n_computed = prisme::run_power_repetitions(study, config);
+        const double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        if (n_computed == 0) {
+            std::printf("All repetitions already computed\n");
+        } else {
+            std::printf("Computed %d repetitions in %.1f s, results journaled in %s\n", n_computed, elapsed,
+                        config.journal_file.c_str());
+        }
+    } catch (const std::exception& e) {
+        std::fprintf(stderr, "prisme_power: %s\n", e.what());
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,109 @@
+/**
+ * bench_cluster_size.cpp - Connected components of the Size method
+ */
+
+#include "bench_utils.hpp"
+#include "prisme/cluster_size.hpp"
+
+#include <algorithm>
+#include <vector>
+
+namespace {
+
+void BM_FindComponents(benchmark::State& state) {
+    const int n_nodes = static_cast<int>(state.range(0));
+    const std::vector<double> adj = prisme_bench::synthetic_adjacency(n_nodes, state.range(1), 1);
+
+    for (auto _ : state) {
+        std::vector<prisme::Component> components = prisme::find_components(adj, n_nodes);
+        benchmark::DoNotOptimize(components.data());
+    }
+    prisme_bench::set_throughput(state, prisme_bench::n_edges(n_nodes), 1);
+}
+
+void BM_SizeNullDistribution(benchmark::State& state) {
+    const int n_nodes = static_cast<int>(state.range(0));
+    const int n_perms = static_cast<int>(state.range(2));
+    const size_t matrix_size = static_cast<size_t>(n_nodes) * n_nodes;
+
+    std::vector<double> permuted(matrix_size * n_perms);
+    for (int p = 0; p < n_perms; p++) {
+        const std::vector<double> adj = prisme_bench::synthetic_adjacency(n_nodes, state.range(1), p + 1);
+        std::copy(adj.begin(), adj.end(), permuted.begin() + p * matrix_size);
+    }
+    std::vector<double> null_dist(n_perms);
+
+    for (auto _ : state) {
+        prisme::size_null_distribution(permuted, n_nodes, null_dist);
+        benchmark::DoNotOptimize(null_dist.data());
+    }
+    prisme_bench::set_throughput(state, prisme_bench::n_edges(n_nodes), n_perms);
+}
+
+// Same permutations as edge statistics thresholded at 0
+void BM_SizeNullDistributionEdges(benchmark::State& state) {
+    const int n_nodes = static_cast<int>(state.range(0));
+    const int n_perms = static_cast<int>(state.range(2));
+    const prisme::EdgeIndex index = prisme_bench::upper_triangle_index(n_nodes);
+
+    std::vector<double> permuted(index.size() * n_perms);
+    for (int p = 0; p < n_perms; p++) {
+        const std::vector<double> flat =
+            prisme_bench::flatten(prisme_bench::synthetic_adjacency(n_nodes, state.range(1), p + 1), index);
+        std::copy(flat.begin(), flat.end(), permuted.begin() + p * index.size());
+    }
+    std::vector<double> null_dist(n_perms);
+
+    for (auto _ : state) {
+        prisme::size_null_distribution(permuted, index, 0.0, null_dist);
+        benchmark::DoNotOptimize(null_dist.data());
+    }
+    prisme_bench::set_throughput(state, prisme_bench::n_edges(n_nodes), n_perms);
+}
+
+// Signed statistics with components in both tails, one pass per permutation
+void BM_SizeNullDistributionTwoTailed(benchmark::State& state) {
+    const int n_nodes = static_cast<int>(state.range(0));
+    const int n_perms = static_cast<int>(state.range(2));
+    const prisme::EdgeIndex index = prisme_bench::upper_triangle_index(n_nodes);
+
+    std::vector<double> permuted(index.size() * n_perms);
+    for (int p = 0; p < n_perms; p++) {
+        const std::vector<double> flat =
+            prisme_bench::flatten(prisme_bench::synthetic_connectome(n_nodes, state.range(1), p + 1), index);
+        std::copy(flat.begin(), flat.end(), permuted.begin() + p * index.size());
+    }
+    std::vector<double> null_dist(n_perms);
+    std::vector<double> null_dist_neg(n_perms);
+
+    for (auto _ : state) {
+        prisme::size_null_distribution_two_tailed(permuted, index, 1.0, null_dist, null_dist_neg);
+        benchmark::DoNotOptimize(null_dist.data());
+        benchmark::DoNotOptimize(null_dist_neg.data());
+    }
+    prisme_bench::set_throughput(state, prisme_bench::n_edges(n_nodes), n_perms);
+}
+
+void BM_SizePvals(benchmark::State& state) {
+    const int n_nodes = static_cast<int>(state.range(0));
+    const std::vector<double> adj = prisme_bench::synthetic_adjacency(n_nodes, state.range(1), 1);
+    std::vector<double> null_dist(1000);
+    for (size_t p = 0; p < null_dist.size(); p++) {
+        null_dist[p] = static_cast<double>(p + 1);
+    }
+    std::vector<double> pval(adj.size());
+
+    for (auto _ : state) {
+        prisme::size_pvals(adj, n_nodes, null_dist, pval);
+        benchmark::DoNotOptimize(pval.data());
+    }
+    prisme_bench::set_throughput(state, prisme_bench::n_edges(n_nodes), 1);
+}
+
+}  // namespace
+
+BENCHMARK(BM_FindComponents)->Apply(prisme_bench::connectome_args)->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_SizeNullDistribution)->Apply(prisme_bench::connectome_perm_args)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_SizeNullDistributionEdges)->Apply(prisme_bench::connectome_perm_args)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_SizeNullDistributionTwoTailed)->Apply(prisme_bench::connectome_perm_args)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_SizePvals)->Apply(prisme_bench::connectome_args)->Unit(benchmark::kMicrosecond);
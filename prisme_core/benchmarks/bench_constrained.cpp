@@ -0,0 +1,78 @@
+/**
+ * bench_constrained.cpp - Network sums of the Constrained method and FDR corrections
+ */
+
+#include "bench_utils.hpp"
+#include "prisme/constrained.hpp"
+#include "prisme/parametric.hpp"
+
+#include <algorithm>
+#include <vector>
+
+namespace {
+
+// Networks of a Shen-like atlas, edge e is in network e % (n_networks + 1), 0 is no network
+const int n_networks = 10;
+
+std::vector<double> network_indices(size_t n_var) {
+    std::vector<double> indices(n_var);
+    for (size_t e = 0; e < n_var; e++) {
+        indices[e] = static_cast<double>(e % (n_networks + 1));
+    }
+    return indices;
+}
+
+// p-values of n_var edges with a share of small ones, as under an effect
+std::vector<double> synthetic_pvals(size_t n_var) {
+    std::vector<double> p = prisme_bench::normal_values(n_var, 3);
+    for (size_t e = 0; e < n_var; e++) {
+        p[e] = e % 20 == 0 ? 1e-4 * (p[e] * p[e]) : std::min(p[e] * p[e] / 4, 1.0);
+    }
+    return p;
+}
+
+void BM_ConstrainedPvals(benchmark::State& state) {
+    const size_t n_var = static_cast<size_t>(prisme_bench::n_edges(state.range(0)));
+    const int n_perms = static_cast<int>(state.range(1));
+    const std::vector<double> edge_stats = prisme_bench::normal_values(n_var, 1);
+    const std::vector<double> permuted = prisme_bench::normal_values(n_var * n_perms, 2);
+    const std::vector<double> indices = network_indices(n_var);
+
+    for (auto _ : state) {
+        prisme::ConstrainedResult result = prisme::constrained_pvals(edge_stats, permuted, indices, 0.05);
+        benchmark::DoNotOptimize(result.exceed_count.data());
+    }
+    prisme_bench::set_throughput(state, static_cast<int64_t>(n_var), n_perms);
+}
+
+// Simes FDR of the Constrained method, applied here at edge scale
+void BM_FdrCorrection(benchmark::State& state) {
+    const size_t n_var = static_cast<size_t>(prisme_bench::n_edges(state.range(0)));
+    const std::vector<double> p = synthetic_pvals(n_var);
+    std::vector<double> p_fdr(n_var);
+
+    for (auto _ : state) {
+        prisme::fdr_correction(p, 0.05, p_fdr);
+        benchmark::DoNotOptimize(p_fdr.data());
+    }
+    prisme_bench::set_throughput(state, static_cast<int64_t>(n_var), 1);
+}
+
+// Benjamini-Hochberg adjusted p-values of Parametric_FDR
+void BM_BhFdr(benchmark::State& state) {
+    const size_t n_var = static_cast<size_t>(prisme_bench::n_edges(state.range(0)));
+    const std::vector<double> p = synthetic_pvals(n_var);
+    std::vector<double> p_fdr(n_var);
+
+    for (auto _ : state) {
+        prisme::bh_fdr(p, p_fdr);
+        benchmark::DoNotOptimize(p_fdr.data());
+    }
+    prisme_bench::set_throughput(state, static_cast<int64_t>(n_var), 1);
+}
+
+}  // namespace
+
+BENCHMARK(BM_ConstrainedPvals)->Apply(prisme_bench::edge_perm_args)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_FdrCorrection)->ArgName("nodes")->ArgsProduct({prisme_bench::node_counts})->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_BhFdr)->ArgName("nodes")->ArgsProduct({prisme_bench::node_counts})->Unit(benchmark::kMicrosecond);
@@ -0,0 +1,138 @@
+/**
+ * bench_glm.cpp - GLM fit and permutation null generation (NBSglm_smn)
+ */
+
+#include "bench_utils.hpp"
+#include "prisme/glm.hpp"
+
+#include <vector>
+
+namespace {
+
+const int n_observations = 40;
+
+// Intercept only design of the one-sample test
+prisme::GlmDesign onesample_design() {
+    static const std::vector<double> X(n_observations, 1.0);
+    static const std::vector<double> contrast = {1.0};
+    return prisme::GlmDesign(X, n_observations, 1, contrast, prisme::GlmTest::OneSample);
+}
+
+// Two groups of equal size, as the 't2' contrast
+prisme::GlmDesign ttest_design() {
+    static const std::vector<double> X = [] {
+        std::vector<double> design(2 * n_observations, 0.0);
+        for (int i = 0; i < n_observations; i++) {
+            design[i + (i < n_observations / 2 ? 0 : n_observations)] = 1.0;
+        }
+        return design;
+    }();
+    static const std::vector<double> contrast = {1.0, -1.0};
+    return prisme::GlmDesign(X, n_observations, 2, contrast, prisme::GlmTest::TTest);
+}
+
+// Score and intercept of the 'r' design, the intercept a nuisance predictor
+prisme::GlmDesign correlation_design() {
+    static const std::vector<double> X = [] {
+        std::vector<double> design(2 * n_observations, 1.0);
+        for (int i = 0; i < n_observations; i++) {
+            design[i] = (i * 37 % n_observations) * 0.25;
+        }
+        return design;
+    }();
+    static const std::vector<double> contrast = {1.0, 0.0};
+    return prisme::GlmDesign(X, n_observations, 2, contrast, prisme::GlmTest::OneSample, {1});
+}
+
+// Intercept, a covariate of interest and a nuisance covariate ('r' with a covariate)
+prisme::GlmDesign ftest_design(bool nuisance) {
+    static const std::vector<double> X = [] {
+        std::vector<double> design(3 * n_observations);
+        for (int i = 0; i < n_observations; i++) {
+            design[i] = 1.0;
+            design[i + n_observations] = i * 0.1 - 2;
+            design[i + 2 * n_observations] = (i % 5) - 2.0;
+        }
+        return design;
+    }();
+    static const std::vector<double> contrast = {0.0, 1.0, 0.0};
+    static const std::vector<double> all = {0.0, 1.0, 1.0};
+    if (nuisance) {
+        return prisme::GlmDesign(X, n_observations, 3, contrast, prisme::GlmTest::FTest, {0, 2});
+    }
+    return prisme::GlmDesign(X, n_observations, 3, all, prisme::GlmTest::FTest);
+}
+
+void BM_GlmTestStat(benchmark::State& state) {
+    const int n_GLMs = static_cast<int>(prisme_bench::n_edges(state.range(0)));
+    const prisme::GlmDesign design = state.range(1) == 0 ? onesample_design() : ttest_design();
+    const std::vector<double> y = prisme_bench::normal_values(static_cast<size_t>(n_observations) * n_GLMs, 1);
+    std::vector<double> test_stat(n_GLMs);
+
+    for (auto _ : state) {
+        design.compute_test_stat(y, n_GLMs, test_stat);
+        benchmark::DoNotOptimize(test_stat.data());
+    }
+    prisme_bench::set_throughput(state, n_GLMs, 1);
+}
+
+void BM_GlmFTestStat(benchmark::State& state) {
+    const int n_GLMs = static_cast<int>(prisme_bench::n_edges(state.range(0)));
+    const prisme::GlmDesign design = ftest_design(state.range(1) != 0);
+    const std::vector<double> y = prisme_bench::normal_values(static_cast<size_t>(n_observations) * n_GLMs, 1);
+    std::vector<double> test_stat(n_GLMs);
+
+    for (auto _ : state) {
+        design.compute_test_stat(y, n_GLMs, test_stat);
+        benchmark::DoNotOptimize(test_stat.data());
+    }
+    prisme_bench::set_throughput(state, n_GLMs, 1);
+}
+
+void BM_GlmPermutations(benchmark::State& state, prisme::GlmDesign (*make_design)(), bool closed_form) {
+    const int n_GLMs = static_cast<int>(prisme_bench::n_edges(state.range(0)));
+    const int n_perms = static_cast<int>(state.range(1));
+    const prisme::GlmDesign design = make_design();
+    const std::vector<double> y = prisme_bench::normal_values(static_cast<size_t>(n_observations) * n_GLMs, 2);
+    std::vector<double> perm_stats(static_cast<size_t>(n_GLMs) * n_perms);
+
+    uint64_t seed = 0;
+    for (auto _ : state) {
+        if (closed_form) {
+            design.generate_closed_form_permutations(y, n_GLMs, n_perms, seed++, perm_stats);
+        } else {
+            design.generate_permutations(y, n_GLMs, n_perms, seed++, perm_stats);
+        }
+        benchmark::DoNotOptimize(perm_stats.data());
+    }
+    prisme_bench::set_throughput(state, n_GLMs, n_perms);
+}
+
+}  // namespace
+
+BENCHMARK(BM_GlmTestStat)
+    ->ArgNames({"nodes", "ttest"})
+    ->ArgsProduct({prisme_bench::node_counts, {0, 1}})
+    ->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_GlmFTestStat)
+    ->ArgNames({"nodes", "nuisance"})
+    ->ArgsProduct({prisme_bench::node_counts, {0, 1}})
+    ->Unit(benchmark::kMillisecond);
+BENCHMARK_CAPTURE(BM_GlmPermutations, onesample, onesample_design, false)
+    ->Apply(prisme_bench::edge_perm_args)
+    ->Unit(benchmark::kMillisecond);
+BENCHMARK_CAPTURE(BM_GlmPermutations, ttest, ttest_design, false)
+    ->Apply(prisme_bench::edge_perm_args)
+    ->Unit(benchmark::kMillisecond);
+BENCHMARK_CAPTURE(BM_GlmPermutations, correlation, correlation_design, false)
+    ->Apply(prisme_bench::edge_perm_args)
+    ->Unit(benchmark::kMillisecond);
+BENCHMARK_CAPTURE(BM_GlmPermutations, onesample_closed_form, onesample_design, true)
+    ->Apply(prisme_bench::edge_perm_args)
+    ->Unit(benchmark::kMillisecond);
+BENCHMARK_CAPTURE(BM_GlmPermutations, ttest_closed_form, ttest_design, true)
+    ->Apply(prisme_bench::edge_perm_args)
+    ->Unit(benchmark::kMillisecond);
+BENCHMARK_CAPTURE(BM_GlmPermutations, correlation_closed_form, correlation_design, true)
+    ->Apply(prisme_bench::edge_perm_args)
+    ->Unit(benchmark::kMillisecond);
@@ -0,0 +1,126 @@
+/**
+ * bench_main.cpp - Entry point of the kernel benchmarks with allocation tracking
+ *
+ * On glibc, malloc, calloc, realloc and free are wrapped to count the heap
+ * allocations of the kernels. This covers operator new as well as Eigen, which
+ * allocates with malloc directly. Google Benchmark reports the counts as
+ * allocs_per_iter and max_bytes_used in its output, e.g.
+ *
+ *   prisme_bench --benchmark_format=json --benchmark_out=kernels.json
+ *
+ * Elsewhere the allocation fields are left out.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+#if defined(__GLIBC__)
+#include <malloc.h>
+
+extern "C" {
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t n, size_t size);
+void* __libc_realloc(void* ptr, size_t size);
+void __libc_free(void* ptr);
+}
+
+namespace {
+
+std::atomic<bool> tracking{false};
+std::atomic<int64_t> n_allocs{0};
+std::atomic<int64_t> allocated_bytes{0};
+std::atomic<int64_t> live_bytes{0};
+std::atomic<int64_t> peak_bytes{0};
+
+void record_alloc(void* ptr) {
+    if (ptr == nullptr || !tracking.load(std::memory_order_relaxed)) {
+        return;
+    }
+    const int64_t size = static_cast<int64_t>(malloc_usable_size(ptr));
+    n_allocs.fetch_add(1, std::memory_order_relaxed);
+    allocated_bytes.fetch_add(size, std::memory_order_relaxed);
+    const int64_t live = live_bytes.fetch_add(size, std::memory_order_relaxed) + size;
+    int64_t peak = peak_bytes.load(std::memory_order_relaxed);
+    while (live > peak && !peak_bytes.compare_exchange_weak(peak, live, std::memory_order_relaxed)) {
+    }
+}
+
+// Blocks allocated before tracking started are subtracted as well, so live_bytes
+// is the net heap growth since Start
+void record_free(void* ptr) {
+    if (ptr == nullptr || !tracking.load(std::memory_order_relaxed)) {
+        return;
+    }
+    live_bytes.fetch_sub(static_cast<int64_t>(malloc_usable_size(ptr)), std::memory_order_relaxed);
+}
+
+class HeapTracker : public benchmark::MemoryManager {
+public:
+    void Start() override {
+        n_allocs = 0;
+        allocated_bytes = 0;
+        live_bytes = 0;
+        peak_bytes = 0;
+        tracking = true;
+    }
+
+    void Stop(Result& result) override {
+        tracking = false;
+        result.num_allocs = n_allocs;
+        result.max_bytes_used = peak_bytes;
+        result.total_allocated_bytes = allocated_bytes;
+        result.net_heap_growth = live_bytes;
+    }
+
+    void Stop(Result* result) override { Stop(*result); }
+};
+
+}  // namespace
+
+extern "C" {
+
+void* malloc(size_t size) {
+    void* ptr = __libc_malloc(size);
+    record_alloc(ptr);
+    return ptr;
+}
+
+void* calloc(size_t n, size_t size) {
+    void* ptr = __libc_calloc(n, size);
+    record_alloc(ptr);
+    return ptr;
+}
+
+void* realloc(void* ptr, size_t size) {
+    record_free(ptr);
+    void* new_ptr = __libc_realloc(ptr, size);
+    record_alloc(new_ptr);
+    return new_ptr;
+}
+
+void free(void* ptr) {
+    record_free(ptr);
+    __libc_free(ptr);
+}
+
+}  // extern "C"
+
+#define PRISME_BENCH_HEAP_TRACKER 1
+#endif
+
+int main(int argc, char** argv) {
+#if defined(PRISME_BENCH_HEAP_TRACKER)
+    static HeapTracker heap_tracker;
+    benchmark::RegisterMemoryManager(&heap_tracker);
+#endif
+    benchmark::Initialize(&argc, argv);
+    if (benchmark::ReportUnrecognizedArguments(argc, argv)) {
+        return 1;
+    }
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+    return 0;
+}
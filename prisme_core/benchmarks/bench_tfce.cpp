@@ -0,0 +1,118 @@
+/**
+ * bench_tfce.cpp - The four TFCE variants on the same synthetic connectomes, and apply_tfce
+ * on their edge variables
+ */
+
+#include "bench_utils.hpp"
+#include "prisme/tfce.hpp"
+
+#include <vector>
+
+namespace {
+
+// Parameters of Fast_TFCE_cpp
+const double dh = 0.1;
+const double H = 3.0;
+const double E = 0.4;
+
+void BM_ApplyTfce(benchmark::State& state) {
+    const int n_nodes = static_cast<int>(state.range(0));
+    const std::vector<double> img = prisme_bench::synthetic_connectome(n_nodes, state.range(1), 1);
+    std::vector<double> tfced(img.size());
+
+    for (auto _ : state) {
+        prisme::apply_tfce(img, n_nodes, dh, H, E, tfced);
+        benchmark::DoNotOptimize(tfced.data());
+    }
+    prisme_bench::set_throughput(state, prisme_bench::n_edges(n_nodes), 1);
+}
+
+// Same connectome as edge variables, no N x N input or output
+void BM_ApplyTfceEdges(benchmark::State& state) {
+    const int n_nodes = static_cast<int>(state.range(0));
+    const prisme::EdgeIndex index = prisme_bench::upper_triangle_index(n_nodes);
+    const std::vector<double> flat =
+        prisme_bench::flatten(prisme_bench::synthetic_connectome(n_nodes, state.range(1), 1), index);
+    std::vector<double> tfced(flat.size());
+
+    for (auto _ : state) {
+        prisme::apply_tfce(flat, index, dh, H, E, tfced);
+        benchmark::DoNotOptimize(tfced.data());
+    }
+    prisme_bench::set_throughput(state, prisme_bench::n_edges(n_nodes), 1);
+}
+
+// Both tails of the same edge variables, against two BM_ApplyTfceEdges calls and a negated copy
+void BM_ApplyTfceEdgesTwoTailed(benchmark::State& state) {
+    const int n_nodes = static_cast<int>(state.range(0));
+    const prisme::EdgeIndex index = prisme_bench::upper_triangle_index(n_nodes);
+    const std::vector<double> flat =
+        prisme_bench::flatten(prisme_bench::synthetic_connectome(n_nodes, state.range(1), 1), index);
+    std::vector<double> tfced(flat.size());
+    std::vector<double> tfced_neg(flat.size());
+
+    for (auto _ : state) {
+        prisme::apply_tfce_two_tailed(flat, index, dh, H, E, tfced, tfced_neg);
+        benchmark::DoNotOptimize(tfced.data());
+        benchmark::DoNotOptimize(tfced_neg.data());
+    }
+    prisme_bench::set_throughput(state, prisme_bench::n_edges(n_nodes), 1);
+}
+
+void BM_ExactTfce(benchmark::State& state) {
+    const int n_nodes = static_cast<int>(state.range(0));
+    const std::vector<double> img = prisme_bench::synthetic_connectome(n_nodes, state.range(1), 1);
+    std::vector<double> tfced(img.size());
+
+    for (auto _ : state) {
+        prisme::exact_tfce(img, n_nodes, H, E, tfced);
+        benchmark::DoNotOptimize(tfced.data());
+    }
+    prisme_bench::set_throughput(state, prisme_bench::n_edges(n_nodes), 1);
+}
+
+void BM_TraditionalTfce(benchmark::State& state) {
+    const int n_nodes = static_cast<int>(state.range(0));
+    const std::vector<double> img = prisme_bench::synthetic_connectome(n_nodes, state.range(1), 1);
+    std::vector<double> tfced(img.size());
+
+    for (auto _ : state) {
+        prisme::traditional_tfce(img, n_nodes, H, E, dh, tfced);
+        benchmark::DoNotOptimize(tfced.data());
+    }
+    prisme_bench::set_throughput(state, prisme_bench::n_edges(n_nodes), 1);
+}
+
+// Positive lower triangle entries as the sparse input of sparse_tfce_cpp
+void BM_SparseTfce(benchmark::State& state) {
+    const int n_nodes = static_cast<int>(state.range(0));
+    const std::vector<double> img = prisme_bench::synthetic_connectome(n_nodes, state.range(1), 1);
+    std::vector<int> rows, cols;
+    std::vector<double> values;
+    for (int j = 0; j < n_nodes; j++) {
+        for (int i = j + 1; i < n_nodes; i++) {
+            const double value = img[i + static_cast<size_t>(j) * n_nodes];
+            if (value > 0) {
+                rows.push_back(i);
+                cols.push_back(j);
+                values.push_back(value);
+            }
+        }
+    }
+    std::vector<double> node_tfce(n_nodes);
+
+    for (auto _ : state) {
+        prisme::sparse_tfce(rows, cols, values, n_nodes, dh, H, E, node_tfce);
+        benchmark::DoNotOptimize(node_tfce.data());
+    }
+    prisme_bench::set_throughput(state, prisme_bench::n_edges(n_nodes), 1);
+}
+
+}  // namespace
+
+BENCHMARK(BM_ApplyTfce)->Apply(prisme_bench::connectome_args)->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_ApplyTfceEdges)->Apply(prisme_bench::connectome_args)->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_ApplyTfceEdgesTwoTailed)->Apply(prisme_bench::connectome_args)->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_ExactTfce)->Apply(prisme_bench::connectome_args)->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_TraditionalTfce)->Apply(prisme_bench::connectome_args)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_SparseTfce)->Apply(prisme_bench::connectome_args)->Unit(benchmark::kMicrosecond);
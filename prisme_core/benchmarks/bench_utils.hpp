@@ -0,0 +1,136 @@
+/**
+ * bench_utils.hpp - Synthetic connectomes and shared arguments of the kernel benchmarks
+ *
+ * Connectomes are N x N, column-major and symmetric with a zero diagonal. A
+ * density of d percent makes d% of the edges positive, the rest are negative, so
+ * thresholding at zero keeps the requested fraction of edges.
+ */
+
+#ifndef PRISME_BENCH_UTILS_HPP
+#define PRISME_BENCH_UTILS_HPP
+
+#include <benchmark/benchmark.h>
+
+#include "prisme/edge_index.hpp"
+
+#include <cstdint>
+#include <random>
+#include <vector>
+
+namespace prisme_bench {
+
+// Atlas sizes of the benchmark: toy, Shen 268, Shen 368 and a dense parcellation
+const std::vector<int64_t> node_counts = {100, 268, 368, 1000};
+
+// Percent of positive edges
+const std::vector<int64_t> edge_densities = {1, 5, 20};
+
+// Inputs above this size are skipped, the N = 1000 x large K combinations would
+// otherwise need several GB
+const double max_input_bytes = 512.0 * 1024 * 1024;
+
+inline int64_t n_edges(int64_t n_nodes) {
+    return n_nodes * (n_nodes - 1) / 2;
+}
+
+inline std::vector<double> synthetic_connectome(int n_nodes, double density_percent, uint64_t seed) {
+    std::mt19937_64 rng(seed);
+    std::uniform_real_distribution<double> unit(0.0, 1.0);
+    std::uniform_real_distribution<double> positive(0.1, 5.0);
+    std::uniform_real_distribution<double> negative(-3.0, -0.1);
+
+    std::vector<double> matrix(static_cast<size_t>(n_nodes) * n_nodes, 0.0);
+    for (int j = 0; j < n_nodes; j++) {
+        for (int i = j + 1; i < n_nodes; i++) {
+            const double value = unit(rng) * 100 < density_percent ? positive(rng) : negative(rng);
+            matrix[i + static_cast<size_t>(j) * n_nodes] = value;
+            matrix[j + static_cast<size_t>(i) * n_nodes] = value;
+        }
+    }
+    return matrix;
+}
+
+// Binary adjacency of the positive edges
+inline std::vector<double> synthetic_adjacency(int n_nodes, double density_percent, uint64_t seed) {
+    std::vector<double> matrix = synthetic_connectome(n_nodes, density_percent, seed);
+    for (double& value : matrix) {
+        value = value > 0 ? 1.0 : 0.0;
+    }
+    return matrix;
+}
+
+// Upper triangle mask, find(triu(ones(N), 1)) - 1
+inline prisme::EdgeIndex upper_triangle_index(int n_nodes) {
+    std::vector<uint64_t> linear_index;
+    for (int j = 0; j < n_nodes; j++) {
+        for (int i = 0; i < j; i++) {
+            linear_index.push_back(i + static_cast<uint64_t>(j) * n_nodes);
+        }
+    }
+    return prisme::make_edge_index(linear_index, n_nodes);
+}
+
+// Edge variables of a connectome in mask order
+inline std::vector<double> flatten(const std::vector<double>& matrix, const prisme::EdgeIndex& index) {
+    std::vector<double> flat(index.size());
+    prisme::flatten_edges(matrix, index, flat);
+    return flat;
+}
+
+inline std::vector<double> normal_values(size_t n, uint64_t seed) {
+    std::mt19937_64 rng(seed);
+    std::normal_distribution<double> normal(0.0, 1.0);
+    std::vector<double> values(n);
+    for (double& value : values) {
+        value = normal(rng);
+    }
+    return values;
+}
+
+// Throughput counters with names that stay fixed across versions of the suite
+inline void set_throughput(benchmark::State& state, int64_t n_edges_per_perm, int64_t n_perms) {
+    state.counters["perms_per_second"] =
+        benchmark::Counter(static_cast<double>(n_perms), benchmark::Counter::kIsIterationInvariantRate);
+    state.counters["edges_per_second"] = benchmark::Counter(static_cast<double>(n_edges_per_perm * n_perms),
+                                                            benchmark::Counter::kIsIterationInvariantRate);
+}
+
+// nodes x density
+inline void connectome_args(benchmark::internal::Benchmark* b) {
+    b->ArgNames({"nodes", "density"});
+    for (int64_t n_nodes : node_counts) {
+        for (int64_t density : edge_densities) {
+            b->Args({n_nodes, density});
+        }
+    }
+}
+
+// nodes x density x K, skipping the N x N x K inputs above max_input_bytes
+inline void connectome_perm_args(benchmark::internal::Benchmark* b) {
+    b->ArgNames({"nodes", "density", "perms"});
+    for (int64_t n_nodes : node_counts) {
+        for (int64_t density : edge_densities) {
+            for (int64_t n_perms : {10, 100}) {
+                if (8.0 * n_nodes * n_nodes * n_perms <= max_input_bytes) {
+                    b->Args({n_nodes, density, n_perms});
+                }
+            }
+        }
+    }
+}
+
+// nodes x K for kernels that take edges x K permutation blocks
+inline void edge_perm_args(benchmark::internal::Benchmark* b) {
+    b->ArgNames({"nodes", "perms"});
+    for (int64_t n_nodes : node_counts) {
+        for (int64_t n_perms : {10, 100, 1000}) {
+            if (8.0 * n_edges(n_nodes) * n_perms <= max_input_bytes) {
+                b->Args({n_nodes, n_perms});
+            }
+        }
+    }
+}
+
+}  // namespace prisme_bench
+
+#endif
@@ -0,0 +1,62 @@
+/**
+ * cluster_size.hpp - Connected components of thresholded connectomes (Size method)
+ *
+ * Matrices are N x N, column-major and symmetric, an edge is present where the
+ * value is positive. Component sizes count edges, as in the network-based statistic.
+ * The edge variable overloads take the flat statistics of an EdgeIndex and a
+ * threshold instead, an edge is present where its statistic exceeds the threshold.
+ */
+
+#ifndef PRISME_CLUSTER_SIZE_HPP
+#define PRISME_CLUSTER_SIZE_HPP
+
+#include "prisme/edge_index.hpp"
+#include "prisme/span.hpp"
+
+#include <vector>
+
+namespace prisme {
+
+// Component with more than one node: its nodes and number of edges
+struct Component {
+    std::vector<int> nodes;
+    double size;
+};
+
+// Components of a binary adjacency matrix, isolated nodes are skipped
+std::vector<Component> find_components(span<const double> adj_matrix, int n_nodes);
+
+// Maximum component size of each of the K = null_dist.size() permuted matrices
+// (N x N x K), at least 1 so the observed components are never compared to 0
+void size_null_distribution(span<const double> permuted_adj_matrices, int n_nodes,
+                            span<double> null_dist);
+
+// FWER-corrected p-value of each edge (N x N) against a null distribution of
+// maximum component sizes, 1 where there is no edge
+void size_pvals(span<const double> adj_matrix, int n_nodes, span<const double> null_dist,
+                span<double> pval);
+
+// Maximum component size of each column of the n_edges x K block of permuted edge
+// statistics, at least 1, as size_null_distribution of the thresholded matrices
+void size_null_distribution(span<const double> permuted_edge_stats, const EdgeIndex& index, double thresh,
+                            span<double> null_dist);
+
+// Both tails of size_null_distribution from one read of each column: null_dist of
+// the block and null_dist_neg of the negated block. An edge above thresh joins the
+// positive components, one below -thresh the negative ones.
+void size_null_distribution_two_tailed(span<const double> permuted_edge_stats, const EdgeIndex& index,
+                                       double thresh, span<double> null_dist, span<double> null_dist_neg);
+
+// FWER-corrected p-value of each edge variable, 1 where the statistic does not
+// exceed thresh, as size_pvals of the thresholded matrix
+void size_pvals(span<const double> edge_stats, const EdgeIndex& index, double thresh,
+                span<const double> null_dist, span<double> pval);
+
+// Number of nodes of the cluster of each node (0 for inactive nodes) of a sparse
+// matrix given by 0-based row and column indices
+void sparse_cluster_sizes(span<const int> rows, span<const int> cols, int n_nodes,
+                          span<double> cluster_sizes);
+
+}  // namespace prisme
+
+#endif
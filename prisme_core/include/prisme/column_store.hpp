@@ -0,0 +1,91 @@
+/**
+ * column_store.hpp - PRISME columnar binary store (.pcol)
+ *
+ * A column store file is a fixed 64 byte header followed by contiguous columns of
+ * n_rows values each (double or single, column-major like MATLAB). Columns are
+ * only ever appended or overwritten in place and the header is rewritten after
+ * the column data, so an interrupted write leaves the previous columns valid.
+ * Errors are reported with std::runtime_error.
+ */
+
+#ifndef PRISME_COLUMN_STORE_HPP
+#define PRISME_COLUMN_STORE_HPP
+
+#include "prisme/span.hpp"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace prisme {
+
+enum class StoreClass : uint32_t { Double = 1, Single = 2 };
+
+// Columns start at this offset, also the offset for external memory maps
+constexpr uint64_t column_store_header_bytes = 64;
+
+struct StoreInfo {
+    uint64_t n_rows;
+    uint64_t n_cols;
+    StoreClass store_class;
+};
+
+// 'double' or 'single'
+const char* store_class_name(StoreClass store_class);
+size_t store_element_bytes(StoreClass store_class);
+
+// Creates an empty store, replacing any existing file
+void create_column_store(const std::string& path, uint64_t n_rows, StoreClass store_class);
+
+StoreInfo read_column_store_info(const std::string& path);
+
+// Writes n_new columns starting at the 0-based column first_col (at the end of the
+// store if append is set) and returns the new column count. Skipped columns are
+// NaN filled, like the columns of repetitions not computed yet in a .mat file.
+uint64_t write_store_columns(const std::string& path, uint64_t first_col, const void* data, uint64_t n_rows,
+                             uint64_t n_new, StoreClass store_class, bool append);
+
+// Copies the requested 0-based columns into out (n_rows x col_idx.size() values of
+// the store class), columns are mapped read-only where available
+void read_store_columns(const std::string& path, const StoreInfo& info, const std::vector<uint64_t>& col_idx,
+                        void* out);
+
+// Whole store as doubles (single stores are converted), n_rows x n_cols
+std::vector<double> read_column_store(const std::string& path, StoreInfo& info);
+
+// Read-only view of a whole store that stays mapped while the object lives. The
+// pages are shared by every thread and every process that maps the same file, so
+// a node holds one copy of a dataset however many workers read from it. Where
+// mmap is not available, the columns are read into memory instead.
+class MappedColumnStore {
+public:
+    MappedColumnStore() = default;
+    explicit MappedColumnStore(const std::string& path);
+    ~MappedColumnStore();
+    MappedColumnStore(MappedColumnStore&& other) noexcept;
+    MappedColumnStore& operator=(MappedColumnStore&& other) noexcept;
+    MappedColumnStore(const MappedColumnStore&) = delete;
+    MappedColumnStore& operator=(const MappedColumnStore&) = delete;
+
+    const StoreInfo& info() const { return info_; }
+
+    // Start of the 0-based column c, n_rows values of the store class
+    const void* column(uint64_t c) const;
+
+    // Copies the requested 0-based columns into out as doubles (single stores are
+    // converted), n_rows x col_idx.size()
+    void gather_columns(span<const uint64_t> col_idx, span<double> out) const;
+
+private:
+    void release();
+
+    StoreInfo info_ = {0, 0, StoreClass::Double};
+    const char* columns_ = nullptr;
+    void* mapped_ = nullptr;
+    uint64_t mapped_bytes_ = 0;
+    std::vector<char> buffer_;  // Columns read into memory where mmap is not available
+};
+
+}  // namespace prisme
+
+#endif
@@ -0,0 +1,51 @@
+/**
+ * constrained.hpp - Network-level (Constrained) p-values with FWER and FDR correction
+ */
+
+#ifndef PRISME_CONSTRAINED_HPP
+#define PRISME_CONSTRAINED_HPP
+
+#include "prisme/span.hpp"
+
+#include <vector>
+
+namespace prisme {
+
+// One entry per network, networks in increasing index order
+struct ConstrainedResult {
+    std::vector<double> pvals_fwer;    // Bonferroni-corrected p-values
+    std::vector<double> pvals_fdr;     // 0 where significant after FDR correction, 1 otherwise
+    std::vector<double> exceed_count;  // Permutations reaching the observed statistic
+};
+
+// Sums edge statistics within each network (index 0 is not a network) and compares
+// them with the sums of each permutation. permuted_edge_stats is edges x permutations,
+// column-major. prior_count and prior_perms carry the counts of previous permutation
+// blocks so a permutation stream can be processed block by block.
+ConstrainedResult constrained_pvals(span<const double> edge_stats, span<const double> permuted_edge_stats,
+                                    span<const double> network_indices, double alpha,
+                                    span<const double> prior_count = {}, double prior_perms = 0);
+
+// Both tails of constrained_pvals: positive for edge_stats and negative for the
+// negated statistics and permutations. The network sums of each permutation are
+// computed once and counted against both observed sums.
+struct ConstrainedTwoTailed {
+    ConstrainedResult positive;
+    ConstrainedResult negative;
+};
+
+ConstrainedTwoTailed constrained_pvals_two_tailed(span<const double> edge_stats,
+                                                  span<const double> permuted_edge_stats,
+                                                  span<const double> network_indices, double alpha,
+                                                  span<const double> prior_count = {},
+                                                  span<const double> prior_count_neg = {}, double prior_perms = 0);
+
+// Bonferroni correction
+void fwer_correction(span<const double> pval_uncorr, span<double> pval_fwer);
+
+// FDR correction (Simes procedure), 0 marks the significant tests
+void fdr_correction(span<const double> pval_uncorr, double alpha, span<double> pval_fdr);
+
+}  // namespace prisme
+
+#endif
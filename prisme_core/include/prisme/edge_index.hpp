@@ -0,0 +1,43 @@
+/**
+ * edge_index.hpp - Node pairs of the edge variables of a connectome mask
+ *
+ * Edge-level studies keep one variable per entry of STATS.mask, in the order of
+ * find(mask). An EdgeIndex holds the (row, col) node pair of each variable, so the
+ * TFCE and Size kernels run on the flat variables directly instead of an N x N
+ * matrix rebuilt for every permutation. unflatten_edges and flatten_edges replace
+ * unflatten_matrix.m and flat_matrix.m where a matrix is still needed.
+ */
+
+#ifndef PRISME_EDGE_INDEX_HPP
+#define PRISME_EDGE_INDEX_HPP
+
+#include "prisme/span.hpp"
+
+#include <cstdint>
+#include <vector>
+
+namespace prisme {
+
+struct EdgeIndex {
+    int n_nodes = 0;
+    std::vector<int> rows;  // 0-based node pair of each variable, in mask order
+    std::vector<int> cols;
+
+    size_t size() const { return rows.size(); }
+};
+
+// Index of the variables of an N x N mask from their 0-based linear indices
+// (find(mask) - 1). Entries on the diagonal and pairs given in both triangles are
+// an error, so every variable is a distinct edge.
+EdgeIndex make_edge_index(span<const uint64_t> linear_index, int n_nodes);
+
+// Symmetric N x N matrix with the value of each variable at both entries of its
+// pair and 0 elsewhere, as temp(mask) = flat; temp + temp' computes it
+void unflatten_edges(span<const double> flat, const EdgeIndex& index, span<double> matrix);
+
+// Entry of each variable of an N x N matrix, matrix(mask)
+void flatten_edges(span<const double> matrix, const EdgeIndex& index, span<double> flat);
+
+}  // namespace prisme
+
+#endif
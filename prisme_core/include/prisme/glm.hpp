@@ -0,0 +1,106 @@
+/**
+ * glm.hpp - Mass-univariate GLM test statistics and permutation nulls (NBSglm_smn)
+ *
+ * All matrices are column-major: X is observations x predictors, y is
+ * observations x GLMs (one column per edge) and permutation blocks are
+ * GLMs x permutations.
+ *
+ * A design holds one or more contrasts (n_contrasts x n_predictors, one per row
+ * as in MATLAB). The fit, residuals and MSE of the data do not depend on the
+ * contrast, so every contrast is evaluated from one solve: a study with c
+ * contrasts pays for one residual pass per (permuted) data set instead of c.
+ * With several contrasts the outputs gain a trailing n_contrasts dimension.
+ *
+ * t-tests of up to 4 predictors (every create_design_matrix.m design but 'pt')
+ * run a kernel compiled for their number of predictors and test, chosen once by
+ * the constructor: each GLM is fit with fixed-size coefficients in registers and
+ * no temporaries. Larger designs use the generic QR solve. Both give the same
+ * statistics to rounding.
+ *
+ * F-tests never fit the data. The constructor keeps orthonormal bases of the full
+ * and reduced models, and the sums of squares of a block of GLMs come from the
+ * norms of one GEMM of their projections with the centered data.
+ */
+
+#ifndef PRISME_GLM_HPP
+#define PRISME_GLM_HPP
+
+#include "prisme/span.hpp"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace prisme {
+
+enum class GlmTest { OneSample, TTest, FTest };
+
+// 'onesample', 'ttest' or 'ftest', throws for anything else
+GlmTest parse_glm_test(const std::string& test);
+
+// Contrast independent part of the GLM, factorized once and shared by every
+// statistic computed against it
+class GlmDesign {
+public:
+    // contrast is n_contrasts x n_predictors (a single contrast is a vector of n_predictors);
+    // ind_nuisance holds 0-based predictor indices regressed out with Freedman & Lane.
+    // The contrasts share the nuisance fit and the reduced F model, so with several of
+    // them every row must be zero exactly on ind_nuisance (std::invalid_argument otherwise)
+    GlmDesign(span<const double> X, int n_observations, int n_predictors, span<const double> contrast,
+              GlmTest test, std::vector<int> ind_nuisance = {});
+    ~GlmDesign();
+    GlmDesign(GlmDesign&&) noexcept;
+    GlmDesign& operator=(GlmDesign&&) noexcept;
+
+    int n_observations() const;
+    int n_predictors() const;
+    int n_contrasts() const;
+
+    // Numerator degrees of freedom of the F statistic of every contrast: the
+    // predictors beyond the intercept without nuisance, otherwise the tested
+    // predictors beyond the reduced model (which keeps its column of ones unless the
+    // nuisance predictors already span it). Throws std::logic_error for t-tests.
+    std::vector<double> f_effect_df() const;
+
+    // Test statistic of every column of y (n_observations x n_GLMs) into test_stat
+    // (n_GLMs x n_contrasts)
+    void compute_test_stat(span<const double> y, int n_GLMs, span<double> test_stat) const;
+
+    // n_perms null statistics (n_GLMs x n_perms x n_contrasts), following the
+    // permute_signal.m rules, with every contrast evaluated on the same permuted data:
+    //   - onesample without nuisance: random sign flips
+    //   - other tests without nuisance: shuffle the observations
+    //   - with nuisance: shuffle residuals and add the nuisance fit back, followed
+    //     by sign flips for onesample
+    // The same seed returns the same block on every platform.
+    void generate_permutations(span<const double> y, int n_GLMs, int n_perms, uint64_t seed,
+                               span<double> perm_stats) const;
+
+    // True for the designs whose permutation nulls have a closed form: sign flips of
+    // an intercept only onesample design and label shuffles of a two group ttest
+    // (X rows of [1 0] or [0 1]), both without nuisance predictors, and correlation
+    // designs ('r': a score and an intercept column, contrasts on the score, the
+    // intercept at most a nuisance predictor)
+    bool has_closed_form_permutations() const;
+
+    // Same permutations as generate_permutations for the same seed, with the
+    // statistics computed from sufficient statistics instead of one solve per
+    // permutation. The sum of squares of each GLM does not change under sign flips
+    // or shuffles, only the (group) sums do, so a block is one GEMM of y' with the
+    // n_observations x n_perms sign or group indicator matrix plus elementwise
+    // finishing. Correlation designs get the Pearson r of every GLM from one GEMM of the
+    // centered y' with the permuted unit norm score and transform it to t in place.
+    // Matches generate_permutations to rounding, not bit for bit.
+    // Throws std::logic_error if has_closed_form_permutations() is false.
+    void generate_closed_form_permutations(span<const double> y, int n_GLMs, int n_perms, uint64_t seed,
+                                           span<double> perm_stats) const;
+
+private:
+    struct Impl;
+    std::unique_ptr<Impl> impl_;
+};
+
+}  // namespace prisme
+
+#endif
@@ -0,0 +1,26 @@
+/**
+ * parametric.hpp - Parametric (t-distribution) p-values with FWER and FDR correction
+ */
+
+#ifndef PRISME_PARAMETRIC_HPP
+#define PRISME_PARAMETRIC_HPP
+
+#include "prisme/glm.hpp"
+#include "prisme/span.hpp"
+
+namespace prisme {
+
+// Student's t cumulative distribution function, as MATLAB tcdf(t, df)
+double t_cdf(double t, double df);
+
+// Uncorrected one-sided p-values tcdf(-t, df) of GLM t statistics, df is
+// n_observations - 1 for onesample and n_observations - 2 for ttest
+// (tcdf_computation.m). Throws for ftest.
+void parametric_pvals(span<const double> test_stat, GlmTest test, int n_observations, span<double> pval);
+
+// Benjamini-Hochberg adjusted p-values, as MATLAB mafdr(p, 'BHFDR', true)
+void bh_fdr(span<const double> pval_uncorr, span<double> pval_fdr);
+
+}  // namespace prisme
+
+#endif
@@ -0,0 +1,113 @@
+/**
+ * power_runner.hpp - MATLAB independent repetition loop of the power calculator
+ *
+ * Runs the subsample -> GLM -> permutation stream -> method pipeline of
+ * pf_repetition_loop.m for the C++ methods (Size_cpp, Fast_TFCE_cpp,
+ * Constrained_cpp and Parametric) and journals the significance indicators of
+ * every method and repetition in the .prj result journal of the compact results
+ * file, which compact_result_journal.m folds into the file as usual.
+ *
+ * A study is a directory written by export_runner_study.m:
+ *   Y.pcol           - Variables x subjects
+ *   X.pcol           - Design of one repetition (observations x predictors), or of
+ *                      all subjects (subjects x predictors) when design = subject
+ *   mask.pcol        - 1-based linear index of each variable in the N x N mask
+ *   edge_groups.pcol - Network of each variable, 0 outside any network
+ *   ids_sampled.pcol - Subject ids (1-based) of each repetition, observations x repetitions
+ *   study.cfg        - key = value parameters, see read_runner_config
+ *
+ * With stage_profile_file set, the stage times of every journaled batch are
+ * appended to that file (see stage_profile.hpp).
+ */
+
+#ifndef PRISME_POWER_RUNNER_HPP
+#define PRISME_POWER_RUNNER_HPP
+
+#include "prisme/column_store.hpp"
+#include "prisme/edge_index.hpp"
+#include "prisme/glm.hpp"
+#include "prisme/span.hpp"
+#include "prisme/stage_profile.hpp"
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace prisme {
+
+struct RunnerConfig {
+    GlmTest test = GlmTest::OneSample;
+    bool design_per_subject = false;           // Rows of X are gathered with the repetition ids ('r')
+    std::vector<double> contrast;
+    int n_nodes = 0;
+    double thresh = 3.1;                       // First level threshold of Size
+    double alpha = 0.05;                       // Second level threshold
+    int n_perms = 1000;
+    int permutation_block_size = 0;            // 0 generates all permutations in one block
+    bool closed_form_permutations = false;     // Closed form blocks where the design has one (glm.hpp)
+    int n_repetitions = 0;                     // Target number of repetitions
+    std::vector<std::string> methods;          // Full method names, e.g. Constrained_cpp_FWER
+    std::map<std::string, int> existing_repetitions;
+    std::string journal_file;
+    std::string stage_profile_file;            // Empty skips the stage profile
+    int batch_size = 10;                       // Repetitions per journal append
+    uint64_t seed = 0;
+    int n_threads = 0;                         // 0 uses every hardware thread
+};
+
+struct Study {
+    size_t n_var = 0;
+    size_t n_subjects = 0;
+    MappedColumnStore Y;                       // n_var x n_subjects, mapped read-only and shared by all workers
+    std::vector<double> X;
+    size_t n_design_rows = 0;
+    size_t n_predictors = 0;
+    std::vector<uint64_t> mask_index;          // 0-based linear index in the N x N mask
+    EdgeIndex edge_index;                      // Node pair of each variable, built from mask_index
+    std::vector<double> edge_groups;
+    std::vector<double> ids_sampled;           // n_observations x n_id_repetitions, 1-based
+    size_t n_observations = 0;
+    size_t n_id_repetitions = 0;
+};
+
+// Result of one full method name in one repetition
+struct MethodResult {
+    std::string name;
+    std::vector<double> pvals;
+    std::vector<double> pvals_neg;
+    double time = 0;
+};
+
+// Full method names the runner implements
+const std::vector<std::string>& supported_runner_methods();
+
+// Parses a study.cfg file. Keys: test, design, contrast, n_nodes, thresh, alpha,
+// n_perms, permutation_block_size, closed_form_permutations (0 or 1), n_repetitions, methods (comma separated),
+// existing.<method>, journal_file, stage_profile_file, batch_size, seed and n_threads. Lines starting
+// with # are comments, unknown keys are an error.
+RunnerConfig read_runner_config(const std::string& path);
+
+// Loads the column stores of a study directory and checks them against the config
+Study load_study(const std::string& study_dir, const RunnerConfig& config);
+
+// 1 - p with the significance_indicator rule: 0 below 1 - alpha, 1 above it
+void significance_indicator(span<const double> pvals, double alpha, span<double> sig);
+
+// Methods of repetition rep_id (1-based) still pending, positive and negative effects.
+// The permutation seed is derived from config.seed and rep_id only, so results do
+// not depend on the number of threads. Stage times are added to profile when given.
+std::vector<MethodResult> run_repetition(const Study& study, const RunnerConfig& config, int rep_id,
+                                         StageProfile* profile = nullptr);
+
+// Runs every pending repetition on config.n_threads workers. Each (repetition,
+// method) pair is a task of a work-stealing TaskPool, and results are journaled as
+// they finish, every method in repetition order, about batch_size repetitions per
+// append. Results match run_repetition. Repetitions already in the journal count
+// as existing, so an interrupted run resumes where it stopped.
+// Returns the number of repetitions computed.
+int run_power_repetitions(const Study& study, const RunnerConfig& config);
+
+}  // namespace prisme
+
+#endif
@@ -0,0 +1,84 @@
+/**
+ * result_cache.hpp - Content-addressed on-disk cache of repetition results (.prc)
+ *
+ * Entries are double matrices (edge statistics, permutation blocks) stored one per
+ * file under the hex key of their inputs: the dataset, the sampled ids, the design,
+ * the contrast and the seed of the permutations. A later run over the same inputs,
+ * for example to add one method to a finished study, reads them back instead of
+ * fitting the GLM and generating the permutations again.
+ *
+ * Entries are written to a temporary file and renamed, so a reader sees either a
+ * complete entry or none; several processes may share one directory. Reading an
+ * entry touches its modification time, and every put evicts the least recently
+ * used entries until the directory is within its byte budget. A missing or
+ * unreadable entry is a miss, only failing to write is a std::runtime_error.
+ */
+
+#ifndef PRISME_RESULT_CACHE_HPP
+#define PRISME_RESULT_CACHE_HPP
+
+#include "prisme/span.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace prisme {
+
+// 128-bit streaming hash of the bytes given to update, not cryptographic. Two
+// multiply-rotate lanes over 8-byte words, finished with the murmur3 mixer.
+class ContentHash {
+public:
+    ContentHash();
+
+    void update(const void* data, size_t n_bytes);
+    void update(const std::string& text);
+    void update(span<const double> values);
+
+    // 32 lowercase hex characters; the hash can keep being updated afterwards
+    std::string hex() const;
+
+private:
+    uint64_t lanes_[2];
+    uint64_t n_bytes_ = 0;
+    unsigned char tail_[8];
+    size_t n_tail_ = 0;
+
+    void mix(uint64_t word);
+};
+
+struct CachedMatrix {
+    uint64_t n_rows = 0;
+    uint64_t n_cols = 0;
+    std::vector<double> values;  // Column major, n_rows x n_cols
+};
+
+class ResultCache {
+public:
+    // Creates directory if needed. max_bytes bounds the total size of the entries
+    ResultCache(const std::string& directory, uint64_t max_bytes);
+
+    // False if key is not cached. A hit marks the entry as recently used
+    bool get(const std::string& key, CachedMatrix& entry) const;
+
+    // Stores values (n_rows x n_cols) under key and evicts the least recently used
+    // entries beyond max_bytes. An entry larger than max_bytes is not stored.
+    void put(const std::string& key, span<const double> values, uint64_t n_rows, uint64_t n_cols);
+
+    // Total size of the entries in the directory
+    uint64_t size_bytes() const;
+
+    const std::string& directory() const { return directory_; }
+
+private:
+    std::string directory_;
+    uint64_t max_bytes_;
+
+    std::string entry_path(const std::string& key) const;
+    void evict() const;
+};
+
+}  // namespace prisme
+
+#endif
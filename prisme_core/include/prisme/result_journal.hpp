@@ -0,0 +1,54 @@
+/**
+ * result_journal.hpp - Append-only journal of per-method repetition results (.prj)
+ *
+ * Records hold the significance indicators of one method and repetition (stored
+ * sparsely), its computation time and repetition index, followed by a CRC32. The
+ * journal header keeps the end of the last complete batch, which is only moved
+ * after the batch is written: an interrupted append is simply not part of the
+ * journal. Errors are reported with std::runtime_error.
+ */
+
+#ifndef PRISME_RESULT_JOURNAL_HPP
+#define PRISME_RESULT_JOURNAL_HPP
+
+#include "prisme/span.hpp"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace prisme {
+
+// Running totals of one method over the valid records
+struct JournalMethodSummary {
+    std::string name;
+    std::vector<double> positives;
+    std::vector<double> negatives;
+    double total_calculations = 0;
+    double total_time = 0;
+    double max_repetition = 0;
+};
+
+struct JournalSummary {
+    uint64_t generation = 0;  // Incremented by every reset
+    size_t n_records = 0;
+    std::vector<JournalMethodSummary> methods;
+};
+
+// Adds one record to a batch buffer, positives and negatives must have the same size
+void encode_journal_record(std::vector<unsigned char>& batch, const std::string& method, uint32_t repetition,
+                           double time, span<const double> positives, span<const double> negatives);
+
+// Appends an encoded batch, creating the journal if needed
+void append_journal_batch(const std::string& path, const std::vector<unsigned char>& batch);
+
+// Sums of the valid records per method. If a repetition was journaled more than
+// once for a method, only its last record counts.
+JournalSummary read_journal(const std::string& path);
+
+// Drops every record and increments the generation
+void reset_journal(const std::string& path);
+
+}  // namespace prisme
+
+#endif
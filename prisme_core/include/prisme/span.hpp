@@ -0,0 +1,50 @@
+/**
+ * span.hpp - Non-owning view over contiguous memory
+ *
+ * The kernels take and fill plain arrays (column-major, as MATLAB stores them), so
+ * the same code runs on mxArray data in the MEX adapters, on std::vector buffers in
+ * native tools and on memory-mapped files. A minimal C++17 stand-in for std::span.
+ */
+
+#ifndef PRISME_SPAN_HPP
+#define PRISME_SPAN_HPP
+
+#include <cstddef>
+#include <type_traits>
+
+namespace prisme {
+
+template <typename T>
+class span {
+public:
+    span() = default;
+    span(T* data, std::size_t size) : data_(data), size_(size) {}
+
+    // Contiguous containers such as std::vector
+    template <typename Container,
+              typename = std::enable_if_t<
+                  std::is_convertible<decltype(std::declval<Container&>().data()), T*>::value>>
+    span(Container& container) : data_(container.data()), size_(container.size()) {}
+
+    // span<T> to span<const T>
+    template <typename U, typename = std::enable_if_t<std::is_convertible<U*, T*>::value>>
+    span(const span<U>& other) : data_(other.data()), size_(other.size()) {}
+
+    T* data() const { return data_; }
+    std::size_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+
+    T& operator[](std::size_t i) const { return data_[i]; }
+    T* begin() const { return data_; }
+    T* end() const { return data_ + size_; }
+
+    span subspan(std::size_t offset, std::size_t count) const { return span(data_ + offset, count); }
+
+private:
+    T* data_ = nullptr;
+    std::size_t size_ = 0;
+};
+
+}  // namespace prisme
+
+#endif
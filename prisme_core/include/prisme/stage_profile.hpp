@@ -0,0 +1,104 @@
+/**
+ * stage_profile.hpp - Per-stage wall time, CPU time, allocations and permutation counts
+ *
+ * The kernels and the repetition driver open a ScopedStage around each hot-path
+ * stage. The timers record into the StageProfile installed on the calling thread
+ * with ProfileScope. Without one, a ScopedStage only reads a thread-local pointer,
+ * so the instrumentation stays in production builds.
+ *
+ * Stages nest. The time of a stage excludes its nested stages, so the stage
+ * totals of a profile add up to the profiled time. bytes_allocated counts the
+ * working buffers a stage reports with add_bytes, not every heap allocation.
+ */
+
+#ifndef PRISME_STAGE_PROFILE_HPP
+#define PRISME_STAGE_PROFILE_HPP
+
+#include <array>
+#include <cstdint>
+#include <string>
+
+namespace prisme {
+
+enum class Stage : int {
+    Subsample,              // Gathering the observations of a repetition
+    GlmFit,                 // Design factorization and test statistics
+    PermutationGeneration,  // Permuted test statistics
+    UnflattenThreshold,     // Edge vectors to N x N matrices, first level threshold
+    ClusterFinding,         // Connected components and TFCE cluster merging
+    NullConstruction,       // Reducing permutations to the null of a method
+    Pvalues,                // Comparing the observed statistics with the null, corrections
+    Io,                     // Study, journal and column store reads and writes
+};
+
+constexpr int n_stages = 8;
+
+// Snake case name used in the profile files, e.g. "permutation_generation"
+const char* stage_name(Stage stage);
+
+struct StageTotals {
+    uint64_t calls = 0;
+    double wall_time = 0;           // Seconds, nested stages excluded
+    double cpu_time = 0;            // Seconds of CPU time of the calling thread
+    uint64_t bytes_allocated = 0;
+    uint64_t permutations = 0;
+};
+
+struct StageProfile {
+    std::array<StageTotals, n_stages> stages;
+
+    StageTotals& operator[](Stage stage) { return stages[static_cast<int>(stage)]; }
+    const StageTotals& operator[](Stage stage) const { return stages[static_cast<int>(stage)]; }
+
+    void merge(const StageProfile& other);
+};
+
+// Makes profile the target of the ScopedStage timers of this thread until the
+// scope ends. Scopes nest, the previous target is restored on exit.
+class ProfileScope {
+public:
+    explicit ProfileScope(StageProfile* profile);
+    ~ProfileScope();
+    ProfileScope(const ProfileScope&) = delete;
+    ProfileScope& operator=(const ProfileScope&) = delete;
+
+private:
+    StageProfile* previous_;
+};
+
+class ScopedStage {
+public:
+    explicit ScopedStage(Stage stage, uint64_t permutations = 0);
+    ~ScopedStage();
+    ScopedStage(const ScopedStage&) = delete;
+    ScopedStage& operator=(const ScopedStage&) = delete;
+
+    void add_bytes(uint64_t bytes) {
+        if (profile_ != nullptr) bytes_ += bytes;
+    }
+    void add_permutations(uint64_t permutations) {
+        if (profile_ != nullptr) permutations_ += permutations;
+    }
+
+private:
+    StageProfile* profile_;
+    ScopedStage* parent_ = nullptr;
+    Stage stage_;
+    double wall_start_ = 0;
+    double cpu_start_ = 0;
+    double child_wall_ = 0;
+    double child_cpu_ = 0;
+    uint64_t bytes_ = 0;
+    uint64_t permutations_ = 0;
+};
+
+// Appends one row per stage with calls > 0 to a CSV file, writing the header when
+// the file is new:
+//   source,first_repetition,last_repetition,stage,calls,wall_time,cpu_time,bytes_allocated,permutations
+// append_stage_profile.m writes the same format from MATLAB.
+void append_stage_profile(const std::string& path, const std::string& source, int first_repetition,
+                          int last_repetition, const StageProfile& profile);
+
+}  // namespace prisme
+
+#endif
@@ -0,0 +1,64 @@
+/**
+ * streaming_glm.hpp - Full sample GLM statistics accumulated from chunks of subjects
+ *
+ * The ground truth fits the GLM once on every subject. Instead of holding the
+ * variables x subjects matrix, StreamingGlm adds the subjects in chunks and keeps
+ * only the sufficient statistics of the least squares fit: Z'Y and the sum of
+ * squares of every variable, with Z = [X, 1]. X'X is known from the design. Memory
+ * is (n_predictors + 2) x n_var values plus one chunk, however many subjects.
+ *
+ * The statistics follow GlmDesign::compute_test_stat (same t and F definitions,
+ * se floor and NaN guard), computed from the normal equations instead of a QR of
+ * the data. They match it to rounding, not bit for bit. Every variable is shifted
+ * by its mean in the first chunk before accumulating, so large means do not cost
+ * precision in the sums of squares.
+ */
+
+#ifndef PRISME_STREAMING_GLM_HPP
+#define PRISME_STREAMING_GLM_HPP
+
+#include "prisme/column_store.hpp"
+#include "prisme/glm.hpp"
+#include "prisme/span.hpp"
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+namespace prisme {
+
+class StreamingGlm {
+public:
+    // X is n_observations x n_predictors, its rows in the order the observations are added
+    StreamingGlm(span<const double> X, int n_observations, int n_predictors, size_t n_var);
+    ~StreamingGlm();
+    StreamingGlm(StreamingGlm&&) noexcept;
+    StreamingGlm& operator=(StreamingGlm&&) noexcept;
+
+    size_t n_var() const;
+    int n_observations() const;
+    int n_added() const;
+
+    // Adds the next n_chunk observations. y_chunk is n_var x n_chunk, one column per
+    // subject as in Y and the column stores (not observations x GLMs as GlmDesign)
+    void add_observations(span<const double> y_chunk, int n_chunk);
+
+    // Test statistic of every variable into test_stat (n_var) once all observations
+    // are added. Any number of contrasts and tests can be computed from one pass;
+    // ind_nuisance holds 0-based predictor indices as for GlmDesign.
+    void compute_test_stat(span<const double> contrast, GlmTest test, const std::vector<int>& ind_nuisance,
+                           span<double> test_stat) const;
+
+private:
+    struct Impl;
+    std::unique_ptr<Impl> impl_;
+};
+
+// Adds every column of store to each GLM in one pass over the file, chunk_size
+// subject columns at a time. The store holds n_var x n_observations values.
+void stream_column_store(const MappedColumnStore& store, const std::vector<StreamingGlm*>& glms,
+                         size_t chunk_size);
+
+}  // namespace prisme
+
+#endif
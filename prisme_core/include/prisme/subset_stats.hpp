@@ -0,0 +1,54 @@
+/**
+ * subset_stats.hpp - t statistics of many subsampled repetitions from sufficient statistics
+ *
+ * For the designs draw_repetition_ids.m produces ('t', 'pt' and 't2'), the GLM t
+ * statistic of a repetition only depends on the per-variable sums and sums of
+ * squares over the sampled subjects. With S the subjects x repetitions selection
+ * matrix, Y S and (Y .* Y) S give these sums for every repetition in two matrix
+ * products, instead of one GLM fit per repetition on Y(:, ids).
+ *
+ * The sums run over data centered per variable, so they do not lose precision to
+ * large means. The statistics match GlmDesign::compute_test_stat on the sliced
+ * data to about 1e-12 relative, not bit for bit: the GLM solves through a QR
+ * factorization and rounds its coefficients to 14 decimals.
+ */
+
+#ifndef PRISME_SUBSET_STATS_HPP
+#define PRISME_SUBSET_STATS_HPP
+
+#include "prisme/span.hpp"
+
+#include <cstddef>
+#include <string>
+
+namespace prisme {
+
+enum class SubsetDesign {
+    OneSample,  // 't': X = ones, contrast 1
+    Paired,     // 'pt': ids [s; s + n_subjects / 2], condition column with contrast 1 and subject columns
+    TwoSample   // 't2': first half of the ids in group 1, second half in group 2, contrast [1, -1]
+};
+
+// 't', 'pt' or 't2', throws for anything else
+SubsetDesign parse_subset_design(const std::string& test_type);
+
+// t statistic of every variable in every repetition into t_stats (n_var x n_reps).
+// Y is n_var x n_subjects, ids holds the 1-based subject ids of each repetition in
+// the ids_sampled layout (n_ids x n_reps). Variables are processed in row blocks,
+// so the working memory stays at a block of Y however many subjects there are.
+void subset_t_stats(span<const double> Y, size_t n_var, span<const double> ids, size_t n_ids,
+                    SubsetDesign design, span<double> t_stats);
+
+// Nested sample size sweep: for every size n_k in sizes (increasing), repetition r
+// uses the first n_k subjects of its ids column (of each group for 't2', the first
+// n_k subjects and their second condition for 'pt'), so sizes follow n_subs_subset.
+// The sums of size k are the sums of size k - 1 plus the added subjects, so a
+// subject enters the products once per repetition whatever the number of sizes.
+// t_stats is n_var x n_sizes x n_reps. With sizes = {n_subs_subset} this is
+// subset_t_stats.
+void nested_subset_t_stats(span<const double> Y, size_t n_var, span<const double> ids, size_t n_ids,
+                           span<const size_t> sizes, SubsetDesign design, span<double> t_stats);
+
+}  // namespace prisme
+
+#endif
@@ -0,0 +1,77 @@
+/**
+ * task_pool.hpp - Work-stealing thread pool of the native runner
+ *
+ * Every worker owns a deque of tasks. A task submitted from inside a task goes to
+ * the back of the deque of the worker running it, and workers take their own tasks
+ * newest first, so follow-up work stays on the thread that holds its data. A worker
+ * without tasks steals the oldest task of another worker, and only then starts a
+ * task submitted from outside the pool. Work already started is thereby finished
+ * before new work begins, which keeps the number of open repetitions of
+ * run_power_repetitions close to the number of threads.
+ */
+
+#ifndef PRISME_TASK_POOL_HPP
+#define PRISME_TASK_POOL_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace prisme {
+
+class TaskPool {
+public:
+    using Task = std::function<void()>;
+
+    // n_threads workers, 0 for one per hardware thread
+    explicit TaskPool(int n_threads);
+    // Waits for the submitted tasks, then stops the workers
+    ~TaskPool();
+    TaskPool(const TaskPool&) = delete;
+    TaskPool& operator=(const TaskPool&) = delete;
+
+    int n_threads() const { return static_cast<int>(workers_.size()); }
+
+    // Queues a task. Tasks may submit further tasks to the same pool.
+    void submit(Task task);
+
+    // Blocks until every submitted task has finished, including the tasks they
+    // submitted. Must not be called from a task. After a task throws, tasks that
+    // have not started are dropped and wait rethrows the first exception.
+    void wait();
+
+private:
+    struct Worker {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    void work(int index);
+    bool take(int index, Task& task);
+    void run(Task& task);
+
+    std::vector<std::unique_ptr<Worker>> workers_;
+    std::vector<std::thread> threads_;
+
+    std::mutex mutex_;  // Guards injected_, stop_ and error_, and the waits below
+    std::condition_variable work_available_;
+    std::condition_variable all_done_;
+    std::deque<Task> injected_;  // Submitted from outside the pool
+    bool stop_ = false;
+    std::exception_ptr error_;
+
+    std::atomic<size_t> queued_{0};   // Tasks waiting in any queue
+    std::atomic<size_t> pending_{0};  // Tasks submitted and not finished
+    std::atomic<bool> failed_{false};
+};
+
+}  // namespace prisme
+
+#endif
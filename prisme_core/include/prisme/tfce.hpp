@@ -0,0 +1,55 @@
+/**
+ * tfce.hpp - Threshold-free cluster enhancement of connectomes
+ *
+ * Edge-based variants take and return N x N column-major matrices, or the flat
+ * edge variables with their EdgeIndex. The node-based variant takes a sparse matrix
+ * (0-based indices) and returns one value per node.
+ * dh is the threshold step, H the height and E the extent exponent.
+ *
+ * The grid variants use the thresholds k * dh, k = 1, 2, ..., and an edge of weight
+ * w is present at level k when floor(w / dh + 1e-10) >= k, so a weight on a boundary
+ * counts at that boundary despite rounding of w / dh.
+ */
+
+#ifndef PRISME_TFCE_HPP
+#define PRISME_TFCE_HPP
+
+#include "prisme/edge_index.hpp"
+#include "prisme/span.hpp"
+
+namespace prisme {
+
+// Incremental TFCE: edges are introduced at their threshold and clusters are merged
+// as the threshold decreases (Fast_TFCE). Values above 1000 are clipped to 100 and
+// the diagonal is ignored.
+void apply_tfce(span<const double> img, int n_nodes, double dh, double H, double E, span<double> tfced);
+
+// apply_tfce of each column of an n_edges x K block of edge variables, without the
+// N x N matrix. Each variable gets the value of its entry in the matrix variant.
+void apply_tfce(span<const double> edge_values, const EdgeIndex& index, double dh, double H, double E,
+                span<double> tfced);
+
+// Both tails of apply_tfce from one read of each column: tfced of edge_values and
+// tfced_neg of -edge_values. The positive and negative edges of a column are split
+// once, and each tail only visits its own edges.
+void apply_tfce_two_tailed(span<const double> edge_values, const EdgeIndex& index, double dh, double H, double E,
+                           span<double> tfced, span<double> tfced_neg);
+
+// Exact integration between consecutive edge values instead of a threshold grid:
+// edges are added from the largest value down and each cluster contributes between
+// the current value and the next smaller one (0 after the weakest positive edge)
+void exact_tfce(span<const double> img, int n_nodes, double H, double E, span<double> tfced);
+
+// Reference TFCE: connected components are recomputed at every threshold, with
+// the same preprocessing and edge levels as apply_tfce
+void traditional_tfce(span<const double> img, int n_nodes, double H, double E, double dh,
+                      span<double> tfced);
+
+// Node-based TFCE of a sparse matrix, only entries with row >= col and a
+// non-negative value are used
+void sparse_tfce(span<const int> rows, span<const int> cols, span<const double> values, int n_nodes,
+                 double dh, double H, double E, span<double> node_tfce);
+
+}  // namespace prisme
+
+#endif
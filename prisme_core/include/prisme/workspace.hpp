@@ -0,0 +1,102 @@
+/**
+ * workspace.hpp - Per-thread scratch buffers of the graph kernels
+ *
+ * The TFCE and Size kernels keep their cluster bookkeeping (node labels, linked
+ * node lists, BFS queues, threshold tables) in the Workspace of the calling thread
+ * instead of allocating it per call. Buffers only grow, so once a thread has seen
+ * its largest problem, the permutation loop runs without heap allocations. The
+ * kernels report the grown bytes to the stage profile as allocations.
+ *
+ * Buffers are addressed by slot. A kernel owns every slot while it runs and must
+ * not call another kernel that uses the workspace in between, contents are not
+ * preserved across kernel calls. Power tables are the exception: they are kept
+ * while their parameters match, so repeated TFCE calls with the same dh, H and E
+ * skip the pow calls of the integral.
+ *
+ * Kernels use the workspace installed on the calling thread with WorkspaceScope,
+ * or a thread-local default. MEX files install one they keep between calls and
+ * free with mexAtExit, so clear mex releases every buffer.
+ */
+
+#ifndef PRISME_WORKSPACE_HPP
+#define PRISME_WORKSPACE_HPP
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace prisme {
+
+class Workspace {
+public:
+    static constexpr size_t n_slots = 10;
+
+    // Buffer of n elements in the given slot, contents unspecified
+    int* ints(size_t slot, size_t n) { return grow(ints_[slot], n); }
+    double* doubles(size_t slot, size_t n) { return grow(doubles_[slot], n); }
+    unsigned char* flags(size_t slot, size_t n) { return grow(flags_[slot], n); }
+
+    static constexpr size_t n_power_slots = 2;
+
+    // (k * step)^exponent for k = 0, ..., n - 1. The table is recomputed only when
+    // step or exponent change, and extended when n grows.
+    const double* powers(size_t slot, size_t n, double step, double exponent);
+
+    // Bytes the buffers grew by since the last call
+    uint64_t take_grown_bytes() {
+        const uint64_t bytes = grown_bytes_;
+        grown_bytes_ = 0;
+        return bytes;
+    }
+
+    // Bytes held by all buffers
+    size_t capacity_bytes() const;
+
+    // Frees every buffer and power table
+    void release();
+
+private:
+    template <typename T>
+    T* grow(std::vector<T>& buffer, size_t n) {
+        if (buffer.capacity() < n) {
+            grown_bytes_ += (n - buffer.capacity()) * sizeof(T);
+            buffer.reserve(n);
+        }
+        buffer.resize(n);
+        return buffer.data();
+    }
+
+    struct PowerTable {
+        double step = 0;
+        double exponent = 0;
+        std::vector<double> values;
+    };
+
+    std::array<std::vector<int>, n_slots> ints_;
+    std::array<std::vector<double>, n_slots> doubles_;
+    std::array<std::vector<unsigned char>, n_slots> flags_;
+    std::array<PowerTable, n_power_slots> powers_;
+    uint64_t grown_bytes_ = 0;
+};
+
+// Workspace installed on the calling thread, otherwise a thread-local default that
+// is created on first use and kept until the thread exits
+Workspace& thread_workspace();
+
+// Makes workspace the one the kernels of this thread use until the scope ends.
+// Scopes nest, the previous workspace is restored on exit.
+class WorkspaceScope {
+public:
+    explicit WorkspaceScope(Workspace* workspace);
+    ~WorkspaceScope();
+    WorkspaceScope(const WorkspaceScope&) = delete;
+    WorkspaceScope& operator=(const WorkspaceScope&) = delete;
+
+private:
+    Workspace* previous_;
+};
+
+}  // namespace prisme
+
+#endif
@@ -0,0 +1,405 @@
+/**
+ * cluster_size.cpp - Connected components of thresholded connectomes (Size method)
+ */
+
+#include "prisme/cluster_size.hpp"
+
+#include "prisme/stage_profile.hpp"
+#include "prisme/workspace.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+namespace prisme {
+
+namespace {
+
+void check_square(span<const double> matrix, int n_nodes, const char* name) {
+    if (n_nodes < 0 || matrix.size() != static_cast<size_t>(n_nodes) * n_nodes) {
+        throw std::invalid_argument(std::string(name) + " must be an N x N matrix");
+    }
+}
+
+// Workspace slots of the component scan
+enum IntSlot { Queue, ComponentBegin, NodeComponent, Parent, ParentNeg };
+enum DoubleSlot { ComponentEdges, ComponentPval, ComponentEdgesNeg };
+enum FlagSlot { Visited };
+
+// Components of an adjacency matrix in the thread workspace. The BFS queue holds the
+// nodes of component c at [begin[c], begin[c + 1]), in visiting order.
+struct ComponentScan {
+    int n_components = 0;
+    const int* queue = nullptr;
+    const int* begin = nullptr;
+    const double* edges = nullptr;
+    const int* node_component = nullptr;  // -1 for nodes outside any component
+};
+
+// BFS from every unvisited node in increasing order. Nodes without a positive entry
+// are skipped and components with a single node are dropped.
+ComponentScan scan_components(const double* adj, int N, Workspace& ws) {
+    int* queue = ws.ints(Queue, N);
+    int* begin = ws.ints(ComponentBegin, static_cast<size_t>(N) + 1);
+    int* node_component = ws.ints(NodeComponent, N);
+    double* edges = ws.doubles(ComponentEdges, N);
+    unsigned char* visited = ws.flags(Visited, N);
+    std::fill(visited, visited + N, 0);
+    std::fill(node_component, node_component + N, -1);
+
+    int n_components = 0;
+    int tail = 0;
+    for (int start = 0; start < N; start++) {
+        if (visited[start]) continue;
+
+        // Check if this node has any connections
+        const double* row = adj + static_cast<size_t>(start) * N;
+        visited[start] = 1;
+        if (std::none_of(row, row + N, [](double value) { return value > 0; })) {
+            continue;  // Skip isolated nodes
+        }
+
+        const int first = tail;
+        double size = 0;
+        queue[tail++] = start;
+
+        // BFS to find all connected nodes and count edges
+        for (int head = first; head < tail; head++) {
+            const int node = queue[head];
+            const double* column = adj + static_cast<size_t>(node) * N;
+
+            for (int neighbor = 0; neighbor < N; neighbor++) {
+                if (column[neighbor] > 0) {
+                    // Count this edge (but avoid double counting)
+                    if (node < neighbor) {
+                        size += 1.0;
+                    }
+
+                    if (!visited[neighbor]) {
+                        visited[neighbor] = 1;
+                        queue[tail++] = neighbor;
+                    }
+                }
+            }
+        }
+
+        // Only keep components with more than one node
+        if (tail - first > 1) {
+            begin[n_components] = first;
+            edges[n_components] = size;
+            for (int k = first; k < tail; k++) {
+                node_component[queue[k]] = n_components;
+            }
+            n_components++;
+        } else {
+            tail = first;
+        }
+    }
+    begin[n_components] = tail;
+
+    return {n_components, queue, begin, edges, node_component};
+}
+
+// Components of the edge variables above thresh in a union-find forest over the
+// nodes. Roots hold the edge count of their component, so no adjacency matrix is built.
+struct EdgeComponents {
+    int* parent = nullptr;
+    double* edges = nullptr;
+
+    EdgeComponents() = default;
+    EdgeComponents(int* parent_buffer, double* edges_buffer, int n_nodes)
+        : parent(parent_buffer), edges(edges_buffer) {
+        for (int node = 0; node < n_nodes; node++) {
+            parent[node] = node;
+            edges[node] = 0;
+        }
+    }
+
+    int root(int node) const {
+        while (parent[node] != node) {
+            parent[node] = parent[parent[node]];
+            node = parent[node];
+        }
+        return node;
+    }
+
+    void add_edge(int i, int j) {
+        const int root_i = root(i);
+        const int root_j = root(j);
+        if (root_i != root_j) {
+            parent[root_j] = root_i;
+            edges[root_i] += edges[root_j];
+        }
+        edges[root_i] += 1.0;
+    }
+
+    // Largest component, at least 1
+    double max_size(int n_nodes) const {
+        double max_sz = 1;
+        for (int node = 0; node < n_nodes; node++) {
+            if (parent[node] == node) {
+                max_sz = std::max(max_sz, edges[node]);
+            }
+        }
+        return max_sz;
+    }
+};
+
+EdgeComponents scan_edge_components(const double* stats, const EdgeIndex& index, double thresh, Workspace& ws) {
+    const int N = index.n_nodes;
+    EdgeComponents components(ws.ints(Parent, N), ws.doubles(ComponentEdges, N), N);
+    for (size_t e = 0; e < index.size(); e++) {
+        if (stats[e] > thresh) {
+            components.add_edge(index.rows[e], index.cols[e]);
+        }
+    }
+    return components;
+}
+
+void check_edge_block(span<const double> stats, const EdgeIndex& index, size_t n_columns, const char* name) {
+    if (stats.size() != index.size() * n_columns) {
+        throw std::invalid_argument(std::string(name) + " must have one row per mask variable");
+    }
+}
+
+}  // namespace
+
+std::vector<Component> find_components(span<const double> adj_matrix, int N) {
+    check_square(adj_matrix, N, "adj_matrix");
+    ScopedStage stage(Stage::ClusterFinding);
+    Workspace& ws = thread_workspace();
+    const ComponentScan scan = scan_components(adj_matrix.data(), N, ws);
+    stage.add_bytes(ws.take_grown_bytes());
+
+    std::vector<Component> components(scan.n_components);
+    for (int c = 0; c < scan.n_components; c++) {
+        components[c].nodes.assign(scan.queue + scan.begin[c], scan.queue + scan.begin[c + 1]);
+        components[c].size = scan.edges[c];
+    }
+    return components;
+}
+
+void size_null_distribution(span<const double> permuted_adj_matrices, int N, span<double> null_dist) {
+    const size_t matrix_size = static_cast<size_t>(N) * N;
+    if (permuted_adj_matrices.size() != matrix_size * null_dist.size()) {
+        throw std::invalid_argument("permuted_adj_matrices must be a 3D array (N x N x K)");
+    }
+    ScopedStage stage(Stage::NullConstruction, null_dist.size());
+    Workspace& ws = thread_workspace();
+
+    for (size_t k = 0; k < null_dist.size(); k++) {
+        ScopedStage cluster_stage(Stage::ClusterFinding);
+        const ComponentScan scan = scan_components(permuted_adj_matrices.data() + k * matrix_size, N, ws);
+        cluster_stage.add_bytes(ws.take_grown_bytes());
+
+        double perm_max_sz = 1;
+        for (int c = 0; c < scan.n_components; c++) {
+            perm_max_sz = std::max(perm_max_sz, scan.edges[c]);
+        }
+        null_dist[k] = perm_max_sz;
+    }
+}
+
+void size_pvals(span<const double> adj_matrix, int N, span<const double> null_dist, span<double> pval) {
+    check_square(adj_matrix, N, "adj_matrix");
+    if (pval.size() != adj_matrix.size()) {
+        throw std::invalid_argument("pval must have the size of adj_matrix");
+    }
+    const size_t K = null_dist.size();
+    ScopedStage stage(Stage::Pvalues);
+    Workspace& ws = thread_workspace();
+
+    ComponentScan scan;
+    {
+        ScopedStage cluster_stage(Stage::ClusterFinding);
+        scan = scan_components(adj_matrix.data(), N, ws);
+        cluster_stage.add_bytes(ws.take_grown_bytes());
+    }
+
+    // Count how many values in null distribution are >= the size of each component
+    double* component_pval = ws.doubles(ComponentPval, scan.n_components);
+    for (int c = 0; c < scan.n_components; c++) {
+        double p_count = 0;
+        for (size_t k = 0; k < K; k++) {
+            if (null_dist[k] >= scan.edges[c]) {
+                p_count += 1.0;
+            }
+        }
+        component_pval[c] = std::min(p_count / K, 1.0);
+    }
+    stage.add_bytes(ws.take_grown_bytes());
+
+    // Edges take the p-value of their component, 1 where there is no edge
+    for (int j = 0; j < N; j++) {
+        for (int i = 0; i < N; i++) {
+            const size_t e = i + static_cast<size_t>(j) * N;
+            const int c = scan.node_component[i];
+            pval[e] = (i != j && c >= 0 && adj_matrix[e] > 0) ? component_pval[c] : 1.0;
+        }
+    }
+}
+
+void size_null_distribution(span<const double> permuted_edge_stats, const EdgeIndex& index, double thresh,
+                            span<double> null_dist) {
+    check_edge_block(permuted_edge_stats, index, null_dist.size(), "permuted_edge_stats");
+    ScopedStage stage(Stage::NullConstruction, null_dist.size());
+    Workspace& ws = thread_workspace();
+
+    for (size_t k = 0; k < null_dist.size(); k++) {
+        ScopedStage cluster_stage(Stage::ClusterFinding);
+        const EdgeComponents components =
+            scan_edge_components(permuted_edge_stats.data() + k * index.size(), index, thresh, ws);
+        cluster_stage.add_bytes(ws.take_grown_bytes());
+        null_dist[k] = components.max_size(index.n_nodes);
+    }
+}
+
+void size_null_distribution_two_tailed(span<const double> permuted_edge_stats, const EdgeIndex& index,
+                                       double thresh, span<double> null_dist, span<double> null_dist_neg) {
+    check_edge_block(permuted_edge_stats, index, null_dist.size(), "permuted_edge_stats");
+    if (null_dist_neg.size() != null_dist.size()) {
+        throw std::invalid_argument("null_dist_neg must have one entry per permutation");
+    }
+    ScopedStage stage(Stage::NullConstruction, null_dist.size());
+    Workspace& ws = thread_workspace();
+    const int N = index.n_nodes;
+
+    for (size_t k = 0; k < null_dist.size(); k++) {
+        ScopedStage cluster_stage(Stage::ClusterFinding);
+        EdgeComponents positive(ws.ints(Parent, N), ws.doubles(ComponentEdges, N), N);
+        EdgeComponents negative(ws.ints(ParentNeg, N), ws.doubles(ComponentEdgesNeg, N), N);
+        cluster_stage.add_bytes(ws.take_grown_bytes());
+
+        // The negative forest thresholds -stat as the negated block would, so an edge
+        // joins both forests when thresh is negative
+        const double* stats = permuted_edge_stats.data() + k * index.size();
+        for (size_t e = 0; e < index.size(); e++) {
+            if (stats[e] > thresh) {
+                positive.add_edge(index.rows[e], index.cols[e]);
+            }
+            if (-stats[e] > thresh) {
+                negative.add_edge(index.rows[e], index.cols[e]);
+            }
+        }
+        null_dist[k] = positive.max_size(N);
+        null_dist_neg[k] = negative.max_size(N);
+    }
+}
+
+void size_pvals(span<const double> edge_stats, const EdgeIndex& index, double thresh, span<const double> null_dist,
+                span<double> pval) {
+    check_edge_block(edge_stats, index, 1, "edge_stats");
+    if (pval.size() != edge_stats.size()) {
+        throw std::invalid_argument("pval must have the size of edge_stats");
+    }
+    const size_t K = null_dist.size();
+    ScopedStage stage(Stage::Pvalues);
+    Workspace& ws = thread_workspace();
+
+    EdgeComponents components;
+    {
+        ScopedStage cluster_stage(Stage::ClusterFinding);
+        components = scan_edge_components(edge_stats.data(), index, thresh, ws);
+        cluster_stage.add_bytes(ws.take_grown_bytes());
+    }
+
+    // P-value of the component at each root, computed when one of its edges asks
+    double* component_pval = ws.doubles(ComponentPval, index.n_nodes);
+    std::fill(component_pval, component_pval + index.n_nodes, -1.0);
+    stage.add_bytes(ws.take_grown_bytes());
+
+    for (size_t e = 0; e < index.size(); e++) {
+        if (!(edge_stats[e] > thresh)) {
+            pval[e] = 1.0;
+            continue;
+        }
+        const int root = components.root(index.rows[e]);
+        if (component_pval[root] < 0) {
+            double p_count = 0;
+            for (size_t k = 0; k < K; k++) {
+                if (null_dist[k] >= components.edges[root]) {
+                    p_count += 1.0;
+                }
+            }
+            component_pval[root] = std::min(p_count / K, 1.0);
+        }
+        pval[e] = component_pval[root];
+    }
+}
+
+void sparse_cluster_sizes(span<const int> rows, span<const int> cols, int N, span<double> cluster_sizes) {
+    if (rows.size() != cols.size()) {
+        throw std::invalid_argument("I and J must have the same number of elements");
+    }
+    if (cluster_sizes.size() != static_cast<size_t>(N)) {
+        throw std::invalid_argument("cluster_sizes must have one entry per node");
+    }
+
+    ScopedStage stage(Stage::ClusterFinding);
+    Workspace& ws = thread_workspace();
+
+    // Cluster indicator array - 0 means no cluster assigned yet. Clusters keep their
+    // nodes in a linked list (first, last, next node) and their node count.
+    int* cluster_id = ws.ints(0, N);
+    int* first = ws.ints(1, static_cast<size_t>(N) + 1);
+    int* last = ws.ints(2, static_cast<size_t>(N) + 1);
+    int* next = ws.ints(3, N);
+    int* count = ws.ints(4, static_cast<size_t>(N) + 1);
+    std::fill(cluster_id, cluster_id + N, 0);
+    stage.add_bytes(ws.take_grown_bytes());
+    int next_cluster_id = 1;
+
+    auto append = [&](int cluster, int node) {
+        cluster_id[node] = cluster;
+        next[node] = -1;
+        next[last[cluster]] = node;
+        last[cluster] = node;
+        count[cluster]++;
+    };
+
+    for (size_t k = 0; k < rows.size(); k++) {
+        int node_i = rows[k];
+        int node_j = cols[k];
+        if (node_i < 0 || node_i >= N || node_j < 0 || node_j >= N) {
+            throw std::out_of_range("Edge index exceeds the matrix size");
+        }
+
+        int cluster_i = cluster_id[node_i];
+        int cluster_j = cluster_id[node_j];
+
+        if (cluster_i == 0 && cluster_j == 0) {
+            // Both nodes do not belong to a cluster - create new cluster
+            int new_cluster = next_cluster_id++;
+            cluster_id[node_i] = new_cluster;
+            next[node_i] = -1;
+            first[new_cluster] = last[new_cluster] = node_i;
+            count[new_cluster] = 1;
+            if (node_i != node_j) {  // Avoid duplicates for self-loops
+                append(new_cluster, node_j);
+            }
+        } else if (cluster_i == 0) {
+            append(cluster_j, node_i);
+        } else if (cluster_j == 0) {
+            append(cluster_i, node_j);
+        } else if (cluster_i != cluster_j) {
+            // Merge smaller cluster into larger one
+            int target = cluster_i;
+            int absorbed = cluster_j;
+            if (count[cluster_i] < count[cluster_j]) {
+                std::swap(target, absorbed);
+            }
+            for (int node = first[absorbed]; node != -1; node = next[node]) {
+                cluster_id[node] = target;
+            }
+            next[last[target]] = first[absorbed];
+            last[target] = last[absorbed];
+            count[target] += count[absorbed];
+        }
+    }
+
+    for (int i = 0; i < N; i++) {
+        cluster_sizes[i] = cluster_id[i] != 0 ? static_cast<double>(count[cluster_id[i]]) : 0.0;
+    }
+}
+
+}  // namespace prisme
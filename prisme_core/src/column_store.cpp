@@ -0,0 +1,334 @@
+/**
+ * column_store.cpp - PRISME columnar binary store (.pcol)
+ */
+
+#include "prisme/column_store.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <utility>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace prisme {
+
+namespace {
+
+const char STORE_MAGIC[8] = {'P', 'R', 'S', 'M', 'C', 'O', 'L', '\0'};
+const uint32_t STORE_VERSION = 1;
+
+// On disk header, padded to column_store_header_bytes so the columns stay aligned
+struct StoreHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t class_id;
+    uint64_t n_rows;
+    uint64_t n_cols;
+    char reserved[column_store_header_bytes - 32];
+};
+
+static_assert(sizeof(StoreHeader) == column_store_header_bytes, "Column store header must be 64 bytes");
+
+// Closes the file on every exit path
+struct FileHandle {
+    FILE* file;
+    explicit FileHandle(FILE* f) : file(f) {}
+    ~FileHandle() {
+        if (file) {
+            std::fclose(file);
+        }
+    }
+    FileHandle(const FileHandle&) = delete;
+    FileHandle& operator=(const FileHandle&) = delete;
+};
+
+// 64-bit seek, long is only 32 bits on Windows
+bool seek_to(FILE* file, uint64_t offset) {
+#ifdef _WIN32
+    return _fseeki64(file, static_cast<__int64>(offset), SEEK_SET) == 0;
+#else
+    return fseeko(file, static_cast<off_t>(offset), SEEK_SET) == 0;
+#endif
+}
+
+StoreHeader read_header(FILE* file) {
+    StoreHeader header;
+    if (!seek_to(file, 0) || std::fread(&header, sizeof(header), 1, file) != 1) {
+        throw std::runtime_error("Could not read the column store header");
+    }
+    if (std::memcmp(header.magic, STORE_MAGIC, sizeof(STORE_MAGIC)) != 0 || header.version != STORE_VERSION ||
+        (header.class_id != static_cast<uint32_t>(StoreClass::Double) &&
+         header.class_id != static_cast<uint32_t>(StoreClass::Single))) {
+        throw std::runtime_error("File is not a column store");
+    }
+    return header;
+}
+
+void write_header(FILE* file, const StoreHeader& header) {
+    if (!seek_to(file, 0) || std::fwrite(&header, sizeof(header), 1, file) != 1 || std::fflush(file) != 0) {
+        throw std::runtime_error("Could not write the column store header");
+    }
+}
+
+StoreHeader open_header(const std::string& path) {
+    FileHandle handle(std::fopen(path.c_str(), "rb"));
+    if (!handle.file) {
+        throw std::runtime_error("Could not open " + path);
+    }
+    return read_header(handle.file);
+}
+
+}  // namespace
+
+const char* store_class_name(StoreClass store_class) {
+    return store_class == StoreClass::Single ? "single" : "double";
+}
+
+size_t store_element_bytes(StoreClass store_class) {
+    return store_class == StoreClass::Single ? sizeof(float) : sizeof(double);
+}
+
+void create_column_store(const std::string& path, uint64_t n_rows, StoreClass store_class) {
+    FileHandle handle(std::fopen(path.c_str(), "wb"));
+    if (!handle.file) {
+        throw std::runtime_error("Could not create " + path);
+    }
+
+    StoreHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, STORE_MAGIC, sizeof(STORE_MAGIC));
+    header.version = STORE_VERSION;
+    header.class_id = static_cast<uint32_t>(store_class);
+    header.n_rows = n_rows;
+    header.n_cols = 0;
+    write_header(handle.file, header);
+}
+
+StoreInfo read_column_store_info(const std::string& path) {
+    const StoreHeader header = open_header(path);
+    return {header.n_rows, header.n_cols, static_cast<StoreClass>(header.class_id)};
+}
+
+uint64_t write_store_columns(const std::string& path, uint64_t first_col, const void* data, uint64_t n_rows,
+                             uint64_t n_new, StoreClass store_class, bool append) {
+    FileHandle handle(std::fopen(path.c_str(), "r+b"));
+    if (!handle.file) {
+        throw std::runtime_error("Could not open " + path);
+    }
+    FILE* file = handle.file;
+
+    StoreHeader header = read_header(file);
+    if (header.n_rows != n_rows || header.class_id != static_cast<uint32_t>(store_class)) {
+        throw std::runtime_error("Columns must have " + std::to_string(header.n_rows) + " rows and class " +
+                                 store_class_name(static_cast<StoreClass>(header.class_id)));
+    }
+
+    if (append) {
+        first_col = header.n_cols;
+    }
+
+    const uint64_t column_bytes = n_rows * store_element_bytes(store_class);
+    bool ok = true;
+
+    // NaN fill any gap between the current end and the first written column, so
+    // repetitions that were never written read as missing rather than as zeros
+    if (first_col > header.n_cols) {
+        std::vector<char> missing(column_bytes);
+        if (store_class == StoreClass::Double) {
+            std::vector<double> nans(n_rows, std::numeric_limits<double>::quiet_NaN());
+            std::memcpy(missing.data(), nans.data(), column_bytes);
+        } else {
+            std::vector<float> nans(n_rows, std::numeric_limits<float>::quiet_NaN());
+            std::memcpy(missing.data(), nans.data(), column_bytes);
+        }
+        ok = seek_to(file, column_store_header_bytes + header.n_cols * column_bytes);
+        for (uint64_t c = header.n_cols; ok && c < first_col; c++) {
+            ok = std::fwrite(missing.data(), 1, column_bytes, file) == column_bytes;
+        }
+    }
+
+    if (ok) {
+        ok = seek_to(file, column_store_header_bytes + first_col * column_bytes) &&
+             std::fwrite(data, 1, n_new * column_bytes, file) == n_new * column_bytes && std::fflush(file) == 0;
+    }
+    if (!ok) {
+        throw std::runtime_error("Could not write columns to " + path);
+    }
+
+    // Header last: the store only grows once its columns are on disk
+    if (first_col + n_new > header.n_cols) {
+        header.n_cols = first_col + n_new;
+        write_header(file, header);
+    }
+    return header.n_cols;
+}
+
+void read_store_columns(const std::string& path, const StoreInfo& info, const std::vector<uint64_t>& col_idx,
+                        void* out) {
+    const uint64_t column_bytes = info.n_rows * store_element_bytes(info.store_class);
+    const uint64_t total_bytes = column_store_header_bytes + info.n_cols * column_bytes;
+    char* out_bytes = static_cast<char*>(out);
+
+    for (uint64_t c : col_idx) {
+        if (c >= info.n_cols) {
+            throw std::out_of_range("Column index exceeds the number of columns of " + path);
+        }
+    }
+
+#ifndef _WIN32
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("Could not open " + path);
+    }
+    if (total_bytes == column_store_header_bytes || col_idx.empty()) {
+        close(fd);
+        return;
+    }
+
+    void* mapped = mmap(nullptr, total_bytes, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mapped == MAP_FAILED) {
+        throw std::runtime_error("Could not map " + path);
+    }
+
+    const char* columns = static_cast<const char*>(mapped) + column_store_header_bytes;
+    for (size_t i = 0; i < col_idx.size(); i++) {
+        std::memcpy(out_bytes + i * column_bytes, columns + col_idx[i] * column_bytes, column_bytes);
+    }
+
+    munmap(mapped, total_bytes);
+#else
+    FileHandle handle(std::fopen(path.c_str(), "rb"));
+    if (!handle.file) {
+        throw std::runtime_error("Could not open " + path);
+    }
+    bool ok = true;
+    for (size_t i = 0; ok && i < col_idx.size(); i++) {
+        ok = seek_to(handle.file, column_store_header_bytes + col_idx[i] * column_bytes) &&
+             std::fread(out_bytes + i * column_bytes, 1, column_bytes, handle.file) == column_bytes;
+    }
+    if (!ok) {
+        throw std::runtime_error("Could not read columns from " + path);
+    }
+    (void)total_bytes;
+#endif
+}
+
+std::vector<double> read_column_store(const std::string& path, StoreInfo& info) {
+    info = read_column_store_info(path);
+    std::vector<uint64_t> col_idx(info.n_cols);
+    for (uint64_t c = 0; c < info.n_cols; c++) {
+        col_idx[c] = c;
+    }
+
+    std::vector<double> values(info.n_rows * info.n_cols);
+    if (info.store_class == StoreClass::Double) {
+        read_store_columns(path, info, col_idx, values.data());
+    } else {
+        std::vector<float> single_values(values.size());
+        read_store_columns(path, info, col_idx, single_values.data());
+        values.assign(single_values.begin(), single_values.end());
+    }
+    return values;
+}
+
+MappedColumnStore::MappedColumnStore(const std::string& path) : info_(read_column_store_info(path)) {
+    const uint64_t data_bytes = info_.n_rows * info_.n_cols * store_element_bytes(info_.store_class);
+    if (data_bytes == 0) {
+        return;
+    }
+
+#ifndef _WIN32
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("Could not open " + path);
+    }
+    const uint64_t total_bytes = column_store_header_bytes + data_bytes;
+    void* mapped = mmap(nullptr, total_bytes, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mapped == MAP_FAILED) {
+        throw std::runtime_error("Could not map " + path);
+    }
+    mapped_ = mapped;
+    mapped_bytes_ = total_bytes;
+    columns_ = static_cast<const char*>(mapped) + column_store_header_bytes;
+#else
+    std::vector<uint64_t> col_idx(info_.n_cols);
+    for (uint64_t c = 0; c < info_.n_cols; c++) {
+        col_idx[c] = c;
+    }
+    buffer_.resize(data_bytes);
+    read_store_columns(path, info_, col_idx, buffer_.data());
+    columns_ = buffer_.data();
+#endif
+}
+
+MappedColumnStore::~MappedColumnStore() {
+    release();
+}
+
+MappedColumnStore::MappedColumnStore(MappedColumnStore&& other) noexcept {
+    *this = std::move(other);
+}
+
+MappedColumnStore& MappedColumnStore::operator=(MappedColumnStore&& other) noexcept {
+    if (this != &other) {
+        release();
+        info_ = other.info_;
+        columns_ = other.columns_;
+        mapped_ = other.mapped_;
+        mapped_bytes_ = other.mapped_bytes_;
+        buffer_ = std::move(other.buffer_);
+        other.info_ = {0, 0, StoreClass::Double};
+        other.columns_ = nullptr;
+        other.mapped_ = nullptr;
+        other.mapped_bytes_ = 0;
+    }
+    return *this;
+}
+
+void MappedColumnStore::release() {
+#ifndef _WIN32
+    if (mapped_) {
+        munmap(mapped_, mapped_bytes_);
+    }
+#endif
+    mapped_ = nullptr;
+    mapped_bytes_ = 0;
+    columns_ = nullptr;
+    buffer_.clear();
+}
+
+const void* MappedColumnStore::column(uint64_t c) const {
+    if (c >= info_.n_cols) {
+        throw std::out_of_range("Column index exceeds the number of columns of the store");
+    }
+    return columns_ + c * info_.n_rows * store_element_bytes(info_.store_class);
+}
+
+void MappedColumnStore::gather_columns(span<const uint64_t> col_idx, span<double> out) const {
+    const uint64_t n_rows = info_.n_rows;
+    if (out.size() != n_rows * col_idx.size()) {
+        throw std::invalid_argument("out must hold n_rows values per requested column");
+    }
+    for (size_t i = 0; i < col_idx.size(); i++) {
+        double* target = out.data() + i * n_rows;
+        if (info_.store_class == StoreClass::Double) {
+            std::memcpy(target, column(col_idx[i]), n_rows * sizeof(double));
+        } else {
+            const float* values = static_cast<const float*>(column(col_idx[i]));
+            for (uint64_t r = 0; r < n_rows; r++) {
+                target[r] = values[r];
+            }
+        }
+    }
+}
+
+}  // namespace prisme
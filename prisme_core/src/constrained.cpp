@@ -0,0 +1,169 @@
+/**
+ * constrained.cpp - Network-level (Constrained) p-values with FWER and FDR correction
+ */
+
+#include "prisme/constrained.hpp"
+
+#include "prisme/stage_profile.hpp"
+
+#include <algorithm>
+#include <set>
+#include <stdexcept>
+#include <utility>
+
+namespace prisme {
+
+void fwer_correction(span<const double> pval_uncorr, span<double> pval_fwer) {
+    const size_t num_networks = pval_uncorr.size();
+    for (size_t i = 0; i < num_networks; i++) {
+        pval_fwer[i] = std::min(pval_uncorr[i] * num_networks, 1.0);
+    }
+}
+
+void fdr_correction(span<const double> pval_uncorr, double alpha, span<double> pval_fdr) {
+    const size_t num_networks = pval_uncorr.size();
+    std::vector<std::pair<double, size_t>> p_indexed(num_networks);
+    for (size_t i = 0; i < num_networks; i++) {
+        p_indexed[i] = std::make_pair(pval_uncorr[i], i);
+    }
+    std::sort(p_indexed.begin(), p_indexed.end());
+
+    // Each sorted p-value is compared with its own threshold, as in Constrained.m
+    std::fill(pval_fdr.begin(), pval_fdr.end(), 1.0);
+    for (size_t j = 0; j < num_networks; j++) {
+        double threshold = (j + 1.0) / num_networks * alpha;
+        if (p_indexed[j].first <= threshold) {
+            pval_fdr[p_indexed[j].second] = 0.0;
+        }
+    }
+}
+
+namespace {
+
+// Positive tail into result and, if negative is set, the tail of the negated
+// statistics from the same network sums: -perm >= -observed is perm <= observed
+void constrained_tails(span<const double> edge_stats, span<const double> permuted_edge_stats,
+                       span<const double> network_indices, double alpha, span<const double> prior_count,
+                       span<const double> prior_count_neg, double prior_perms, ConstrainedResult& result,
+                       ConstrainedResult* negative) {
+    const size_t num_edges = edge_stats.size();
+    if (network_indices.size() != num_edges) {
+        throw std::invalid_argument("network_indices must have the same length as edge_stats");
+    }
+    if ((num_edges == 0 && !permuted_edge_stats.empty()) ||
+        (num_edges > 0 && permuted_edge_stats.size() % num_edges != 0)) {
+        throw std::invalid_argument("permuted_edge_stats must have dimensions [num_edges x num_perms]");
+    }
+    const size_t num_perms = num_edges > 0 ? permuted_edge_stats.size() / num_edges : 0;
+    // The final call of a chained stream only turns the counts into p-values
+    ScopedStage stage(num_perms > 0 ? Stage::NullConstruction : Stage::Pvalues, num_perms);
+
+    // Unique network indices, zero is not a network
+    std::set<int> network_set;
+    int max_network_idx = 0;
+    for (size_t e = 0; e < num_edges; e++) {
+        int idx = static_cast<int>(network_indices[e]);
+        if (idx == 0) continue;
+        if (idx < 0) {
+            throw std::invalid_argument("network_indices must be non-negative");
+        }
+        network_set.insert(idx);
+        max_network_idx = std::max(max_network_idx, idx);
+    }
+    const std::vector<int> unique_networks(network_set.begin(), network_set.end());
+    const size_t num_networks = unique_networks.size();
+
+    // Direct indexing by network index
+    std::vector<double> network_stats(max_network_idx + 1, 0.0);
+    std::vector<double> perm_network_stats(max_network_idx + 1, 0.0);
+    std::vector<size_t> count(max_network_idx + 1, 0);
+    std::vector<size_t> count_neg(negative ? max_network_idx + 1 : 0, 0);
+
+    // Counts carried over from previous permutation blocks
+    size_t total_perms = num_perms;
+    if (!prior_count.empty() || !prior_count_neg.empty() || prior_perms > 0) {
+        if (prior_count.size() != num_networks || (negative && prior_count_neg.size() != num_networks)) {
+            throw std::invalid_argument("prior_count must have one entry per network");
+        }
+        for (size_t i = 0; i < num_networks; i++) {
+            count[unique_networks[i]] = static_cast<size_t>(prior_count[i]);
+            if (negative) {
+                count_neg[unique_networks[i]] = static_cast<size_t>(prior_count_neg[i]);
+            }
+        }
+        total_perms += static_cast<size_t>(prior_perms);
+    }
+
+    for (size_t e = 0; e < num_edges; e++) {
+        int network_idx = static_cast<int>(network_indices[e]);
+        if (network_idx == 0) continue;
+        network_stats[network_idx] += edge_stats[e];
+    }
+
+    for (size_t p = 0; p < num_perms; p++) {
+        for (int idx : unique_networks) {
+            perm_network_stats[idx] = 0.0;
+        }
+
+        const double* perm_data = permuted_edge_stats.data() + p * num_edges;
+        for (size_t e = 0; e < num_edges; e++) {
+            int network_idx = static_cast<int>(network_indices[e]);
+            if (network_idx == 0) continue;
+            perm_network_stats[network_idx] += perm_data[e];
+        }
+
+        for (int idx : unique_networks) {
+            if (perm_network_stats[idx] >= network_stats[idx]) {
+                count[idx]++;
+            }
+        }
+        if (negative) {
+            for (int idx : unique_networks) {
+                if (perm_network_stats[idx] <= network_stats[idx]) {
+                    count_neg[idx]++;
+                }
+            }
+        }
+    }
+
+    auto finish = [&](const std::vector<size_t>& counts, ConstrainedResult& out) {
+        std::vector<double> pval_uncorr(num_networks);
+        out.exceed_count.resize(num_networks);
+        for (size_t i = 0; i < num_networks; i++) {
+            out.exceed_count[i] = static_cast<double>(counts[unique_networks[i]]);
+            pval_uncorr[i] = out.exceed_count[i] / total_perms;
+        }
+        out.pvals_fwer.resize(num_networks);
+        out.pvals_fdr.resize(num_networks);
+        fwer_correction(pval_uncorr, out.pvals_fwer);
+        fdr_correction(pval_uncorr, alpha, out.pvals_fdr);
+    };
+    finish(count, result);
+    if (negative) {
+        finish(count_neg, *negative);
+    }
+}
+
+}  // namespace
+
+ConstrainedResult constrained_pvals(span<const double> edge_stats, span<const double> permuted_edge_stats,
+                                    span<const double> network_indices, double alpha,
+                                    span<const double> prior_count, double prior_perms) {
+    ConstrainedResult result;
+    constrained_tails(edge_stats, permuted_edge_stats, network_indices, alpha, prior_count, {}, prior_perms,
+                      result, nullptr);
+    return result;
+}
+
+ConstrainedTwoTailed constrained_pvals_two_tailed(span<const double> edge_stats,
+                                                  span<const double> permuted_edge_stats,
+                                                  span<const double> network_indices, double alpha,
+                                                  span<const double> prior_count,
+                                                  span<const double> prior_count_neg, double prior_perms) {
+    ConstrainedTwoTailed result;
+    constrained_tails(edge_stats, permuted_edge_stats, network_indices, alpha, prior_count, prior_count_neg,
+                      prior_perms, result.positive, &result.negative);
+    return result;
+}
+
+}  // namespace prisme
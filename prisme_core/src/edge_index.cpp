@@ -0,0 +1,83 @@
+/**
+ * edge_index.cpp - Node pairs of the edge variables of a connectome mask
+ */
+
+#include "prisme/edge_index.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace prisme {
+
+namespace {
+
+void check_matrix(span<const double> matrix, const EdgeIndex& index) {
+    if (matrix.size() != static_cast<size_t>(index.n_nodes) * index.n_nodes) {
+        throw std::invalid_argument("matrix must be an N x N matrix");
+    }
+}
+
+void check_flat(span<const double> flat, const EdgeIndex& index) {
+    if (flat.size() != index.size()) {
+        throw std::invalid_argument("flat must have one entry per mask variable");
+    }
+}
+
+}  // namespace
+
+EdgeIndex make_edge_index(span<const uint64_t> linear_index, int n_nodes) {
+    if (n_nodes < 0) {
+        throw std::invalid_argument("n_nodes must not be negative");
+    }
+    const uint64_t N = static_cast<uint64_t>(n_nodes);
+
+    EdgeIndex index;
+    index.n_nodes = n_nodes;
+    index.rows.resize(linear_index.size());
+    index.cols.resize(linear_index.size());
+    std::vector<uint64_t> pairs(linear_index.size());
+    for (size_t e = 0; e < linear_index.size(); e++) {
+        if (linear_index[e] >= N * N) {
+            throw std::invalid_argument("Mask index exceeds the N x N matrix");
+        }
+        const uint64_t row = linear_index[e] % N;
+        const uint64_t col = linear_index[e] / N;
+        if (row == col) {
+            throw std::invalid_argument("Mask must not contain diagonal entries");
+        }
+        index.rows[e] = static_cast<int>(row);
+        index.cols[e] = static_cast<int>(col);
+        pairs[e] = std::min(row, col) + std::max(row, col) * N;
+    }
+
+    std::sort(pairs.begin(), pairs.end());
+    if (std::adjacent_find(pairs.begin(), pairs.end()) != pairs.end()) {
+        throw std::invalid_argument("Mask must contain each node pair once");
+    }
+    return index;
+}
+
+void unflatten_edges(span<const double> flat, const EdgeIndex& index, span<double> matrix) {
+    check_flat(flat, index);
+    check_matrix(matrix, index);
+    const size_t N = static_cast<size_t>(index.n_nodes);
+
+    // 0 + value, as temp + temp' adds the zero of the other triangle
+    std::fill(matrix.begin(), matrix.end(), 0.0);
+    for (size_t e = 0; e < index.size(); e++) {
+        matrix[index.rows[e] + index.cols[e] * N] += flat[e];
+        matrix[index.cols[e] + index.rows[e] * N] += flat[e];
+    }
+}
+
+void flatten_edges(span<const double> matrix, const EdgeIndex& index, span<double> flat) {
+    check_flat(flat, index);
+    check_matrix(matrix, index);
+    const size_t N = static_cast<size_t>(index.n_nodes);
+
+    for (size_t e = 0; e < index.size(); e++) {
+        flat[e] = matrix[index.rows[e] + index.cols[e] * N];
+    }
+}
+
+}  // namespace prisme
@@ -0,0 +1,645 @@
+/**
+ * glm.cpp - Mass-univariate GLM test statistics and permutation nulls (NBSglm_smn)
+ */
+
+#include "prisme/glm.hpp"
+
+#include "prisme/stage_profile.hpp"
+
+#include <Eigen/Dense>
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <stdexcept>
+
+namespace prisme {
+
+GlmTest parse_glm_test(const std::string& test) {
+    if (test == "onesample") return GlmTest::OneSample;
+    if (test == "ttest") return GlmTest::TTest;
+    if (test == "ftest") return GlmTest::FTest;
+    throw std::invalid_argument("Test type " + test + " not supported");
+}
+
+struct GlmDesign::Impl {
+    Eigen::MatrixXd X;
+    Eigen::MatrixXd contrasts;  // n_predictors x n_contrasts, one contrast per column
+    GlmTest test;
+    int n_observations;
+    int n_predictors;
+    int n_contrasts;
+
+    Eigen::ColPivHouseholderQR<Eigen::MatrixXd> qr;
+    Eigen::VectorXd contrast_terms;  // c'(X'X)^-1 c of every contrast
+
+    // Nuisance predictors (Freedman & Lane)
+    std::vector<int> ind_nuisance;
+    Eigen::MatrixXd X_nuisance;
+
+    // Reduced model for the F-test
+    Eigen::MatrixXd X_reduced;
+    Eigen::ColPivHouseholderQR<Eigen::MatrixXd> qr_reduced;
+    Eigen::VectorXi v;  // Numerator degrees of freedom of the F statistic of each contrast
+
+    // F-test projections of the centered data: rows of Q' for orthonormal bases of X
+    // and X_reduced, then w' with w = P 1 - 1 (zero when X spans an intercept)
+    Eigen::MatrixXd f_projection;
+    Eigen::Index rank_full = 0;
+    Eigen::Index rank_reduced = 0;
+    double w_full = 0;     // |P 1 - 1|^2 of X
+    double w_reduced = 0;  // and of X_reduced
+
+    // Closed form permutations: onesample intercept or rows of the first ttest group
+    bool closed_form = false;
+    std::vector<char> in_first_group;
+
+    // Correlation designs ('r'): the score column, centered and scaled to unit norm
+    int score_column = -1;
+    Eigen::VectorXd score_weights;
+
+    // t-test kernel for designs of up to max_fixed_predictors, chosen once by the
+    // constructor for the number of predictors and the test (null for other designs)
+    using FixedSizeStat = void (Impl::*)(const double*, int, double*, size_t) const;
+    FixedSizeStat fixed_size_stat = nullptr;
+    Eigen::MatrixXd X_rows;      // X', one observation per column
+    Eigen::MatrixXd solve_rows;  // Linear map of qr.solve, n_predictors x n_observations
+
+    // Statistics of contrast c go to out + c * stride, y is n_observations x n_GLMs
+    void compute_test_stat(const double* y, int n_GLMs, double* out, size_t stride) const;
+    void compute_f_stat(const double* y, int n_GLMs, double* out, size_t stride) const;
+    void correlation_permutations(const Eigen::Map<const Eigen::MatrixXd>& y, int n_perms, uint64_t seed,
+                                  double* perm_stats, ScopedStage& stage) const;
+
+    template <int P, GlmTest Test>
+    void compute_fixed_size(const double* y, int n_GLMs, double* out, size_t stride) const;
+
+    template <int P>
+    static FixedSizeStat select_fixed_size(GlmTest test);
+};
+
+namespace {
+
+// Designs of create_design_matrix.m have up to 4 predictors ('pt' designs with one
+// column per subject go through the generic solve)
+const int max_fixed_predictors = 4;
+
+// GLMs per GEMM of the F-test projections
+const int f_block_GLMs = 256;
+
+// Fisher-Yates shuffle written out so a seed gives the same block on every platform
+void random_order(std::vector<int>& order, std::mt19937_64& rng) {
+    for (int i = 0; i < static_cast<int>(order.size()); i++) {
+        order[i] = i;
+    }
+    for (int i = static_cast<int>(order.size()) - 1; i > 0; i--) {
+        int j = static_cast<int>(rng() % static_cast<uint64_t>(i + 1));
+        std::swap(order[i], order[j]);
+    }
+}
+
+}  // namespace
+
+GlmDesign::GlmDesign(span<const double> X, int n_observations, int n_predictors, span<const double> contrast,
+                     GlmTest test, std::vector<int> ind_nuisance)
+    : impl_(new Impl) {
+    ScopedStage stage(Stage::GlmFit);
+    if (n_observations <= 0 || n_predictors <= 0 ||
+        X.size() != static_cast<size_t>(n_observations) * n_predictors) {
+        throw std::invalid_argument("X must be n_observations x n_predictors");
+    }
+    if (contrast.empty() || contrast.size() % n_predictors != 0) {
+        throw std::invalid_argument("contrast must be n_contrasts x n_predictors");
+    }
+    for (int idx : ind_nuisance) {
+        if (idx < 0 || idx >= n_predictors) {
+            throw std::invalid_argument("ind_nuisance exceeds the number of predictors");
+        }
+    }
+    const size_t n_contrasts = contrast.size() / n_predictors;
+    if (n_contrasts > 1) {
+        std::vector<char> is_nuisance(n_predictors, 0);
+        for (int idx : ind_nuisance) {
+            is_nuisance[idx] = 1;
+        }
+        for (size_t c = 0; c < n_contrasts; c++) {
+            for (int p = 0; p < n_predictors; p++) {
+                if ((contrast[p * n_contrasts + c] == 0) != (is_nuisance[p] != 0)) {
+                    throw std::invalid_argument("Every contrast must be zero exactly on the nuisance predictors");
+                }
+            }
+        }
+    }
+
+    Impl& design = *impl_;
+    design.X = Eigen::Map<const Eigen::MatrixXd>(X.data(), n_observations, n_predictors);
+    design.n_contrasts = static_cast<int>(n_contrasts);
+    design.contrasts =
+        Eigen::Map<const Eigen::MatrixXd>(contrast.data(), design.n_contrasts, n_predictors).transpose();
+    design.test = test;
+    design.n_observations = n_observations;
+    design.n_predictors = n_predictors;
+    design.ind_nuisance = std::move(ind_nuisance);
+
+    design.qr.compute(design.X);
+
+    if (test == GlmTest::OneSample || test == GlmTest::TTest) {
+        const Eigen::MatrixXd XtX_inv = (design.X.transpose() * design.X).inverse();
+        design.contrast_terms = (design.contrasts.transpose() * XtX_inv * design.contrasts).diagonal();
+    }
+
+    int n_nuisance = static_cast<int>(design.ind_nuisance.size());
+    if (n_nuisance > 0) {
+        design.X_nuisance = Eigen::MatrixXd(n_observations, n_nuisance);
+        for (int i = 0; i < n_nuisance; i++) {
+            design.X_nuisance.col(i) = design.X.col(design.ind_nuisance[i]);
+        }
+    }
+
+    if (test == GlmTest::FTest && n_nuisance > 0) {
+        // Create reduced model design matrix
+        Eigen::MatrixXd X_new(n_observations, n_nuisance + 1);
+        X_new.col(0) = Eigen::VectorXd::Ones(n_observations);
+        X_new.rightCols(n_nuisance) = design.X_nuisance;
+
+        // Remove column of ones if rank deficient
+        Eigen::ColPivHouseholderQR<Eigen::MatrixXd> qr(X_new);
+        const Eigen::VectorXi n_effects = (design.contrasts.array() != 0).cast<int>().colwise().sum().transpose();
+        if (qr.rank() < n_nuisance + 1) {
+            design.X_reduced = design.X_nuisance;
+            design.v = n_effects;
+        } else {
+            design.X_reduced = X_new;
+            design.v = n_effects.array() - 1;
+        }
+        design.qr_reduced.compute(design.X_reduced);
+    }
+
+    if (test == GlmTest::FTest) {
+        // Orthonormal basis of the columns of a model and the part of the ones vector
+        // it does not span
+        const Eigen::VectorXd ones = Eigen::VectorXd::Ones(n_observations);
+        auto basis = [n_observations](const Eigen::ColPivHouseholderQR<Eigen::MatrixXd>& qr) {
+            return Eigen::MatrixXd(qr.householderQ() * Eigen::MatrixXd::Identity(n_observations, qr.rank()));
+        };
+        const Eigen::MatrixXd Q_full = basis(design.qr);
+        const Eigen::VectorXd w = Q_full * (Q_full.transpose() * ones) - ones;
+        design.rank_full = Q_full.cols();
+        design.w_full = w.squaredNorm();
+        // Without nuisance the reduced model has no rows in the projection
+        Eigen::MatrixXd Q_reduced(n_observations, 0);
+        if (n_nuisance == 0) {
+            // Without nuisance the F statistic does not depend on the contrast
+            design.v = Eigen::VectorXi::Constant(design.n_contrasts, n_predictors - 1);
+        } else {
+            Q_reduced = basis(design.qr_reduced);
+            design.rank_reduced = Q_reduced.cols();
+            design.w_reduced = (Q_reduced * (Q_reduced.transpose() * ones) - ones).squaredNorm();
+        }
+        design.f_projection.resize(design.rank_full + design.rank_reduced + 1, n_observations);
+        design.f_projection.topRows(design.rank_full) = Q_full.transpose();
+        design.f_projection.middleRows(design.rank_full, design.rank_reduced) = Q_reduced.transpose();
+        design.f_projection.bottomRows(1) = w.transpose();
+    }
+
+    if (n_nuisance == 0 && test == GlmTest::OneSample && n_predictors == 1) {
+        design.closed_form = design.X(0, 0) != 0 && (design.X.array() == design.X(0, 0)).all();
+    } else if (n_nuisance == 0 && test == GlmTest::TTest && n_predictors == 2) {
+        design.in_first_group.resize(n_observations);
+        int n_first = 0;
+        bool indicators = true;
+        for (int i = 0; i < n_observations; i++) {
+            const double first = design.X(i, 0);
+            const double second = design.X(i, 1);
+            indicators = indicators && ((first == 1 && second == 0) || (first == 0 && second == 1));
+            design.in_first_group[i] = first == 1;
+            n_first += first == 1;
+        }
+        design.closed_form = indicators && n_first > 0 && n_first < n_observations;
+    }
+
+    // Correlation designs ('r'): a score and an intercept column with every contrast on
+    // the score, the intercept at most a nuisance predictor
+    if (!design.closed_form && test != GlmTest::FTest && n_predictors == 2) {
+        for (int intercept = 0; intercept < 2; intercept++) {
+            const int score = 1 - intercept;
+            const double a = design.X(0, intercept);
+            const bool constant = a != 0 && (design.X.col(intercept).array() == a).all();
+            const bool nuisance = n_nuisance == 0 || (n_nuisance == 1 && design.ind_nuisance[0] == intercept);
+            const bool on_score = (design.contrasts.row(intercept).array() == 0).all() &&
+                                  (design.contrasts.row(score).array() != 0).all();
+            const Eigen::VectorXd centered = design.X.col(score).array() - design.X.col(score).mean();
+            if (constant && nuisance && on_score && centered.norm() > 0) {
+                design.closed_form = true;
+                design.score_column = score;
+                design.score_weights = centered / centered.norm();
+                break;
+            }
+        }
+    }
+
+    if (test != GlmTest::FTest && n_predictors <= max_fixed_predictors) {
+        switch (n_predictors) {
+            case 1: design.fixed_size_stat = Impl::select_fixed_size<1>(test); break;
+            case 2: design.fixed_size_stat = Impl::select_fixed_size<2>(test); break;
+            case 3: design.fixed_size_stat = Impl::select_fixed_size<3>(test); break;
+            case 4: design.fixed_size_stat = Impl::select_fixed_size<4>(test); break;
+        }
+        // solve() is linear in its right-hand side, so applying it to the identity gives
+        // the map from a column of y to its coefficients, rank deficient designs included.
+        // The identity goes in blocks of columns to keep large cohorts from an n x n matrix.
+        const auto identity = Eigen::MatrixXd::Identity(n_observations, n_observations);
+        design.X_rows = design.X.transpose();
+        design.solve_rows.resize(n_predictors, n_observations);
+        for (int first = 0; first < n_observations; first += 256) {
+            const int n_cols = std::min(256, n_observations - first);
+            design.solve_rows.middleCols(first, n_cols) = design.qr.solve(identity.middleCols(first, n_cols));
+        }
+    }
+}
+
+GlmDesign::~GlmDesign() = default;
+GlmDesign::GlmDesign(GlmDesign&&) noexcept = default;
+GlmDesign& GlmDesign::operator=(GlmDesign&&) noexcept = default;
+
+int GlmDesign::n_observations() const { return impl_->n_observations; }
+int GlmDesign::n_predictors() const { return impl_->n_predictors; }
+int GlmDesign::n_contrasts() const { return impl_->n_contrasts; }
+
+std::vector<double> GlmDesign::f_effect_df() const {
+    if (impl_->test != GlmTest::FTest) {
+        throw std::logic_error("Effect degrees of freedom are only defined for F-tests");
+    }
+    return std::vector<double>(impl_->v.data(), impl_->v.data() + impl_->v.size());
+}
+
+template <int P>
+GlmDesign::Impl::FixedSizeStat GlmDesign::Impl::select_fixed_size(GlmTest test) {
+    if (test == GlmTest::OneSample) {
+        return &Impl::compute_fixed_size<P, GlmTest::OneSample>;
+    }
+    return &Impl::compute_fixed_size<P, GlmTest::TTest>;
+}
+
+// Same statistics as the generic path, one GLM at a time with P x 1 coefficients kept
+// in registers: one pass over the column for the coefficients, one for the residuals,
+// and no n_observations x n_GLMs temporaries. Both t-tests share the steps, the test
+// parameter gives each its own kernel.
+template <int P, GlmTest Test>
+void GlmDesign::Impl::compute_fixed_size(const double* y, int n_GLMs, double* out, size_t stride) const {
+    using Vector = Eigen::Matrix<double, P, 1>;
+    using Rows = Eigen::Map<const Eigen::Matrix<double, P, Eigen::Dynamic>>;
+    const int n = n_observations;
+    const Rows x_rows(X_rows.data(), P, n);
+    const Rows solve(solve_rows.data(), P, n);
+    const Rows contrast_rows(contrasts.data(), P, n_contrasts);
+    const double dof = n - P;
+
+    for (int g = 0; g < n_GLMs; g++) {
+        const double* column = y + static_cast<size_t>(g) * n;
+        Vector beta = Vector::Zero();
+        for (int i = 0; i < n; i++) {
+            beta += solve.col(i) * column[i];
+        }
+        beta = ((beta * 1e14).array().round() / 1e14).matrix();
+
+        double sse = 0;
+        for (int i = 0; i < n; i++) {
+            const double residual = column[i] - x_rows.col(i).dot(beta);
+            sse += residual * residual;
+        }
+
+        for (int c = 0; c < n_contrasts; c++) {
+            const double se = std::max(std::sqrt(sse / dof * contrast_terms(c)), 1e-15);
+            const double stat = contrast_rows.col(c).dot(beta) / se;
+            out[c * stride + g] = std::isnan(stat) ? 0 : stat;
+        }
+    }
+}
+
+// F statistics from projections instead of fits. With yc = y - mean(y) and P the
+// projection on a model, |P y - mean(y)|^2 = |Q' yc|^2 + mean(y)^2 |w|^2 and
+// |y - P y|^2 = |yc|^2 - |Q' yc|^2 - 2 mean(y) w' yc + mean(y)^2 |w|^2, so the sums of
+// squares of both models come from one GEMM of f_projection with the centered block.
+void GlmDesign::Impl::compute_f_stat(const double* y_in, int n_GLMs, double* out, size_t stride) const {
+    const double dof = n_observations - n_predictors;
+    Eigen::MatrixXd centered;
+    Eigen::MatrixXd projected;
+    // Blocks of GLMs keep the centered data and its projections in cache
+    for (int first = 0; first < n_GLMs; first += f_block_GLMs) {
+        const int n_block = std::min(f_block_GLMs, n_GLMs - first);
+        const Eigen::Map<const Eigen::MatrixXd> y(y_in + static_cast<size_t>(first) * n_observations,
+                                                  n_observations, n_block);
+        const Eigen::RowVectorXd y_mean = y.colwise().mean();
+        centered = y.rowwise() - y_mean;
+        projected.noalias() = f_projection * centered;
+
+        for (int g = 0; g < n_block; g++) {
+            const double mean = y_mean(g);
+            const double full = projected.col(g).head(rank_full).squaredNorm();
+            const double reduced = projected.col(g).segment(rank_full, rank_reduced).squaredNorm();
+            const double shift = projected(rank_full + rank_reduced, g);
+            const double ssr = full + mean * mean * w_full;
+            const double ssr_reduced = reduced + mean * mean * w_reduced;
+            const double sse =
+                std::max(centered.col(g).squaredNorm() - full - 2 * mean * shift + mean * mean * w_full, 0.0);
+
+            for (int c = 0; c < n_contrasts; c++) {
+                const double stat = ((ssr - ssr_reduced) / v(c)) / (sse / dof);
+                out[c * stride + first + g] = std::isnan(stat) ? 0 : stat;
+            }
+        }
+    }
+}
+
+// Compute the statistic of every column of y, same steps as NBSglm_smn.m. The fit,
+// residuals and MSE do not depend on the contrast and are shared by all of them.
+// F-tests go through the projections, small t-test designs through their kernel.
+void GlmDesign::Impl::compute_test_stat(const double* y_in, int n_GLMs, double* out, size_t stride) const {
+    if (test == GlmTest::FTest) {
+        compute_f_stat(y_in, n_GLMs, out, stride);
+        return;
+    }
+    if (fixed_size_stat != nullptr) {
+        (this->*fixed_size_stat)(y_in, n_GLMs, out, stride);
+        return;
+    }
+    const Eigen::Map<const Eigen::MatrixXd> y(y_in, n_observations, n_GLMs);
+
+    // Compute beta (regression coefficients)
+    Eigen::MatrixXd beta = qr.solve(y);
+
+    // Round beta to remove numerical issues (equivalent to MATLAB's round to 14 decimals)
+    beta = (beta * 1e14).array().round() / 1e14;
+
+    // Mean squared error
+    const Eigen::VectorXd mse = (y - X * beta).colwise().squaredNorm() / (n_observations - n_predictors);
+    const Eigen::MatrixXd effects = contrasts.transpose() * beta;
+
+    for (int c = 0; c < n_contrasts; c++) {
+        Eigen::Map<Eigen::VectorXd> test_stat(out + c * stride, n_GLMs);
+
+        // Standard error using contrast
+        Eigen::VectorXd se = (mse.array() * contrast_terms(c)).sqrt();
+
+        // Prevent division by zero
+        for (int i = 0; i < se.size(); i++) {
+            if (se(i) < 1e-15) se(i) = 1e-15;
+        }
+
+        test_stat = effects.row(c).transpose().array() / se.array();
+    }
+
+    // Replace NaN values with zero
+    for (int c = 0; c < n_contrasts; c++) {
+        for (int i = 0; i < n_GLMs; i++) {
+            if (std::isnan(out[c * stride + i])) {
+                out[c * stride + i] = 0;
+            }
+        }
+    }
+}
+
+void GlmDesign::compute_test_stat(span<const double> y, int n_GLMs, span<double> test_stat) const {
+    const Impl& design = *impl_;
+    if (n_GLMs < 0 || y.size() != static_cast<size_t>(design.n_observations) * n_GLMs) {
+        throw std::invalid_argument("y must be n_observations x n_GLMs");
+    }
+    if (test_stat.size() != static_cast<size_t>(n_GLMs) * design.n_contrasts) {
+        throw std::invalid_argument("test_stat must be n_GLMs x n_contrasts");
+    }
+    ScopedStage stage(Stage::GlmFit);
+    design.compute_test_stat(y.data(), n_GLMs, test_stat.data(), static_cast<size_t>(n_GLMs));
+}
+
+void GlmDesign::generate_permutations(span<const double> y_in, int n_GLMs, int n_perms, uint64_t seed,
+                                      span<double> perm_stats) const {
+    const Impl& design = *impl_;
+    const int n_observations = design.n_observations;
+    if (n_GLMs < 0 || y_in.size() != static_cast<size_t>(n_observations) * n_GLMs) {
+        throw std::invalid_argument("y must be n_observations x n_GLMs");
+    }
+    if (n_perms < 0 || perm_stats.size() != static_cast<size_t>(n_GLMs) * n_perms * design.n_contrasts) {
+        throw std::invalid_argument("perm_stats must be n_GLMs x n_perms x n_contrasts");
+    }
+
+    ScopedStage stage(Stage::PermutationGeneration, static_cast<uint64_t>(n_perms));
+    const Eigen::Map<const Eigen::MatrixXd> y(y_in.data(), n_observations, n_GLMs);
+    const bool do_sign_flip = (design.test == GlmTest::OneSample);
+    const bool has_nuisance = !design.ind_nuisance.empty();
+
+    std::mt19937_64 rng(seed);
+    std::vector<int> order(n_observations);
+    Eigen::MatrixXd y_perm(n_observations, n_GLMs);
+    stage.add_bytes(y_in.size() * sizeof(double) * (has_nuisance ? 3 : 1));
+
+    // Regress out nuisance predictors once, residuals are permuted afterwards
+    Eigen::MatrixXd nuisance_fit;
+    Eigen::MatrixXd resid_y;
+    if (has_nuisance) {
+        nuisance_fit = design.X_nuisance * design.X_nuisance.colPivHouseholderQr().solve(y);
+        resid_y = y - nuisance_fit;
+    }
+
+    for (int k = 0; k < n_perms; k++) {
+        if (!has_nuisance && do_sign_flip) {
+            for (int i = 0; i < n_observations; i++) {
+                double sign = (rng() >> 63) ? 1.0 : -1.0;
+                y_perm.row(i) = sign * y.row(i);
+            }
+        } else if (!has_nuisance) {
+            random_order(order, rng);
+            for (int i = 0; i < n_observations; i++) {
+                y_perm.row(i) = y.row(order[i]);
+            }
+        } else {
+            random_order(order, rng);
+            for (int i = 0; i < n_observations; i++) {
+                y_perm.row(i) = resid_y.row(order[i]) + nuisance_fit.row(i);
+            }
+            if (do_sign_flip) {
+                for (int i = 0; i < n_observations; i++) {
+                    double sign = (rng() >> 63) ? 1.0 : -1.0;
+                    y_perm.row(i) *= sign;
+                }
+            }
+        }
+
+        design.compute_test_stat(y_perm.data(), n_GLMs, perm_stats.data() + static_cast<size_t>(k) * n_GLMs,
+                                 static_cast<size_t>(n_GLMs) * n_perms);
+    }
+}
+
+bool GlmDesign::has_closed_form_permutations() const { return impl_->closed_form; }
+
+void GlmDesign::generate_closed_form_permutations(span<const double> y_in, int n_GLMs, int n_perms, uint64_t seed,
+                                                  span<double> perm_stats) const {
+    const Impl& design = *impl_;
+    const int n_observations = design.n_observations;
+    if (!design.closed_form) {
+        throw std::logic_error("The permutations of this design have no closed form");
+    }
+    if (n_GLMs < 0 || y_in.size() != static_cast<size_t>(n_observations) * n_GLMs) {
+        throw std::invalid_argument("y must be n_observations x n_GLMs");
+    }
+    if (n_perms < 0 || perm_stats.size() != static_cast<size_t>(n_GLMs) * n_perms * design.n_contrasts) {
+        throw std::invalid_argument("perm_stats must be n_GLMs x n_perms x n_contrasts");
+    }
+
+    ScopedStage stage(Stage::PermutationGeneration, static_cast<uint64_t>(n_perms));
+    const Eigen::Map<const Eigen::MatrixXd> y(y_in.data(), n_observations, n_GLMs);
+    if (design.score_column >= 0) {
+        design.correlation_permutations(y, n_perms, seed, perm_stats.data(), stage);
+        return;
+    }
+    // The sums go to the block of the first contrast, which is written last for every entry
+    Eigen::Map<Eigen::MatrixXd> sums(perm_stats.data(), n_GLMs, n_perms);
+    const size_t stride = static_cast<size_t>(n_GLMs) * n_perms;
+    const int n_contrasts = design.n_contrasts;
+    const bool two_sample = design.test == GlmTest::TTest;
+    const double n = n_observations;
+
+    // Draw the permutations in the order of generate_permutations. Observation
+    // order[i] takes the place of row i, so it joins the group of row i.
+    std::mt19937_64 rng(seed);
+    std::vector<int> order(n_observations);
+    Eigen::MatrixXd selection(n_observations, n_perms);
+    for (int k = 0; k < n_perms; k++) {
+        if (two_sample) {
+            random_order(order, rng);
+            for (int i = 0; i < n_observations; i++) {
+                selection(order[i], k) = design.in_first_group[i] ? 1.0 : 0.0;
+            }
+        } else {
+            for (int i = 0; i < n_observations; i++) {
+                selection(i, k) = (rng() >> 63) ? 1.0 : -1.0;
+            }
+        }
+    }
+
+    if (!two_sample) {
+        stage.add_bytes(selection.size() * sizeof(double));
+        sums.noalias() = y.transpose() * selection;
+
+        // y = a beta: beta = mean / a, mse = (ss - n mean^2) / (n - 1)
+        const double a = design.X(0, 0);
+        const Eigen::VectorXd square_sums = y.colwise().squaredNorm().transpose();
+        for (int k = 0; k < n_perms; k++) {
+            for (int g = 0; g < n_GLMs; g++) {
+                const double mean = sums(g, k) / n;
+                const double mse = std::max(square_sums(g) - sums(g, k) * mean, 0.0) / (n - 1);
+                for (int c = n_contrasts - 1; c >= 0; c--) {
+                    const double se = std::sqrt(mse * design.contrast_terms(c));
+                    const double t = design.contrasts(0, c) * mean / a / std::max(se, 1e-15);
+                    perm_stats[c * stride + static_cast<size_t>(k) * n_GLMs + g] = std::isnan(t) ? 0 : t;
+                }
+            }
+        }
+        return;
+    }
+
+    // Centered per GLM, so the group sums do not lose precision to large means and
+    // the second group sum is minus the first
+    const Eigen::RowVectorXd center = y.colwise().mean();
+    const Eigen::MatrixXd centered = y.rowwise() - center;
+    stage.add_bytes((selection.size() + centered.size()) * sizeof(double));
+    sums.noalias() = centered.transpose() * selection;
+
+    const double n_first = static_cast<double>(std::count(design.in_first_group.begin(),
+                                                          design.in_first_group.end(), 1));
+    const double n_second = n - n_first;
+    const Eigen::VectorXd square_sums = centered.colwise().squaredNorm().transpose();
+    for (int k = 0; k < n_perms; k++) {
+        for (int g = 0; g < n_GLMs; g++) {
+            const double sum = sums(g, k);
+            const double mean_first = sum / n_first;
+            const double mean_second = -sum / n_second;
+            const double sse = square_sums(g) - sum * mean_first + sum * mean_second;
+            const double mse = std::max(sse, 0.0) / (n - 2);
+            for (int c = n_contrasts - 1; c >= 0; c--) {
+                const double c1 = design.contrasts(0, c);
+                const double c2 = design.contrasts(1, c);
+                const double se = std::sqrt(mse * design.contrast_terms(c));
+                const double beta = c1 * mean_first + c2 * mean_second + (c1 + c2) * center(g);
+                const double t = beta / std::max(se, 1e-15);
+                perm_stats[c * stride + static_cast<size_t>(k) * n_GLMs + g] = std::isnan(t) ? 0 : t;
+            }
+        }
+    }
+}
+
+// Permuted data of generate_permutations is y_perm(i) = sign(i) (yc(order(i)) + mean(y)),
+// with yc the centered GLM (the intercept nuisance fit is the mean), order the identity
+// without shuffles and the signs 1 without flips. With z the unit norm centered score,
+// the Pearson r of a permutation is z' y_perm over the norm of y_perm - mean(y_perm):
+// one GEMM of yc' with the weights z(i) sign(i) at row order(i), and one with the signs
+// for the mean of y_perm when there are flips. r gives t = r sqrt((n - 2) / (1 - r^2)).
+void GlmDesign::Impl::correlation_permutations(const Eigen::Map<const Eigen::MatrixXd>& y, int n_perms,
+                                               uint64_t seed, double* perm_stats, ScopedStage& stage) const {
+    const int n_GLMs = static_cast<int>(y.cols());
+    const bool flips = test == GlmTest::OneSample;
+    const bool shuffles = !ind_nuisance.empty() || !flips;
+    const double n = n_observations;
+
+    std::mt19937_64 rng(seed);
+    std::vector<int> order(n_observations);
+    std::vector<double> signs(n_observations, 1.0);
+    Eigen::MatrixXd weights(n_observations, n_perms);
+    Eigen::MatrixXd sign_matrix(flips ? n_observations : 0, n_perms);
+    Eigen::VectorXd weight_sums(n_perms);  // z' sign
+    Eigen::VectorXd sign_sums(n_perms);    // 1' sign
+    for (int k = 0; k < n_perms; k++) {
+        if (shuffles) {
+            random_order(order, rng);
+        } else {
+            for (int i = 0; i < n_observations; i++) order[i] = i;
+        }
+        if (flips) {
+            for (int i = 0; i < n_observations; i++) {
+                signs[i] = (rng() >> 63) ? 1.0 : -1.0;
+            }
+        }
+        weight_sums(k) = 0;
+        sign_sums(k) = 0;
+        for (int i = 0; i < n_observations; i++) {
+            weights(order[i], k) = score_weights(i) * signs[i];
+            if (flips) sign_matrix(order[i], k) = signs[i];
+            weight_sums(k) += score_weights(i) * signs[i];
+            sign_sums(k) += signs[i];
+        }
+    }
+
+    const Eigen::RowVectorXd y_mean = y.colwise().mean();
+    const Eigen::MatrixXd centered = y.rowwise() - y_mean;
+    const Eigen::RowVectorXd square_sums = centered.colwise().squaredNorm();
+    const Eigen::MatrixXd products = centered.transpose() * weights;
+    Eigen::MatrixXd flip_sums;
+    if (flips) {
+        flip_sums.noalias() = centered.transpose() * sign_matrix;
+    }
+    stage.add_bytes((weights.size() + sign_matrix.size() + centered.size() + products.size() + flip_sums.size()) *
+                    sizeof(double));
+
+    const size_t stride = static_cast<size_t>(n_GLMs) * n_perms;
+    for (int k = 0; k < n_perms; k++) {
+        for (int g = 0; g < n_GLMs; g++) {
+            const double mean = y_mean(g);
+            double cross = products(g, k);
+            double deviations = square_sums(g);
+            if (flips) {
+                // |y_perm|^2 = |yc|^2 + n mean^2 whatever the signs
+                const double sum = flip_sums(g, k) + mean * sign_sums(k);
+                cross += mean * weight_sums(k);
+                deviations += n * mean * mean - sum * sum / n;
+            }
+            const double r = cross / std::sqrt(std::max(deviations, 0.0));
+            const double t = r * std::sqrt((n - 2) / (1 - r * r));
+            for (int c = 0; c < n_contrasts; c++) {
+                const double stat = contrasts(score_column, c) < 0 ? -t : t;
+                perm_stats[c * stride + static_cast<size_t>(k) * n_GLMs + g] = std::isnan(stat) ? 0 : stat;
+            }
+        }
+    }
+}
+
+}  // namespace prisme
@@ -0,0 +1,128 @@
+/**
+ * parametric.cpp - Parametric (t-distribution) p-values with FWER and FDR correction
+ */
+
+#include "prisme/parametric.hpp"
+
+#include "prisme/stage_profile.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <numeric>
+#include <stdexcept>
+#include <vector>
+
+namespace prisme {
+
+namespace {
+
+// Continued fraction of the incomplete beta function (modified Lentz)
+double beta_continued_fraction(double a, double b, double x) {
+    const int max_iterations = 1000;
+    const double eps = 1e-16;
+    const double tiny = 1e-300;
+
+    double c = 1.0;
+    double d = 1.0 - (a + b) * x / (a + 1.0);
+    if (std::fabs(d) < tiny) d = tiny;
+    d = 1.0 / d;
+    double h = d;
+
+    for (int m = 1; m <= max_iterations; m++) {
+        const double m2 = 2.0 * m;
+        // Even step
+        double aa = m * (b - m) * x / ((a + m2 - 1.0) * (a + m2));
+        d = 1.0 + aa * d;
+        if (std::fabs(d) < tiny) d = tiny;
+        c = 1.0 + aa / c;
+        if (std::fabs(c) < tiny) c = tiny;
+        d = 1.0 / d;
+        h *= d * c;
+        // Odd step
+        aa = -(a + m) * (a + b + m) * x / ((a + m2) * (a + m2 + 1.0));
+        d = 1.0 + aa * d;
+        if (std::fabs(d) < tiny) d = tiny;
+        c = 1.0 + aa / c;
+        if (std::fabs(c) < tiny) c = tiny;
+        d = 1.0 / d;
+        const double delta = d * c;
+        h *= delta;
+        if (std::fabs(delta - 1.0) < eps) {
+            break;
+        }
+    }
+    return h;
+}
+
+// Regularized incomplete beta function I_x(a, b)
+double incomplete_beta(double x, double a, double b) {
+    if (x <= 0) return 0.0;
+    if (x >= 1) return 1.0;
+    const double log_front = std::lgamma(a + b) - std::lgamma(a) - std::lgamma(b) + a * std::log(x) +
+                             b * std::log1p(-x);
+    // The continued fraction converges fastest below (a + 1) / (a + b + 2)
+    if (x < (a + 1.0) / (a + b + 2.0)) {
+        return std::exp(log_front) * beta_continued_fraction(a, b, x) / a;
+    }
+    return 1.0 - std::exp(log_front) * beta_continued_fraction(b, a, 1.0 - x) / b;
+}
+
+}  // namespace
+
+double t_cdf(double t, double df) {
+    if (std::isnan(t) || !(df > 0)) {
+        return std::numeric_limits<double>::quiet_NaN();
+    }
+    if (std::isinf(t)) {
+        return t < 0 ? 0.0 : 1.0;
+    }
+    // Lower tail of |t| in terms of the incomplete beta function
+    const double x = df / (df + t * t);
+    const double tail = 0.5 * incomplete_beta(x, df / 2.0, 0.5);
+    return t < 0 ? tail : 1.0 - tail;
+}
+
+void parametric_pvals(span<const double> test_stat, GlmTest test, int n_observations, span<double> pval) {
+    double df = 0;
+    switch (test) {
+        case GlmTest::OneSample:
+            df = n_observations - 1;
+            break;
+        case GlmTest::TTest:
+            df = n_observations - 2;
+            break;
+        case GlmTest::FTest:
+            throw std::invalid_argument("F-test currently not supported.");
+    }
+    if (pval.size() != test_stat.size()) {
+        throw std::invalid_argument("pval must have one entry per test statistic");
+    }
+    ScopedStage stage(Stage::Pvalues);
+    for (size_t i = 0; i < test_stat.size(); i++) {
+        pval[i] = t_cdf(-test_stat[i], df);
+    }
+}
+
+void bh_fdr(span<const double> pval_uncorr, span<double> pval_fdr) {
+    const size_t n = pval_uncorr.size();
+    if (pval_fdr.size() != n) {
+        throw std::invalid_argument("pval_fdr must have one entry per p-value");
+    }
+    ScopedStage stage(Stage::Pvalues);
+    stage.add_bytes(n * sizeof(size_t));
+    std::vector<size_t> order(n);
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(),
+                     [&](size_t a, size_t b) { return pval_uncorr[a] < pval_uncorr[b]; });
+
+    // Step-up: running minimum of p_(k) * n / k from the largest p-value down
+    double running_min = 1.0;
+    for (size_t k = n; k > 0; k--) {
+        const size_t i = order[k - 1];
+        running_min = std::min(running_min, pval_uncorr[i] * n / k);
+        pval_fdr[i] = running_min;
+    }
+}
+
+}  // namespace prisme
@@ -0,0 +1,1013 @@
+/**
+ * power_runner.cpp - MATLAB independent repetition loop of the power calculator
+ */
+
+#include "prisme/power_runner.hpp"
+
+#include "prisme/cluster_size.hpp"
+#include "prisme/column_store.hpp"
+#include "prisme/constrained.hpp"
+#include "prisme/parametric.hpp"
+#include "prisme/result_journal.hpp"
+#include "prisme/task_pool.hpp"
+#include "prisme/tfce.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <exception>
+#include <fstream>
+#include <limits>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+
+namespace prisme {
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+double seconds_since(Clock::time_point start) {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+// Fast_TFCE_cpp parameters and permutation cap
+const double fast_tfce_dh = 0.1;
+const double fast_tfce_H = 3.0;
+const double fast_tfce_E = 0.4;
+const int fast_tfce_permutations = 800;
+
+// Repetition seeds are spread with splitmix64 so neighbouring repetitions do not
+// share permutation streams
+uint64_t repetition_seed(uint64_t seed, int rep_id) {
+    uint64_t z = seed + 0x9E3779B97F4A7C15ull * static_cast<uint64_t>(rep_id);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+std::string trim(const std::string& text) {
+    const size_t first = text.find_first_not_of(" \t\r\n");
+    if (first == std::string::npos) {
+        return "";
+    }
+    const size_t last = text.find_last_not_of(" \t\r\n");
+    return text.substr(first, last - first + 1);
+}
+
+std::vector<std::string> split(const std::string& text, char separator) {
+    std::vector<std::string> parts;
+    std::stringstream stream(text);
+    std::string part;
+    while (std::getline(stream, part, separator)) {
+        part = trim(part);
+        if (!part.empty()) {
+            parts.push_back(part);
+        }
+    }
+    return parts;
+}
+
+double to_number(const std::string& key, const std::string& value) {
+    try {
+        size_t used = 0;
+        const double number = std::stod(value, &used);
+        if (used == value.size()) {
+            return number;
+        }
+    } catch (const std::exception&) {
+    }
+    throw std::invalid_argument("Invalid value '" + value + "' for " + key);
+}
+
+// Everything a method needs besides the statistics, shared by both effect signs
+struct MethodContext {
+    const RunnerConfig& config;
+    const Study& study;
+};
+
+// C++ counterpart of the init_null / update_null / pvals_from_null interface of the
+// MATLAB method classes. One instance per effect sign.
+class MethodRun {
+public:
+    virtual ~MethodRun() = default;
+    virtual bool permutation_based() const = 0;
+    virtual void update_null(span<const double> permuted_edge_stats, int n_perms) = 0;
+
+    // Updates this run with the block and negative, a run of the same method on the
+    // negated statistics, with the negated block. The kernels with a two-tailed mode
+    // read each permutation once for both; the default negates a copy.
+    virtual void update_null_two_tailed(MethodRun& negative, span<const double> permuted_edge_stats, int n_perms) {
+        std::vector<double> negated(permuted_edge_stats.size());
+        {
+            ScopedStage stage(Stage::PermutationGeneration);
+            stage.add_bytes(negated.size() * sizeof(double));
+            for (size_t i = 0; i < negated.size(); i++) {
+                negated[i] = -permuted_edge_stats[i];
+            }
+        }
+        update_null(permuted_edge_stats, n_perms);
+        negative.update_null(negated, n_perms);
+    }
+
+    // One p-value vector per submethod, in the order of the method family
+    virtual std::vector<std::vector<double>> pvals_from_null() = 0;
+};
+
+// Size and Fast TFCE run on the edge variables through the EdgeIndex of the study,
+// no N x N matrix is built per permutation
+class SizeRun : public MethodRun {
+public:
+    SizeRun(const MethodContext& context, span<const double> edge_stats)
+        : context_(context), edge_stats_(edge_stats.begin(), edge_stats.end()) {}
+
+    bool permutation_based() const override { return true; }
+
+    void update_null(span<const double> permuted_edge_stats, int n_perms) override {
+        const size_t n_null = null_dist_.size();
+        null_dist_.resize(n_null + n_perms);
+        size_null_distribution(permuted_edge_stats.subspan(0, context_.study.n_var * n_perms),
+                               context_.study.edge_index, context_.config.thresh,
+                               span<double>(null_dist_.data() + n_null, n_perms));
+    }
+
+    void update_null_two_tailed(MethodRun& negative_run, span<const double> permuted_edge_stats,
+                                int n_perms) override {
+        SizeRun& negative = static_cast<SizeRun&>(negative_run);
+        const size_t n_null = null_dist_.size();
+        null_dist_.resize(n_null + n_perms);
+        negative.null_dist_.resize(n_null + n_perms);
+        size_null_distribution_two_tailed(permuted_edge_stats.subspan(0, context_.study.n_var * n_perms),
+                                          context_.study.edge_index, context_.config.thresh,
+                                          span<double>(null_dist_.data() + n_null, n_perms),
+                                          span<double>(negative.null_dist_.data() + n_null, n_perms));
+    }
+
+    std::vector<std::vector<double>> pvals_from_null() override {
+        std::vector<double> pval(edge_stats_.size());
+        size_pvals(edge_stats_, context_.study.edge_index, context_.config.thresh, null_dist_, pval);
+        return {pval};
+    }
+
+private:
+    const MethodContext& context_;
+    std::vector<double> edge_stats_;
+    std::vector<double> null_dist_;
+};
+
+class FastTfceRun : public MethodRun {
+public:
+    FastTfceRun(const MethodContext& context, span<const double> edge_stats)
+        : context_(context), target_(edge_stats.size()) {
+        apply_tfce(edge_stats, context_.study.edge_index, fast_tfce_dh, fast_tfce_H, fast_tfce_E, target_);
+    }
+
+    bool permutation_based() const override { return true; }
+
+    // Only the first fast_tfce_permutations permutations of the stream are used
+    void update_null(span<const double> permuted_edge_stats, int n_perms) override {
+        const size_t n_var = context_.study.n_var;
+        const int n_used = std::min(n_perms, fast_tfce_permutations - static_cast<int>(null_dist_.size()));
+        if (n_used <= 0) {
+            return;
+        }
+        tfce_.resize(n_var * n_used);
+        apply_tfce(permuted_edge_stats.subspan(0, n_var * n_used), context_.study.edge_index, fast_tfce_dh,
+                   fast_tfce_H, fast_tfce_E, tfce_);
+        add_maxima(n_used);
+    }
+
+    void update_null_two_tailed(MethodRun& negative_run, span<const double> permuted_edge_stats,
+                                int n_perms) override {
+        FastTfceRun& negative = static_cast<FastTfceRun&>(negative_run);
+        const size_t n_var = context_.study.n_var;
+        const int n_used = std::min(n_perms, fast_tfce_permutations - static_cast<int>(null_dist_.size()));
+        if (n_used <= 0) {
+            return;
+        }
+        tfce_.resize(n_var * n_used);
+        negative.tfce_.resize(n_var * n_used);
+        apply_tfce_two_tailed(permuted_edge_stats.subspan(0, n_var * n_used), context_.study.edge_index,
+                              fast_tfce_dh, fast_tfce_H, fast_tfce_E, tfce_, negative.tfce_);
+        add_maxima(n_used);
+        negative.add_maxima(n_used);
+    }
+
+    std::vector<std::vector<double>> pvals_from_null() override {
+        if (null_dist_.empty()) {
+            throw std::runtime_error("Permutation data is missing for Fast_TFCE_cpp");
+        }
+        const double K = static_cast<double>(null_dist_.size());
+        std::vector<double> pval(target_.size());
+        for (size_t e = 0; e < target_.size(); e++) {
+            double count = 0;
+            for (double null_value : null_dist_) {
+                count += target_[e] <= null_value ? 1 : 0;
+            }
+            pval[e] = count / K;
+        }
+        return {pval};
+    }
+
+private:
+    // Maximum TFCE value of each of the first n_used permutations in tfce_
+    void add_maxima(int n_used) {
+        const size_t n_var = context_.study.n_var;
+        ScopedStage stage(Stage::NullConstruction, n_used);
+        for (int p = 0; p < n_used; p++) {
+            const auto column = tfce_.begin() + p * n_var;
+            null_dist_.push_back(n_var > 0 ? *std::max_element(column, column + n_var) : 0.0);
+        }
+    }
+
+    const MethodContext& context_;
+    std::vector<double> tfce_;
+    std::vector<double> target_;
+    std::vector<double> null_dist_;
+};
+
+class ConstrainedRun : public MethodRun {
+public:
+    ConstrainedRun(const MethodContext& context, span<const double> edge_stats)
+        : context_(context), edge_stats_(edge_stats.begin(), edge_stats.end()) {}
+
+    bool permutation_based() const override { return true; }
+
+    void update_null(span<const double> permuted_edge_stats, int n_perms) override {
+        ConstrainedResult result = constrained_pvals(edge_stats_, permuted_edge_stats, context_.study.edge_groups,
+                                                     context_.config.alpha, counts_, n_perms_);
+        counts_ = std::move(result.exceed_count);
+        n_perms_ += n_perms;
+    }
+
+    void update_null_two_tailed(MethodRun& negative_run, span<const double> permuted_edge_stats,
+                                int n_perms) override {
+        ConstrainedRun& negative = static_cast<ConstrainedRun&>(negative_run);
+        ConstrainedTwoTailed result =
+            constrained_pvals_two_tailed(edge_stats_, permuted_edge_stats, context_.study.edge_groups,
+                                         context_.config.alpha, counts_, negative.counts_, n_perms_);
+        counts_ = std::move(result.positive.exceed_count);
+        negative.counts_ = std::move(result.negative.exceed_count);
+        n_perms_ += n_perms;
+        negative.n_perms_ += n_perms;
+    }
+
+    // FWER, FDR
+    std::vector<std::vector<double>> pvals_from_null() override {
+        if (n_perms_ == 0) {
+            throw std::runtime_error("Permutation data is missing for Constrained_cpp");
+        }
+        ConstrainedResult result = constrained_pvals(edge_stats_, {}, context_.study.edge_groups,
+                                                     context_.config.alpha, counts_, n_perms_);
+        return {std::move(result.pvals_fwer), std::move(result.pvals_fdr)};
+    }
+
+private:
+    const MethodContext& context_;
+    std::vector<double> edge_stats_;
+    std::vector<double> counts_;
+    double n_perms_ = 0;
+};
+
+class ParametricRun : public MethodRun {
+public:
+    ParametricRun(const MethodContext& context, span<const double> edge_stats)
+        : context_(context), edge_stats_(edge_stats.begin(), edge_stats.end()) {}
+
+    bool permutation_based() const override { return false; }
+
+    void update_null(span<const double>, int) override {}
+
+    // FWER, FDR
+    std::vector<std::vector<double>> pvals_from_null() override {
+        const size_t n = edge_stats_.size();
+        std::vector<double> p_uncorr(n);
+        parametric_pvals(edge_stats_, context_.config.test, static_cast<int>(context_.study.n_observations),
+                         p_uncorr);
+        std::vector<double> p_fwer(n);
+        for (size_t i = 0; i < n; i++) {
+            p_fwer[i] = std::min(p_uncorr[i] * n, 1.0);
+        }
+        std::vector<double> p_fdr(n);
+        bh_fdr(p_uncorr, p_fdr);
+        return {p_fwer, p_fdr};
+    }
+
+private:
+    const MethodContext& context_;
+    std::vector<double> edge_stats_;
+};
+
+// Method class and its submethods; full names are class or class_submethod
+struct MethodFamily {
+    std::string name;
+    std::vector<std::string> submethods;
+    std::unique_ptr<MethodRun> (*create)(const MethodContext&, span<const double>);
+    int max_permutations;  // Permutations of the stream the method reads, 0 if it is not permutation based
+};
+
+template <typename Run>
+std::unique_ptr<MethodRun> create_run(const MethodContext& context, span<const double> edge_stats) {
+    return std::unique_ptr<MethodRun>(new Run(context, edge_stats));
+}
+
+const std::vector<MethodFamily>& method_families() {
+    static const std::vector<MethodFamily> families = {
+        {"Size_cpp", {}, &create_run<SizeRun>, std::numeric_limits<int>::max()},
+        {"Fast_TFCE_cpp", {}, &create_run<FastTfceRun>, fast_tfce_permutations},
+        {"Constrained_cpp", {"FWER", "FDR"}, &create_run<ConstrainedRun>, std::numeric_limits<int>::max()},
+        {"Parametric", {"FWER", "FDR"}, &create_run<ParametricRun>, 0},
+    };
+    return families;
+}
+
+std::vector<std::string> full_names(const MethodFamily& family) {
+    if (family.submethods.empty()) {
+        return {family.name};
+    }
+    std::vector<std::string> names;
+    for (const std::string& sub : family.submethods) {
+        names.push_back(family.name + "_" + sub);
+    }
+    return names;
+}
+
+bool is_pending(const RunnerConfig& config, const std::string& full_name, int rep_id) {
+    if (std::find(config.methods.begin(), config.methods.end(), full_name) == config.methods.end()) {
+        return false;
+    }
+    auto existing = config.existing_repetitions.find(full_name);
+    return existing == config.existing_repetitions.end() || rep_id > existing->second;
+}
+
+// Subsampled data of one repetition: y is observations x variables, X observations x predictors
+void gather_repetition(const Study& study, const RunnerConfig& config, int rep_id, std::vector<double>& y,
+                       std::vector<double>& X) {
+    if (rep_id < 1 || static_cast<size_t>(rep_id) > study.n_id_repetitions) {
+        throw std::out_of_range("No subject ids for repetition " + std::to_string(rep_id));
+    }
+    const size_t n_obs = study.n_observations;
+    const double* ids = study.ids_sampled.data() + (rep_id - 1) * n_obs;
+
+    // Only the sampled subject columns are read from the mapped Y
+    y.resize(n_obs * study.n_var);
+    for (size_t o = 0; o < n_obs; o++) {
+        const size_t subject = static_cast<size_t>(ids[o]) - 1;
+        const double* column = static_cast<const double*>(study.Y.column(subject));
+        for (size_t e = 0; e < study.n_var; e++) {
+            y[e * n_obs + o] = column[e];
+        }
+    }
+
+    if (!config.design_per_subject) {
+        X = study.X;
+        return;
+    }
+    X.resize(n_obs * study.n_predictors);
+    for (size_t p = 0; p < study.n_predictors; p++) {
+        for (size_t o = 0; o < n_obs; o++) {
+            X[p * n_obs + o] = study.X[p * study.n_design_rows + static_cast<size_t>(ids[o]) - 1];
+        }
+    }
+}
+
+// Subsampled data and GLM statistics of one repetition, shared by its methods
+struct RepetitionData {
+    std::vector<double> y;  // observations x variables
+    GlmDesign design;
+    std::vector<double> edge_stats;
+    std::vector<double> edge_stats_neg;
+};
+
+RepetitionData prepare_repetition(const Study& study, const RunnerConfig& config, int rep_id) {
+    std::vector<double> y;
+    std::vector<double> X;
+    {
+        ScopedStage stage(Stage::Subsample);
+        gather_repetition(study, config, rep_id, y, X);
+        stage.add_bytes((y.size() + X.size()) * sizeof(double));
+    }
+
+    std::vector<int> ind_nuisance;
+    for (size_t p = 0; p < config.contrast.size(); p++) {
+        if (config.contrast[p] == 0) {
+            ind_nuisance.push_back(static_cast<int>(p));
+        }
+    }
+    const int n_obs = static_cast<int>(study.n_observations);
+    RepetitionData data{std::move(y),
+                        GlmDesign(X, n_obs, static_cast<int>(study.n_predictors), config.contrast, config.test,
+                                  ind_nuisance),
+                        std::vector<double>(study.n_var), std::vector<double>(study.n_var)};
+
+    data.design.compute_test_stat(data.y, static_cast<int>(study.n_var), data.edge_stats);
+    for (size_t e = 0; e < study.n_var; e++) {
+        data.edge_stats_neg[e] = -data.edge_stats[e];
+    }
+    return data;
+}
+
+// Families with at least one pending full name, as in pf_repetition_loop
+std::vector<const MethodFamily*> pending_families(const RunnerConfig& config, int rep_id) {
+    std::vector<const MethodFamily*> families;
+    for (const MethodFamily& family : method_families()) {
+        for (const std::string& name : full_names(family)) {
+            if (is_pending(config, name, rep_id)) {
+                families.push_back(&family);
+                break;
+            }
+        }
+    }
+    return families;
+}
+
+// Results of the pending full names of a family, one p-value vector per submethod
+void add_results(const RunnerConfig& config, int rep_id, const MethodFamily& family,
+                 std::vector<std::vector<double>>& pvals, std::vector<std::vector<double>>& pvals_neg, double time,
+                 std::vector<MethodResult>& results) {
+    const std::vector<std::string> names = full_names(family);
+    for (size_t s = 0; s < names.size(); s++) {
+        if (!is_pending(config, names[s], rep_id)) {
+            continue;
+        }
+        MethodResult result;
+        result.name = names[s];
+        result.pvals = std::move(pvals[s]);
+        result.pvals_neg = std::move(pvals_neg[s]);
+        result.time = time;
+        results.push_back(std::move(result));
+    }
+}
+
+int permutation_block_size(const RunnerConfig& config) {
+    return config.permutation_block_size > 0 ? std::min(config.permutation_block_size, config.n_perms)
+                                             : config.n_perms;
+}
+
+// Block of n_block permutations; the closed form draws the same permutations
+void generate_block(bool closed_form, const RepetitionData& data, int n_var, int n_block, uint64_t seed,
+                    span<double> block) {
+    if (closed_form && data.design.has_closed_form_permutations()) {
+        data.design.generate_closed_form_permutations(data.y, n_var, n_block, seed, block);
+    } else {
+        data.design.generate_permutations(data.y, n_var, n_block, seed, block);
+    }
+}
+
+// Permutation blocks of one repetition, shared by the method tasks of the scheduler.
+// The first task that reads a block generates it, and the block is dropped after
+// its last reader. At most max_cached_blocks stay cached: a task running further
+// ahead keeps its block to itself, and the tasks behind it generate the block
+// again from the same seed. Every task therefore sees the stream of run_repetition.
+class PermutationCache {
+public:
+    static const size_t max_cached_blocks = 2;
+
+    PermutationCache(const RunnerConfig& config, int rep_id, const RepetitionData& data, int n_var)
+        : data_(data),
+          n_var_(n_var),
+          n_perms_(config.n_perms),
+          block_size_(permutation_block_size(config)),
+          closed_form_(config.closed_form_permutations),
+          seed_(repetition_seed(config.seed, rep_id)) {}
+
+    // Blocks holding the first max_permutations permutations of the stream
+    int n_blocks(int max_permutations) const {
+        const int n_used = std::min(n_perms_, max_permutations);
+        return (n_used + block_size_ - 1) / block_size_;
+    }
+
+    int block_permutations(int i_block) const { return std::min(block_size_, n_perms_ - i_block * block_size_); }
+
+    // Counts a reader of the first n_blocks blocks, called before the tasks start
+    void add_reader(int n_blocks) {
+        if (readers_.size() < static_cast<size_t>(n_blocks)) {
+            readers_.resize(n_blocks, 0);
+        }
+        for (int b = 0; b < n_blocks; b++) {
+            readers_[b]++;
+        }
+    }
+
+    // Block i_block (0-based), n_var x block_permutations(i_block)
+    std::shared_ptr<const std::vector<double>> acquire(int i_block) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            auto cached = blocks_.find(i_block);
+            if (cached != blocks_.end()) {
+                return cached->second;
+            }
+        }
+
+        // Generated outside the lock, so the other tasks of the repetition go on
+        const int n_block = block_permutations(i_block);
+        auto block = std::make_shared<std::vector<double>>(static_cast<size_t>(n_var_) * n_block);
+        {
+            ScopedStage stage(Stage::PermutationGeneration);
+            stage.add_bytes(block->size() * sizeof(double));
+            generate_block(closed_form_, data_, n_var_, n_block, seed_ + i_block + 1, *block);
+        }
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (readers_[i_block] > 1 && blocks_.size() < max_cached_blocks) {
+            blocks_.emplace(i_block, block);
+        }
+        return block;
+    }
+
+    // Called by every reader when it is done with the block
+    void release(int i_block) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (--readers_[i_block] == 0) {
+            blocks_.erase(i_block);
+        }
+    }
+
+private:
+    const RepetitionData& data_;
+    const int n_var_;
+    const int n_perms_;
+    const int block_size_;
+    const bool closed_form_;
+    const uint64_t seed_;
+
+    std::mutex mutex_;
+    std::vector<int> readers_;  // Readers still to come, per block
+    std::map<int, std::shared_ptr<const std::vector<double>>> blocks_;
+};
+
+// Both effect signs of one method family in one repetition, a task of the scheduler
+std::vector<MethodResult> run_family(const MethodContext& context, int rep_id, const MethodFamily& family,
+                                     const RepetitionData& data, PermutationCache& permutations) {
+    Clock::time_point start = Clock::now();
+    std::unique_ptr<MethodRun> run = family.create(context, data.edge_stats);
+    std::unique_ptr<MethodRun> run_neg = family.create(context, data.edge_stats_neg);
+    double time = seconds_since(start);
+
+    const int n_blocks = permutations.n_blocks(family.max_permutations);
+    for (int i_block = 0; i_block < n_blocks; i_block++) {
+        const std::shared_ptr<const std::vector<double>> block = permutations.acquire(i_block);
+        const int n_block = permutations.block_permutations(i_block);
+
+        start = Clock::now();
+        run->update_null_two_tailed(*run_neg, *block, n_block);
+        time += seconds_since(start);
+        permutations.release(i_block);
+    }
+
+    start = Clock::now();
+    std::vector<std::vector<double>> pvals;
+    std::vector<std::vector<double>> pvals_neg;
+    {
+        ScopedStage stage(Stage::Pvalues);
+        pvals = run->pvals_from_null();
+        pvals_neg = run_neg->pvals_from_null();
+    }
+    time += seconds_since(start);
+
+    std::vector<MethodResult> results;
+    add_results(context.config, rep_id, family, pvals, pvals_neg, time, results);
+    return results;
+}
+
+std::vector<double> read_store(const std::string& study_dir, const std::string& name, StoreInfo& info) {
+    return read_column_store(study_dir + "/" + name + ".pcol", info);
+}
+
+}  // namespace
+
+const std::vector<std::string>& supported_runner_methods() {
+    static const std::vector<std::string> names = [] {
+        std::vector<std::string> all;
+        for (const MethodFamily& family : method_families()) {
+            for (const std::string& name : full_names(family)) {
+                all.push_back(name);
+            }
+        }
+        return all;
+    }();
+    return names;
+}
+
+RunnerConfig read_runner_config(const std::string& path) {
+    std::ifstream file(path);
+    if (!file) {
+        throw std::runtime_error("Could not open " + path);
+    }
+
+    RunnerConfig config;
+    std::string line;
+    while (std::getline(file, line)) {
+        line = trim(line);
+        if (line.empty() || line[0] == '#') {
+            continue;
+        }
+        const size_t equal = line.find('=');
+        if (equal == std::string::npos) {
+            throw std::invalid_argument("Expected key = value in " + path + ": " + line);
+        }
+        const std::string key = trim(line.substr(0, equal));
+        const std::string value = trim(line.substr(equal + 1));
+
+        if (key == "test") {
+            config.test = parse_glm_test(value);
+        } else if (key == "design") {
+            if (value != "repetition" && value != "subject") {
+                throw std::invalid_argument("design must be 'repetition' or 'subject'");
+            }
+            config.design_per_subject = value == "subject";
+        } else if (key == "contrast") {
+            config.contrast.clear();
+            for (const std::string& entry : split(value, ' ')) {
+                config.contrast.push_back(to_number(key, entry));
+            }
+        } else if (key == "n_nodes") {
+            config.n_nodes = static_cast<int>(to_number(key, value));
+        } else if (key == "thresh") {
+            config.thresh = to_number(key, value);
+        } else if (key == "alpha") {
+            config.alpha = to_number(key, value);
+        } else if (key == "n_perms") {
+            config.n_perms = static_cast<int>(to_number(key, value));
+        } else if (key == "permutation_block_size") {
+            config.permutation_block_size = static_cast<int>(to_number(key, value));
+        } else if (key == "closed_form_permutations") {
+            config.closed_form_permutations = to_number(key, value) != 0;
+        } else if (key == "n_repetitions") {
+            config.n_repetitions = static_cast<int>(to_number(key, value));
+        } else if (key == "methods") {
+            config.methods = split(value, ',');
+        } else if (key.compare(0, 9, "existing.") == 0) {
+            config.existing_repetitions[key.substr(9)] = static_cast<int>(to_number(key, value));
+        } else if (key == "journal_file") {
+            config.journal_file = value;
+        } else if (key == "stage_profile_file") {
+            config.stage_profile_file = value;
+        } else if (key == "batch_size") {
+            config.batch_size = static_cast<int>(to_number(key, value));
+        } else if (key == "seed") {
+            config.seed = static_cast<uint64_t>(to_number(key, value));
+        } else if (key == "n_threads") {
+            config.n_threads = static_cast<int>(to_number(key, value));
+        } else {
+            throw std::invalid_argument("Unknown key '" + key + "' in " + path);
+        }
+    }
+
+    const std::vector<std::string>& supported = supported_runner_methods();
+    for (const std::string& method : config.methods) {
+        if (std::find(supported.begin(), supported.end(), method) == supported.end()) {
+            throw std::invalid_argument("Method " + method + " is not supported by the native runner");
+        }
+    }
+    if (config.n_perms < 1 || config.batch_size < 1 || config.n_threads < 0) {
+        throw std::invalid_argument("n_perms and batch_size must be positive, n_threads non-negative");
+    }
+    return config;
+}
+
+Study load_study(const std::string& study_dir, const RunnerConfig& config) {
+    ScopedStage stage(Stage::Io);
+    Study study;
+    StoreInfo info;
+
+    study.Y = MappedColumnStore(study_dir + "/Y.pcol");
+    if (study.Y.info().store_class != StoreClass::Double) {
+        throw std::invalid_argument("Y must be a double column store");
+    }
+    study.n_var = study.Y.info().n_rows;
+    study.n_subjects = study.Y.info().n_cols;
+
+    study.X = read_store(study_dir, "X", info);
+    study.n_design_rows = info.n_rows;
+    study.n_predictors = info.n_cols;
+
+    const std::vector<double> mask = read_store(study_dir, "mask", info);
+    if (info.n_rows != study.n_var || info.n_cols != 1) {
+        throw std::invalid_argument("mask must have one index per variable");
+    }
+    const uint64_t n_matrix = static_cast<uint64_t>(config.n_nodes) * config.n_nodes;
+    for (double index : mask) {
+        if (index < 1 || index > static_cast<double>(n_matrix)) {
+            throw std::invalid_argument("mask indices must be between 1 and n_nodes^2");
+        }
+        study.mask_index.push_back(static_cast<uint64_t>(index) - 1);
+    }
+    study.edge_index = make_edge_index(study.mask_index, config.n_nodes);
+
+    study.edge_groups = read_store(study_dir, "edge_groups", info);
+    if (info.n_rows != study.n_var || info.n_cols != 1) {
+        throw std::invalid_argument("edge_groups must have one network per variable");
+    }
+
+    study.ids_sampled = read_store(study_dir, "ids_sampled", info);
+    study.n_observations = info.n_rows;
+    study.n_id_repetitions = info.n_cols;
+    // Y is mapped, not allocated
+    stage.add_bytes((study.X.size() + study.edge_groups.size() + study.ids_sampled.size()) * sizeof(double) +
+                    study.mask_index.size() * sizeof(uint64_t));
+    for (double id : study.ids_sampled) {
+        const size_t max_id = config.design_per_subject ? std::min(study.n_subjects, study.n_design_rows)
+                                                        : study.n_subjects;
+        if (id < 1 || id > static_cast<double>(max_id)) {
+            throw std::invalid_argument("ids_sampled must be subject indices between 1 and the number of subjects");
+        }
+    }
+
+    if (!config.design_per_subject && study.n_design_rows != study.n_observations) {
+        throw std::invalid_argument("X must have one row per observation of a repetition");
+    }
+    if (config.contrast.size() != study.n_predictors) {
+        throw std::invalid_argument("contrast must have one entry per column of X");
+    }
+    return study;
+}
+
+void significance_indicator(span<const double> pvals, double alpha, span<double> sig) {
+    const double level = 1 - alpha;
+    for (size_t i = 0; i < pvals.size(); i++) {
+        double value = 1 - pvals[i];
+        if (value < level) {
+            value = 0;
+        } else if (value > level) {
+            value = 1;
+        }
+        sig[i] = value;
+    }
+}
+
+std::vector<MethodResult> run_repetition(const Study& study, const RunnerConfig& config, int rep_id,
+                                         StageProfile* profile) {
+    ProfileScope profile_scope(profile);
+
+    const RepetitionData data = prepare_repetition(study, config, rep_id);
+    const int n_var = static_cast<int>(study.n_var);
+    const MethodContext context{config, study};
+
+    // Pending methods and their null accumulators, as in pf_repetition_loop
+    struct PendingMethod {
+        const MethodFamily* family;
+        std::unique_ptr<MethodRun> run;
+        std::unique_ptr<MethodRun> run_neg;
+        double time = 0;
+    };
+    std::vector<PendingMethod> pending;
+    bool any_permutation_based = false;
+    for (const MethodFamily* family : pending_families(config, rep_id)) {
+        const Clock::time_point start = Clock::now();
+        PendingMethod method;
+        method.family = family;
+        method.run = family->create(context, data.edge_stats);
+        method.run_neg = family->create(context, data.edge_stats_neg);
+        method.time = seconds_since(start);
+        any_permutation_based = any_permutation_based || method.run->permutation_based();
+        pending.push_back(std::move(method));
+    }
+
+    // One pass over the permutation stream shared by every method
+    if (any_permutation_based) {
+        const int block_size = permutation_block_size(config);
+        const int n_blocks = (config.n_perms + block_size - 1) / block_size;
+        const uint64_t seed = repetition_seed(config.seed, rep_id);
+        std::vector<double> block(study.n_var * block_size);
+
+        for (int i_block = 1; i_block <= n_blocks; i_block++) {
+            const int n_block = std::min(block_size, config.n_perms - (i_block - 1) * block_size);
+            const size_t n_values = study.n_var * n_block;
+            {
+                // The permutations are counted by the kernel
+                ScopedStage stage(Stage::PermutationGeneration);
+                if (i_block == 1) {
+                    stage.add_bytes(block.size() * sizeof(double));
+                }
+                generate_block(config.closed_form_permutations, data, n_var, n_block, seed + i_block,
+                               span<double>(block.data(), n_values));
+            }
+
+            for (PendingMethod& method : pending) {
+                if (!method.run->permutation_based()) {
+                    continue;
+                }
+                const Clock::time_point start = Clock::now();
+                method.run->update_null_two_tailed(*method.run_neg, span<const double>(block.data(), n_values),
+                                                   n_block);
+                method.time += seconds_since(start);
+            }
+        }
+    }
+
+    std::vector<MethodResult> results;
+    for (PendingMethod& method : pending) {
+        const Clock::time_point start = Clock::now();
+        std::vector<std::vector<double>> pvals;
+        std::vector<std::vector<double>> pvals_neg;
+        {
+            ScopedStage stage(Stage::Pvalues);
+            pvals = method.run->pvals_from_null();
+            pvals_neg = method.run_neg->pvals_from_null();
+        }
+        method.time += seconds_since(start);
+        add_results(config, rep_id, *method.family, pvals, pvals_neg, method.time, results);
+    }
+    return results;
+}
+
+int run_power_repetitions(const Study& study, const RunnerConfig& study_config) {
+    if (study_config.journal_file.empty()) {
+        throw std::invalid_argument("journal_file is not set");
+    }
+
+    // Repetitions journaled by an earlier (interrupted) run are not computed again;
+    // each method is journaled in order, so its last repetition covers all before it
+    RunnerConfig config = study_config;
+    if (std::FILE* file = std::fopen(config.journal_file.c_str(), "rb")) {
+        std::fclose(file);
+        for (const JournalMethodSummary& method : read_journal(config.journal_file).methods) {
+            int& existing = config.existing_repetitions[method.name];
+            existing = std::max(existing, static_cast<int>(method.max_repetition));
+        }
+    }
+
+    // First repetition any method still needs
+    int first_rep = config.n_repetitions + 1;
+    for (const std::string& name : config.methods) {
+        auto existing = config.existing_repetitions.find(name);
+        first_rep = std::min(first_rep, (existing == config.existing_repetitions.end() ? 0 : existing->second) + 1);
+    }
+    const int n_pending = std::max(config.n_repetitions - first_rep + 1, 0);
+    if (n_pending == 0) {
+        return 0;
+    }
+
+    // Methods of this run, in the order run_repetition returns them
+    std::vector<std::string> names;
+    for (const std::string& name : supported_runner_methods()) {
+        if (std::find(config.methods.begin(), config.methods.end(), name) != config.methods.end()) {
+            names.push_back(name);
+        }
+    }
+    const size_t n_names = names.size();
+
+    // Results of method k in repetition first_rep + i wait in entry i * n_names + k
+    // until the method is done in every earlier repetition, so the journal never
+    // holds a repetition of a method beyond a missing one. Entries of methods that
+    // are not pending count as done.
+    std::vector<MethodResult> finished(n_pending * n_names);
+    std::vector<bool> done(n_pending * n_names);
+    for (int i = 0; i < n_pending; i++) {
+        for (size_t k = 0; k < n_names; k++) {
+            done[i * n_names + k] = !is_pending(config, names[k], first_rep + i);
+        }
+    }
+    std::vector<int> next_to_journal(n_names, 0);
+    int next_complete = 0;  // First repetition with a method not journaled yet
+    std::vector<StageProfile> profiles(n_pending);
+    StageProfile journal_profile;  // Appends since the last stage profile row
+    std::mutex journal_mutex;
+
+    // Called with journal_mutex held. Appends once batch_size repetitions worth of
+    // results are ready, methods that finish early do not wait for the slow ones.
+    auto journal_ready = [&](bool flush_all) {
+        std::vector<int> end = next_to_journal;
+        size_t n_ready = 0;
+        for (size_t k = 0; k < n_names; k++) {
+            while (end[k] < n_pending && done[end[k] * n_names + k]) {
+                end[k]++;
+            }
+            n_ready += end[k] - next_to_journal[k];
+        }
+        if (n_ready == 0 || (!flush_all && n_ready < static_cast<size_t>(config.batch_size) * n_names)) {
+            return;
+        }
+
+        {
+            ProfileScope profile_scope(&journal_profile);
+            ScopedStage stage(Stage::Io);
+            std::vector<unsigned char> batch;
+            const int last = *std::max_element(end.begin(), end.end());
+            for (int i = next_complete; i < last; i++) {
+                for (size_t k = 0; k < n_names; k++) {
+                    MethodResult& result = finished[i * n_names + k];
+                    if (i < next_to_journal[k] || i >= end[k] || result.name.empty()) {
+                        continue;
+                    }
+                    std::vector<double> positives(result.pvals.size());
+                    std::vector<double> negatives(result.pvals_neg.size());
+                    significance_indicator(result.pvals, config.alpha, positives);
+                    significance_indicator(result.pvals_neg, config.alpha, negatives);
+                    encode_journal_record(batch, result.name, static_cast<uint32_t>(first_rep + i), result.time,
+                                          positives, negatives);
+                    result = MethodResult();
+                }
+            }
+            if (!batch.empty()) {
+                append_journal_batch(config.journal_file, batch);
+            }
+            stage.add_bytes(batch.size());
+        }
+        next_to_journal = end;
+
+        // Stage times are written with the repetitions every method has journaled
+        const int complete = *std::min_element(end.begin(), end.end());
+        if (complete > next_complete) {
+            if (!config.stage_profile_file.empty()) {
+                for (int i = next_complete; i < complete; i++) {
+                    journal_profile.merge(profiles[i]);
+                }
+                append_stage_profile(config.stage_profile_file, "prisme_power", first_rep + next_complete,
+                                     first_rep + complete - 1, journal_profile);
+            }
+            journal_profile = StageProfile();
+            next_complete = complete;
+            std::printf("Repetition %d completed \n", first_rep + complete - 1);
+            std::fflush(stdout);
+        }
+    };
+
+    int n_threads = config.n_threads;
+    if (n_threads == 0) {
+        n_threads = std::max(static_cast<int>(std::thread::hardware_concurrency()), 1);
+    }
+    n_threads = std::min(n_threads, n_pending * static_cast<int>(method_families().size()));
+    TaskPool pool(n_threads);
+    const MethodContext context{config, study};
+
+    // Repetition data shared by the method tasks, freed with the last of them
+    struct RepetitionJob {
+        RepetitionJob(RepetitionData repetition, const RunnerConfig& config, int rep_id, int n_var)
+            : data(std::move(repetition)), permutations(config, rep_id, data, n_var) {}
+
+        RepetitionData data;
+        PermutationCache permutations;
+    };
+
+    // One task per pending method family of a repetition
+    auto run_method = [&](int i, std::shared_ptr<RepetitionJob> job, const MethodFamily* family) {
+        StageProfile profile;
+        std::vector<MethodResult> results;
+        {
+            ProfileScope profile_scope(&profile);
+            results = run_family(context, first_rep + i, *family, job->data, job->permutations);
+        }
+        job.reset();
+
+        std::lock_guard<std::mutex> lock(journal_mutex);
+        profiles[i].merge(profile);
+        for (MethodResult& result : results) {
+            const size_t k = std::find(names.begin(), names.end(), result.name) - names.begin();
+            finished[i * n_names + k] = std::move(result);
+            done[i * n_names + k] = true;
+        }
+        journal_ready(false);
+    };
+
+    // Subsample and GLM of a repetition, then its method tasks. Idle workers steal
+    // the oldest of them, the permutation methods, while this worker goes on with
+    // the cheaper ones.
+    auto start_repetition = [&](int i) {
+        const int rep_id = first_rep + i;
+        StageProfile profile;
+        std::shared_ptr<RepetitionJob> job;
+        {
+            ProfileScope profile_scope(&profile);
+            job = std::make_shared<RepetitionJob>(prepare_repetition(study, config, rep_id), config, rep_id,
+                                                  static_cast<int>(study.n_var));
+        }
+        const std::vector<const MethodFamily*> families = pending_families(config, rep_id);
+        for (const MethodFamily* family : families) {
+            if (family->max_permutations > 0) {
+                job->permutations.add_reader(job->permutations.n_blocks(family->max_permutations));
+            }
+        }
+        {
+            std::lock_guard<std::mutex> lock(journal_mutex);
+            profiles[i].merge(profile);
+        }
+        for (const MethodFamily* family : families) {
+            pool.submit([&run_method, i, job, family] { run_method(i, job, family); });
+        }
+    };
+
+    for (int i = 0; i < n_pending; i++) {
+        pool.submit([&start_repetition, i] { start_repetition(i); });
+    }
+    std::exception_ptr error;
+    try {
+        pool.wait();
+    } catch (...) {
+        error = std::current_exception();
+    }
+
+    // Journal whatever completed in order, even if a later task failed
+    journal_ready(true);
+    if (error) {
+        std::rethrow_exception(error);
+    }
+    return n_pending;
+}
+
+}  // namespace prisme
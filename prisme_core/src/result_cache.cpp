@@ -0,0 +1,308 @@
+/**
+ * result_cache.cpp - Content-addressed on-disk cache of repetition results (.prc)
+ */
+
+#include "prisme/result_cache.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <functional>
+#include <stdexcept>
+#include <system_error>
+#include <thread>
+#include <tuple>
+
+#ifdef _WIN32
+#include <process.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace fs = std::filesystem;
+
+namespace prisme {
+
+namespace {
+
+const char CACHE_MAGIC[8] = {'P', 'R', 'S', 'M', 'R', 'C', 'H', '\0'};
+const uint32_t CACHE_VERSION = 1;
+const char* const ENTRY_EXTENSION = ".prc";
+
+struct EntryHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t reserved;
+    uint64_t n_rows;
+    uint64_t n_cols;
+};
+
+const uint64_t C1 = 0x87c37b91114253d5ULL;
+const uint64_t C2 = 0x4cf5ad432745937fULL;
+const uint64_t C3 = 0x9e3779b97f4a7c15ULL;
+
+uint64_t rotl(uint64_t x, int r) { return (x << r) | (x >> (64 - r)); }
+
+uint64_t fmix(uint64_t k) {
+    k ^= k >> 33;
+    k *= 0xff51afd7ed558ccdULL;
+    k ^= k >> 33;
+    k *= 0xc4ceb9fe1a85ec53ULL;
+    k ^= k >> 33;
+    return k;
+}
+
+// Closes the file on every exit path
+struct FileHandle {
+    FILE* file;
+    explicit FileHandle(FILE* f) : file(f) {}
+    ~FileHandle() {
+        if (file) {
+            std::fclose(file);
+        }
+    }
+    FileHandle(const FileHandle&) = delete;
+    FileHandle& operator=(const FileHandle&) = delete;
+};
+
+// Keys name files, so only hex digits are accepted
+void check_key(const std::string& key) {
+    const bool hex = !key.empty() && std::all_of(key.begin(), key.end(), [](char c) {
+        return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'f');
+    });
+    if (!hex) {
+        throw std::invalid_argument("Cache keys must be lowercase hex strings");
+    }
+}
+
+// Unique per process and call, entries written concurrently never share a temporary
+std::string temporary_suffix() {
+    static std::atomic<uint64_t> counter(0);
+#ifdef _WIN32
+    const long pid = _getpid();
+#else
+    const long pid = static_cast<long>(getpid());
+#endif
+    return ".tmp" + std::to_string(pid) + "_" +
+           std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id())) + "_" +
+           std::to_string(counter++);
+}
+
+bool is_entry(const fs::directory_entry& entry) {
+    std::error_code ec;
+    return entry.is_regular_file(ec) && entry.path().extension() == ENTRY_EXTENSION;
+}
+
+}  // namespace
+
+ContentHash::ContentHash() : lanes_{0x6a09e667f3bcc908ULL, 0xbb67ae8584caa73bULL}, tail_{} {}
+
+void ContentHash::mix(uint64_t word) {
+    lanes_[0] = rotl(lanes_[0] ^ (word * C1), 31) * C2;
+    lanes_[1] = (rotl(lanes_[1] + word * C2, 29) ^ word) * C3;
+}
+
+void ContentHash::update(const void* data, size_t n_bytes) {
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    n_bytes_ += n_bytes;
+    uint64_t word;
+
+    // Complete the word left over from the previous update
+    if (n_tail_ > 0) {
+        const size_t n_fill = std::min(sizeof(word) - n_tail_, n_bytes);
+        std::memcpy(tail_ + n_tail_, bytes, n_fill);
+        n_tail_ += n_fill;
+        bytes += n_fill;
+        n_bytes -= n_fill;
+        if (n_tail_ < sizeof(word)) {
+            return;
+        }
+        std::memcpy(&word, tail_, sizeof(word));
+        mix(word);
+        n_tail_ = 0;
+    }
+    for (; n_bytes >= sizeof(word); bytes += sizeof(word), n_bytes -= sizeof(word)) {
+        std::memcpy(&word, bytes, sizeof(word));
+        mix(word);
+    }
+    std::memcpy(tail_ + n_tail_, bytes, n_bytes);
+    n_tail_ += n_bytes;
+}
+
+void ContentHash::update(const std::string& text) {
+    // The length separates consecutive strings
+    const uint64_t length = text.size();
+    update(&length, sizeof(length));
+    update(text.data(), text.size());
+}
+
+void ContentHash::update(span<const double> values) {
+    const uint64_t length = values.size();
+    update(&length, sizeof(length));
+    update(values.data(), values.size() * sizeof(double));
+}
+
+std::string ContentHash::hex() const {
+    ContentHash last(*this);
+    if (last.n_tail_ > 0) {
+        uint64_t word = 0;
+        std::memcpy(&word, last.tail_, last.n_tail_);
+        last.mix(word);
+    }
+    uint64_t a = last.lanes_[0] ^ n_bytes_;
+    uint64_t b = last.lanes_[1] ^ n_bytes_;
+    a += b;
+    b += a;
+    a = fmix(a);
+    b = fmix(b);
+    a += b;
+    b += a;
+
+    char text[33];
+    std::snprintf(text, sizeof(text), "%016llx%016llx", static_cast<unsigned long long>(a),
+                  static_cast<unsigned long long>(b));
+    return text;
+}
+
+ResultCache::ResultCache(const std::string& directory, uint64_t max_bytes)
+    : directory_(directory), max_bytes_(max_bytes) {
+    if (directory.empty()) {
+        throw std::invalid_argument("The cache directory must not be empty");
+    }
+    if (max_bytes == 0) {
+        throw std::invalid_argument("max_bytes must be positive");
+    }
+    std::error_code ec;
+    fs::create_directories(directory, ec);
+    if (!fs::is_directory(directory, ec)) {
+        throw std::runtime_error("Could not create the cache directory " + directory);
+    }
+}
+
+std::string ResultCache::entry_path(const std::string& key) const {
+    check_key(key);
+    return (fs::path(directory_) / (key + ENTRY_EXTENSION)).string();
+}
+
+bool ResultCache::get(const std::string& key, CachedMatrix& entry) const {
+    const std::string path = entry_path(key);
+    {
+        FileHandle handle(std::fopen(path.c_str(), "rb"));
+        if (!handle.file) {
+            return false;
+        }
+        EntryHeader header;
+        if (std::fread(&header, sizeof(header), 1, handle.file) != 1 ||
+            std::memcmp(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC)) != 0 || header.version != CACHE_VERSION) {
+            return false;
+        }
+        const uint64_t n_values = header.n_rows * header.n_cols;
+        if (header.n_cols != 0 && n_values / header.n_cols != header.n_rows) {
+            return false;
+        }
+        std::vector<double> values(n_values);
+        if (std::fread(values.data(), sizeof(double), n_values, handle.file) != n_values ||
+            std::fgetc(handle.file) != EOF) {
+            return false;
+        }
+        entry.n_rows = header.n_rows;
+        entry.n_cols = header.n_cols;
+        entry.values.swap(values);
+    }
+
+    // The modification time orders the entries for eviction
+    std::error_code ec;
+    fs::last_write_time(path, fs::file_time_type::clock::now(), ec);
+    return true;
+}
+
+void ResultCache::put(const std::string& key, span<const double> values, uint64_t n_rows, uint64_t n_cols) {
+    const std::string path = entry_path(key);
+    if (values.size() != n_rows * n_cols) {
+        throw std::invalid_argument("values must hold n_rows x n_cols entries");
+    }
+    if (sizeof(EntryHeader) + values.size() * sizeof(double) > max_bytes_) {
+        return;
+    }
+
+    EntryHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC));
+    header.version = CACHE_VERSION;
+    header.n_rows = n_rows;
+    header.n_cols = n_cols;
+
+    const std::string temporary = path + temporary_suffix();
+    bool ok;
+    {
+        FileHandle handle(std::fopen(temporary.c_str(), "wb"));
+        if (!handle.file) {
+            throw std::runtime_error("Could not create " + temporary);
+        }
+        ok = std::fwrite(&header, sizeof(header), 1, handle.file) == 1 &&
+             std::fwrite(values.data(), sizeof(double), values.size(), handle.file) == values.size();
+        ok = std::fclose(handle.file) == 0 && ok;
+        handle.file = nullptr;
+    }
+
+    // Readers see the whole entry or none, an existing entry of the same key is replaced
+    std::error_code ec;
+    if (ok) {
+        fs::rename(temporary, path, ec);
+    }
+    if (!ok || ec) {
+        fs::remove(temporary, ec);
+        throw std::runtime_error("Could not write the cache entry " + path);
+    }
+    evict();
+}
+
+uint64_t ResultCache::size_bytes() const {
+    uint64_t total = 0;
+    std::error_code ec;
+    for (const fs::directory_entry& entry : fs::directory_iterator(directory_, ec)) {
+        if (is_entry(entry)) {
+            total += entry.file_size(ec);
+        }
+    }
+    return total;
+}
+
+// Another process may evict or replace the same entries meanwhile, failures are skipped
+void ResultCache::evict() const {
+    std::vector<std::tuple<fs::file_time_type, uint64_t, fs::path>> entries;
+    uint64_t total = 0;
+    std::error_code ec;
+    for (const fs::directory_entry& entry : fs::directory_iterator(directory_, ec)) {
+        if (!is_entry(entry)) {
+            continue;
+        }
+        const uint64_t bytes = entry.file_size(ec);
+        if (ec) {
+            continue;
+        }
+        const fs::file_time_type time = entry.last_write_time(ec);
+        if (ec) {
+            continue;
+        }
+        entries.emplace_back(time, bytes, entry.path());
+        total += bytes;
+    }
+    if (total <= max_bytes_) {
+        return;
+    }
+
+    std::sort(entries.begin(), entries.end());
+    for (const auto& entry : entries) {
+        if (total <= max_bytes_) {
+            break;
+        }
+        if (fs::remove(std::get<2>(entry), ec)) {
+            total -= std::get<1>(entry);
+        }
+    }
+}
+
+}  // namespace prisme
@@ -0,0 +1,335 @@
+/**
+ * result_journal.cpp - Append-only journal of per-method repetition results (.prj)
+ */
+
+#include "prisme/result_journal.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <stdexcept>
+#include <utility>
+
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+namespace prisme {
+
+namespace {
+
+const char JOURNAL_MAGIC[8] = {'P', 'R', 'S', 'M', 'J', 'R', 'N', '\0'};
+const uint32_t JOURNAL_VERSION = 1;
+
+struct JournalHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t reserved;
+    uint64_t end_offset;   // End of the last complete batch
+    uint64_t generation;
+};
+
+const uint64_t HEADER_BYTES = sizeof(JournalHeader);
+
+// One decoded record
+struct JournalRecord {
+    std::string method;
+    uint32_t repetition;
+    uint32_t n_values;
+    double time;
+    std::vector<uint32_t> pos_idx;
+    std::vector<double> pos_val;
+    std::vector<uint32_t> neg_idx;
+    std::vector<double> neg_val;
+};
+
+// Closes the file on every exit path
+struct FileHandle {
+    FILE* file;
+    explicit FileHandle(FILE* f) : file(f) {}
+    ~FileHandle() {
+        if (file) {
+            std::fclose(file);
+        }
+    }
+    FileHandle(const FileHandle&) = delete;
+    FileHandle& operator=(const FileHandle&) = delete;
+};
+
+uint32_t crc32(const unsigned char* data, size_t n) {
+    static const std::vector<uint32_t> table = [] {
+        std::vector<uint32_t> t(256);
+        for (uint32_t i = 0; i < 256; i++) {
+            uint32_t c = i;
+            for (int k = 0; k < 8; k++) {
+                c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            }
+            t[i] = c;
+        }
+        return t;
+    }();
+    uint32_t crc = 0xFFFFFFFFu;
+    for (size_t i = 0; i < n; i++) {
+        crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    }
+    return crc ^ 0xFFFFFFFFu;
+}
+
+bool seek_to(FILE* file, uint64_t offset) {
+#ifdef _WIN32
+    return _fseeki64(file, static_cast<__int64>(offset), SEEK_SET) == 0;
+#else
+    return fseeko(file, static_cast<off_t>(offset), SEEK_SET) == 0;
+#endif
+}
+
+template <typename T>
+void put(std::vector<unsigned char>& buffer, const T& value) {
+    const unsigned char* bytes = reinterpret_cast<const unsigned char*>(&value);
+    buffer.insert(buffer.end(), bytes, bytes + sizeof(T));
+}
+
+template <typename T>
+bool get(const std::vector<unsigned char>& buffer, size_t& pos, T& value) {
+    if (pos + sizeof(T) > buffer.size()) {
+        return false;
+    }
+    std::memcpy(&value, buffer.data() + pos, sizeof(T));
+    pos += sizeof(T);
+    return true;
+}
+
+// Only the non-zero significance values are stored
+void put_sparse(std::vector<unsigned char>& buffer, span<const double> values) {
+    std::vector<uint32_t> idx;
+    for (uint32_t i = 0; i < values.size(); i++) {
+        if (values[i] != 0) {
+            idx.push_back(i);
+        }
+    }
+    put(buffer, static_cast<uint32_t>(idx.size()));
+    for (uint32_t i : idx) {
+        put(buffer, i);
+    }
+    for (uint32_t i : idx) {
+        put(buffer, values[i]);
+    }
+}
+
+bool get_sparse(const std::vector<unsigned char>& buffer, size_t& pos, uint32_t n_values,
+                std::vector<uint32_t>& idx, std::vector<double>& val) {
+    uint32_t nnz;
+    if (!get(buffer, pos, nnz) || nnz > n_values) {
+        return false;
+    }
+    idx.resize(nnz);
+    val.resize(nnz);
+    for (uint32_t i = 0; i < nnz; i++) {
+        if (!get(buffer, pos, idx[i]) || idx[i] >= n_values) {
+            return false;
+        }
+    }
+    for (uint32_t i = 0; i < nnz; i++) {
+        if (!get(buffer, pos, val[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool decode_record(const std::vector<unsigned char>& payload, JournalRecord& record) {
+    size_t pos = 0;
+    uint32_t name_len;
+    if (!get(payload, pos, name_len) || pos + name_len > payload.size()) {
+        return false;
+    }
+    record.method.assign(reinterpret_cast<const char*>(payload.data() + pos), name_len);
+    pos += name_len;
+    return get(payload, pos, record.repetition) && get(payload, pos, record.n_values) &&
+           get(payload, pos, record.time) &&
+           get_sparse(payload, pos, record.n_values, record.pos_idx, record.pos_val) &&
+           get_sparse(payload, pos, record.n_values, record.neg_idx, record.neg_val) &&
+           pos == payload.size();
+}
+
+bool read_header(FILE* file, JournalHeader& header) {
+    return seek_to(file, 0) && std::fread(&header, sizeof(header), 1, file) == 1 &&
+           std::memcmp(header.magic, JOURNAL_MAGIC, sizeof(JOURNAL_MAGIC)) == 0 &&
+           header.version == JOURNAL_VERSION && header.end_offset >= HEADER_BYTES;
+}
+
+bool write_header(FILE* file, const JournalHeader& header) {
+    return seek_to(file, 0) && std::fwrite(&header, sizeof(header), 1, file) == 1 && std::fflush(file) == 0;
+}
+
+// Opens the journal for update, creating an empty one if needed
+FILE* open_journal(const std::string& path, JournalHeader& header) {
+    FILE* file = std::fopen(path.c_str(), "r+b");
+    if (!file) {
+        file = std::fopen(path.c_str(), "w+b");
+        if (!file) {
+            throw std::runtime_error("Could not create " + path);
+        }
+        std::memset(&header, 0, sizeof(header));
+        std::memcpy(header.magic, JOURNAL_MAGIC, sizeof(JOURNAL_MAGIC));
+        header.version = JOURNAL_VERSION;
+        header.end_offset = HEADER_BYTES;
+        header.generation = 0;
+        if (!write_header(file, header)) {
+            std::fclose(file);
+            throw std::runtime_error("Could not write the journal header");
+        }
+        return file;
+    }
+    if (!read_header(file, header)) {
+        std::fclose(file);
+        throw std::runtime_error(path + " is not a result journal");
+    }
+    return file;
+}
+
+// Reads every valid record; stops at the first record that fails its checks
+std::vector<JournalRecord> read_records(const std::string& path, JournalHeader& header) {
+    FileHandle handle(std::fopen(path.c_str(), "rb"));
+    if (!handle.file) {
+        throw std::runtime_error("Could not open " + path);
+    }
+    FILE* file = handle.file;
+    if (!read_header(file, header)) {
+        throw std::runtime_error(path + " is not a result journal");
+    }
+
+    std::vector<JournalRecord> records;
+    uint64_t offset = HEADER_BYTES;
+    std::vector<unsigned char> payload;
+    while (offset + sizeof(uint32_t) <= header.end_offset) {
+        uint32_t record_bytes;
+        if (!seek_to(file, offset) || std::fread(&record_bytes, sizeof(record_bytes), 1, file) != 1 ||
+            record_bytes < 2 * sizeof(uint32_t) || offset + record_bytes > header.end_offset) {
+            break;
+        }
+        payload.resize(record_bytes - 2 * sizeof(uint32_t));
+        uint32_t crc;
+        if (std::fread(payload.data(), 1, payload.size(), file) != payload.size() ||
+            std::fread(&crc, sizeof(crc), 1, file) != 1 || crc != crc32(payload.data(), payload.size())) {
+            break;
+        }
+
+        JournalRecord record;
+        if (!decode_record(payload, record)) {
+            break;
+        }
+        records.push_back(std::move(record));
+        offset += record_bytes;
+    }
+    return records;
+}
+
+std::vector<JournalMethodSummary> summarize(const std::vector<JournalRecord>& records) {
+    // Last record of each (method, repetition) wins
+    std::map<std::pair<std::string, uint32_t>, size_t> last_record;
+    for (size_t r = 0; r < records.size(); r++) {
+        last_record[std::make_pair(records[r].method, records[r].repetition)] = r;
+    }
+
+    std::vector<JournalMethodSummary> methods;
+    std::map<std::string, size_t> method_index;
+    for (size_t r = 0; r < records.size(); r++) {
+        const JournalRecord& record = records[r];
+        if (last_record[std::make_pair(record.method, record.repetition)] != r) {
+            continue;
+        }
+
+        auto found = method_index.find(record.method);
+        if (found == method_index.end()) {
+            JournalMethodSummary summary;
+            summary.name = record.method;
+            summary.positives.assign(record.n_values, 0.0);
+            summary.negatives.assign(record.n_values, 0.0);
+            found = method_index.emplace(record.method, methods.size()).first;
+            methods.push_back(std::move(summary));
+        }
+
+        JournalMethodSummary& summary = methods[found->second];
+        if (summary.positives.size() != record.n_values) {
+            throw std::runtime_error("Journal records of " + record.method + " have different sizes");
+        }
+        for (size_t i = 0; i < record.pos_idx.size(); i++) {
+            summary.positives[record.pos_idx[i]] += record.pos_val[i];
+        }
+        for (size_t i = 0; i < record.neg_idx.size(); i++) {
+            summary.negatives[record.neg_idx[i]] += record.neg_val[i];
+        }
+        summary.total_calculations += 1;
+        summary.total_time += record.time;
+        if (record.repetition > summary.max_repetition) {
+            summary.max_repetition = record.repetition;
+        }
+    }
+    return methods;
+}
+
+}  // namespace
+
+// Record layout: record_bytes | payload | crc32(payload), record_bytes counts all three
+void encode_journal_record(std::vector<unsigned char>& batch, const std::string& method, uint32_t repetition,
+                           double time, span<const double> positives, span<const double> negatives) {
+    if (positives.size() != negatives.size()) {
+        throw std::invalid_argument("positives and negatives must have the same size");
+    }
+    std::vector<unsigned char> payload;
+    put(payload, static_cast<uint32_t>(method.size()));
+    payload.insert(payload.end(), method.begin(), method.end());
+    put(payload, repetition);
+    put(payload, static_cast<uint32_t>(positives.size()));
+    put(payload, time);
+    put_sparse(payload, positives);
+    put_sparse(payload, negatives);
+
+    put(batch, static_cast<uint32_t>(payload.size() + 2 * sizeof(uint32_t)));
+    batch.insert(batch.end(), payload.begin(), payload.end());
+    put(batch, crc32(payload.data(), payload.size()));
+}
+
+void append_journal_batch(const std::string& path, const std::vector<unsigned char>& batch) {
+    JournalHeader header;
+    FileHandle handle(open_journal(path, header));
+    FILE* file = handle.file;
+
+    // Anything after end_offset belongs to an interrupted append and is overwritten
+    bool ok = seek_to(file, header.end_offset) &&
+              std::fwrite(batch.data(), 1, batch.size(), file) == batch.size() && std::fflush(file) == 0;
+#ifndef _WIN32
+    ok = ok && fsync(fileno(file)) == 0;
+#endif
+    if (ok) {
+        header.end_offset += batch.size();
+        ok = write_header(file, header);
+    }
+    if (!ok) {
+        throw std::runtime_error("Could not append to " + path);
+    }
+}
+
+JournalSummary read_journal(const std::string& path) {
+    JournalHeader header;
+    const std::vector<JournalRecord> records = read_records(path, header);
+
+    JournalSummary summary;
+    summary.generation = header.generation;
+    summary.n_records = records.size();
+    summary.methods = summarize(records);
+    return summary;
+}
+
+void reset_journal(const std::string& path) {
+    JournalHeader header;
+    FileHandle handle(open_journal(path, header));
+    header.end_offset = HEADER_BYTES;
+    header.generation += 1;
+    if (!write_header(handle.file, header)) {
+        throw std::runtime_error("Could not reset " + path);
+    }
+}
+
+}  // namespace prisme
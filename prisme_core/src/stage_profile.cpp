@@ -0,0 +1,148 @@
+/**
+ * stage_profile.cpp - Per-stage wall time, CPU time, allocations and permutation counts
+ */
+
+#include "prisme/stage_profile.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <ctime>
+#include <memory>
+#include <stdexcept>
+
+namespace prisme {
+
+namespace {
+
+thread_local StageProfile* current_profile = nullptr;
+thread_local ScopedStage* current_stage = nullptr;
+
+double wall_seconds() {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// CPU time of the calling thread where the platform has a thread clock, of the
+// process otherwise
+double cpu_seconds() {
+#if defined(CLOCK_THREAD_CPUTIME_ID)
+    timespec now;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now);
+    return static_cast<double>(now.tv_sec) + 1e-9 * static_cast<double>(now.tv_nsec);
+#else
+    return static_cast<double>(std::clock()) / CLOCKS_PER_SEC;
+#endif
+}
+
+struct FileCloser {
+    void operator()(std::FILE* file) const { std::fclose(file); }
+};
+
+}  // namespace
+
+const char* stage_name(Stage stage) {
+    switch (stage) {
+        case Stage::Subsample:
+            return "subsample";
+        case Stage::GlmFit:
+            return "glm_fit";
+        case Stage::PermutationGeneration:
+            return "permutation_generation";
+        case Stage::UnflattenThreshold:
+            return "unflatten_threshold";
+        case Stage::ClusterFinding:
+            return "cluster_finding";
+        case Stage::NullConstruction:
+            return "null_construction";
+        case Stage::Pvalues:
+            return "pvalues";
+        case Stage::Io:
+            return "io";
+    }
+    return "unknown";
+}
+
+void StageProfile::merge(const StageProfile& other) {
+    for (int s = 0; s < n_stages; s++) {
+        stages[s].calls += other.stages[s].calls;
+        stages[s].wall_time += other.stages[s].wall_time;
+        stages[s].cpu_time += other.stages[s].cpu_time;
+        stages[s].bytes_allocated += other.stages[s].bytes_allocated;
+        stages[s].permutations += other.stages[s].permutations;
+    }
+}
+
+ProfileScope::ProfileScope(StageProfile* profile) : previous_(current_profile) {
+    current_profile = profile;
+}
+
+ProfileScope::~ProfileScope() {
+    current_profile = previous_;
+}
+
+ScopedStage::ScopedStage(Stage stage, uint64_t permutations) : profile_(current_profile), stage_(stage) {
+    if (profile_ == nullptr) {
+        return;
+    }
+    parent_ = current_stage;
+    current_stage = this;
+    permutations_ = permutations;
+    wall_start_ = wall_seconds();
+    cpu_start_ = cpu_seconds();
+}
+
+ScopedStage::~ScopedStage() {
+    if (profile_ == nullptr) {
+        return;
+    }
+    const double wall = wall_seconds() - wall_start_;
+    const double cpu = cpu_seconds() - cpu_start_;
+
+    StageTotals& totals = (*profile_)[stage_];
+    totals.calls++;
+    totals.wall_time += wall - child_wall_;
+    totals.cpu_time += cpu - child_cpu_;
+    totals.bytes_allocated += bytes_;
+    totals.permutations += permutations_;
+
+    if (parent_ != nullptr) {
+        parent_->child_wall_ += wall;
+        parent_->child_cpu_ += cpu;
+    }
+    current_stage = parent_;
+}
+
+void append_stage_profile(const std::string& path, const std::string& source, int first_repetition,
+                          int last_repetition, const StageProfile& profile) {
+    bool is_new = true;
+    if (std::FILE* existing = std::fopen(path.c_str(), "rb")) {
+        std::fseek(existing, 0, SEEK_END);
+        is_new = std::ftell(existing) == 0;
+        std::fclose(existing);
+    }
+
+    std::unique_ptr<std::FILE, FileCloser> file(std::fopen(path.c_str(), "ab"));
+    if (!file) {
+        throw std::runtime_error("Could not open " + path);
+    }
+    if (is_new) {
+        std::fprintf(file.get(),
+                     "source,first_repetition,last_repetition,stage,calls,wall_time,cpu_time,bytes_allocated,"
+                     "permutations\n");
+    }
+    for (int s = 0; s < n_stages; s++) {
+        const StageTotals& totals = profile.stages[s];
+        if (totals.calls == 0) {
+            continue;
+        }
+        std::fprintf(file.get(), "%s,%d,%d,%s,%llu,%.9g,%.9g,%llu,%llu\n", source.c_str(), first_repetition,
+                     last_repetition, stage_name(static_cast<Stage>(s)),
+                     static_cast<unsigned long long>(totals.calls), totals.wall_time, totals.cpu_time,
+                     static_cast<unsigned long long>(totals.bytes_allocated),
+                     static_cast<unsigned long long>(totals.permutations));
+    }
+    if (std::fflush(file.get()) != 0) {
+        throw std::runtime_error("Could not write " + path);
+    }
+}
+
+}  // namespace prisme
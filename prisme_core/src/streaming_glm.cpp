@@ -0,0 +1,248 @@
+/**
+ * streaming_glm.cpp - Full sample GLM statistics accumulated from chunks of subjects
+ */
+
+#include "prisme/streaming_glm.hpp"
+
+#include "prisme/stage_profile.hpp"
+
+#include <Eigen/Dense>
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+namespace prisme {
+
+namespace {
+
+// Fit of one set of columns of Z = [X, 1] to every variable
+struct ModelFit {
+    Eigen::MatrixXd beta;  // Coefficients of the unshifted data, n_columns x n_var
+    Eigen::VectorXd sse;   // Residual sum of squares
+    Eigen::VectorXd ssr;   // Sum of squares of the fit around the mean of the data
+};
+
+}  // namespace
+
+struct StreamingGlm::Impl {
+    Eigen::MatrixXd Z;     // n_observations x (n_predictors + 1), the last column is ones
+    Eigen::MatrixXd gram;  // Z'Z
+    int n_observations;
+    int n_predictors;
+    size_t n_var;
+    int n_added = 0;
+
+    // Sufficient statistics of the shifted data Ys = Y - shift
+    Eigen::VectorXd shift;        // Mean of every variable in the first chunk
+    Eigen::MatrixXd cross;        // Z'Ys, (n_predictors + 1) x n_var
+    Eigen::VectorXd square_sums;  // Sum of Ys.^2 of every variable
+    Eigen::MatrixXd shifted;      // Chunk buffer, reused between chunks
+
+    ModelFit fit(const std::vector<int>& columns) const;
+};
+
+// Least squares fit from the Gram matrix. With Y = Ys + s, the residual of the ones
+// column r1 = 1'(I - P)1 links the sums of squares of Y and Ys; it vanishes when the
+// model spans an intercept, and the shifted sums are then used as they are.
+ModelFit StreamingGlm::Impl::fit(const std::vector<int>& columns) const {
+    const Eigen::Index k = static_cast<Eigen::Index>(columns.size());
+    const int ones = n_predictors;
+    const double n = n_observations;
+    Eigen::MatrixXd G(k, k);
+    Eigen::VectorXd z1(k);
+    Eigen::MatrixXd C(k, static_cast<Eigen::Index>(n_var));
+    for (Eigen::Index a = 0; a < k; a++) {
+        for (Eigen::Index b = 0; b < k; b++) {
+            G(a, b) = gram(columns[a], columns[b]);
+        }
+        z1(a) = gram(columns[a], ones);
+        C.row(a) = cross.row(columns[a]);
+    }
+
+    const Eigen::CompleteOrthogonalDecomposition<Eigen::MatrixXd> solver(G);
+    const Eigen::MatrixXd beta_shifted = solver.solve(C);
+    const Eigen::VectorXd b1 = solver.solve(z1);
+    const double r1 = n - z1.dot(b1);
+    const bool has_intercept = r1 <= 1e-10 * n;
+
+    ModelFit result;
+    result.beta.resize(k, static_cast<Eigen::Index>(n_var));
+    result.sse.resize(static_cast<Eigen::Index>(n_var));
+    result.ssr.resize(static_cast<Eigen::Index>(n_var));
+    for (Eigen::Index j = 0; j < static_cast<Eigen::Index>(n_var); j++) {
+        const double s = shift(j);
+        const double u = cross(ones, j);  // 1'Ys
+        double sse = square_sums(j) - C.col(j).dot(beta_shifted.col(j));
+        result.beta.col(j) = beta_shifted.col(j) + s * b1;
+        if (has_intercept) {
+            // Residuals and the fit around the mean do not depend on the shift
+            result.ssr(j) = square_sums(j) - u * u / n - sse;
+        } else {
+            sse += 2 * s * (u - z1.dot(beta_shifted.col(j))) + s * s * r1;
+            const double y_mean = s + u / n;
+            const double fitted_squares = (C.col(j) + s * z1).dot(result.beta.col(j));
+            const double fitted_sum = z1.dot(result.beta.col(j));
+            result.ssr(j) = fitted_squares - 2 * y_mean * fitted_sum + n * y_mean * y_mean;
+        }
+        result.sse(j) = std::max(sse, 0.0);
+    }
+    return result;
+}
+
+StreamingGlm::StreamingGlm(span<const double> X, int n_observations, int n_predictors, size_t n_var)
+    : impl_(new Impl) {
+    if (n_observations <= 0 || n_predictors <= 0 ||
+        X.size() != static_cast<size_t>(n_observations) * n_predictors) {
+        throw std::invalid_argument("X must be n_observations x n_predictors");
+    }
+    if (n_var == 0) {
+        throw std::invalid_argument("n_var must be positive");
+    }
+
+    Impl& glm = *impl_;
+    glm.n_observations = n_observations;
+    glm.n_predictors = n_predictors;
+    glm.n_var = n_var;
+    glm.Z.resize(n_observations, n_predictors + 1);
+    glm.Z.leftCols(n_predictors) = Eigen::Map<const Eigen::MatrixXd>(X.data(), n_observations, n_predictors);
+    glm.Z.col(n_predictors).setOnes();
+    glm.gram = glm.Z.transpose() * glm.Z;
+    glm.shift = Eigen::VectorXd::Zero(static_cast<Eigen::Index>(n_var));
+    glm.cross = Eigen::MatrixXd::Zero(n_predictors + 1, static_cast<Eigen::Index>(n_var));
+    glm.square_sums = Eigen::VectorXd::Zero(static_cast<Eigen::Index>(n_var));
+}
+
+StreamingGlm::~StreamingGlm() = default;
+StreamingGlm::StreamingGlm(StreamingGlm&&) noexcept = default;
+StreamingGlm& StreamingGlm::operator=(StreamingGlm&&) noexcept = default;
+
+size_t StreamingGlm::n_var() const { return impl_->n_var; }
+int StreamingGlm::n_observations() const { return impl_->n_observations; }
+int StreamingGlm::n_added() const { return impl_->n_added; }
+
+void StreamingGlm::add_observations(span<const double> y_chunk, int n_chunk) {
+    Impl& glm = *impl_;
+    if (n_chunk <= 0 || y_chunk.size() != glm.n_var * n_chunk) {
+        throw std::invalid_argument("y_chunk must be n_var x n_chunk");
+    }
+    if (glm.n_added + n_chunk > glm.n_observations) {
+        throw std::invalid_argument("More observations added than rows of X");
+    }
+
+    ScopedStage stage(Stage::GlmFit);
+    const Eigen::Index n_var = static_cast<Eigen::Index>(glm.n_var);
+    const Eigen::Map<const Eigen::MatrixXd> y(y_chunk.data(), n_var, n_chunk);
+    if (glm.n_added == 0) {
+        glm.shift = y.rowwise().mean();
+    }
+    if (glm.shifted.cols() < n_chunk) {
+        stage.add_bytes(y_chunk.size() * sizeof(double));
+    }
+    glm.shifted = y.colwise() - glm.shift;
+    glm.cross.noalias() += glm.Z.middleRows(glm.n_added, n_chunk).transpose() * glm.shifted.transpose();
+    glm.square_sums += glm.shifted.rowwise().squaredNorm();
+    glm.n_added += n_chunk;
+}
+
+void StreamingGlm::compute_test_stat(span<const double> contrast_in, GlmTest test,
+                                     const std::vector<int>& ind_nuisance, span<double> test_stat) const {
+    const Impl& glm = *impl_;
+    const int p = glm.n_predictors;
+    if (glm.n_added != glm.n_observations) {
+        throw std::logic_error("All observations must be added before computing statistics");
+    }
+    if (contrast_in.size() != static_cast<size_t>(p)) {
+        throw std::invalid_argument("contrast must have one entry per predictor");
+    }
+    if (test_stat.size() != glm.n_var) {
+        throw std::invalid_argument("test_stat must have one entry per variable");
+    }
+    for (int idx : ind_nuisance) {
+        if (idx < 0 || idx >= p) {
+            throw std::invalid_argument("ind_nuisance exceeds the number of predictors");
+        }
+    }
+
+    ScopedStage stage(Stage::GlmFit);
+    const Eigen::Map<const Eigen::VectorXd> contrast(contrast_in.data(), p);
+    const double dof = glm.n_observations - p;
+    std::vector<int> full(p);
+    for (int c = 0; c < p; c++) {
+        full[c] = c;
+    }
+    const ModelFit model = glm.fit(full);
+    Eigen::Map<Eigen::VectorXd> out(test_stat.data(), static_cast<Eigen::Index>(glm.n_var));
+
+    if (test == GlmTest::OneSample || test == GlmTest::TTest) {
+        const double contrast_term =
+            contrast.transpose() * glm.gram.topLeftCorner(p, p).inverse() * contrast;
+        for (Eigen::Index j = 0; j < out.size(); j++) {
+            double se = std::sqrt(model.sse(j) / dof * contrast_term);
+            if (se < 1e-15) se = 1e-15;
+            out(j) = contrast.dot(model.beta.col(j)) / se;
+        }
+    } else if (ind_nuisance.empty()) {
+        out = (model.ssr.array() / (p - 1)) / (model.sse.array() / dof);
+    } else {
+        // Reduced model of GlmDesign: intercept and nuisance, without the intercept if rank deficient
+        const int n_nuisance = static_cast<int>(ind_nuisance.size());
+        Eigen::MatrixXd X_new(glm.n_observations, n_nuisance + 1);
+        X_new.col(0) = glm.Z.col(p);
+        for (int i = 0; i < n_nuisance; i++) {
+            X_new.col(i + 1) = glm.Z.col(ind_nuisance[i]);
+        }
+        const int n_effects = static_cast<int>((contrast.array() != 0).count());
+        std::vector<int> reduced(ind_nuisance);
+        int v = n_effects;
+        if (Eigen::ColPivHouseholderQR<Eigen::MatrixXd>(X_new).rank() == n_nuisance + 1) {
+            reduced.insert(reduced.begin(), p);
+            v = n_effects - 1;
+        }
+        const ModelFit reduced_model = glm.fit(reduced);
+        out = ((model.ssr.array() - reduced_model.ssr.array()) / v) / (model.sse.array() / dof);
+    }
+
+    for (Eigen::Index j = 0; j < out.size(); j++) {
+        if (std::isnan(out(j))) {
+            out(j) = 0;
+        }
+    }
+}
+
+void stream_column_store(const MappedColumnStore& store, const std::vector<StreamingGlm*>& glms,
+                         size_t chunk_size) {
+    const StoreInfo& info = store.info();
+    if (chunk_size == 0) {
+        throw std::invalid_argument("chunk_size must be positive");
+    }
+    for (const StreamingGlm* glm : glms) {
+        if (glm->n_var() != info.n_rows || static_cast<uint64_t>(glm->n_observations()) != info.n_cols ||
+            glm->n_added() != 0) {
+            throw std::invalid_argument("The store must hold n_var x n_observations values of every GLM");
+        }
+    }
+
+    std::vector<uint64_t> columns;
+    std::vector<double> chunk;
+    for (uint64_t first = 0; first < info.n_cols; first += chunk_size) {
+        const uint64_t n_chunk = std::min<uint64_t>(chunk_size, info.n_cols - first);
+        columns.resize(n_chunk);
+        for (uint64_t c = 0; c < n_chunk; c++) {
+            columns[c] = first + c;
+        }
+        {
+            ScopedStage stage(Stage::Io);
+            if (chunk.size() < info.n_rows * n_chunk) {
+                stage.add_bytes((info.n_rows * n_chunk - chunk.size()) * sizeof(double));
+            }
+            chunk.resize(info.n_rows * n_chunk);
+            store.gather_columns(columns, chunk);
+        }
+        for (StreamingGlm* glm : glms) {
+            glm->add_observations(chunk, static_cast<int>(n_chunk));
+        }
+    }
+}
+
+}  // namespace prisme
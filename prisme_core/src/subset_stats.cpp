@@ -0,0 +1,199 @@
+/**
+ * subset_stats.cpp - t statistics of many subsampled repetitions from sufficient statistics
+ */
+
+#include "prisme/subset_stats.hpp"
+
+#include "prisme/stage_profile.hpp"
+
+#include <Eigen/Dense>
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+namespace prisme {
+
+namespace {
+
+// Variables per block: a block of the data, its squares and the sums of 500
+// repetitions stay within a few MB for 1000 subjects
+const size_t block_rows = 256;
+
+}  // namespace
+
+SubsetDesign parse_subset_design(const std::string& test_type) {
+    if (test_type == "t") {
+        return SubsetDesign::OneSample;
+    }
+    if (test_type == "pt") {
+        return SubsetDesign::Paired;
+    }
+    if (test_type == "t2") {
+        return SubsetDesign::TwoSample;
+    }
+    throw std::invalid_argument("Subset statistics support the 't', 'pt' and 't2' designs, not '" + test_type + "'");
+}
+
+void subset_t_stats(span<const double> Y, size_t n_var, span<const double> ids, size_t n_ids,
+                    SubsetDesign design, span<double> t_stats) {
+    if (n_ids == 0) {
+        throw std::invalid_argument("ids must be n_ids x n_reps");
+    }
+    const size_t n_per_group = design == SubsetDesign::OneSample ? n_ids : n_ids / 2;
+    const size_t size = n_per_group;
+    nested_subset_t_stats(Y, n_var, ids, n_ids, span<const size_t>(&size, 1), design, t_stats);
+}
+
+void nested_subset_t_stats(span<const double> Y, size_t n_var, span<const double> ids, size_t n_ids,
+                           span<const size_t> sizes, SubsetDesign design, span<double> t_stats) {
+    if (n_var == 0 || Y.size() % n_var != 0) {
+        throw std::invalid_argument("Y must be n_var x n_subjects");
+    }
+    if (n_ids == 0 || ids.size() % n_ids != 0) {
+        throw std::invalid_argument("ids must be n_ids x n_reps");
+    }
+    const size_t n_subjects = Y.size() / n_var;
+    const size_t n_reps = ids.size() / n_ids;
+    const size_t n_sizes = sizes.size();
+    if (t_stats.size() != n_var * n_sizes * n_reps) {
+        throw std::invalid_argument("t_stats must be n_var x n_sizes x n_reps");
+    }
+
+    const bool paired = design == SubsetDesign::Paired;
+    const bool two_sample = design == SubsetDesign::TwoSample;
+    if ((paired || two_sample) && n_ids % 2 != 0) {
+        throw std::invalid_argument("pt and t2 repetitions must have an even number of ids");
+    }
+    if (paired && n_subjects % 2 != 0) {
+        throw std::invalid_argument("pt data must hold both conditions of every subject");
+    }
+
+    // Paired sums run over the condition differences of the subjects
+    const size_t n_base = paired ? n_subjects / 2 : n_subjects;
+    const size_t n_per_group = paired || two_sample ? n_ids / 2 : n_ids;
+    const size_t n_groups = two_sample ? 2 : 1;
+    for (size_t k = 0; k < n_sizes; k++) {
+        if (sizes[k] == 0 || sizes[k] > n_per_group || (k > 0 && sizes[k] <= sizes[k - 1])) {
+            throw std::invalid_argument("sizes must increase and fit in the ids of a repetition");
+        }
+    }
+
+    ScopedStage stage(Stage::GlmFit);
+
+    // Selection matrix with one column per repetition, size and group. The column of
+    // size k only holds the subjects added since size k - 1, every subject enters once
+    auto column = [n_sizes, n_groups](size_t r, size_t k, size_t group) {
+        return static_cast<Eigen::Index>((r * n_sizes + k) * n_groups + group);
+    };
+    Eigen::MatrixXd selection = Eigen::MatrixXd::Zero(n_base, n_groups * n_sizes * n_reps);
+    for (size_t r = 0; r < n_reps; r++) {
+        const double* rep_ids = ids.data() + r * n_ids;
+        for (size_t group = 0; group < n_groups; group++) {
+            size_t k = 0;
+            for (size_t i = 0; i < sizes[n_sizes - 1]; i++) {
+                if (i >= sizes[k]) k++;
+                const double id = rep_ids[group * n_per_group + i];
+                if (id < 1 || id > static_cast<double>(n_base) || id != std::floor(id)) {
+                    throw std::invalid_argument("ids must be subject indices between 1 and the number of subjects");
+                }
+                if (paired && rep_ids[i + n_per_group] != id + static_cast<double>(n_base)) {
+                    throw std::invalid_argument("pt ids must list the second condition of the same subjects");
+                }
+                selection(static_cast<Eigen::Index>(id) - 1, column(r, k, group)) += 1;
+            }
+        }
+    }
+
+    // Sums of size k are the sums of size k - 1 plus the added subjects
+    auto accumulate_sizes = [&](Eigen::MatrixXd& sums) {
+        for (size_t r = 0; r < n_reps; r++) {
+            for (size_t k = 1; k < n_sizes; k++) {
+                for (size_t group = 0; group < n_groups; group++) {
+                    sums.col(column(r, k, group)) += sums.col(column(r, k - 1, group));
+                }
+            }
+        }
+    };
+    Eigen::MatrixXd counts = selection.colwise().sum();
+    accumulate_sizes(counts);
+
+    Eigen::MatrixXd block;
+    Eigen::MatrixXd squares;
+    Eigen::MatrixXd sums;
+    Eigen::MatrixXd square_sums;
+    stage.add_bytes((selection.size() + 2 * std::min(block_rows, n_var) * (n_base + selection.cols())) *
+                    sizeof(double));
+
+    for (size_t first = 0; first < n_var; first += block_rows) {
+        const size_t rows = std::min(block_rows, n_var - first);
+        block.resize(rows, n_base);
+        for (size_t s = 0; s < n_base; s++) {
+            const double* subject = Y.data() + s * n_var + first;
+            if (paired) {
+                const double* second = Y.data() + (s + n_base) * n_var + first;
+                for (size_t e = 0; e < rows; e++) {
+                    block(e, s) = subject[e] - second[e];
+                }
+            } else {
+                for (size_t e = 0; e < rows; e++) {
+                    block(e, s) = subject[e];
+                }
+            }
+        }
+
+        // Centered per variable, the mean is added back to the coefficient
+        const Eigen::VectorXd center = block.rowwise().mean();
+        block.colwise() -= center;
+        squares = block.array().square();
+        sums.noalias() = block * selection;
+        square_sums.noalias() = squares * selection;
+        if (n_sizes > 1) {
+            accumulate_sizes(sums);
+            accumulate_sizes(square_sums);
+        }
+
+        for (size_t r = 0; r < n_reps; r++) {
+            for (size_t k = 0; k < n_sizes; k++) {
+                double* out = t_stats.data() + (r * n_sizes + k) * n_var + first;
+                for (size_t e = 0; e < rows; e++) {
+                    double beta;
+                    double se;
+                    if (two_sample) {
+                        const Eigen::Index c1 = column(r, k, 0);
+                        const Eigen::Index c2 = column(r, k, 1);
+                        const double n1 = counts(0, c1);
+                        const double n2 = counts(0, c2);
+                        const double mean1 = sums(e, c1) / n1;
+                        const double mean2 = sums(e, c2) / n2;
+                        const double sse = square_sums(e, c1) - sums(e, c1) * mean1 + square_sums(e, c2) -
+                                           sums(e, c2) * mean2;
+                        const double mse = std::max(sse, 0.0) / (n1 + n2 - 2);
+                        beta = mean1 - mean2;
+                        se = std::sqrt(mse * (1 / n1 + 1 / n2));
+                    } else {
+                        const Eigen::Index c = column(r, k, 0);
+                        const double n = counts(0, c);
+                        const double mean = sums(e, c) / n;
+                        const double mse = std::max(square_sums(e, c) - sums(e, c) * mean, 0.0) / (n - 1);
+                        if (paired) {
+                            // Condition coefficient of the +-1 column: half the mean difference, with
+                            // half the variance of the differences as residual variance
+                            beta = (center(e) + mean) / 2;
+                            se = std::sqrt(mse / 2 / (2 * n));
+                        } else {
+                            beta = center(e) + mean;
+                            se = std::sqrt(mse / n);
+                        }
+                    }
+
+                    // Same guards as the GLM: se floor and NaN to zero
+                    const double t = beta / std::max(se, 1e-15);
+                    out[e] = std::isnan(t) ? 0 : t;
+                }
+            }
+        }
+    }
+}
+
+}  // namespace prisme
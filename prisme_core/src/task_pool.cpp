@@ -0,0 +1,148 @@
+/**
+ * task_pool.cpp - Work-stealing thread pool of the native runner
+ */
+
+#include "prisme/task_pool.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace prisme {
+
+namespace {
+
+// Pool and worker index of the calling thread, so tasks submit to their own deque
+thread_local const TaskPool* current_pool = nullptr;
+thread_local int current_worker = -1;
+
+}  // namespace
+
+TaskPool::TaskPool(int n_threads) {
+    if (n_threads < 0) {
+        throw std::invalid_argument("n_threads must not be negative");
+    }
+    if (n_threads == 0) {
+        n_threads = std::max(static_cast<int>(std::thread::hardware_concurrency()), 1);
+    }
+    for (int t = 0; t < n_threads; t++) {
+        workers_.emplace_back(new Worker());
+    }
+    for (int t = 0; t < n_threads; t++) {
+        threads_.emplace_back(&TaskPool::work, this, t);
+    }
+}
+
+TaskPool::~TaskPool() {
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        all_done_.wait(lock, [this] { return pending_ == 0; });
+        stop_ = true;
+    }
+    work_available_.notify_all();
+    for (std::thread& thread : threads_) {
+        thread.join();
+    }
+}
+
+void TaskPool::submit(Task task) {
+    pending_++;
+    if (current_pool == this) {
+        Worker& worker = *workers_[current_worker];
+        {
+            std::lock_guard<std::mutex> lock(worker.mutex);
+            worker.tasks.push_back(std::move(task));
+            queued_++;
+        }
+        // Orders the count before the check of a worker going to sleep
+        std::lock_guard<std::mutex> lock(mutex_);
+    } else {
+        std::lock_guard<std::mutex> lock(mutex_);
+        injected_.push_back(std::move(task));
+        queued_++;
+    }
+    work_available_.notify_one();
+}
+
+void TaskPool::wait() {
+    if (current_pool == this) {
+        throw std::logic_error("TaskPool::wait must not be called from a task");
+    }
+    std::unique_lock<std::mutex> lock(mutex_);
+    all_done_.wait(lock, [this] { return pending_ == 0; });
+    if (error_) {
+        std::exception_ptr error = error_;
+        error_ = nullptr;
+        failed_ = false;
+        std::rethrow_exception(error);
+    }
+}
+
+void TaskPool::work(int index) {
+    current_pool = this;
+    current_worker = index;
+    Task task;
+    while (true) {
+        if (take(index, task)) {
+            run(task);
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(mutex_);
+        work_available_.wait(lock, [this] { return stop_ || queued_ > 0; });
+        if (stop_ && queued_ == 0) {
+            return;
+        }
+    }
+}
+
+// Own deque newest first, then the oldest task of the other workers, then the
+// tasks submitted from outside
+bool TaskPool::take(int index, Task& task) {
+    const int n_workers = static_cast<int>(workers_.size());
+    for (int k = 0; k < n_workers; k++) {
+        Worker& worker = *workers_[(index + k) % n_workers];
+        std::lock_guard<std::mutex> lock(worker.mutex);
+        if (worker.tasks.empty()) {
+            continue;
+        }
+        if (k == 0) {
+            task = std::move(worker.tasks.back());
+            worker.tasks.pop_back();
+        } else {
+            task = std::move(worker.tasks.front());
+            worker.tasks.pop_front();
+        }
+        queued_--;
+        return true;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (injected_.empty()) {
+        return false;
+    }
+    task = std::move(injected_.front());
+    injected_.pop_front();
+    queued_--;
+    return true;
+}
+
+void TaskPool::run(Task& task) {
+    if (!failed_) {
+        try {
+            task();
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (!error_) {
+                error_ = std::current_exception();
+            }
+            failed_ = true;
+        }
+    }
+    // Captured state is released before wait returns
+    task = nullptr;
+    if (--pending_ == 0) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        all_done_.notify_all();
+    }
+}
+
+}  // namespace prisme
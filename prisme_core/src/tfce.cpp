@@ -0,0 +1,569 @@
+/**
+ * tfce.cpp - Threshold-free cluster enhancement of connectomes
+ */
+
+#include "prisme/tfce.hpp"
+
+#include "prisme/edge_index.hpp"
+#include "prisme/stage_profile.hpp"
+#include "prisme/workspace.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <queue>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace prisme {
+
+namespace {
+
+// Workspace slots of the TFCE variants
+enum IntSlot {
+    Labels, NextNode, LastNode, NodeSize, ClusterSize, LevelOffsets, LevelCursor, LevelEdges,
+    PositiveEdges, NegativeEdges
+};
+enum DoubleSlot { NodeTfce, EdgeValues, PositiveWeights, NegativeWeights };
+enum FlagSlot { NodeInactive, ClusterActive };
+enum PowerSlot { Heights, Extents };  // (k dh)^H of each level, s^E of each cluster size
+
+void check_matrices(span<const double> img, span<double> tfced, int n_nodes) {
+    if (n_nodes < 0 || img.size() != static_cast<size_t>(n_nodes) * n_nodes) {
+        throw std::invalid_argument("Input must be a square matrix");
+    }
+    if (tfced.size() != img.size()) {
+        throw std::invalid_argument("Output must have the size of the input matrix");
+    }
+}
+
+// Values above 1000 are clipped to 100, as the MATLAB implementation does
+double clip(double value) {
+    return value > 1000 ? 100 : value;
+}
+
+// Clusters of the incremental and exact variants in the thread workspace. Cluster c
+// starts as node c and keeps its nodes in a linked list headed by c, so a merge
+// relabels the nodes of the smaller cluster and splices its list onto the larger one.
+struct Clusters {
+    int* label;
+    int* next;       // Next node of the cluster, -1 at the end
+    int* last;
+    int* node_size;
+    int* size;       // Number of edges
+
+    Clusters(Workspace& ws, int num_nodes)
+        : label(ws.ints(Labels, num_nodes)),
+          next(ws.ints(NextNode, num_nodes)),
+          last(ws.ints(LastNode, num_nodes)),
+          node_size(ws.ints(NodeSize, num_nodes)),
+          size(ws.ints(ClusterSize, num_nodes)) {
+        for (int n = 0; n < num_nodes; n++) {
+            label[n] = n;
+            next[n] = -1;
+            last[n] = n;
+            node_size[n] = 1;
+            size[n] = 0;
+        }
+    }
+
+    // Add edge (i, j), merging the smaller cluster into the larger one
+    void add_edge(int i, int j) {
+        const int cluster_i = label[i];
+        const int cluster_j = label[j];
+        if (cluster_i == cluster_j) {
+            size[cluster_i] += 1;
+            return;
+        }
+
+        int target_cluster = cluster_i;
+        int absorbed_cluster = cluster_j;
+        if (node_size[cluster_i] < node_size[cluster_j]) {
+            std::swap(target_cluster, absorbed_cluster);
+        }
+        for (int n = absorbed_cluster; n != -1; n = next[n]) {
+            label[n] = target_cluster;
+        }
+        next[last[target_cluster]] = absorbed_cluster;
+        last[target_cluster] = last[absorbed_cluster];
+        node_size[target_cluster] += node_size[absorbed_cluster];
+        size[target_cluster] += 1 + size[absorbed_cluster];
+    }
+};
+
+// Number of thresholds 0, dh, 2 dh, ... up to max_val + dh. Level k is k * dh, as the
+// MATLAB colon operator computes it, so edges on a boundary land on the same level
+// in every variant.
+int grid_size(double max_val, double dh) {
+    if (!(dh > 0)) {
+        throw std::invalid_argument("dh must be positive");
+    }
+    int num_thresh = 0;
+    while (num_thresh * dh <= max_val + dh) {
+        num_thresh++;
+    }
+    return num_thresh;
+}
+
+// Counting sort of edges by level: the edges of level h are
+// edges[offsets[h]], ..., edges[offsets[h + 1] - 1], in the order of level_of
+struct LevelBuckets {
+    const int* offsets;
+    const int* edges;
+};
+
+template <typename Visit>
+LevelBuckets bucket_by_level(Workspace& ws, int num_thresh, Visit visit_edges) {
+    int* offsets = ws.ints(LevelOffsets, static_cast<size_t>(num_thresh) + 1);
+    std::fill(offsets, offsets + num_thresh + 1, 0);
+    visit_edges([&](int level, int) { offsets[level + 1]++; });
+    for (int h = 0; h < num_thresh; h++) {
+        offsets[h + 1] += offsets[h];
+    }
+
+    int* cursor = ws.ints(LevelCursor, num_thresh);
+    std::copy(offsets, offsets + num_thresh, cursor);
+    int* edges = ws.ints(LevelEdges, offsets[num_thresh]);
+    visit_edges([&](int level, int edge) { edges[cursor[level]++] = edge; });
+    return {offsets, edges};
+}
+
+// Highest threshold level at which an edge of this weight is present. The small
+// perturbation keeps weights on a boundary (e.g. 0.3 with dh = 0.1) on their level.
+int edge_level(double weight, double dh) {
+    return static_cast<int>(std::floor(weight / dh + 1e-10));
+}
+
+// Incremental TFCE of the edges that visit_edges passes to visit(edge, weight). An
+// edge is an id that node_pair maps to its two nodes. write(edge, value) receives
+// the value of every edge present at a level above 0, other edges are left alone.
+// Both nodes of an edge share its cluster at every level up to the edge level, so
+// the value does not depend on the order of the pair.
+struct NodePair {
+    int row;
+    int col;
+};
+
+template <typename VisitEdges, typename GetNodePair, typename Write>
+void incremental_tfce(Workspace& ws, ScopedStage& stage, int num_nodes, double dh, double H, double E,
+                      VisitEdges visit_edges, GetNodePair node_pair, Write write) {
+    const size_t n = static_cast<size_t>(num_nodes);
+
+    double max_val = 0;
+    visit_edges([&](int, double weight) { max_val = std::max(max_val, clip(weight)); });
+    const int num_thresh = grid_size(max_val, dh);
+
+    // Edge introduction rounds
+    const LevelBuckets rounds = bucket_by_level(ws, num_thresh, [&](auto&& add) {
+        visit_edges([&](int edge, double weight) {
+            const double edge_weight = clip(weight);
+            if (edge_weight <= 0) {
+                return;
+            }
+            const int round_idx = edge_level(edge_weight, dh);
+            if (round_idx < num_thresh) {
+                add(round_idx, edge);
+            }
+        });
+    });
+
+    // Contribution of each node at each threshold, turned into running sums below
+    Clusters clusters(ws, num_nodes);
+    double* node_tfce = ws.doubles(NodeTfce, static_cast<size_t>(num_thresh) * n);
+    const double* heights = ws.powers(Heights, num_thresh, dh, H);
+    const double* extents = ws.powers(Extents, static_cast<size_t>(rounds.offsets[num_thresh]) + 1, 1.0, E);
+    std::fill(node_tfce, node_tfce + n, 0.0);
+    stage.add_bytes(ws.take_grown_bytes());
+
+    // Iterate over thresholds and incrementally merge clusters
+    for (int h = num_thresh - 1; h >= 1; h--) {
+        for (int k = rounds.offsets[h]; k < rounds.offsets[h + 1]; k++) {
+            const NodePair pair = node_pair(rounds.edges[k]);
+            clusters.add_edge(pair.row, pair.col);
+        }
+
+        double* row = node_tfce + h * n;
+        for (int node = 0; node < num_nodes; node++) {
+            row[node] = extents[clusters.size[clusters.label[node]]] * heights[h] * dh;
+        }
+    }
+
+    // Accumulate the TFCE contributions from the lowest threshold up
+    for (int h = 1; h < num_thresh; h++) {
+        for (size_t node = 0; node < n; node++) {
+            node_tfce[h * n + node] = node_tfce[(h - 1) * n + node] + node_tfce[h * n + node];
+        }
+    }
+
+    for (int h = 1; h < num_thresh; h++) {
+        for (int k = rounds.offsets[h]; k < rounds.offsets[h + 1]; k++) {
+            write(rounds.edges[k], node_tfce[h * n + node_pair(rounds.edges[k]).row]);
+        }
+    }
+}
+
+// Connected components of the edges present at a level, cluster edge count of each node
+void find_connected_components(const std::vector<int>& levels, int n, int level,
+                               std::vector<int>& cluster_size_per_node) {
+    std::vector<bool> visited(n, false);
+    std::fill(cluster_size_per_node.begin(), cluster_size_per_node.end(), 0);
+
+    for (int start = 0; start < n; ++start) {
+        if (visited[start]) continue;
+
+        std::queue<int> q;
+        std::vector<int> component;
+        q.push(start);
+        visited[start] = true;
+        component.push_back(start);
+
+        int edge_count = 0;
+        while (!q.empty()) {
+            int node = q.front();
+            q.pop();
+
+            for (int neighbor = 0; neighbor < n; ++neighbor) {
+                if (levels[static_cast<size_t>(neighbor) * n + node] >= level) {
+                    // Count this edge (only upper triangle to avoid double counting)
+                    if (node < neighbor) {
+                        edge_count++;
+                    }
+                    if (!visited[neighbor]) {
+                        visited[neighbor] = true;
+                        q.push(neighbor);
+                        component.push_back(neighbor);
+                    }
+                }
+            }
+        }
+
+        for (int node : component) {
+            cluster_size_per_node[node] = edge_count;
+        }
+    }
+}
+
+// Clipped copy with a zero diagonal, used by the reference variant
+std::vector<double> preprocess(span<const double> img, int num_nodes) {
+    std::vector<double> work(img.begin(), img.end());
+    for (double& value : work) {
+        value = clip(value);
+    }
+    for (int i = 0; i < num_nodes; i++) {
+        work[static_cast<size_t>(i) * num_nodes + i] = 0;
+    }
+    return work;
+}
+
+}  // namespace
+
+void apply_tfce(span<const double> img, int num_nodes, double dh, double H, double E, span<double> tfced) {
+    check_matrices(img, tfced, num_nodes);
+    ScopedStage stage(Stage::ClusterFinding);
+    const size_t n = static_cast<size_t>(num_nodes);
+
+    // Edge i + j * n of the upper triangle, the diagonal is ignored
+    std::fill(tfced.begin(), tfced.end(), 0.0);
+    incremental_tfce(
+        thread_workspace(), stage, num_nodes, dh, H, E,
+        [&](auto&& visit) {
+            for (int i = 0; i < num_nodes; i++) {
+                for (int j = i + 1; j < num_nodes; j++) {
+                    visit(static_cast<int>(i + j * n), img[i + j * n]);
+                }
+            }
+        },
+        [&](int edge) { return NodePair{edge % num_nodes, edge / num_nodes}; },
+        [&](int edge, double value) {
+            const size_t row = edge % num_nodes;
+            const size_t col = edge / num_nodes;
+            tfced[row + col * n] = value;
+            tfced[col + row * n] = value;
+        });
+}
+
+void apply_tfce(span<const double> edge_values, const EdgeIndex& index, double dh, double H, double E,
+                span<double> tfced) {
+    const size_t n_edges = index.size();
+    if (n_edges == 0 ? !edge_values.empty() : edge_values.size() % n_edges != 0) {
+        throw std::invalid_argument("edge_values must have one row per mask variable");
+    }
+    if (tfced.size() != edge_values.size()) {
+        throw std::invalid_argument("Output must have the size of edge_values");
+    }
+    ScopedStage stage(Stage::ClusterFinding);
+    Workspace& ws = thread_workspace();
+    std::fill(tfced.begin(), tfced.end(), 0.0);
+
+    for (size_t offset = 0; offset < edge_values.size(); offset += n_edges) {
+        const double* values = edge_values.data() + offset;
+        double* out = tfced.data() + offset;
+        incremental_tfce(
+            ws, stage, index.n_nodes, dh, H, E,
+            [&](auto&& visit) {
+                for (size_t e = 0; e < n_edges; e++) {
+                    visit(static_cast<int>(e), values[e]);
+                }
+            },
+            [&](int edge) { return NodePair{index.rows[edge], index.cols[edge]}; },
+            [&](int edge, double value) { out[edge] = value; });
+    }
+}
+
+void apply_tfce_two_tailed(span<const double> edge_values, const EdgeIndex& index, double dh, double H, double E,
+                           span<double> tfced, span<double> tfced_neg) {
+    const size_t n_edges = index.size();
+    if (n_edges == 0 ? !edge_values.empty() : edge_values.size() % n_edges != 0) {
+        throw std::invalid_argument("edge_values must have one row per mask variable");
+    }
+    if (tfced.size() != edge_values.size() || tfced_neg.size() != edge_values.size()) {
+        throw std::invalid_argument("Outputs must have the size of edge_values");
+    }
+    ScopedStage stage(Stage::ClusterFinding);
+    Workspace& ws = thread_workspace();
+    std::fill(tfced.begin(), tfced.end(), 0.0);
+    std::fill(tfced_neg.begin(), tfced_neg.end(), 0.0);
+
+    int* positive_edges = ws.ints(PositiveEdges, n_edges);
+    int* negative_edges = ws.ints(NegativeEdges, n_edges);
+    double* positive_weights = ws.doubles(PositiveWeights, n_edges);
+    double* negative_weights = ws.doubles(NegativeWeights, n_edges);
+
+    for (size_t offset = 0; offset < edge_values.size(); offset += n_edges) {
+        // Only edges above 0 enter the TFCE of a tail, so one read of the column
+        // splits it into the edges of each sign
+        const double* values = edge_values.data() + offset;
+        int n_positive = 0;
+        int n_negative = 0;
+        for (size_t e = 0; e < n_edges; e++) {
+            if (values[e] > 0) {
+                positive_edges[n_positive] = static_cast<int>(e);
+                positive_weights[n_positive++] = values[e];
+            } else if (values[e] < 0) {
+                negative_edges[n_negative] = static_cast<int>(e);
+                negative_weights[n_negative++] = -values[e];
+            }
+        }
+
+        auto run_tail = [&](const int* edges, const double* weights, int n_tail, double* out) {
+            incremental_tfce(
+                ws, stage, index.n_nodes, dh, H, E,
+                [&](auto&& visit) {
+                    for (int k = 0; k < n_tail; k++) {
+                        visit(edges[k], weights[k]);
+                    }
+                },
+                [&](int edge) { return NodePair{index.rows[edge], index.cols[edge]}; },
+                [&](int edge, double value) { out[edge] = value; });
+        };
+        run_tail(positive_edges, positive_weights, n_positive, tfced.data() + offset);
+        run_tail(negative_edges, negative_weights, n_negative, tfced_neg.data() + offset);
+    }
+}
+
+void exact_tfce(span<const double> img, int num_nodes, double H, double E, span<double> tfce_res) {
+    check_matrices(img, tfce_res, num_nodes);
+    ScopedStage stage(Stage::ClusterFinding);
+    Workspace& ws = thread_workspace();
+    const size_t n = static_cast<size_t>(num_nodes);
+
+    // Positive edges of the upper triangle, sorted in descending order
+    int n_edges = 0;
+    for (size_t j = 0; j < n; j++) {
+        for (size_t i = 0; i < j; i++) {
+            n_edges += img[i + j * n] > 0;
+        }
+    }
+    int* sorted_edges = ws.ints(LevelEdges, n_edges);
+    double* values = ws.doubles(EdgeValues, n_edges);
+    int k = 0;
+    for (size_t j = 0; j < n; j++) {
+        for (size_t i = 0; i < j; i++) {
+            if (img[i + j * n] > 0) {
+                sorted_edges[k++] = static_cast<int>(i + j * n);
+            }
+        }
+    }
+    std::sort(sorted_edges, sorted_edges + n_edges, [&](int a, int b) {
+        return img[a] > img[b] || (img[a] == img[b] && a < b);
+    });
+    for (int idx = 0; idx < n_edges; idx++) {
+        values[idx] = img[sorted_edges[idx]];
+    }
+
+    Clusters clusters(ws, num_nodes);
+    const double* extents = ws.powers(Extents, static_cast<size_t>(n_edges) + 1, 1.0, E);
+    stage.add_bytes(ws.take_grown_bytes());
+    std::fill(tfce_res.begin(), tfce_res.end(), 0.0);
+
+    // Introduce edges from the strongest down, integrating each cluster from the
+    // current value to the next smaller one (0 after the weakest edge). The edges
+    // added so far are the active ones.
+    for (int idx = 0; idx < n_edges; idx++) {
+        clusters.add_edge(sorted_edges[idx] % num_nodes, sorted_edges[idx] / num_nodes);
+
+        const double th_current = values[idx];
+        const double th_next = idx + 1 < n_edges ? values[idx + 1] : 0.0;
+        const double height_diff = std::pow(th_current, H + 1) - std::pow(th_next, H + 1);
+        if (height_diff == 0) {
+            continue;  // Tied values, the last edge of the tie integrates the interval
+        }
+
+        for (int active = 0; active <= idx; active++) {
+            const size_t row = sorted_edges[active] % num_nodes;
+            const size_t col = sorted_edges[active] / num_nodes;
+            const double contribution = extents[clusters.size[clusters.label[row]]] * height_diff / (H + 1);
+            tfce_res[row + col * n] += contribution;
+            tfce_res[col + row * n] += contribution;
+        }
+    }
+}
+
+void traditional_tfce(span<const double> img_in, int n, double H, double E, double dh, span<double> tfced) {
+    check_matrices(img_in, tfced, n);
+    ScopedStage stage(Stage::ClusterFinding);
+    const std::vector<double> img = preprocess(img_in, n);
+    const size_t N = static_cast<size_t>(n);
+    stage.add_bytes(img.size() * sizeof(double));
+
+    double max_val = 0.0;
+    for (size_t j = 0; j < N; ++j) {
+        for (size_t i = 0; i < j; ++i) {
+            max_val = std::max(max_val, img[i + j * N]);
+        }
+    }
+
+    // Same thresholds and edge levels as apply_tfce
+    const int num_thresh = grid_size(max_val, dh);
+    std::vector<int> levels(img.size());
+    for (size_t k = 0; k < img.size(); ++k) {
+        levels[k] = img[k] > 0 ? edge_level(img[k], dh) : 0;
+    }
+    stage.add_bytes(levels.size() * sizeof(int));
+    std::vector<int> cluster_size_per_node(n);
+    std::fill(tfced.begin(), tfced.end(), 0.0);
+
+    // For each threshold (skip index 0, matching Fast_TFCE)
+    for (int level = 1; level < num_thresh; ++level) {
+        double thresh = level * dh;
+        find_connected_components(levels, n, level, cluster_size_per_node);
+
+        for (size_t j = 0; j < N; ++j) {
+            for (size_t i = 0; i < j; ++i) {
+                if (levels[i + j * N] >= level && cluster_size_per_node[i] > 0) {
+                    double contribution = std::pow(cluster_size_per_node[i], E) * std::pow(thresh, H) * dh;
+                    tfced[i + j * N] += contribution;
+                    tfced[j + i * N] += contribution;
+                }
+            }
+        }
+    }
+}
+
+void sparse_tfce(span<const int> I, span<const int> J, span<const double> V, int num_nodes,
+                 double dh, double H, double E, span<double> node_tfce_values) {
+    if (I.size() != J.size() || I.size() != V.size()) {
+        throw std::invalid_argument("I, J and V must have the same number of elements");
+    }
+    if (num_nodes <= 0) {
+        throw std::invalid_argument("num_nodes must be positive");
+    }
+    if (node_tfce_values.size() != static_cast<size_t>(num_nodes)) {
+        throw std::invalid_argument("Output must have one entry per node");
+    }
+    ScopedStage stage(Stage::ClusterFinding);
+    std::fill(node_tfce_values.begin(), node_tfce_values.end(), 0.0);
+    const size_t nnz = V.size();
+    if (nnz == 0) {
+        return;
+    }
+    for (size_t idx = 0; idx < nnz; idx++) {
+        if (I[idx] < 0 || I[idx] >= num_nodes || J[idx] < 0 || J[idx] >= num_nodes) {
+            throw std::out_of_range("Edge index exceeds num_nodes");
+        }
+    }
+    Workspace& ws = thread_workspace();
+
+    double max_val = *std::max_element(V.begin(), V.end());
+    const int num_thresh = grid_size(max_val, dh);
+
+    // Edge introduction rounds
+    const LevelBuckets rounds = bucket_by_level(ws, num_thresh, [&](auto&& add) {
+        for (size_t idx = 0; idx < nnz; idx++) {
+            // Only one triangle to avoid duplicates, skip negative weights
+            if (I[idx] < J[idx] || V[idx] < 0) {
+                continue;
+            }
+            const int round_idx = edge_level(V[idx], dh);
+            if (round_idx < num_thresh) {
+                add(round_idx, static_cast<int>(idx));
+            }
+        }
+    });
+
+    // Clusters hold linked node lists headed by the cluster index, size counts active nodes
+    int* cluster_labels = ws.ints(Labels, num_nodes);
+    int* next_node = ws.ints(NextNode, num_nodes);
+    int* last_node = ws.ints(LastNode, num_nodes);
+    int* cluster_size = ws.ints(ClusterSize, num_nodes);
+    unsigned char* cluster_active = ws.flags(ClusterActive, num_nodes);
+    unsigned char* node_inactive = ws.flags(NodeInactive, num_nodes);
+    for (int node = 0; node < num_nodes; node++) {
+        cluster_labels[node] = node;
+        next_node[node] = -1;
+        last_node[node] = node;
+        cluster_size[node] = 0;
+        cluster_active[node] = 1;
+        node_inactive[node] = 1;
+    }
+    const double* heights = ws.powers(Heights, num_thresh, dh, H);
+    const double* extents = ws.powers(Extents, static_cast<size_t>(num_nodes) + 1, 1.0, E);
+    stage.add_bytes(ws.take_grown_bytes());
+
+    for (int h = num_thresh - 1; h >= 1; h--) {
+        for (int k = rounds.offsets[h]; k < rounds.offsets[h + 1]; k++) {
+            const int edge_idx = rounds.edges[k];
+            int i = I[edge_idx];
+            int j = J[edge_idx];
+
+            int cluster_i = cluster_labels[i];
+            int cluster_j = cluster_labels[j];
+
+            if (node_inactive[i]) {
+                cluster_size[cluster_i] += 1;
+                node_inactive[i] = 0;
+            }
+            if (node_inactive[j]) {
+                cluster_size[cluster_j] += 1;
+                node_inactive[j] = 0;
+            }
+
+            if (cluster_i != cluster_j) {
+                int target_cluster = cluster_i;
+                int absorbed_cluster = cluster_j;
+                if (cluster_size[cluster_i] < cluster_size[cluster_j]) {
+                    std::swap(target_cluster, absorbed_cluster);
+                }
+
+                for (int node_id = absorbed_cluster; node_id != -1; node_id = next_node[node_id]) {
+                    cluster_labels[node_id] = target_cluster;
+                }
+                next_node[last_node[target_cluster]] = absorbed_cluster;
+                last_node[target_cluster] = last_node[absorbed_cluster];
+                cluster_size[target_cluster] += cluster_size[absorbed_cluster];
+                cluster_active[absorbed_cluster] = 0;
+            }
+        }
+
+        for (int node_id = 0; node_id < num_nodes; node_id++) {
+            if (!node_inactive[node_id]) {
+                int cluster_id = cluster_labels[node_id];
+                if (cluster_active[cluster_id] && cluster_size[cluster_id] > 0) {
+                    node_tfce_values[node_id] += extents[cluster_size[cluster_id]] * heights[h] * dh;
+                }
+            }
+        }
+    }
+}
+
+}  // namespace prisme
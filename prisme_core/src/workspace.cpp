@@ -0,0 +1,76 @@
+/**
+ * workspace.cpp - Per-thread scratch buffers of the graph kernels
+ */
+
+#include "prisme/workspace.hpp"
+
+#include <cmath>
+
+namespace prisme {
+
+namespace {
+
+// A plain pointer, so a MEX file that installs its own workspace leaves no
+// thread-local destructor behind and can be unloaded
+thread_local Workspace* installed_workspace = nullptr;
+
+}  // namespace
+
+const double* Workspace::powers(size_t slot, size_t n, double step, double exponent) {
+    PowerTable& table = powers_[slot];
+    if (table.step != step || table.exponent != exponent) {
+        table.values.clear();
+        table.step = step;
+        table.exponent = exponent;
+    }
+    if (table.values.capacity() < n) {
+        grown_bytes_ += (n - table.values.capacity()) * sizeof(double);
+        table.values.reserve(n);
+    }
+    for (size_t k = table.values.size(); k < n; k++) {
+        table.values.push_back(std::pow(k * step, exponent));
+    }
+    return table.values.data();
+}
+
+size_t Workspace::capacity_bytes() const {
+    size_t bytes = 0;
+    for (size_t slot = 0; slot < n_slots; slot++) {
+        bytes += ints_[slot].capacity() * sizeof(int) + doubles_[slot].capacity() * sizeof(double) +
+                 flags_[slot].capacity();
+    }
+    for (const PowerTable& table : powers_) {
+        bytes += table.values.capacity() * sizeof(double);
+    }
+    return bytes;
+}
+
+void Workspace::release() {
+    for (size_t slot = 0; slot < n_slots; slot++) {
+        std::vector<int>().swap(ints_[slot]);
+        std::vector<double>().swap(doubles_[slot]);
+        std::vector<unsigned char>().swap(flags_[slot]);
+    }
+    for (PowerTable& table : powers_) {
+        table = PowerTable();
+    }
+    grown_bytes_ = 0;
+}
+
+Workspace& thread_workspace() {
+    if (installed_workspace != nullptr) {
+        return *installed_workspace;
+    }
+    thread_local Workspace workspace;
+    return workspace;
+}
+
+WorkspaceScope::WorkspaceScope(Workspace* workspace) : previous_(installed_workspace) {
+    installed_workspace = workspace;
+}
+
+WorkspaceScope::~WorkspaceScope() {
+    installed_workspace = previous_;
+}
+
+}  // namespace prisme
@@ -0,0 +1,161 @@
+/**
+ * test_cluster_size.cpp - Components, Size null distribution and p-values
+ */
+
+#include "prisme/cluster_size.hpp"
+#include "test_utils.hpp"
+
+#include <cstdint>
+#include <vector>
+
+namespace {
+
+// Symmetric N x N adjacency matrix with the given undirected edges
+std::vector<double> adjacency(int N, const std::vector<std::pair<int, int>>& edges) {
+    std::vector<double> adj(static_cast<size_t>(N) * N, 0.0);
+    for (const auto& edge : edges) {
+        adj[edge.first + edge.second * N] = 1;
+        adj[edge.second + edge.first * N] = 1;
+    }
+    return adj;
+}
+
+void test_components() {
+    // Triangle 0-1-2 (3 edges), pair 3-4 (1 edge), isolated node 5
+    std::vector<double> adj = adjacency(6, {{0, 1}, {1, 2}, {0, 2}, {3, 4}});
+    std::vector<prisme::Component> components = prisme::find_components(adj, 6);
+
+    CHECK(components.size() == 2);
+    CHECK_NEAR(components[0].size, 3, 0);
+    CHECK(components[0].nodes.size() == 3);
+    CHECK_NEAR(components[1].size, 1, 0);
+    CHECK(components[1].nodes.size() == 2);
+}
+
+void test_null_and_pvals() {
+    const int N = 6;
+    std::vector<double> adj = adjacency(N, {{0, 1}, {1, 2}, {0, 2}, {3, 4}});
+
+    // Null: an empty permutation (max size floored at 1), a 2 edge and a 4 edge component
+    std::vector<double> permuted;
+    for (const auto& perm : {adjacency(N, {}), adjacency(N, {{0, 5}, {5, 3}}),
+                             adjacency(N, {{0, 1}, {1, 2}, {2, 3}, {3, 4}})}) {
+        permuted.insert(permuted.end(), perm.begin(), perm.end());
+    }
+    std::vector<double> null_dist(3);
+    prisme::size_null_distribution(permuted, N, null_dist);
+    CHECK_NEAR(null_dist[0], 1, 0);
+    CHECK_NEAR(null_dist[1], 2, 0);
+    CHECK_NEAR(null_dist[2], 4, 0);
+
+    std::vector<double> pval(N * N);
+    prisme::size_pvals(adj, N, null_dist, pval);
+    // Triangle edges: 1 of 3 null maxima >= 3, pair edge: all 3 >= 1, no edge: 1
+    CHECK_NEAR(pval[0 + 1 * N], 1.0 / 3, 1e-15);
+    CHECK_NEAR(pval[2 + 0 * N], 1.0 / 3, 1e-15);
+    CHECK_NEAR(pval[3 + 4 * N], 1.0, 0);
+    CHECK_NEAR(pval[0 + 5 * N], 1.0, 0);
+
+    CHECK_THROWS(prisme::size_null_distribution(permuted, N, prisme::span<double>(null_dist.data(), 2)));
+}
+
+void test_edge_variables() {
+    // Upper triangle of 6 nodes, statistics above 3.1 on the triangle 0-1-2 and the pair 3-4
+    const int N = 6;
+    const double thresh = 3.1;
+    std::vector<uint64_t> linear_index;
+    for (int j = 0; j < N; j++) {
+        for (int i = 0; i < j; i++) {
+            linear_index.push_back(i + j * N);
+        }
+    }
+    const prisme::EdgeIndex index = prisme::make_edge_index(linear_index, N);
+    auto edge_stats = [&](const std::vector<std::pair<int, int>>& edges) {
+        std::vector<double> stats(index.size(), 1.0);
+        for (const auto& edge : edges) {
+            for (size_t e = 0; e < index.size(); e++) {
+                if (index.rows[e] == edge.first && index.cols[e] == edge.second) {
+                    stats[e] = 4.0;
+                }
+            }
+        }
+        return stats;
+    };
+
+    std::vector<double> permuted;
+    for (const auto& perm : {edge_stats({}), edge_stats({{0, 5}, {3, 5}}),
+                             edge_stats({{0, 1}, {1, 2}, {2, 3}, {3, 4}})}) {
+        permuted.insert(permuted.end(), perm.begin(), perm.end());
+    }
+    std::vector<double> null_dist(3);
+    prisme::size_null_distribution(permuted, index, thresh, null_dist);
+    CHECK_NEAR(null_dist[0], 1, 0);
+    CHECK_NEAR(null_dist[1], 2, 0);
+    CHECK_NEAR(null_dist[2], 4, 0);
+
+    // Same p-values as the thresholded matrix
+    const std::vector<double> stats = edge_stats({{0, 1}, {1, 2}, {0, 2}, {3, 4}});
+    std::vector<double> pval(index.size());
+    prisme::size_pvals(stats, index, thresh, null_dist, pval);
+    std::vector<double> adj = adjacency(N, {{0, 1}, {1, 2}, {0, 2}, {3, 4}});
+    std::vector<double> matrix_pval(N * N);
+    prisme::size_pvals(adj, N, null_dist, matrix_pval);
+    std::vector<double> expected(index.size());
+    prisme::flatten_edges(matrix_pval, index, expected);
+    CHECK(pval == expected);
+
+    CHECK_THROWS(prisme::size_null_distribution(permuted, index, thresh,
+                                                prisme::span<double>(null_dist.data(), 2)));
+
+    // Two-tailed pass: the negated third permutation gives the negative tail the path 0-1-2-3-4
+    std::vector<double> mixed(permuted.begin(), permuted.begin() + 2 * index.size());
+    for (size_t e = 0; e < index.size(); e++) {
+        mixed.push_back(-permuted[2 * index.size() + e]);
+    }
+    std::vector<double> negated(mixed.size());
+    for (size_t i = 0; i < mixed.size(); i++) {
+        negated[i] = -mixed[i];
+    }
+    for (double t : {thresh, -0.5}) {
+        std::vector<double> expected(3);
+        std::vector<double> expected_neg(3);
+        prisme::size_null_distribution(mixed, index, t, expected);
+        prisme::size_null_distribution(negated, index, t, expected_neg);
+        std::vector<double> both(3);
+        std::vector<double> both_neg(3);
+        prisme::size_null_distribution_two_tailed(mixed, index, t, both, both_neg);
+        CHECK(both == expected);
+        CHECK(both_neg == expected_neg);
+    }
+    std::vector<double> null_neg(3);
+    prisme::size_null_distribution_two_tailed(mixed, index, thresh, null_dist, null_neg);
+    CHECK_NEAR(null_dist[2], 1, 0);
+    CHECK_NEAR(null_neg[2], 4, 0);
+    CHECK_THROWS(prisme::size_null_distribution_two_tailed(mixed, index, thresh, null_dist,
+                                                           prisme::span<double>(null_neg.data(), 2)));
+}
+
+void test_sparse_cluster_sizes() {
+    // Edges 0-1, 1-2 and 4-5 (both triangles listed as find() would), node 3 inactive
+    std::vector<int> rows = {1, 0, 2, 1, 5, 4};
+    std::vector<int> cols = {0, 1, 1, 2, 4, 5};
+    std::vector<double> sizes(6);
+    prisme::sparse_cluster_sizes(rows, cols, 6, sizes);
+
+    CHECK_NEAR(sizes[0], 3, 0);
+    CHECK_NEAR(sizes[1], 3, 0);
+    CHECK_NEAR(sizes[2], 3, 0);
+    CHECK_NEAR(sizes[3], 0, 0);
+    CHECK_NEAR(sizes[4], 2, 0);
+    CHECK_NEAR(sizes[5], 2, 0);
+}
+
+}  // namespace
+
+int main() {
+    test_components();
+    test_null_and_pvals();
+    test_edge_variables();
+    test_sparse_cluster_sizes();
+    return TEST_RESULT();
+}
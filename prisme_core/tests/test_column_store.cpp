@@ -0,0 +1,114 @@
+/**
+ * test_column_store.cpp - Column store round trips, gap filling, mapped stores and header checks
+ */
+
+#include "prisme/column_store.hpp"
+#include "test_utils.hpp"
+
+#include <cmath>
+#include <cstdio>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace {
+
+const std::string store_file = "test_column_store.pcol";
+
+void test_round_trip() {
+    prisme::create_column_store(store_file, 3, prisme::StoreClass::Double);
+    const std::vector<double> columns = {1, 2, 3, 4, 5, 6};
+    CHECK(prisme::write_store_columns(store_file, 0, columns.data(), 3, 2, prisme::StoreClass::Double, true) == 2);
+
+    // Writing past the end NaN fills the skipped columns
+    const std::vector<double> last = {7, 8, 9};
+    CHECK(prisme::write_store_columns(store_file, 3, last.data(), 3, 1, prisme::StoreClass::Double, false) == 4);
+
+    prisme::StoreInfo info;
+    const std::vector<double> values = prisme::read_column_store(store_file, info);
+    CHECK(info.n_rows == 3 && info.n_cols == 4);
+    const double nan = std::nan("");
+    const std::vector<double> expected = {1, 2, 3, 4, 5, 6, nan, nan, nan, 7, 8, 9};
+    CHECK(values.size() == expected.size());
+    for (size_t i = 0; i < values.size() && i < expected.size(); i++) {
+        CHECK(values[i] == expected[i] || (std::isnan(values[i]) && std::isnan(expected[i])));
+    }
+
+    std::vector<double> second(3);
+    prisme::read_store_columns(store_file, info, {1}, second.data());
+    CHECK_NEAR(second[0], 4, 0);
+    CHECK_NEAR(second[2], 6, 0);
+
+    // Rows and class must match the store
+    CHECK_THROWS(prisme::write_store_columns(store_file, 0, columns.data(), 2, 1, prisme::StoreClass::Double, true));
+    CHECK_THROWS(prisme::read_store_columns(store_file, info, {4}, second.data()));
+}
+
+void test_single_class() {
+    prisme::create_column_store(store_file, 2, prisme::StoreClass::Single);
+    const std::vector<float> columns = {0.5f, 1.5f};
+    prisme::write_store_columns(store_file, 0, columns.data(), 2, 1, prisme::StoreClass::Single, true);
+    CHECK_THROWS(prisme::write_store_columns(store_file, 0, columns.data(), 2, 1, prisme::StoreClass::Double, true));
+
+    prisme::StoreInfo info;
+    const std::vector<double> values = prisme::read_column_store(store_file, info);
+    CHECK(info.store_class == prisme::StoreClass::Single);
+    CHECK_NEAR(values[1], 1.5, 0);
+
+    // Skipped single columns are NaN too
+    prisme::write_store_columns(store_file, 2, columns.data(), 2, 1, prisme::StoreClass::Single, false);
+    const std::vector<double> gapped = prisme::read_column_store(store_file, info);
+    CHECK(info.n_cols == 3 && std::isnan(gapped[2]) && std::isnan(gapped[3]) && gapped[4] == 0.5);
+}
+
+void test_mapped_store() {
+    prisme::create_column_store(store_file, 3, prisme::StoreClass::Double);
+    const std::vector<double> columns = {1, 2, 3, 4, 5, 6, 7, 8, 9};
+    prisme::write_store_columns(store_file, 0, columns.data(), 3, 3, prisme::StoreClass::Double, true);
+
+    prisme::MappedColumnStore store(store_file);
+    CHECK(store.info().n_rows == 3 && store.info().n_cols == 3);
+    CHECK_NEAR(static_cast<const double*>(store.column(1))[2], 6, 0);
+
+    // Sampled columns in any order, repeats included
+    const std::vector<uint64_t> col_idx = {2, 0, 2};
+    std::vector<double> gathered(9);
+    store.gather_columns(col_idx, gathered);
+    CHECK(gathered == std::vector<double>({7, 8, 9, 1, 2, 3, 7, 8, 9}));
+    CHECK_THROWS(store.column(3));
+    std::vector<double> too_small(3);
+    CHECK_THROWS(store.gather_columns(col_idx, too_small));
+
+    // Moving keeps the mapping, the moved-from store is empty
+    prisme::MappedColumnStore moved(std::move(store));
+    CHECK_NEAR(static_cast<const double*>(moved.column(0))[0], 1, 0);
+    CHECK(store.info().n_cols == 0);
+
+    prisme::create_column_store(store_file, 2, prisme::StoreClass::Single);
+    const std::vector<float> single_columns = {0.5f, 1.5f, 2.5f, 3.5f};
+    prisme::write_store_columns(store_file, 0, single_columns.data(), 2, 2, prisme::StoreClass::Single, true);
+    prisme::MappedColumnStore single_store(store_file);
+    const std::vector<uint64_t> second = {1};
+    std::vector<double> converted(2);
+    single_store.gather_columns(second, converted);
+    CHECK(converted == std::vector<double>({2.5, 3.5}));
+}
+
+void test_not_a_store() {
+    std::FILE* file = std::fopen(store_file.c_str(), "wb");
+    std::fputs("not a column store, but long enough to hold a header of sixty-four bytes", file);
+    std::fclose(file);
+    CHECK_THROWS(prisme::read_column_store_info(store_file));
+    CHECK_THROWS(prisme::read_column_store_info("missing_store.pcol"));
+}
+
+}  // namespace
+
+int main() {
+    test_round_trip();
+    test_single_class();
+    test_mapped_store();
+    test_not_a_store();
+    std::remove(store_file.c_str());
+    return TEST_RESULT();
+}
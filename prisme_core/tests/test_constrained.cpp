@@ -0,0 +1,106 @@
+/**
+ * test_constrained.cpp - Network sums, exceedance counts and corrections
+ */
+
+#include "prisme/constrained.hpp"
+#include "test_utils.hpp"
+
+#include <vector>
+
+namespace {
+
+// Six edges in networks 1, 1, 2, 2, 0 (no network) and 3
+const std::vector<double> edge_stats = {2, 1, 0.5, 0.5, 9, -1};
+const std::vector<double> network_indices = {1, 1, 2, 2, 0, 3};
+
+// Two permutations (edges x permutations), network sums {1, 4, 0} and {3, 0, -2}
+const std::vector<double> permuted = {0.5, 0.5, 2, 2, 0, 0,
+                                      2, 1, 0, 0, 5, -2};
+
+void test_single_block() {
+    prisme::ConstrainedResult result = prisme::constrained_pvals(edge_stats, permuted, network_indices, 0.05);
+
+    // Observed sums {3, 1, -1}: exceedances {1, 1, 1}
+    CHECK(result.exceed_count.size() == 3);
+    CHECK_NEAR(result.exceed_count[0], 1, 0);
+    CHECK_NEAR(result.exceed_count[1], 1, 0);
+    CHECK_NEAR(result.exceed_count[2], 1, 0);
+    CHECK_NEAR(result.pvals_fwer[0], 1.0, 0);
+    CHECK_NEAR(result.pvals_fdr[0], 1.0, 0);
+}
+
+void test_blocks_chain() {
+    prisme::span<const double> all(permuted);
+    prisme::ConstrainedResult first = prisme::constrained_pvals(edge_stats, all.subspan(0, 6), network_indices, 0.05);
+    prisme::ConstrainedResult chained = prisme::constrained_pvals(edge_stats, all.subspan(6, 6), network_indices, 0.05,
+                                                                  first.exceed_count, 1);
+    prisme::ConstrainedResult whole = prisme::constrained_pvals(edge_stats, permuted, network_indices, 0.05);
+
+    for (size_t i = 0; i < whole.exceed_count.size(); i++) {
+        CHECK_NEAR(chained.exceed_count[i], whole.exceed_count[i], 0);
+        CHECK_NEAR(chained.pvals_fwer[i], whole.pvals_fwer[i], 0);
+    }
+
+    std::vector<double> wrong_prior = {0, 0};
+    CHECK_THROWS(prisme::constrained_pvals(edge_stats, permuted, network_indices, 0.05, wrong_prior, 1));
+}
+
+void test_two_tailed() {
+    std::vector<double> edge_stats_neg(edge_stats.size());
+    for (size_t e = 0; e < edge_stats.size(); e++) {
+        edge_stats_neg[e] = -edge_stats[e];
+    }
+    std::vector<double> permuted_neg(permuted.size());
+    for (size_t i = 0; i < permuted.size(); i++) {
+        permuted_neg[i] = -permuted[i];
+    }
+
+    // Chained over the two permutations as a stream, against each tail on its own
+    prisme::span<const double> all(permuted);
+    prisme::ConstrainedTwoTailed first =
+        prisme::constrained_pvals_two_tailed(edge_stats, all.subspan(0, 6), network_indices, 0.05);
+    prisme::ConstrainedTwoTailed both = prisme::constrained_pvals_two_tailed(
+        edge_stats, all.subspan(6, 6), network_indices, 0.05, first.positive.exceed_count,
+        first.negative.exceed_count, 1);
+    prisme::ConstrainedResult positive = prisme::constrained_pvals(edge_stats, permuted, network_indices, 0.05);
+    prisme::ConstrainedResult negative =
+        prisme::constrained_pvals(edge_stats_neg, permuted_neg, network_indices, 0.05);
+
+    // Negated sums {-1, -4, 0} and {-3, 0, 2} against {-3, -1, 1}
+    CHECK(both.positive.exceed_count == positive.exceed_count);
+    CHECK(both.negative.exceed_count == negative.exceed_count);
+    CHECK(both.negative.pvals_fwer == negative.pvals_fwer);
+    CHECK(both.negative.pvals_fdr == negative.pvals_fdr);
+    CHECK_NEAR(both.negative.exceed_count[0], 2, 0);
+    CHECK_NEAR(both.negative.exceed_count[2], 1, 0);
+
+    std::vector<double> wrong_prior = {0, 0};
+    CHECK_THROWS(prisme::constrained_pvals_two_tailed(edge_stats, permuted, network_indices, 0.05,
+                                                      first.positive.exceed_count, wrong_prior, 1));
+}
+
+void test_corrections() {
+    const std::vector<double> pvals = {0.01, 0.04, 0.03, 0.5};
+    std::vector<double> fwer(4);
+    std::vector<double> fdr(4);
+    prisme::fwer_correction(pvals, fwer);
+    prisme::fdr_correction(pvals, 0.05, fdr);
+
+    CHECK_NEAR(fwer[0], 0.04, 1e-15);
+    CHECK_NEAR(fwer[3], 1.0, 0);
+    // Sorted 0.01 <= 0.0125 passes, 0.03 > 0.025 stops the procedure
+    CHECK_NEAR(fdr[0], 0, 0);
+    CHECK_NEAR(fdr[1], 1, 0);
+    CHECK_NEAR(fdr[2], 1, 0);
+    CHECK_NEAR(fdr[3], 1, 0);
+}
+
+}  // namespace
+
+int main() {
+    test_single_block();
+    test_blocks_chain();
+    test_two_tailed();
+    test_corrections();
+    return TEST_RESULT();
+}
@@ -0,0 +1,524 @@
+/**
+ * test_differential.cpp - Randomized differential test of the kernels against references
+ *
+ * Every trial draws a random weighted graph whose weights mix ties, zeros, negative
+ * values, values on the dh grid (both k * dh and k / 10 with dh = 0.1), values above
+ * the 1000 clamp of the TFCE variants and continuous values, and compares each fast
+ * kernel with a direct reference implementation written for clarity:
+ *
+ *   find_components, size_null_distribution,  union-find over the edges, exact
+ *   size_pvals, sparse_cluster_sizes,
+ *   edge variable overloads
+ *   apply_tfce, traditional_tfce,            grid sum over the levels k * dh with the edge
+ *   apply_tfce of edge variables             level rule of tfce.hpp, relative 1e-9
+ *   exact_tfce                               integral over the distinct edge values, relative 1e-9
+ *   sparse_tfce                              grid sum over active node clusters, relative 1e-9
+ *   constrained_pvals                        brute-force network sums and Simes FDR as in
+ *                                            Constrained.m, block chaining, exact
+ *
+ * PRISME_DIFFERENTIAL_TRIALS (default 200) and PRISME_DIFFERENTIAL_SEED (default 1)
+ * scale the run, e.g. before merging a kernel optimization. A failing trial prints its
+ * seed, so it can be reproduced with PRISME_DIFFERENTIAL_SEED=<seed> and 1 trial.
+ * The edge variable overloads run on the upper triangle with random pair orientation.
+ */
+
+#include "prisme/cluster_size.hpp"
+#include "prisme/constrained.hpp"
+#include "prisme/edge_index.hpp"
+#include "prisme/tfce.hpp"
+#include "test_utils.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <map>
+#include <numeric>
+#include <random>
+#include <vector>
+
+namespace {
+
+const double tfce_rel_tol = 1e-9;
+
+uint64_t env_or(const char* name, uint64_t fallback) {
+    const char* value = std::getenv(name);
+    return value != nullptr && *value != '\0' ? std::strtoull(value, nullptr, 10) : fallback;
+}
+
+// Union-find with path halving
+struct DisjointSets {
+    std::vector<int> parent;
+
+    explicit DisjointSets(int n) : parent(n) { std::iota(parent.begin(), parent.end(), 0); }
+
+    int find(int x) {
+        while (parent[x] != x) {
+            parent[x] = parent[parent[x]];
+            x = parent[x];
+        }
+        return x;
+    }
+
+    void join(int a, int b) { parent[find(a)] = find(b); }
+};
+
+// Random weight of a connectome edge, see the file comment
+double random_weight(std::mt19937_64& rng) {
+    std::uniform_int_distribution<int> kind(0, 7);
+    std::uniform_int_distribution<int> step(1, 40);
+    std::uniform_real_distribution<double> continuous(0.0, 4.0);
+    static const double tie_pool[] = {0.5, 1.0, 1.7, 2.3};
+    switch (kind(rng)) {
+        case 0:
+            return 0.0;
+        case 1:
+            return -continuous(rng);
+        case 2:
+            return tie_pool[step(rng) % 4];
+        case 3:
+            return step(rng) * 0.1;
+        case 4:
+            return step(rng) / 10.0;
+        case 5:
+            return 1000.0 + step(rng) * 25.0;
+        default:
+            return continuous(rng);
+    }
+}
+
+// Symmetric N x N matrix, each pair present with the given density, occasional diagonal entries
+std::vector<double> random_connectome(std::mt19937_64& rng, int N, double density) {
+    std::bernoulli_distribution present(density);
+    std::bernoulli_distribution diagonal(0.1);
+    std::vector<double> img(static_cast<size_t>(N) * N, 0.0);
+    for (int j = 0; j < N; j++) {
+        for (int i = 0; i < j; i++) {
+            if (present(rng)) {
+                img[i + static_cast<size_t>(j) * N] = random_weight(rng);
+                img[j + static_cast<size_t>(i) * N] = img[i + static_cast<size_t>(j) * N];
+            }
+        }
+        if (diagonal(rng)) {
+            img[j + static_cast<size_t>(j) * N] = random_weight(rng);
+        }
+    }
+    return img;
+}
+
+std::vector<double> binarize(const std::vector<double>& img) {
+    std::vector<double> adj(img.size());
+    for (size_t k = 0; k < img.size(); k++) {
+        adj[k] = img[k] > 0 ? 1.0 : 0.0;
+    }
+    return adj;
+}
+
+// Every node pair as one variable, listed in the upper or lower triangle at random
+prisme::EdgeIndex random_edge_index(std::mt19937_64& rng, int N) {
+    std::vector<uint64_t> linear_index;
+    for (int j = 0; j < N; j++) {
+        for (int i = 0; i < j; i++) {
+            linear_index.push_back(rng() % 2 ? i + static_cast<uint64_t>(j) * N : j + static_cast<uint64_t>(i) * N);
+        }
+    }
+    return prisme::make_edge_index(linear_index, N);
+}
+
+std::vector<double> flatten(const std::vector<double>& matrix, const prisme::EdgeIndex& index) {
+    std::vector<double> flat(index.size());
+    prisme::flatten_edges(matrix, index, flat);
+    return flat;
+}
+
+double max_rel_error(const std::vector<double>& a, const std::vector<double>& b) {
+    double err = 0;
+    for (size_t k = 0; k < a.size(); k++) {
+        err = std::max(err, std::fabs(a[k] - b[k]) / std::max(1.0, std::fabs(b[k])));
+    }
+    return err;
+}
+
+// Component of each node and edge count of each component, over the off-diagonal
+// entries of adj that are positive
+struct ReferenceComponents {
+    std::vector<int> root;
+    std::map<int, double> edges;
+    std::map<int, int> nodes;
+};
+
+ReferenceComponents reference_components(const std::vector<double>& adj, int N) {
+    DisjointSets sets(N);
+    for (int j = 0; j < N; j++) {
+        for (int i = 0; i < j; i++) {
+            if (adj[i + static_cast<size_t>(j) * N] > 0) sets.join(i, j);
+        }
+    }
+    ReferenceComponents ref;
+    ref.root.resize(N);
+    for (int n = 0; n < N; n++) {
+        ref.root[n] = sets.find(n);
+        ref.nodes[ref.root[n]]++;
+    }
+    for (int j = 0; j < N; j++) {
+        for (int i = 0; i < j; i++) {
+            if (adj[i + static_cast<size_t>(j) * N] > 0) ref.edges[ref.root[i]] += 1;
+        }
+    }
+    return ref;
+}
+
+bool check_size(std::mt19937_64& rng, const std::vector<double>& img, int N) {
+    const std::vector<double> adj = binarize(img);
+    const ReferenceComponents ref = reference_components(adj, N);
+    bool ok = true;
+
+    // Components: same node sets and edge counts, isolated nodes skipped
+    std::vector<prisme::Component> components = prisme::find_components(adj, N);
+    size_t n_ref_components = 0;
+    for (const auto& entry : ref.nodes) {
+        n_ref_components += entry.second > 1 ? 1 : 0;
+    }
+    ok &= components.size() == n_ref_components;
+    for (const prisme::Component& component : components) {
+        const int root = ref.root[component.nodes[0]];
+        ok &= static_cast<int>(component.nodes.size()) == ref.nodes.at(root);
+        ok &= component.size == ref.edges.at(root);
+        for (int node : component.nodes) {
+            ok &= ref.root[node] == root;
+        }
+    }
+
+    // Null distribution of K random matrices: the largest edge count, at least 1
+    const int K = 5;
+    std::vector<double> permuted;
+    std::vector<double> ref_null(K);
+    for (int k = 0; k < K; k++) {
+        const std::vector<double> perm = binarize(random_connectome(rng, N, 0.3));
+        permuted.insert(permuted.end(), perm.begin(), perm.end());
+        const ReferenceComponents perm_ref = reference_components(perm, N);
+        ref_null[k] = 1;
+        for (const auto& entry : perm_ref.edges) {
+            ref_null[k] = std::max(ref_null[k], entry.second);
+        }
+    }
+    std::vector<double> null_dist(K);
+    prisme::size_null_distribution(permuted, N, null_dist);
+    ok &= null_dist == ref_null;
+
+    // P-values: share of the null reaching the size of the component of each edge
+    std::vector<double> pval(adj.size());
+    prisme::size_pvals(adj, N, null_dist, pval);
+    for (int j = 0; j < N; j++) {
+        for (int i = 0; i < N; i++) {
+            double expected = 1.0;
+            if (i != j && adj[i + static_cast<size_t>(j) * N] > 0) {
+                const double size = ref.edges.at(ref.root[i]);
+                expected = std::count_if(null_dist.begin(), null_dist.end(),
+                                         [&](double value) { return value >= size; }) /
+                           static_cast<double>(K);
+            }
+            ok &= pval[i + static_cast<size_t>(j) * N] == expected;
+        }
+    }
+
+    // Edge variables with thresh 0 give the same null distribution and p-values
+    const prisme::EdgeIndex index = random_edge_index(rng, N);
+    std::vector<double> permuted_flat;
+    for (int k = 0; k < K; k++) {
+        const std::vector<double> perm(permuted.begin() + k * adj.size(), permuted.begin() + (k + 1) * adj.size());
+        const std::vector<double> flat = flatten(perm, index);
+        permuted_flat.insert(permuted_flat.end(), flat.begin(), flat.end());
+    }
+    std::vector<double> flat_null(K);
+    prisme::size_null_distribution(permuted_flat, index, 0.0, flat_null);
+    ok &= flat_null == ref_null;
+    std::vector<double> flat_pval(index.size());
+    const std::vector<double> flat_stats = flatten(img, index);
+    prisme::size_pvals(flat_stats, index, 0.0, null_dist, flat_pval);
+    ok &= flat_pval == flatten(pval, index);
+
+    // Sparse clusters: node count of the cluster of each node that has an entry
+    std::vector<int> rows;
+    std::vector<int> cols;
+    DisjointSets sets(N);
+    std::vector<bool> active(N, false);
+    for (int j = 0; j < N; j++) {
+        for (int i = 0; i < N; i++) {
+            if (adj[i + static_cast<size_t>(j) * N] > 0) {
+                rows.push_back(i);
+                cols.push_back(j);
+                sets.join(i, j);
+                active[i] = active[j] = true;
+            }
+        }
+    }
+    std::vector<int> cluster_nodes(N, 0);
+    for (int n = 0; n < N; n++) {
+        if (active[n]) cluster_nodes[sets.find(n)]++;
+    }
+    std::vector<double> sizes(N);
+    prisme::sparse_cluster_sizes(rows, cols, N, sizes);
+    for (int n = 0; n < N; n++) {
+        ok &= sizes[n] == (active[n] ? cluster_nodes[sets.find(n)] : 0);
+    }
+    return ok;
+}
+
+// Grid level of an edge as documented in tfce.hpp
+int level(double weight, double dh) {
+    return static_cast<int>(std::floor(weight / dh + 1e-10));
+}
+
+// Edge TFCE on the grid k * dh: at every level, each present edge gets the edge count
+// of its component. Values above 1000 become 100 and the diagonal is ignored.
+std::vector<double> reference_grid_tfce(const std::vector<double>& img, int N, double dh, double H, double E) {
+    std::vector<int> levels(img.size(), 0);
+    int max_level = 0;
+    for (int j = 0; j < N; j++) {
+        for (int i = 0; i < j; i++) {
+            double w = img[i + static_cast<size_t>(j) * N];
+            w = w > 1000 ? 100 : w;
+            const int l = w > 0 ? level(w, dh) : 0;
+            levels[i + static_cast<size_t>(j) * N] = l;
+            max_level = std::max(max_level, l);
+        }
+    }
+
+    std::vector<double> tfced(img.size(), 0.0);
+    for (int h = 1; h <= max_level; h++) {
+        std::vector<double> present(img.size(), 0.0);
+        for (size_t k = 0; k < img.size(); k++) {
+            present[k] = levels[k] >= h ? 1.0 : 0.0;
+        }
+        const ReferenceComponents ref = reference_components(present, N);
+        for (int j = 0; j < N; j++) {
+            for (int i = 0; i < j; i++) {
+                if (present[i + static_cast<size_t>(j) * N] > 0) {
+                    const double contribution =
+                        std::pow(ref.edges.at(ref.root[i]), E) * std::pow(h * dh, H) * dh;
+                    tfced[i + static_cast<size_t>(j) * N] += contribution;
+                    tfced[j + static_cast<size_t>(i) * N] += contribution;
+                }
+            }
+        }
+    }
+    return tfced;
+}
+
+// Edge TFCE integrated exactly: between consecutive distinct positive values v > v'
+// (v' = 0 after the smallest) every edge >= v gets size^E (v^(H+1) - v'^(H+1)) / (H+1)
+std::vector<double> reference_exact_tfce(const std::vector<double>& img, int N, double H, double E) {
+    std::vector<double> values;
+    for (int j = 0; j < N; j++) {
+        for (int i = 0; i < j; i++) {
+            if (img[i + static_cast<size_t>(j) * N] > 0) values.push_back(img[i + static_cast<size_t>(j) * N]);
+        }
+    }
+    std::sort(values.begin(), values.end(), std::greater<double>());
+    values.erase(std::unique(values.begin(), values.end()), values.end());
+
+    std::vector<double> tfced(img.size(), 0.0);
+    for (size_t t = 0; t < values.size(); t++) {
+        const double next = t + 1 < values.size() ? values[t + 1] : 0.0;
+        const double height = (std::pow(values[t], H + 1) - std::pow(next, H + 1)) / (H + 1);
+        std::vector<double> present(img.size(), 0.0);
+        for (int j = 0; j < N; j++) {
+            for (int i = 0; i < j; i++) {
+                present[i + static_cast<size_t>(j) * N] = img[i + static_cast<size_t>(j) * N] >= values[t] ? 1 : 0;
+            }
+        }
+        const ReferenceComponents ref = reference_components(present, N);
+        for (int j = 0; j < N; j++) {
+            for (int i = 0; i < j; i++) {
+                if (present[i + static_cast<size_t>(j) * N] > 0) {
+                    const double contribution = std::pow(ref.edges.at(ref.root[i]), E) * height;
+                    tfced[i + static_cast<size_t>(j) * N] += contribution;
+                    tfced[j + static_cast<size_t>(i) * N] += contribution;
+                }
+            }
+        }
+    }
+    return tfced;
+}
+
+// Node TFCE of the entries with row >= col and a non-negative value: at every level,
+// each node with a present entry gets the number of such nodes in its cluster
+std::vector<double> reference_sparse_tfce(const std::vector<int>& rows, const std::vector<int>& cols,
+                                          const std::vector<double>& values, int N, double dh, double H,
+                                          double E) {
+    int max_level = 0;
+    for (size_t k = 0; k < values.size(); k++) {
+        if (rows[k] >= cols[k] && values[k] >= 0) max_level = std::max(max_level, level(values[k], dh));
+    }
+    std::vector<double> node_tfce(N, 0.0);
+    for (int h = 1; h <= max_level; h++) {
+        DisjointSets sets(N);
+        std::vector<bool> active(N, false);
+        for (size_t k = 0; k < values.size(); k++) {
+            if (rows[k] >= cols[k] && values[k] >= 0 && level(values[k], dh) >= h) {
+                sets.join(rows[k], cols[k]);
+                active[rows[k]] = active[cols[k]] = true;
+            }
+        }
+        std::vector<int> cluster_nodes(N, 0);
+        for (int n = 0; n < N; n++) {
+            if (active[n]) cluster_nodes[sets.find(n)]++;
+        }
+        for (int n = 0; n < N; n++) {
+            if (active[n]) node_tfce[n] += std::pow(cluster_nodes[sets.find(n)], E) * std::pow(h * dh, H) * dh;
+        }
+    }
+    return node_tfce;
+}
+
+bool check_tfce(std::mt19937_64& rng, const std::vector<double>& img, int N) {
+    static const double dhs[] = {0.1, 0.25, 0.05};
+    const double dh = dhs[rng() % 3];
+    const double H = (rng() % 2) ? 3.0 : 2.0;
+    const double E = (rng() % 2) ? 0.4 : 0.5;
+    bool ok = true;
+
+    const std::vector<double> grid = reference_grid_tfce(img, N, dh, H, E);
+    std::vector<double> tfced(img.size());
+    prisme::apply_tfce(img, N, dh, H, E, tfced);
+    ok &= max_rel_error(tfced, grid) <= tfce_rel_tol;
+    prisme::traditional_tfce(img, N, H, E, dh, tfced);
+    ok &= max_rel_error(tfced, grid) <= tfce_rel_tol;
+
+    const prisme::EdgeIndex index = random_edge_index(rng, N);
+    std::vector<double> flat_tfce(index.size());
+    const std::vector<double> flat_img = flatten(img, index);
+    prisme::apply_tfce(flat_img, index, dh, H, E, flat_tfce);
+    ok &= max_rel_error(flat_tfce, flatten(grid, index)) <= tfce_rel_tol;
+
+    prisme::exact_tfce(img, N, H, E, tfced);
+    ok &= max_rel_error(tfced, reference_exact_tfce(img, N, H, E)) <= tfce_rel_tol;
+
+    // Sparse entries of both triangles, the kernel keeps row >= col
+    std::vector<int> rows;
+    std::vector<int> cols;
+    std::vector<double> values;
+    for (int j = 0; j < N; j++) {
+        for (int i = 0; i < N; i++) {
+            if (img[i + static_cast<size_t>(j) * N] != 0) {
+                rows.push_back(i);
+                cols.push_back(j);
+                values.push_back(img[i + static_cast<size_t>(j) * N]);
+            }
+        }
+    }
+    std::vector<double> node_tfce(N);
+    prisme::sparse_tfce(rows, cols, values, N, dh, H, E, node_tfce);
+    ok &= max_rel_error(node_tfce, reference_sparse_tfce(rows, cols, values, N, dh, H, E)) <= tfce_rel_tol;
+    return ok;
+}
+
+bool check_constrained(std::mt19937_64& rng) {
+    // Dyadic statistics keep every network sum exact, so ties are compared exactly
+    std::uniform_int_distribution<int> n_edges_dist(1, 60);
+    std::uniform_int_distribution<int> stat_dist(-8, 8);
+    const int n_edges = n_edges_dist(rng);
+    const int n_perms = 1 + static_cast<int>(rng() % 40);
+    const int n_networks = 1 + static_cast<int>(rng() % 6);
+    const double alpha = 0.05 * (1 + rng() % 4);
+
+    std::vector<double> edge_stats(n_edges);
+    std::vector<double> network(n_edges);
+    for (int e = 0; e < n_edges; e++) {
+        edge_stats[e] = stat_dist(rng) * 0.25;
+        network[e] = static_cast<double>(rng() % (n_networks + 1));
+    }
+    std::vector<double> permuted(static_cast<size_t>(n_edges) * n_perms);
+    for (double& value : permuted) {
+        value = stat_dist(rng) * 0.25;
+    }
+
+    // Brute force: network sums of the observed and of every permutation
+    std::vector<int> networks;
+    for (double idx : network) {
+        if (idx > 0) networks.push_back(static_cast<int>(idx));
+    }
+    std::sort(networks.begin(), networks.end());
+    networks.erase(std::unique(networks.begin(), networks.end()), networks.end());
+    const size_t J = networks.size();
+    auto network_sum = [&](const double* stats, int idx) {
+        double sum = 0;
+        for (int e = 0; e < n_edges; e++) {
+            if (network[e] == idx) sum += stats[e];
+        }
+        return sum;
+    };
+    std::vector<double> count(J, 0.0);
+    std::vector<double> p_uncorr(J);
+    for (size_t i = 0; i < J; i++) {
+        const double observed = network_sum(edge_stats.data(), networks[i]);
+        for (int p = 0; p < n_perms; p++) {
+            count[i] += network_sum(permuted.data() + static_cast<size_t>(p) * n_edges, networks[i]) >= observed;
+        }
+        p_uncorr[i] = count[i] / n_perms;
+    }
+
+    // Bonferroni, and Simes as in Constrained.m: every sorted p-value at or below its threshold
+    std::vector<double> fwer(J);
+    std::vector<double> fdr(J, 1.0);
+    std::vector<size_t> order(J);
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return p_uncorr[a] < p_uncorr[b]; });
+    for (size_t k = 0; k < J; k++) {
+        fwer[k] = std::min(p_uncorr[k] * J, 1.0);
+        if (p_uncorr[order[k]] <= (k + 1.0) / J * alpha) fdr[order[k]] = 0.0;
+    }
+
+    bool ok = true;
+    const prisme::ConstrainedResult whole = prisme::constrained_pvals(edge_stats, permuted, network, alpha);
+    ok &= whole.exceed_count == count;
+    ok &= whole.pvals_fwer == fwer;
+    ok &= whole.pvals_fdr == fdr;
+
+    // A permutation stream in random blocks ends with the counts of the whole run
+    std::vector<double> prior;
+    double prior_perms = 0;
+    int done = 0;
+    while (done < n_perms) {
+        const int block = std::min(n_perms - done, 1 + static_cast<int>(rng() % 10));
+        const prisme::span<const double> block_perms(permuted.data() + static_cast<size_t>(done) * n_edges,
+                                                     static_cast<size_t>(block) * n_edges);
+        prior = prisme::constrained_pvals(edge_stats, block_perms, network, alpha, prior, prior_perms).exceed_count;
+        prior_perms += block;
+        done += block;
+    }
+    const prisme::ConstrainedResult chained =
+        prisme::constrained_pvals(edge_stats, prisme::span<const double>(), network, alpha, prior, prior_perms);
+    ok &= chained.exceed_count == whole.exceed_count;
+    ok &= chained.pvals_fwer == whole.pvals_fwer;
+    ok &= chained.pvals_fdr == whole.pvals_fdr;
+    return ok;
+}
+
+}  // namespace
+
+int main() {
+    const uint64_t n_trials = env_or("PRISME_DIFFERENTIAL_TRIALS", 200);
+    const uint64_t first_seed = env_or("PRISME_DIFFERENTIAL_SEED", 1);
+
+    for (uint64_t seed = first_seed; seed < first_seed + n_trials; seed++) {
+        std::mt19937_64 rng(seed);
+        const int N = 1 + static_cast<int>(rng() % 24);
+        const double density = std::uniform_real_distribution<double>(0.05, 0.6)(rng);
+        const std::vector<double> img = random_connectome(rng, N, density);
+
+        const bool size_ok = check_size(rng, img, N);
+        const bool tfce_ok = check_tfce(rng, img, N);
+        const bool constrained_ok = check_constrained(rng);
+        if (!size_ok || !tfce_ok || !constrained_ok) {
+            std::printf("Seed %llu (N = %d):%s%s%s\n", static_cast<unsigned long long>(seed), N,
+                        size_ok ? "" : " size", tfce_ok ? "" : " tfce", constrained_ok ? "" : " constrained");
+        }
+        CHECK(size_ok);
+        CHECK(tfce_ok);
+        CHECK(constrained_ok);
+    }
+
+    return TEST_RESULT();
+}
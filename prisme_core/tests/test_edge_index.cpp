@@ -0,0 +1,90 @@
+/**
+ * test_edge_index.cpp - Mask index tables and the unflatten/flatten round trip
+ */
+
+#include "prisme/edge_index.hpp"
+#include "test_utils.hpp"
+
+#include <cstdint>
+#include <vector>
+
+namespace {
+
+// 0-based linear indices of the upper triangle of an N x N mask, as find(triu(mask, 1)) - 1
+std::vector<uint64_t> upper_triangle(int N) {
+    std::vector<uint64_t> linear_index;
+    for (int j = 0; j < N; j++) {
+        for (int i = 0; i < j; i++) {
+            linear_index.push_back(static_cast<uint64_t>(i) + static_cast<uint64_t>(j) * N);
+        }
+    }
+    return linear_index;
+}
+
+void test_index() {
+    const int N = 4;
+    const std::vector<uint64_t> linear_index = upper_triangle(N);
+    const prisme::EdgeIndex index = prisme::make_edge_index(linear_index, N);
+    CHECK(index.size() == 6);
+    CHECK(index.n_nodes == N);
+    // Column-major order: (0,1), (0,2), (1,2), (0,3), ...
+    CHECK(index.rows[2] == 1 && index.cols[2] == 2);
+    CHECK(index.rows[5] == 2 && index.cols[5] == 3);
+
+    // Lower triangle entries keep their orientation
+    const std::vector<uint64_t> lower = {1 + 0 * N, 3 + 2 * N};
+    const prisme::EdgeIndex lower_index = prisme::make_edge_index(lower, N);
+    CHECK(lower_index.rows[1] == 3 && lower_index.cols[1] == 2);
+}
+
+void test_round_trip() {
+    const int N = 5;
+    const std::vector<uint64_t> linear_index = upper_triangle(N);
+    const prisme::EdgeIndex index = prisme::make_edge_index(linear_index, N);
+    std::vector<double> flat(index.size());
+    for (size_t e = 0; e < flat.size(); e++) {
+        flat[e] = 0.5 * static_cast<double>(e) - 1.0;
+    }
+
+    std::vector<double> matrix(N * N, 7.0);
+    prisme::unflatten_edges(flat, index, matrix);
+    for (size_t e = 0; e < flat.size(); e++) {
+        CHECK(matrix[index.rows[e] + index.cols[e] * N] == flat[e]);
+        CHECK(matrix[index.cols[e] + index.rows[e] * N] == flat[e]);
+    }
+    for (int node = 0; node < N; node++) {
+        CHECK(matrix[node + node * N] == 0.0);
+    }
+
+    std::vector<double> back(flat.size());
+    prisme::flatten_edges(matrix, index, back);
+    CHECK(back == flat);
+}
+
+void test_invalid_input() {
+    const int N = 3;
+    const std::vector<uint64_t> diagonal = {0, 1 + 2 * N};
+    CHECK_THROWS(prisme::make_edge_index(diagonal, N));
+    const std::vector<uint64_t> both_triangles = {0 + 1 * N, 1 + 0 * N};
+    CHECK_THROWS(prisme::make_edge_index(both_triangles, N));
+    const std::vector<uint64_t> outside = {N * N};
+    CHECK_THROWS(prisme::make_edge_index(outside, N));
+
+    const std::vector<uint64_t> linear_index = upper_triangle(N);
+    const prisme::EdgeIndex index = prisme::make_edge_index(linear_index, N);
+    std::vector<double> flat(2);
+    std::vector<double> matrix(N * N);
+    CHECK_THROWS(prisme::unflatten_edges(flat, index, matrix));
+    std::vector<double> small_matrix(4);
+    std::vector<double> full_flat(index.size());
+    CHECK_THROWS(prisme::flatten_edges(small_matrix, index, full_flat));
+}
+
+}  // namespace
+
+int main() {
+    test_index();
+    test_round_trip();
+    test_invalid_input();
+    return TEST_RESULT();
+}
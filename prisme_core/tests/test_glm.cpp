@@ -0,0 +1,310 @@
+/**
+ * test_glm.cpp - GLM statistics against closed forms and permutation reproducibility
+ */
+
+#include "prisme/glm.hpp"
+#include "test_utils.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+
+namespace {
+
+// n_observations x n_GLMs column-major matrix of normal draws
+std::vector<double> random_data(int n_observations, int n_GLMs, uint64_t seed) {
+    std::mt19937_64 rng(seed);
+    std::normal_distribution<double> normal(0.5, 1.0);
+    std::vector<double> y(static_cast<size_t>(n_observations) * n_GLMs);
+    for (double& value : y) {
+        value = normal(rng);
+    }
+    return y;
+}
+
+double mean(const double* x, int n) {
+    double sum = 0;
+    for (int i = 0; i < n; i++) sum += x[i];
+    return sum / n;
+}
+
+double sum_squares(const double* x, int n, double center) {
+    double sum = 0;
+    for (int i = 0; i < n; i++) sum += (x[i] - center) * (x[i] - center);
+    return sum;
+}
+
+void test_onesample() {
+    const int n = 20, n_GLMs = 5;
+    std::vector<double> X(n, 1.0);
+    std::vector<double> contrast = {1.0};
+    std::vector<double> y = random_data(n, n_GLMs, 1);
+
+    prisme::GlmDesign design(X, n, 1, contrast, prisme::GlmTest::OneSample);
+    std::vector<double> t(n_GLMs);
+    design.compute_test_stat(y, n_GLMs, t);
+
+    for (int g = 0; g < n_GLMs; g++) {
+        const double* column = y.data() + g * n;
+        double m = mean(column, n);
+        double sd = std::sqrt(sum_squares(column, n, m) / (n - 1));
+        CHECK_NEAR(t[g], m / (sd / std::sqrt(n)), 1e-9);
+    }
+}
+
+void test_two_sample_ttest() {
+    const int n1 = 8, n2 = 12, n = n1 + n2, n_GLMs = 3;
+    std::vector<double> X(2 * n, 0.0);
+    for (int i = 0; i < n; i++) {
+        X[i + (i < n1 ? 0 : n)] = 1.0;
+    }
+    std::vector<double> contrast = {1.0, -1.0};
+    std::vector<double> y = random_data(n, n_GLMs, 2);
+
+    prisme::GlmDesign design(X, n, 2, contrast, prisme::GlmTest::TTest);
+    std::vector<double> t(n_GLMs);
+    design.compute_test_stat(y, n_GLMs, t);
+
+    for (int g = 0; g < n_GLMs; g++) {
+        const double* column = y.data() + g * n;
+        double m1 = mean(column, n1);
+        double m2 = mean(column + n1, n2);
+        double pooled = (sum_squares(column, n1, m1) + sum_squares(column + n1, n2, m2)) / (n - 2);
+        CHECK_NEAR(t[g], (m1 - m2) / std::sqrt(pooled * (1.0 / n1 + 1.0 / n2)), 1e-9);
+    }
+}
+
+void test_ftest() {
+    const int n = 15, n_GLMs = 2;
+    std::vector<double> X(2 * n);
+    for (int i = 0; i < n; i++) {
+        X[i] = 1.0;
+        X[i + n] = i * 0.3 - 1;
+    }
+    std::vector<double> contrast = {0.0, 1.0};
+    std::vector<double> y = random_data(n, n_GLMs, 3);
+
+    prisme::GlmDesign design(X, n, 2, contrast, prisme::GlmTest::FTest);
+    std::vector<double> F(n_GLMs);
+    design.compute_test_stat(y, n_GLMs, F);
+
+    // Simple regression: F = r^2 (n - 2) / (1 - r^2)
+    const double* x = X.data() + n;
+    double mx = mean(x, n);
+    for (int g = 0; g < n_GLMs; g++) {
+        const double* column = y.data() + g * n;
+        double my = mean(column, n);
+        double sxy = 0;
+        for (int i = 0; i < n; i++) sxy += (x[i] - mx) * (column[i] - my);
+        double r2 = sxy * sxy / (sum_squares(x, n, mx) * sum_squares(column, n, my));
+        CHECK_NEAR(F[g], r2 * (n - 2) / (1 - r2), 1e-8);
+    }
+
+    // Partial F of one covariate against a reduced model with the intercept and a
+    // nuisance covariate is the square of its t statistic, large means included
+    std::vector<double> X3(3 * n);
+    std::vector<double> y3 = random_data(n, n_GLMs, 8);
+    for (int i = 0; i < n; i++) {
+        X3[i] = 1.0;
+        X3[i + n] = i * 0.3 - 1;
+        X3[i + 2 * n] = (i % 4) - 1.5;
+        y3[n + i] += 1e4;
+    }
+    const std::vector<double> tested = {1.0, 1.0, 0.0};
+    const std::vector<double> covariate = {0.0, 1.0, 0.0};
+    prisme::GlmDesign partial(X3, n, 3, tested, prisme::GlmTest::FTest, {2});
+    prisme::GlmDesign t_design(X3, n, 3, covariate, prisme::GlmTest::TTest);
+    std::vector<double> t(n_GLMs);
+    partial.compute_test_stat(y3, n_GLMs, F);
+    t_design.compute_test_stat(y3, n_GLMs, t);
+    for (int g = 0; g < n_GLMs; g++) {
+        CHECK_NEAR(F[g], t[g] * t[g], 1e-8 * std::max(1.0, F[g]));
+    }
+
+    // Effect degrees of freedom, which glm_and_perm_computation.m takes for fcdf
+    CHECK((design.f_effect_df() == std::vector<double>{1}));
+    CHECK((partial.f_effect_df() == std::vector<double>{1}));
+    CHECK_THROWS(t_design.f_effect_df());
+
+    // The intercept as nuisance makes [1, X(:, ind_nuisance)] rank deficient: the
+    // reduced model drops its ones and both slopes count, as the overall F-test
+    const std::vector<double> slopes = {0.0, 1.0, 1.0};
+    prisme::GlmDesign deficient(X3, n, 3, slopes, prisme::GlmTest::FTest, {0});
+    prisme::GlmDesign overall(X3, n, 3, slopes, prisme::GlmTest::FTest);
+    CHECK((deficient.f_effect_df() == std::vector<double>{2}));
+    CHECK((overall.f_effect_df() == std::vector<double>{2}));
+    std::vector<double> F_overall(n_GLMs);
+    deficient.compute_test_stat(y3, n_GLMs, F);
+    overall.compute_test_stat(y3, n_GLMs, F_overall);
+    for (int g = 0; g < n_GLMs; g++) {
+        CHECK_NEAR(F[g], F_overall[g], 1e-8 * std::max(1.0, F[g]));
+    }
+}
+
+void test_permutations() {
+    const int n = 10, n_GLMs = 4, n_perms = 6;
+    std::vector<double> X(n, 1.0);
+    std::vector<double> contrast = {1.0};
+    std::vector<double> y = random_data(n, n_GLMs, 4);
+    prisme::GlmDesign design(X, n, 1, contrast, prisme::GlmTest::OneSample);
+
+    std::vector<double> block_a(n_GLMs * n_perms);
+    std::vector<double> block_b(n_GLMs * n_perms);
+    std::vector<double> block_c(n_GLMs * n_perms);
+    design.generate_permutations(y, n_GLMs, n_perms, 42, block_a);
+    design.generate_permutations(y, n_GLMs, n_perms, 42, block_b);
+    design.generate_permutations(y, n_GLMs, n_perms, 43, block_c);
+
+    CHECK(block_a == block_b);
+    CHECK(block_a != block_c);
+
+    std::vector<double> wrong_size(n_GLMs);
+    CHECK_THROWS(design.generate_permutations(y, n_GLMs, n_perms, 42, wrong_size));
+    CHECK_THROWS(prisme::parse_glm_test("anova"));
+}
+
+void check_closed_form(const prisme::GlmDesign& design, const std::vector<double>& y, int n_GLMs) {
+    const int n_perms = 50;
+    CHECK(design.has_closed_form_permutations());
+    std::vector<double> expected(n_GLMs * n_perms * design.n_contrasts());
+    std::vector<double> closed_form(expected.size());
+    design.generate_permutations(y, n_GLMs, n_perms, 7, expected);
+    design.generate_closed_form_permutations(y, n_GLMs, n_perms, 7, closed_form);
+    for (size_t i = 0; i < expected.size(); i++) {
+        CHECK_NEAR(closed_form[i], expected[i], 1e-9 * std::max(1.0, std::fabs(expected[i])));
+    }
+}
+
+void test_closed_form_permutations() {
+    const int n = 16, n_GLMs = 6;
+    std::vector<double> y = random_data(n, n_GLMs, 5);
+    // A large mean on one GLM and a constant one
+    for (int i = 0; i < n; i++) {
+        y[n + i] += 1e4;
+        y[2 * n + i] = 3.0;
+    }
+
+    std::vector<double> ones(n, 1.0);
+    std::vector<double> one = {1.0};
+    check_closed_form(prisme::GlmDesign(ones, n, 1, one, prisme::GlmTest::OneSample), y, n_GLMs);
+
+    // Groups interleaved and of unequal size, both contrast signs
+    std::vector<double> X(2 * n, 0.0);
+    for (int i = 0; i < n; i++) {
+        X[i + (i % 3 == 0 ? 0 : n)] = 1.0;
+    }
+    std::vector<double> contrast = {1.0, -1.0};
+    std::vector<double> contrast_neg = {-1.0, 1.0};
+    check_closed_form(prisme::GlmDesign(X, n, 2, contrast, prisme::GlmTest::TTest), y, n_GLMs);
+    check_closed_form(prisme::GlmDesign(X, n, 2, contrast_neg, prisme::GlmTest::TTest), y, n_GLMs);
+    // Both signs and a weighted difference in one design, contrasts one per row
+    std::vector<double> three_contrasts = {1.0, -1.0, 1.0, -1.0, 1.0, -2.0};
+    check_closed_form(prisme::GlmDesign(X, n, 2, three_contrasts, prisme::GlmTest::TTest), y, n_GLMs);
+
+    // Correlation designs ('r'): score and intercept, shuffles and sign flips with or
+    // without the intercept as nuisance, both contrast signs
+    std::vector<double> score(2 * n);
+    for (int i = 0; i < n; i++) {
+        score[i] = std::sin(1.3 * i) + 0.1 * i;
+        score[i + n] = 1.0;
+    }
+    const std::vector<double> on_score = {1.0, 0.0};
+    const std::vector<double> both_signs = {1.0, -1.0, 0.0, 0.0};
+    check_closed_form(prisme::GlmDesign(score, n, 2, on_score, prisme::GlmTest::TTest), y, n_GLMs);
+    check_closed_form(prisme::GlmDesign(score, n, 2, both_signs, prisme::GlmTest::TTest, {1}), y, n_GLMs);
+    check_closed_form(prisme::GlmDesign(score, n, 2, on_score, prisme::GlmTest::OneSample), y, n_GLMs);
+    check_closed_form(prisme::GlmDesign(score, n, 2, both_signs, prisme::GlmTest::OneSample, {1}), y, n_GLMs);
+    const std::vector<double> on_intercept = {1.0, 1.0};
+    CHECK(!prisme::GlmDesign(score, n, 2, on_intercept, prisme::GlmTest::TTest).has_closed_form_permutations());
+
+    // Nuisance predictors are permuted with Freedman & Lane, which has no closed form
+    prisme::GlmDesign nuisance(X, n, 2, contrast, prisme::GlmTest::TTest, {1});
+    CHECK(!nuisance.has_closed_form_permutations());
+    std::vector<double> block(n_GLMs);
+    CHECK_THROWS(nuisance.generate_closed_form_permutations(y, n_GLMs, 1, 7, block));
+    prisme::GlmDesign ftest(X, n, 2, contrast, prisme::GlmTest::FTest);
+    CHECK(!ftest.has_closed_form_permutations());
+}
+
+// Statistics of a multi contrast design against one design per contrast
+void check_contrasts(const std::vector<double>& X, int n, int n_predictors, const std::vector<double>& contrasts,
+                     prisme::GlmTest test, const std::vector<int>& ind_nuisance, const std::vector<double>& y,
+                     int n_GLMs) {
+    const int n_perms = 7;
+    const int n_contrasts = static_cast<int>(contrasts.size()) / n_predictors;
+    prisme::GlmDesign design(X, n, n_predictors, contrasts, test, ind_nuisance);
+    CHECK(design.n_contrasts() == n_contrasts);
+    std::vector<double> stats(n_GLMs * n_contrasts);
+    std::vector<double> perms(n_GLMs * n_perms * n_contrasts);
+    design.compute_test_stat(y, n_GLMs, stats);
+    design.generate_permutations(y, n_GLMs, n_perms, 11, perms);
+
+    for (int c = 0; c < n_contrasts; c++) {
+        std::vector<double> contrast(n_predictors);
+        for (int p = 0; p < n_predictors; p++) {
+            contrast[p] = contrasts[p * n_contrasts + c];
+        }
+        prisme::GlmDesign single(X, n, n_predictors, contrast, test, ind_nuisance);
+        std::vector<double> expected(n_GLMs);
+        std::vector<double> expected_perms(n_GLMs * n_perms);
+        single.compute_test_stat(y, n_GLMs, expected);
+        single.generate_permutations(y, n_GLMs, n_perms, 11, expected_perms);
+        for (int g = 0; g < n_GLMs; g++) {
+            CHECK_NEAR(stats[c * n_GLMs + g], expected[g], 1e-12 * std::max(1.0, std::fabs(expected[g])));
+        }
+        for (int i = 0; i < n_GLMs * n_perms; i++) {
+            const double value = expected_perms[i];
+            CHECK_NEAR(perms[c * n_GLMs * n_perms + i], value, 1e-12 * std::max(1.0, std::fabs(value)));
+        }
+    }
+}
+
+void test_multiple_contrasts() {
+    const int n = 18, n_GLMs = 5;
+    std::vector<double> y = random_data(n, n_GLMs, 6);
+    std::vector<double> X(3 * n);
+    for (int i = 0; i < n; i++) {
+        X[i] = 1.0;
+        X[i + n] = i * 0.2 - 1;
+        X[i + 2 * n] = (i % 4) - 1.5;
+    }
+
+    // Rows [1 1 1], [1 -1 2] and [2 1 -1] without nuisance
+    const std::vector<double> contrasts = {1, 1, 2, 1, -1, 1, 1, 2, -1};
+    check_contrasts(X, n, 3, contrasts, prisme::GlmTest::TTest, {}, y, n_GLMs);
+    check_contrasts(X, n, 3, contrasts, prisme::GlmTest::FTest, {}, y, n_GLMs);
+    // Rows [0 1 0] and [0 -1 0] with the intercept and the covariate as nuisance
+    const std::vector<double> slope = {0, 0, 1, -1, 0, 0};
+    check_contrasts(X, n, 3, slope, prisme::GlmTest::TTest, {0, 2}, y, n_GLMs);
+    check_contrasts(X, n, 3, slope, prisme::GlmTest::FTest, {0, 2}, y, n_GLMs);
+    // Rows [0 1 1] and [0 2 -1] with the intercept as nuisance
+    const std::vector<double> slopes = {0, 0, 1, 2, 1, -1};
+    check_contrasts(X, n, 3, slopes, prisme::GlmTest::TTest, {0}, y, n_GLMs);
+    check_contrasts(X, n, 3, slopes, prisme::GlmTest::FTest, {0}, y, n_GLMs);
+
+    // Contrasts with different nuisance sets would share one nuisance fit and reduced model
+    const std::vector<double> mixed = {0, 0, 1, 1, 0, 1};
+    CHECK_THROWS(prisme::GlmDesign(X, n, 3, mixed, prisme::GlmTest::FTest, {0, 2}));
+    CHECK_THROWS(prisme::GlmDesign(X, n, 3, mixed, prisme::GlmTest::FTest, {0}));
+    CHECK_THROWS(prisme::GlmDesign(X, n, 3, mixed, prisme::GlmTest::TTest));
+    CHECK_THROWS(prisme::GlmDesign(X, n, 3, slope, prisme::GlmTest::TTest, {0}));
+
+    const std::vector<double> partial = {1, 0, 0, 1};
+    CHECK_THROWS(prisme::GlmDesign(X, n, 3, partial, prisme::GlmTest::TTest));
+    prisme::GlmDesign design(X, n, 3, contrasts, prisme::GlmTest::TTest);
+    std::vector<double> one_contrast(n_GLMs);
+    CHECK_THROWS(design.compute_test_stat(y, n_GLMs, one_contrast));
+}
+
+}  // namespace
+
+int main() {
+    test_onesample();
+    test_two_sample_ttest();
+    test_ftest();
+    test_permutations();
+    test_closed_form_permutations();
+    test_multiple_contrasts();
+    return TEST_RESULT();
+}
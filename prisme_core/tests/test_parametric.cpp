@@ -0,0 +1,57 @@
+/**
+ * test_parametric.cpp - t distribution against closed forms and BH adjusted p-values
+ */
+
+#include "prisme/parametric.hpp"
+#include "test_utils.hpp"
+
+#include <cmath>
+#include <vector>
+
+namespace {
+
+void test_t_cdf() {
+    const double pi = std::acos(-1.0);
+    // df = 1 is the Cauchy distribution, df = 2 has a closed form as well
+    for (double t : {-30.0, -2.5, -0.3, 0.0, 0.7, 4.0}) {
+        CHECK_NEAR(prisme::t_cdf(t, 1), 0.5 + std::atan(t) / pi, 1e-14);
+        CHECK_NEAR(prisme::t_cdf(t, 2), 0.5 + t / (2 * std::sqrt(2 + t * t)), 1e-14);
+    }
+    // Large df approaches the normal distribution
+    CHECK_NEAR(prisme::t_cdf(-1.96, 1e6), 0.5 * std::erfc(1.96 / std::sqrt(2.0)), 1e-6);
+    CHECK_NEAR(prisme::t_cdf(-INFINITY, 5), 0, 0);
+    CHECK(std::isnan(prisme::t_cdf(NAN, 5)));
+}
+
+void test_parametric_pvals() {
+    const std::vector<double> t = {-1, 0, 3};
+    std::vector<double> p(3);
+    // onesample with 3 observations: df = 2
+    prisme::parametric_pvals(t, prisme::GlmTest::OneSample, 3, p);
+    CHECK_NEAR(p[1], 0.5, 1e-15);
+    CHECK_NEAR(p[2], 0.5 - 3 / (2 * std::sqrt(11.0)), 1e-14);
+    // ttest with 3 observations: df = 1
+    prisme::parametric_pvals(t, prisme::GlmTest::TTest, 3, p);
+    CHECK_NEAR(p[0], 0.75, 1e-14);
+    CHECK_THROWS(prisme::parametric_pvals(t, prisme::GlmTest::FTest, 3, p));
+}
+
+void test_bh_fdr() {
+    const std::vector<double> p = {0.01, 0.04, 0.03, 0.5};
+    std::vector<double> fdr(4);
+    prisme::bh_fdr(p, fdr);
+    // Sorted p * m / k: 0.04, 0.06, 0.0533, 0.5 with the running minimum from the top
+    CHECK_NEAR(fdr[0], 0.04, 1e-15);
+    CHECK_NEAR(fdr[2], 0.16 / 3, 1e-15);
+    CHECK_NEAR(fdr[1], 0.16 / 3, 1e-15);
+    CHECK_NEAR(fdr[3], 0.5, 1e-15);
+}
+
+}  // namespace
+
+int main() {
+    test_t_cdf();
+    test_parametric_pvals();
+    test_bh_fdr();
+    return TEST_RESULT();
+}
@@ -0,0 +1,253 @@
+/**
+ * test_power_runner.cpp - Runner on a small exported study: config, methods and journal
+ */
+
+#include "prisme/column_store.hpp"
+#include "prisme/glm.hpp"
+#include "prisme/parametric.hpp"
+#include "prisme/power_runner.hpp"
+#include "prisme/result_journal.hpp"
+#include "test_utils.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <sys/stat.h>
+
+namespace {
+
+const std::string study_dir = "test_power_runner_study";
+const int n_nodes = 6;
+const int n_subjects = 20;
+const int n_observations = 8;
+const int n_repetitions = 4;
+
+void write_store(const std::string& name, const std::vector<double>& values, uint64_t n_rows) {
+    const std::string path = study_dir + "/" + name + ".pcol";
+    prisme::create_column_store(path, n_rows, prisme::StoreClass::Double);
+    prisme::write_store_columns(path, 0, values.data(), n_rows, values.size() / n_rows,
+                                prisme::StoreClass::Double, true);
+}
+
+// Upper triangle of a 6 node connectome, two networks and an effect in the first one
+void export_study() {
+    mkdir(study_dir.c_str(), 0755);
+
+    std::vector<double> mask;
+    std::vector<double> edge_groups;
+    for (int col = 0; col < n_nodes; col++) {
+        for (int row = 0; row < col; row++) {
+            mask.push_back(row + col * n_nodes + 1);
+            edge_groups.push_back(col < 3 ? 1 : (row >= 3 ? 2 : 0));
+        }
+    }
+    const size_t n_var = mask.size();
+
+    std::mt19937_64 rng(7);
+    std::normal_distribution<double> normal(0.0, 1.0);
+    std::vector<double> Y(n_var * n_subjects);
+    for (int s = 0; s < n_subjects; s++) {
+        for (size_t e = 0; e < n_var; e++) {
+            Y[s * n_var + e] = normal(rng) + (edge_groups[e] == 1 ? 1.5 : 0.0);
+        }
+    }
+
+    std::vector<double> ids;
+    for (int r = 0; r < n_repetitions; r++) {
+        std::vector<double> subjects;
+        for (int s = 1; s <= n_subjects; s++) subjects.push_back(s);
+        std::shuffle(subjects.begin(), subjects.end(), rng);
+        ids.insert(ids.end(), subjects.begin(), subjects.begin() + n_observations);
+    }
+
+    write_store("Y", Y, n_var);
+    write_store("X", std::vector<double>(n_observations, 1.0), n_observations);
+    write_store("mask", mask, n_var);
+    write_store("edge_groups", edge_groups, n_var);
+    write_store("ids_sampled", ids, n_observations);
+
+    std::ofstream cfg(study_dir + "/study.cfg");
+    cfg << "# Exported for the runner test\n"
+        << "test = onesample\n"
+        << "design = repetition\n"
+        << "contrast = 1\n"
+        << "n_nodes = " << n_nodes << "\n"
+        << "thresh = 2.0\n"
+        << "alpha = 0.05\n"
+        << "n_perms = 40\n"
+        << "permutation_block_size = 16\n"
+        << "n_repetitions = " << n_repetitions << "\n"
+        << "methods = Size_cpp, Fast_TFCE_cpp, Constrained_cpp_FWER, Constrained_cpp_FDR, "
+           "Parametric_FWER, Parametric_FDR\n"
+        << "existing.Size_cpp = 2\n"
+        << "journal_file = " << study_dir << "/results_journal.prj\n"
+        << "batch_size = 3\n"
+        << "seed = 11\n";
+}
+
+const prisme::MethodResult* find_result(const std::vector<prisme::MethodResult>& results, const std::string& name) {
+    for (const prisme::MethodResult& result : results) {
+        if (result.name == name) return &result;
+    }
+    return nullptr;
+}
+
+void test_config() {
+    const prisme::RunnerConfig config = prisme::read_runner_config(study_dir + "/study.cfg");
+    CHECK(config.methods.size() == 6);
+    CHECK(config.existing_repetitions.at("Size_cpp") == 2);
+    CHECK(config.permutation_block_size == 16);
+    CHECK_NEAR(config.thresh, 2.0, 0);
+    CHECK(!config.closed_form_permutations);
+
+    std::ofstream(study_dir + "/bad.cfg") << "methods = Size_cpp, Omnibus_cNBS\n";
+    CHECK_THROWS(prisme::read_runner_config(study_dir + "/bad.cfg"));
+    std::ofstream(study_dir + "/bad.cfg") << "n_perm = 10\n";
+    CHECK_THROWS(prisme::read_runner_config(study_dir + "/bad.cfg"));
+}
+
+void test_repetition() {
+    const prisme::RunnerConfig config = prisme::read_runner_config(study_dir + "/study.cfg");
+    const prisme::Study study = prisme::load_study(study_dir, config);
+    CHECK(study.n_var == 15);
+    CHECK(study.n_observations == n_observations);
+
+    // Size_cpp is only pending from repetition 3
+    const std::vector<prisme::MethodResult> first = prisme::run_repetition(study, config, 1);
+    CHECK(first.size() == 5);
+    CHECK(find_result(first, "Size_cpp") == nullptr);
+    prisme::StageProfile profile;
+    CHECK(prisme::run_repetition(study, config, 3, &profile).size() == 6);
+    CHECK(profile[prisme::Stage::Subsample].calls == 1);
+    CHECK(profile[prisme::Stage::PermutationGeneration].permutations == 40);
+    CHECK(profile[prisme::Stage::ClusterFinding].calls > 0);
+    CHECK(profile[prisme::Stage::NullConstruction].permutations > 0);
+    CHECK(profile[prisme::Stage::Pvalues].calls > 0);
+
+    const prisme::MethodResult* constrained = find_result(first, "Constrained_cpp_FWER");
+    CHECK(constrained && constrained->pvals.size() == 2 && constrained->pvals_neg.size() == 2);
+    const prisme::MethodResult* tfce = find_result(first, "Fast_TFCE_cpp");
+    CHECK(tfce && tfce->pvals.size() == study.n_var);
+
+    // Parametric against the GLM and t distribution directly
+    std::vector<double> y(n_observations * study.n_var);
+    for (int o = 0; o < n_observations; o++) {
+        const size_t subject = static_cast<size_t>(study.ids_sampled[o]) - 1;
+        for (size_t e = 0; e < study.n_var; e++) {
+            y[e * n_observations + o] = static_cast<const double*>(study.Y.column(subject))[e];
+        }
+    }
+    prisme::GlmDesign design(study.X, n_observations, 1, config.contrast, config.test);
+    std::vector<double> t(study.n_var);
+    design.compute_test_stat(y, static_cast<int>(study.n_var), t);
+    const prisme::MethodResult* parametric = find_result(first, "Parametric_FWER");
+    CHECK(parametric != nullptr);
+    for (size_t e = 0; parametric && e < study.n_var; e++) {
+        const double expected = std::min(prisme::t_cdf(-t[e], n_observations - 1) * study.n_var, 1.0);
+        CHECK_NEAR(parametric->pvals[e], expected, 1e-12);
+        const double expected_neg = std::min(prisme::t_cdf(t[e], n_observations - 1) * study.n_var, 1.0);
+        CHECK_NEAR(parametric->pvals_neg[e], expected_neg, 1e-12);
+    }
+
+    // Seeds depend on the repetition only
+    const std::vector<prisme::MethodResult> again = prisme::run_repetition(study, config, 1);
+    CHECK(find_result(again, "Fast_TFCE_cpp")->pvals == tfce->pvals);
+    CHECK_THROWS(prisme::run_repetition(study, config, n_repetitions + 1));
+
+    // Closed form blocks hold the same permutations
+    prisme::RunnerConfig closed_form_config = config;
+    closed_form_config.closed_form_permutations = true;
+    const std::vector<prisme::MethodResult> closed_form = prisme::run_repetition(study, closed_form_config, 1);
+    CHECK(find_result(closed_form, "Fast_TFCE_cpp")->pvals == tfce->pvals);
+    CHECK(find_result(closed_form, "Constrained_cpp_FWER")->pvals == constrained->pvals);
+}
+
+prisme::JournalSummary run_with_threads(int n_threads) {
+    prisme::RunnerConfig config = prisme::read_runner_config(study_dir + "/study.cfg");
+    config.n_threads = n_threads;
+    std::remove(config.journal_file.c_str());
+    const prisme::Study study = prisme::load_study(study_dir, config);
+    CHECK(prisme::run_power_repetitions(study, config) == n_repetitions);
+    return prisme::read_journal(config.journal_file);
+}
+
+void test_journal() {
+    const prisme::JournalSummary serial = run_with_threads(1);
+    const prisme::JournalSummary parallel = run_with_threads(3);
+
+    CHECK(serial.methods.size() == 6);
+    CHECK(serial.n_records == parallel.n_records);
+    for (size_t m = 0; m < serial.methods.size() && m < parallel.methods.size(); m++) {
+        const prisme::JournalMethodSummary& method = serial.methods[m];
+        CHECK(method.name == parallel.methods[m].name);
+        CHECK(method.positives == parallel.methods[m].positives);
+        CHECK(method.negatives == parallel.methods[m].negatives);
+        CHECK_NEAR(method.max_repetition, n_repetitions, 0);
+        CHECK_NEAR(method.total_calculations, method.name == "Size_cpp" ? 2 : n_repetitions, 0);
+    }
+
+    // The method tasks of the scheduler read the permutation stream of run_repetition
+    const prisme::RunnerConfig config = prisme::read_runner_config(study_dir + "/study.cfg");
+    const prisme::Study study = prisme::load_study(study_dir, config);
+    std::vector<std::vector<prisme::MethodResult>> repetitions;
+    for (int rep = 1; rep <= n_repetitions; rep++) {
+        repetitions.push_back(prisme::run_repetition(study, config, rep));
+    }
+    for (const prisme::JournalMethodSummary& method : parallel.methods) {
+        std::vector<double> positives(method.positives.size(), 0.0);
+        for (const std::vector<prisme::MethodResult>& results : repetitions) {
+            const prisme::MethodResult* result = find_result(results, method.name);
+            if (result == nullptr) continue;
+            std::vector<double> sig(result->pvals.size());
+            prisme::significance_indicator(result->pvals, config.alpha, sig);
+            for (size_t e = 0; e < sig.size() && e < positives.size(); e++) {
+                positives[e] += sig[e];
+            }
+        }
+        CHECK(positives == method.positives);
+    }
+
+    // A second run finds every repetition in the journal
+    CHECK(prisme::run_power_repetitions(study, config) == 0);
+    CHECK(prisme::read_journal(config.journal_file).n_records == parallel.n_records);
+}
+
+void test_stage_profile_file() {
+    prisme::RunnerConfig config = prisme::read_runner_config(study_dir + "/study.cfg");
+    // One worker finishes the repetitions in order, so the batches are fixed
+    config.n_threads = 1;
+    config.stage_profile_file = study_dir + "/results_stages.csv";
+    std::remove(config.journal_file.c_str());
+    std::remove(config.stage_profile_file.c_str());
+    const prisme::Study study = prisme::load_study(study_dir, config);
+    CHECK(prisme::run_power_repetitions(study, config) == n_repetitions);
+
+    // One block of rows per journaled batch of 3 repetitions
+    std::ifstream file(config.stage_profile_file);
+    std::string line;
+    std::getline(file, line);
+    CHECK(line.compare(0, 7, "source,") == 0);
+    int n_io_rows = 0;
+    int n_generation_rows = 0;
+    while (std::getline(file, line)) {
+        n_io_rows += line.find(",io,") != std::string::npos ? 1 : 0;
+        n_generation_rows += line.find(",permutation_generation,") != std::string::npos ? 1 : 0;
+    }
+    CHECK(n_io_rows == (n_repetitions + 2) / 3);
+    CHECK(n_generation_rows == n_io_rows);
+}
+
+}  // namespace
+
+int main() {
+    export_study();
+    test_config();
+    test_repetition();
+    test_journal();
+    test_stage_profile_file();
+    return TEST_RESULT();
+}
@@ -0,0 +1,146 @@
+/**
+ * test_result_cache.cpp - Content keys, cache round trips, torn entries and LRU eviction
+ */
+
+#include "prisme/result_cache.hpp"
+#include "test_utils.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+// Not the name of the test executable, which lives in the working directory
+const std::string cache_dir = (std::filesystem::temp_directory_path() / "prisme_result_cache_test").string();
+
+std::string key_of(const std::vector<double>& values, const std::string& text) {
+    prisme::ContentHash hash;
+    hash.update(values);
+    hash.update(text);
+    return hash.hex();
+}
+
+// Modification times order the entries, keep them apart on coarse file systems
+void wait_tick() { std::this_thread::sleep_for(std::chrono::milliseconds(20)); }
+
+void test_content_hash() {
+    const std::vector<double> ids = {3, 17, 4, 9};
+    const std::string key = key_of(ids, "t2");
+    CHECK(key.size() == 32);
+    CHECK(key == key_of(ids, "t2"));
+    CHECK(key != key_of(ids, "t"));
+    CHECK(key != key_of({3, 17, 4, 10}, "t2"));
+
+    // Strings are length prefixed, the split between them matters
+    prisme::ContentHash ab_c;
+    ab_c.update(std::string("ab"));
+    ab_c.update(std::string("c"));
+    prisme::ContentHash a_bc;
+    a_bc.update(std::string("a"));
+    a_bc.update(std::string("bc"));
+    CHECK(ab_c.hex() != a_bc.hex());
+
+    // Raw bytes hash the same however they are split between updates
+    const unsigned char bytes[19] = {1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16, 17, 18, 19};
+    prisme::ContentHash whole;
+    whole.update(bytes, sizeof(bytes));
+    prisme::ContentHash parts;
+    parts.update(bytes, 3);
+    parts.update(bytes + 3, 9);
+    parts.update(bytes + 12, 7);
+    CHECK(whole.hex() == parts.hex());
+    prisme::ContentHash shorter;
+    shorter.update(bytes, 18);
+    CHECK(whole.hex() != shorter.hex());
+}
+
+void test_round_trip() {
+    std::filesystem::remove_all(cache_dir);
+    prisme::ResultCache cache(cache_dir, 1 << 20);
+
+    const std::vector<double> block = {1.5, -2, 0, 4e10, -1e-300, 6};
+    const std::string key = key_of(block, "block");
+    prisme::CachedMatrix entry;
+    CHECK(!cache.get(key, entry));
+    cache.put(key, block, 3, 2);
+    CHECK(cache.get(key, entry));
+    CHECK(entry.n_rows == 3 && entry.n_cols == 2);
+    CHECK(entry.values == block);
+
+    // Replacing an entry keeps one file
+    const std::vector<double> edge_stats = {7, 8};
+    cache.put(key, edge_stats, 1, 2);
+    CHECK(cache.get(key, entry) && entry.values == edge_stats);
+    CHECK(cache.size_bytes() == std::filesystem::file_size(cache_dir + "/" + key + ".prc"));
+
+    // Empty results are entries too
+    const std::vector<double> none;
+    cache.put("0123abcd", none, 0, 0);
+    CHECK(cache.get("0123abcd", entry) && entry.values.empty());
+
+    CHECK_THROWS(cache.put(key, block, 2, 2));
+    CHECK_THROWS(cache.put("../escape", block, 3, 2));
+    CHECK_THROWS(cache.get("ABC", entry));
+    CHECK_THROWS(prisme::ResultCache(cache_dir, 0));
+}
+
+void test_torn_entry() {
+    prisme::ResultCache cache(cache_dir, 1 << 20);
+    const std::vector<double> values(100, 2.5);
+    const std::string key = key_of(values, "torn");
+    cache.put(key, values, 100, 1);
+
+    // A truncated or foreign file is a miss, not an error
+    const std::string path = cache_dir + "/" + key + ".prc";
+    std::filesystem::resize_file(path, std::filesystem::file_size(path) - 8);
+    prisme::CachedMatrix entry;
+    CHECK(!cache.get(key, entry));
+    std::FILE* file = std::fopen(path.c_str(), "wb");
+    std::fputs("not a cache entry", file);
+    std::fclose(file);
+    CHECK(!cache.get(key, entry));
+}
+
+void test_lru_eviction() {
+    std::filesystem::remove_all(cache_dir);
+    const std::vector<double> values(1000, 1.0);
+    const uint64_t entry_bytes = 32 + values.size() * sizeof(double);
+    prisme::ResultCache cache(cache_dir, 2 * entry_bytes + 100);
+
+    cache.put("aa", values, 1000, 1);
+    wait_tick();
+    cache.put("bb", values, 1000, 1);
+    wait_tick();
+
+    // Reading aa makes bb the least recently used entry
+    prisme::CachedMatrix entry;
+    CHECK(cache.get("aa", entry));
+    wait_tick();
+    cache.put("cc", values, 1000, 1);
+    CHECK(cache.get("aa", entry));
+    CHECK(!cache.get("bb", entry));
+    CHECK(cache.get("cc", entry));
+    CHECK(cache.size_bytes() == 2 * entry_bytes);
+
+    // Larger than the whole budget: not stored, nothing evicted
+    const std::vector<double> large(1000 * 3, 1.0);
+    cache.put("dd", large, 3000, 1);
+    CHECK(!cache.get("dd", entry));
+    CHECK(cache.get("aa", entry) && cache.get("cc", entry));
+
+    std::filesystem::remove_all(cache_dir);
+}
+
+}  // namespace
+
+int main() {
+    test_content_hash();
+    test_round_trip();
+    test_torn_entry();
+    test_lru_eviction();
+    return TEST_RESULT();
+}
@@ -0,0 +1,84 @@
+/**
+ * test_result_journal.cpp - Journal sums, duplicate repetitions, torn appends and resets
+ */
+
+#include "prisme/result_journal.hpp"
+#include "test_utils.hpp"
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+namespace {
+
+const std::string journal_file = "test_result_journal.prj";
+
+void add_record(std::vector<unsigned char>& batch, const std::string& method, uint32_t repetition, double time,
+                const std::vector<double>& positives, const std::vector<double>& negatives) {
+    prisme::encode_journal_record(batch, method, repetition, time, positives, negatives);
+}
+
+void test_append_and_read() {
+    std::remove(journal_file.c_str());
+
+    std::vector<unsigned char> batch;
+    add_record(batch, "Size_cpp", 1, 0.5, {1, 0, 1}, {0, 0, 1});
+    add_record(batch, "Size_cpp", 2, 0.25, {1, 1, 0}, {0, 0, 0});
+    prisme::append_journal_batch(journal_file, batch);
+
+    // Repetition 2 again: only the last record counts
+    batch.clear();
+    add_record(batch, "Size_cpp", 2, 0.75, {0, 0, 1}, {1, 0, 0});
+    add_record(batch, "Parametric_FWER", 2, 0.1, {1}, {0});
+    prisme::append_journal_batch(journal_file, batch);
+
+    const prisme::JournalSummary journal = prisme::read_journal(journal_file);
+    CHECK(journal.generation == 0);
+    CHECK(journal.n_records == 4);
+    CHECK(journal.methods.size() == 2);
+
+    const prisme::JournalMethodSummary& size = journal.methods[0];
+    CHECK(size.name == "Size_cpp");
+    CHECK((size.positives == std::vector<double>{1, 0, 2}));
+    CHECK((size.negatives == std::vector<double>{1, 0, 1}));
+    CHECK_NEAR(size.total_calculations, 2, 0);
+    CHECK_NEAR(size.total_time, 1.25, 1e-15);
+    CHECK_NEAR(size.max_repetition, 2, 0);
+
+    CHECK_THROWS(add_record(batch, "Size_cpp", 3, 0, {1}, {}));
+}
+
+void test_torn_append() {
+    const prisme::JournalSummary before = prisme::read_journal(journal_file);
+
+    // Bytes past the committed end (an interrupted append) are not part of the journal
+    std::FILE* file = std::fopen(journal_file.c_str(), "ab");
+    const unsigned char garbage[] = {40, 0, 0, 0, 1, 2, 3};
+    std::fwrite(garbage, 1, sizeof(garbage), file);
+    std::fclose(file);
+    CHECK(prisme::read_journal(journal_file).n_records == before.n_records);
+
+    // The next append overwrites them
+    std::vector<unsigned char> batch;
+    add_record(batch, "Size_cpp", 3, 0, {0, 1, 0}, {0, 0, 0});
+    prisme::append_journal_batch(journal_file, batch);
+    CHECK(prisme::read_journal(journal_file).n_records == before.n_records + 1);
+}
+
+void test_reset() {
+    prisme::reset_journal(journal_file);
+    const prisme::JournalSummary journal = prisme::read_journal(journal_file);
+    CHECK(journal.generation == 1);
+    CHECK(journal.n_records == 0);
+    CHECK(journal.methods.empty());
+}
+
+}  // namespace
+
+int main() {
+    test_append_and_read();
+    test_torn_append();
+    test_reset();
+    std::remove(journal_file.c_str());
+    return TEST_RESULT();
+}
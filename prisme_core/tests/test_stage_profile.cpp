@@ -0,0 +1,146 @@
+/**
+ * test_stage_profile.cpp - Nested stage timers, kernel instrumentation and profile files
+ */
+
+#include "prisme/cluster_size.hpp"
+#include "prisme/stage_profile.hpp"
+#include "test_utils.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+double now() {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void busy_wait(double seconds) {
+    const auto start = std::chrono::steady_clock::now();
+    while (std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() < seconds) {
+    }
+}
+
+void test_no_profile() {
+    // Without a ProfileScope the timers record nothing
+    prisme::ScopedStage stage(prisme::Stage::GlmFit, 10);
+    stage.add_bytes(100);
+    CHECK(true);
+}
+
+void test_nested_stages() {
+    // Each stage lies within the times taken around its scope
+    prisme::StageProfile profile;
+    double outer_start;
+    double outer_end;
+    double inner_start;
+    double inner_end;
+    {
+        prisme::ProfileScope scope(&profile);
+        outer_start = now();
+        {
+            prisme::ScopedStage outer(prisme::Stage::NullConstruction, 5);
+            busy_wait(0.01);
+            inner_start = now();
+            {
+                prisme::ScopedStage inner(prisme::Stage::ClusterFinding);
+                inner.add_bytes(64);
+                busy_wait(0.02);
+            }
+            inner_end = now();
+        }
+        outer_end = now();
+    }
+    const prisme::StageTotals& outer = profile[prisme::Stage::NullConstruction];
+    const prisme::StageTotals& inner = profile[prisme::Stage::ClusterFinding];
+    CHECK(outer.calls == 1 && inner.calls == 1);
+    CHECK(outer.permutations == 5 && inner.permutations == 0);
+    CHECK(inner.bytes_allocated == 64);
+
+    // The outer stage excludes the time of the inner one: both fit in the outer scope,
+    // whatever the load of the machine. Counting the inner time twice would exceed it
+    const double slack = 1e-9;
+    CHECK(inner.wall_time >= 0.02 && inner.wall_time <= inner_end - inner_start + slack);
+    CHECK(outer.wall_time >= 0.01);
+    CHECK(outer.wall_time + inner.wall_time <= outer_end - outer_start + slack);
+    CHECK(inner.cpu_time > 0);
+
+    // Scopes restore the previous target
+    {
+        prisme::ScopedStage after(prisme::Stage::Io);
+    }
+    CHECK(profile[prisme::Stage::Io].calls == 0);
+}
+
+void test_kernel_stages() {
+    const int N = 4;
+    std::vector<double> adj(N * N, 0.0);
+    adj[0 + 1 * N] = adj[1 + 0 * N] = 1;
+    std::vector<double> permuted(adj);
+    permuted.insert(permuted.end(), adj.begin(), adj.end());
+    std::vector<double> null_dist(2);
+
+    prisme::StageProfile profile;
+    {
+        prisme::ProfileScope scope(&profile);
+        prisme::size_null_distribution(permuted, N, null_dist);
+    }
+    CHECK(profile[prisme::Stage::NullConstruction].calls == 1);
+    CHECK(profile[prisme::Stage::NullConstruction].permutations == 2);
+    CHECK(profile[prisme::Stage::ClusterFinding].calls == 2);
+}
+
+void test_threads_are_separate() {
+    prisme::StageProfile profile;
+    prisme::ProfileScope scope(&profile);
+    std::thread worker([] { prisme::ScopedStage stage(prisme::Stage::Io); });
+    worker.join();
+    CHECK(profile[prisme::Stage::Io].calls == 0);
+}
+
+void test_profile_file() {
+    const std::string path = "stage_profile_test.csv";
+    std::remove(path.c_str());
+
+    prisme::StageProfile profile;
+    profile[prisme::Stage::GlmFit].calls = 2;
+    profile[prisme::Stage::GlmFit].wall_time = 0.5;
+    profile[prisme::Stage::PermutationGeneration].calls = 1;
+    profile[prisme::Stage::PermutationGeneration].permutations = 100;
+
+    prisme::StageProfile merged;
+    merged.merge(profile);
+    merged.merge(profile);
+    CHECK(merged[prisme::Stage::GlmFit].calls == 4);
+    CHECK_NEAR(merged[prisme::Stage::GlmFit].wall_time, 1.0, 1e-12);
+
+    prisme::append_stage_profile(path, "test", 1, 3, profile);
+    prisme::append_stage_profile(path, "test", 4, 4, merged);
+
+    std::ifstream file(path);
+    std::vector<std::string> lines;
+    for (std::string line; std::getline(file, line);) {
+        lines.push_back(line);
+    }
+    CHECK(lines.size() == 5);
+    CHECK(lines[0] == "source,first_repetition,last_repetition,stage,calls,wall_time,cpu_time,bytes_allocated,"
+                      "permutations");
+    CHECK(lines[1] == "test,1,3,glm_fit,2,0.5,0,0,0");
+    CHECK(lines[2] == "test,1,3,permutation_generation,1,0,0,0,100");
+    CHECK(lines[4] == "test,4,4,permutation_generation,2,0,0,0,200");
+}
+
+}  // namespace
+
+int main() {
+    test_no_profile();
+    test_nested_stages();
+    test_kernel_stages();
+    test_threads_are_separate();
+    test_profile_file();
+    return TEST_RESULT();
+}
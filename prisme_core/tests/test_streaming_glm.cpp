@@ -0,0 +1,163 @@
+/**
+ * test_streaming_glm.cpp - Chunked full sample statistics against GlmDesign on the whole data
+ */
+
+#include "prisme/column_store.hpp"
+#include "prisme/glm.hpp"
+#include "prisme/streaming_glm.hpp"
+#include "test_utils.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+const int n = 45;
+const size_t n_var = 12;
+const std::string store_file = "test_streaming_glm.pcol";
+
+// n_var x n, one column per subject, with large offsets on some variables
+std::vector<double> random_data(uint64_t seed) {
+    std::mt19937_64 rng(seed);
+    std::normal_distribution<double> normal(0.0, 1.0);
+    std::vector<double> Y(n_var * n);
+    for (int s = 0; s < n; s++) {
+        for (size_t e = 0; e < n_var; e++) {
+            Y[s * n_var + e] = (e % 4 == 0 ? 1e4 : 0.0) + 0.3 * e + normal(rng);
+        }
+    }
+    return Y;
+}
+
+// intercept, two groups, covariates or no intercept at all
+std::vector<double> design(int n_predictors, bool groups, uint64_t seed) {
+    std::mt19937_64 rng(seed);
+    std::normal_distribution<double> normal(0.0, 1.0);
+    std::vector<double> X(n * n_predictors);
+    for (int i = 0; i < n; i++) {
+        for (int p = 0; p < n_predictors; p++) {
+            if (groups) {
+                X[p * n + i] = (i % 3 == 0) == (p == 0) ? 1.0 : 0.0;
+            } else {
+                X[p * n + i] = p == 0 ? 1.0 : normal(rng);
+            }
+        }
+    }
+    return X;
+}
+
+void check_against_glm(const std::vector<double>& X, int n_predictors, const std::vector<double>& Y,
+                       const std::vector<double>& contrast, prisme::GlmTest test,
+                       const std::vector<int>& ind_nuisance, int chunk) {
+    prisme::StreamingGlm streaming(X, n, n_predictors, n_var);
+    for (int first = 0; first < n; first += chunk) {
+        const int n_chunk = std::min(chunk, n - first);
+        const std::vector<double> part(Y.begin() + first * n_var, Y.begin() + (first + n_chunk) * n_var);
+        streaming.add_observations(part, n_chunk);
+    }
+    std::vector<double> stats(n_var);
+    streaming.compute_test_stat(contrast, test, ind_nuisance, stats);
+
+    // GlmDesign takes observations x GLMs
+    std::vector<double> y(n * n_var);
+    for (int s = 0; s < n; s++) {
+        for (size_t e = 0; e < n_var; e++) {
+            y[e * n + s] = Y[s * n_var + e];
+        }
+    }
+    prisme::GlmDesign glm(X, n, n_predictors, contrast, test, ind_nuisance);
+    std::vector<double> expected(n_var);
+    glm.compute_test_stat(y, static_cast<int>(n_var), expected);
+    for (size_t e = 0; e < n_var; e++) {
+        CHECK_NEAR(stats[e], expected[e], 1e-8 * std::max(1.0, std::fabs(expected[e])));
+    }
+}
+
+void test_designs() {
+    const std::vector<double> Y = random_data(1);
+
+    const std::vector<double> ones(n, 1.0);
+    check_against_glm(ones, 1, Y, {1}, prisme::GlmTest::OneSample, {}, 7);
+
+    const std::vector<double> groups = design(2, true, 2);
+    check_against_glm(groups, 2, Y, {1, -1}, prisme::GlmTest::TTest, {}, 10);
+
+    // Intercept and two covariates: t on a covariate, F without and with nuisance
+    const std::vector<double> covariates = design(3, false, 3);
+    check_against_glm(covariates, 3, Y, {0, 1, 0}, prisme::GlmTest::TTest, {0, 2}, 45);
+    check_against_glm(covariates, 3, Y, {0, 1, 1}, prisme::GlmTest::FTest, {}, 4);
+    check_against_glm(covariates, 3, Y, {0, 1, 0}, prisme::GlmTest::FTest, {0, 2}, 16);
+
+    // Four predictors (the largest fixed size GLM kernel) and six (the generic solve)
+    const std::vector<double> four = design(4, false, 6);
+    check_against_glm(four, 4, Y, {0, 1, 0, -1}, prisme::GlmTest::TTest, {0, 2}, 11);
+    check_against_glm(four, 4, Y, {0, 1, 1, 1}, prisme::GlmTest::FTest, {}, 11);
+    check_against_glm(four, 4, Y, {0, 1, 0, 1}, prisme::GlmTest::FTest, {0, 2}, 11);
+    const std::vector<double> six = design(6, false, 7);
+    check_against_glm(six, 6, Y, {0, 1, 0, 0, 0, 0}, prisme::GlmTest::TTest, {}, 11);
+    check_against_glm(six, 6, Y, {0, 1, 0, 1, 0, 0}, prisme::GlmTest::FTest, {0, 2}, 11);
+
+    // No intercept in the design, the shift of the data matters for the residuals
+    const std::vector<double> slope(covariates.begin() + n, covariates.end());
+    check_against_glm(slope, 2, Y, {1, 0}, prisme::GlmTest::TTest, {}, 9);
+    check_against_glm(slope, 2, Y, {1, 1}, prisme::GlmTest::FTest, {}, 9);
+}
+
+void test_column_store_pass() {
+    const std::vector<double> Y = random_data(4);
+    prisme::create_column_store(store_file, n_var, prisme::StoreClass::Double);
+    prisme::write_store_columns(store_file, 0, Y.data(), n_var, n, prisme::StoreClass::Double, true);
+
+    // Two designs over the same subjects from one pass over the file
+    const std::vector<double> ones(n, 1.0);
+    const std::vector<double> groups = design(2, true, 5);
+    prisme::StreamingGlm onesample(ones, n, 1, n_var);
+    prisme::StreamingGlm two_sample(groups, n, 2, n_var);
+    {
+        prisme::MappedColumnStore store(store_file);
+        prisme::stream_column_store(store, {&onesample, &two_sample}, 8);
+        CHECK(onesample.n_added() == n && two_sample.n_added() == n);
+        CHECK_THROWS(prisme::stream_column_store(store, {&onesample}, 8));
+    }
+    std::remove(store_file.c_str());
+
+    std::vector<double> t(n_var);
+    std::vector<double> t_neg(n_var);
+    std::vector<double> contrast = {1};
+    std::vector<double> contrast_neg = {-1};
+    onesample.compute_test_stat(contrast, prisme::GlmTest::OneSample, {}, t);
+    onesample.compute_test_stat(contrast_neg, prisme::GlmTest::OneSample, {}, t_neg);
+    for (size_t e = 0; e < n_var; e++) {
+        CHECK_NEAR(t[e], -t_neg[e], 1e-12 * std::fabs(t[e]));
+    }
+    std::vector<double> t2(n_var);
+    const std::vector<double> difference = {1, -1};
+    two_sample.compute_test_stat(difference, prisme::GlmTest::TTest, {}, t2);
+    CHECK(std::all_of(t2.begin(), t2.end(), [](double value) { return std::isfinite(value); }));
+}
+
+void test_invalid_input() {
+    const std::vector<double> ones(n, 1.0);
+    CHECK_THROWS(prisme::StreamingGlm(ones, n, 2, n_var));
+    prisme::StreamingGlm glm(ones, n, 1, n_var);
+    std::vector<double> stats(n_var);
+    const std::vector<double> contrast = {1};
+    // Statistics need every observation
+    CHECK_THROWS(glm.compute_test_stat(contrast, prisme::GlmTest::OneSample, {}, stats));
+    const std::vector<double> chunk(n_var * (n + 1), 0.0);
+    CHECK_THROWS(glm.add_observations(chunk, n + 1));
+    CHECK_THROWS(glm.add_observations(chunk, 3));
+}
+
+}  // namespace
+
+int main() {
+    test_designs();
+    test_column_store_pass();
+    test_invalid_input();
+    return TEST_RESULT();
+}
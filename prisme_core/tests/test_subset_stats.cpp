@@ -0,0 +1,244 @@
+/**
+ * test_subset_stats.cpp - Sufficient statistic t values against a GLM fit per repetition and nested sizes
+ */
+
+#include "prisme/glm.hpp"
+#include "prisme/subset_stats.hpp"
+#include "test_utils.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <random>
+#include <vector>
+
+namespace {
+
+const size_t n_var = 300;  // More than one block of variables
+
+std::vector<double> random_data(size_t n_subjects, std::mt19937_64& rng) {
+    std::normal_distribution<double> normal(0.0, 1.0);
+    std::vector<double> Y(n_var * n_subjects);
+    for (size_t s = 0; s < n_subjects; s++) {
+        for (size_t e = 0; e < n_var; e++) {
+            // Large offsets on some variables, an empty one and effects on others
+            const double offset = e % 7 == 0 ? 1e4 : 0.0;
+            Y[s * n_var + e] = e == 3 ? 0.0 : offset + normal(rng) + (e % 5 == 0 ? 0.8 : 0.0);
+        }
+    }
+    return Y;
+}
+
+// k distinct ids from first..first + n - 1, as randperm(n, k) + first - 1
+std::vector<double> draw(size_t n, size_t k, size_t first, std::mt19937_64& rng) {
+    std::vector<double> ids(n);
+    std::iota(ids.begin(), ids.end(), static_cast<double>(first));
+    std::shuffle(ids.begin(), ids.end(), rng);
+    ids.resize(k);
+    return ids;
+}
+
+// GLM statistics of one repetition on Y(:, ids), as pf_repetition_loop fits them
+std::vector<double> glm_stats(const std::vector<double>& Y, const double* ids, size_t n_obs,
+                              const std::vector<double>& X, int n_predictors, const std::vector<double>& contrast,
+                              prisme::GlmTest test) {
+    std::vector<double> y(n_obs * n_var);
+    for (size_t o = 0; o < n_obs; o++) {
+        const size_t subject = static_cast<size_t>(ids[o]) - 1;
+        for (size_t e = 0; e < n_var; e++) {
+            y[e * n_obs + o] = Y[subject * n_var + e];
+        }
+    }
+    std::vector<int> ind_nuisance;
+    for (size_t p = 0; p < contrast.size(); p++) {
+        if (contrast[p] == 0) ind_nuisance.push_back(static_cast<int>(p));
+    }
+    prisme::GlmDesign design(X, static_cast<int>(n_obs), n_predictors, contrast, test, ind_nuisance);
+    std::vector<double> t(n_var);
+    design.compute_test_stat(y, static_cast<int>(n_var), t);
+    return t;
+}
+
+void check_against_glm(const std::vector<double>& t_stats, size_t r, const std::vector<double>& expected) {
+    for (size_t e = 0; e < n_var; e++) {
+        const double value = t_stats[r * n_var + e];
+        CHECK_NEAR(value, expected[e], 1e-9 * std::max(1.0, std::fabs(expected[e])));
+    }
+}
+
+void test_one_sample() {
+    std::mt19937_64 rng(1);
+    const size_t n_subjects = 40;
+    const size_t n_obs = 12;
+    const size_t n_reps = 5;
+    const std::vector<double> Y = random_data(n_subjects, rng);
+    std::vector<double> ids;
+    for (size_t r = 0; r < n_reps; r++) {
+        const std::vector<double> rep = draw(n_subjects, n_obs, 1, rng);
+        ids.insert(ids.end(), rep.begin(), rep.end());
+    }
+
+    std::vector<double> t_stats(n_var * n_reps);
+    prisme::subset_t_stats(Y, n_var, ids, n_obs, prisme::SubsetDesign::OneSample, t_stats);
+    const std::vector<double> X(n_obs, 1.0);
+    for (size_t r = 0; r < n_reps; r++) {
+        check_against_glm(t_stats, r, glm_stats(Y, ids.data() + r * n_obs, n_obs, X, 1, {1}, prisme::GlmTest::OneSample));
+        CHECK(t_stats[r * n_var + 3] == 0);
+    }
+}
+
+void test_paired() {
+    std::mt19937_64 rng(2);
+    const size_t n_subs = 30;
+    const size_t n_pairs = 10;
+    const size_t n_reps = 4;
+    const std::vector<double> Y = random_data(2 * n_subs, rng);
+    std::vector<double> ids;
+    for (size_t r = 0; r < n_reps; r++) {
+        const std::vector<double> rep = draw(n_subs, n_pairs, 1, rng);
+        ids.insert(ids.end(), rep.begin(), rep.end());
+        for (double id : rep) ids.push_back(id + n_subs);
+    }
+
+    std::vector<double> t_stats(n_var * n_reps);
+    prisme::subset_t_stats(Y, n_var, ids, 2 * n_pairs, prisme::SubsetDesign::Paired, t_stats);
+
+    // create_design_matrix('pt', n): condition column of +-1 and one column per subject
+    const size_t n_obs = 2 * n_pairs;
+    const int n_predictors = static_cast<int>(n_pairs) + 1;
+    std::vector<double> X(n_obs * n_predictors, 0.0);
+    for (size_t i = 0; i < n_pairs; i++) {
+        X[i] = 1;
+        X[n_pairs + i] = -1;
+        X[(i + 1) * n_obs + i] = 1;
+        X[(i + 1) * n_obs + n_pairs + i] = 1;
+    }
+    std::vector<double> contrast(n_predictors, 0.0);
+    contrast[0] = 1;
+    for (size_t r = 0; r < n_reps; r++) {
+        check_against_glm(t_stats, r,
+                          glm_stats(Y, ids.data() + r * n_obs, n_obs, X, n_predictors, contrast, prisme::GlmTest::TTest));
+    }
+}
+
+void test_two_sample() {
+    std::mt19937_64 rng(3);
+    const size_t n_subs_1 = 25;
+    const size_t n_subs_2 = 20;
+    const size_t n_group = 8;
+    const size_t n_reps = 4;
+    const std::vector<double> Y = random_data(n_subs_1 + n_subs_2, rng);
+    std::vector<double> ids;
+    for (size_t r = 0; r < n_reps; r++) {
+        const std::vector<double> first = draw(n_subs_1, n_group, 1, rng);
+        const std::vector<double> second = draw(n_subs_2, n_group, n_subs_1 + 1, rng);
+        ids.insert(ids.end(), first.begin(), first.end());
+        ids.insert(ids.end(), second.begin(), second.end());
+    }
+
+    std::vector<double> t_stats(n_var * n_reps);
+    prisme::subset_t_stats(Y, n_var, ids, 2 * n_group, prisme::SubsetDesign::TwoSample, t_stats);
+
+    const size_t n_obs = 2 * n_group;
+    std::vector<double> X(n_obs * 2, 0.0);
+    for (size_t i = 0; i < n_group; i++) {
+        X[i] = 1;
+        X[n_obs + n_group + i] = 1;
+    }
+    for (size_t r = 0; r < n_reps; r++) {
+        check_against_glm(t_stats, r,
+                          glm_stats(Y, ids.data() + r * n_obs, n_obs, X, 2, {1, -1}, prisme::GlmTest::TTest));
+    }
+}
+
+// Nested sizes against subset_t_stats on the first n_k ids of each group
+void check_nested(const std::vector<double>& Y, const std::vector<double>& ids, size_t n_ids,
+                  prisme::SubsetDesign design, const std::vector<size_t>& sizes) {
+    const size_t n_reps = ids.size() / n_ids;
+    const size_t n_groups = design == prisme::SubsetDesign::OneSample ? 1 : 2;
+    const size_t n_per_group = n_ids / n_groups;
+    std::vector<double> nested(n_var * sizes.size() * n_reps);
+    prisme::nested_subset_t_stats(Y, n_var, ids, n_ids, sizes, design, nested);
+
+    for (size_t k = 0; k < sizes.size(); k++) {
+        std::vector<double> prefix;
+        for (size_t r = 0; r < n_reps; r++) {
+            for (size_t group = 0; group < n_groups; group++) {
+                const double* first = ids.data() + r * n_ids + group * n_per_group;
+                prefix.insert(prefix.end(), first, first + sizes[k]);
+            }
+        }
+        std::vector<double> expected(n_var * n_reps);
+        prisme::subset_t_stats(Y, n_var, prefix, n_groups * sizes[k], design, expected);
+        for (size_t r = 0; r < n_reps; r++) {
+            for (size_t e = 0; e < n_var; e++) {
+                const double value = nested[(r * sizes.size() + k) * n_var + e];
+                const double target = expected[r * n_var + e];
+                CHECK_NEAR(value, target, 1e-10 * std::max(1.0, std::fabs(target)));
+            }
+        }
+    }
+}
+
+void test_nested_sizes() {
+    std::mt19937_64 rng(4);
+    const size_t n_subs = 30;
+    const std::vector<double> Y = random_data(2 * n_subs, rng);
+    const std::vector<size_t> sizes = {4, 7, 12};
+
+    std::vector<double> one_sample;
+    std::vector<double> paired;
+    std::vector<double> two_sample;
+    for (size_t r = 0; r < 3; r++) {
+        const std::vector<double> rep = draw(2 * n_subs, 12, 1, rng);
+        one_sample.insert(one_sample.end(), rep.begin(), rep.end());
+        const std::vector<double> base = draw(n_subs, 12, 1, rng);
+        paired.insert(paired.end(), base.begin(), base.end());
+        for (double id : base) paired.push_back(id + n_subs);
+        const std::vector<double> first = draw(n_subs, 12, 1, rng);
+        const std::vector<double> second = draw(n_subs, 12, n_subs + 1, rng);
+        two_sample.insert(two_sample.end(), first.begin(), first.end());
+        two_sample.insert(two_sample.end(), second.begin(), second.end());
+    }
+    check_nested(Y, one_sample, 12, prisme::SubsetDesign::OneSample, sizes);
+    check_nested(Y, paired, 24, prisme::SubsetDesign::Paired, sizes);
+    check_nested(Y, two_sample, 24, prisme::SubsetDesign::TwoSample, sizes);
+
+    // Sizes must increase and fit in a repetition
+    std::vector<double> t_stats(n_var * 2 * 3);
+    const std::vector<size_t> decreasing = {7, 4};
+    CHECK_THROWS(prisme::nested_subset_t_stats(Y, n_var, one_sample, 12, decreasing,
+                                               prisme::SubsetDesign::OneSample, t_stats));
+    const std::vector<size_t> too_large = {7, 13};
+    CHECK_THROWS(prisme::nested_subset_t_stats(Y, n_var, one_sample, 12, too_large,
+                                               prisme::SubsetDesign::OneSample, t_stats));
+}
+
+void test_invalid_input() {
+    CHECK(prisme::parse_subset_design("pt") == prisme::SubsetDesign::Paired);
+    CHECK_THROWS(prisme::parse_subset_design("r"));
+
+    const std::vector<double> Y(n_var * 6, 1.0);
+    std::vector<double> t_stats(n_var);
+    const std::vector<double> outside = {1, 7};
+    CHECK_THROWS(prisme::subset_t_stats(Y, n_var, outside, 2, prisme::SubsetDesign::OneSample, t_stats));
+    const std::vector<double> odd = {1, 2, 3};
+    CHECK_THROWS(prisme::subset_t_stats(Y, n_var, odd, 3, prisme::SubsetDesign::TwoSample, t_stats));
+    // The second half of a pt repetition must be the other condition of the same subjects
+    const std::vector<double> unpaired = {1, 2, 4, 6};
+    CHECK_THROWS(prisme::subset_t_stats(Y, n_var, unpaired, 4, prisme::SubsetDesign::Paired, t_stats));
+    const std::vector<double> ids = {1, 2};
+    std::vector<double> small(n_var - 1);
+    CHECK_THROWS(prisme::subset_t_stats(Y, n_var, ids, 2, prisme::SubsetDesign::OneSample, small));
+}
+
+}  // namespace
+
+int main() {
+    test_one_sample();
+    test_paired();
+    test_two_sample();
+    test_nested_sizes();
+    test_invalid_input();
+    return TEST_RESULT();
+}
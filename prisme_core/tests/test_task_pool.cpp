@@ -0,0 +1,98 @@
+/**
+ * test_task_pool.cpp - Nested tasks, task order, stealing and errors of the work-stealing pool
+ */
+
+#include "prisme/task_pool.hpp"
+#include "test_utils.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <set>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+namespace {
+
+void test_nested_tasks() {
+    prisme::TaskPool pool(4);
+    CHECK(pool.n_threads() == 4);
+    std::atomic<int> count(0);
+    for (int i = 0; i < 20; i++) {
+        pool.submit([&pool, &count] {
+            for (int j = 0; j < 10; j++) {
+                pool.submit([&count] { count++; });
+            }
+            count++;
+        });
+    }
+    // wait also covers the tasks submitted by tasks
+    pool.wait();
+    CHECK(count == 220);
+
+    // The pool can be reused after wait
+    pool.submit([&count] { count++; });
+    pool.wait();
+    CHECK(count == 221);
+}
+
+void test_order() {
+    // One worker: its own tasks run newest first, tasks from outside in submission order
+    prisme::TaskPool pool(1);
+    std::vector<int> order;
+    pool.submit([&pool, &order] {
+        order.push_back(0);
+        for (int j = 1; j <= 3; j++) {
+            pool.submit([&order, j] { order.push_back(j); });
+        }
+    });
+    pool.submit([&order] { order.push_back(4); });
+    pool.wait();
+    CHECK(order == std::vector<int>({0, 3, 2, 1, 4}));
+}
+
+void test_stealing() {
+    // Tasks submitted from one task are spread over the idle workers
+    prisme::TaskPool pool(4);
+    std::mutex mutex;
+    std::set<std::thread::id> threads;
+    pool.submit([&] {
+        for (int j = 0; j < 16; j++) {
+            pool.submit([&] {
+                std::this_thread::sleep_for(std::chrono::milliseconds(5));
+                std::lock_guard<std::mutex> lock(mutex);
+                threads.insert(std::this_thread::get_id());
+            });
+        }
+    });
+    pool.wait();
+    CHECK(threads.size() > 1);
+}
+
+void test_errors() {
+    prisme::TaskPool pool(2);
+    std::atomic<int> count(0);
+    pool.submit([] { throw std::runtime_error("task failed"); });
+    CHECK_THROWS(pool.wait());
+
+    // The error is reported once, later tasks run again
+    pool.submit([&count] { count++; });
+    pool.wait();
+    CHECK(count == 1);
+
+    // wait from inside a task is an error of that task
+    pool.submit([&pool] { pool.wait(); });
+    CHECK_THROWS(pool.wait());
+    CHECK_THROWS(prisme::TaskPool(-1));
+}
+
+}  // namespace
+
+int main() {
+    test_nested_tasks();
+    test_order();
+    test_stealing();
+    test_errors();
+    return TEST_RESULT();
+}
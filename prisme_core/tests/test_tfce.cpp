@@ -0,0 +1,150 @@
+/**
+ * test_tfce.cpp - Agreement of the TFCE variants on small graphs
+ */
+
+#include "prisme/tfce.hpp"
+#include "test_utils.hpp"
+
+#include <cmath>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+namespace {
+
+const double dh = 0.1;
+const double H = 3.0;
+const double E = 0.4;
+
+// Integral of t^H over the threshold grid up to 1: 0.1^4 * (1 + 8 + ... + 1000)
+const double unit_edge_tfce = 0.3025;
+
+void test_single_edge() {
+    const int N = 3;
+    std::vector<double> img(N * N, 0.0);
+    img[0 + 1 * N] = 1.0;
+    img[1 + 0 * N] = 1.0;
+    const std::vector<double> img_copy = img;
+
+    std::vector<double> fast(N * N);
+    prisme::apply_tfce(img, N, dh, H, E, fast);
+    CHECK_NEAR(fast[0 + 1 * N], unit_edge_tfce, 1e-9);
+    CHECK_NEAR(fast[1 + 0 * N], unit_edge_tfce, 1e-9);
+    CHECK_NEAR(fast[0 + 2 * N], 0, 0);
+    CHECK(img == img_copy);
+
+    std::vector<double> traditional(N * N);
+    prisme::traditional_tfce(img, N, H, E, dh, traditional);
+    CHECK_NEAR(traditional[0 + 1 * N], unit_edge_tfce, 1e-9);
+
+    // Exact integral of t^H from 0 to 1
+    std::vector<double> exact(N * N);
+    prisme::exact_tfce(img, N, H, E, exact);
+    CHECK_NEAR(exact[0 + 1 * N], 1.0 / (H + 1), 1e-12);
+
+    // Node-based: both nodes are in a two node cluster
+    std::vector<int> rows = {1};
+    std::vector<int> cols = {0};
+    std::vector<double> values = {1.0};
+    std::vector<double> node_tfce(N);
+    prisme::sparse_tfce(rows, cols, values, N, dh, H, E, node_tfce);
+    CHECK_NEAR(node_tfce[0], std::pow(2.0, E) * unit_edge_tfce, 1e-9);
+    CHECK_NEAR(node_tfce[1], std::pow(2.0, E) * unit_edge_tfce, 1e-9);
+    CHECK_NEAR(node_tfce[2], 0, 0);
+}
+
+void test_fast_matches_traditional() {
+    const int N = 12;
+    std::mt19937_64 rng(7);
+    std::uniform_real_distribution<double> weight(-1.0, 3.0);
+
+    std::vector<double> img(N * N, 0.0);
+    for (int j = 0; j < N; j++) {
+        for (int i = 0; i < j; i++) {
+            img[i + j * N] = weight(rng);
+            img[j + i * N] = img[i + j * N];
+        }
+    }
+
+    std::vector<double> fast(N * N);
+    std::vector<double> traditional(N * N);
+    prisme::apply_tfce(img, N, dh, H, E, fast);
+    prisme::traditional_tfce(img, N, H, E, dh, traditional);
+
+    for (int e = 0; e < N * N; e++) {
+        CHECK_NEAR(fast[e], traditional[e], 1e-9 * (1 + std::fabs(traditional[e])));
+    }
+}
+
+void test_edge_variables() {
+    const int N = 10;
+    const int K = 3;
+    std::mt19937_64 rng(11);
+    std::uniform_real_distribution<double> weight(-1.0, 3.0);
+
+    // Upper triangle mask with one edge listed in the lower triangle
+    std::vector<uint64_t> linear_index;
+    for (int j = 0; j < N; j++) {
+        for (int i = 0; i < j; i++) {
+            linear_index.push_back(i == 0 && j == 1 ? 1 : i + j * N);
+        }
+    }
+    const prisme::EdgeIndex index = prisme::make_edge_index(linear_index, N);
+    std::vector<double> flat(index.size() * K);
+    for (double& value : flat) {
+        value = weight(rng);
+    }
+
+    // Every column matches the matrix variant on the unflattened matrix
+    std::vector<double> flat_tfce(flat.size());
+    prisme::apply_tfce(flat, index, dh, H, E, flat_tfce);
+    std::vector<double> img(N * N);
+    std::vector<double> matrix_tfce(N * N);
+    std::vector<double> expected(index.size());
+    for (int k = 0; k < K; k++) {
+        prisme::unflatten_edges(prisme::span<const double>(flat.data() + k * index.size(), index.size()), index,
+                                img);
+        prisme::apply_tfce(img, N, dh, H, E, matrix_tfce);
+        prisme::flatten_edges(matrix_tfce, index, expected);
+        for (size_t e = 0; e < index.size(); e++) {
+            CHECK(flat_tfce[k * index.size() + e] == expected[e]);
+        }
+    }
+
+    std::vector<double> ragged(index.size() + 1);
+    std::vector<double> ragged_out(ragged.size());
+    CHECK_THROWS(prisme::apply_tfce(ragged, index, dh, H, E, ragged_out));
+
+    // Both tails in one pass match apply_tfce of the block and of the negated block
+    std::vector<double> negated(flat.size());
+    for (size_t i = 0; i < flat.size(); i++) {
+        negated[i] = -flat[i];
+    }
+    std::vector<double> expected_neg(flat.size());
+    prisme::apply_tfce(negated, index, dh, H, E, expected_neg);
+    std::vector<double> tfce_pos(flat.size());
+    std::vector<double> tfce_neg(flat.size());
+    prisme::apply_tfce_two_tailed(flat, index, dh, H, E, tfce_pos, tfce_neg);
+    CHECK(tfce_pos == flat_tfce);
+    CHECK(tfce_neg == expected_neg);
+    CHECK_THROWS(prisme::apply_tfce_two_tailed(flat, index, dh, H, E, tfce_pos, ragged_out));
+}
+
+void test_invalid_input() {
+    std::vector<double> img(6, 0.0);
+    std::vector<double> out(6);
+    CHECK_THROWS(prisme::apply_tfce(img, 3, dh, H, E, out));
+    std::vector<double> square(9, 0.0);
+    std::vector<double> square_out(9);
+    CHECK_THROWS(prisme::apply_tfce(square, 3, 0.0, H, E, square_out));
+}
+
+}  // namespace
+
+int main() {
+    test_single_edge();
+    test_fast_matches_traditional();
+    test_edge_variables();
+    test_invalid_input();
+    return TEST_RESULT();
+}
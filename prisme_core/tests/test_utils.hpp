@@ -0,0 +1,53 @@
+/**
+ * test_utils.hpp - Minimal checks for the native kernel tests
+ *
+ * Each test executable returns the number of failed checks, so ctest reports any
+ * failure without a test framework dependency.
+ */
+
+#ifndef PRISME_TEST_UTILS_HPP
+#define PRISME_TEST_UTILS_HPP
+
+#include <cmath>
+#include <cstdio>
+
+static int prisme_test_failures = 0;
+
+#define CHECK(condition)                                                              \
+    do {                                                                              \
+        if (!(condition)) {                                                           \
+            std::printf("%s:%d: CHECK failed: %s\n", __FILE__, __LINE__, #condition); \
+            prisme_test_failures++;                                                   \
+        }                                                                             \
+    } while (0)
+
+#define CHECK_NEAR(a, b, tol)                                                                       \
+    do {                                                                                            \
+        const double check_a = (a);                                                                 \
+        const double check_b = (b);                                                                 \
+        if (!(std::fabs(check_a - check_b) <= (tol))) {                                             \
+            std::printf("%s:%d: CHECK_NEAR failed: %s = %.12g, %s = %.12g\n", __FILE__, __LINE__, #a, \
+                        check_a, #b, check_b);                                                      \
+            prisme_test_failures++;                                                                 \
+        }                                                                                           \
+    } while (0)
+
+#define CHECK_THROWS(statement)                                                          \
+    do {                                                                                 \
+        bool check_thrown = false;                                                       \
+        try {                                                                            \
+            statement;                                                                   \
+        } catch (...) {                                                                  \
+            check_thrown = true;                                                         \
+        }                                                                                \
+        if (!check_thrown) {                                                             \
+            std::printf("%s:%d: CHECK_THROWS failed: %s\n", __FILE__, __LINE__, #statement); \
+            prisme_test_failures++;                                                      \
+        }                                                                                \
+    } while (0)
+
+#define TEST_RESULT()                                                  \
+    (prisme_test_failures == 0 ? (std::printf("All checks passed\n"), 0) \
+                               : (std::printf("%d checks failed\n", prisme_test_failures), 1))
+
+#endif
@@ -0,0 +1,172 @@
+/**
+ * test_workspace.cpp - Workspace growth, power tables, reuse across calls and per-thread buffers
+ */
+
+#include "prisme/cluster_size.hpp"
+#include "prisme/stage_profile.hpp"
+#include "prisme/tfce.hpp"
+#include "prisme/workspace.hpp"
+#include "test_utils.hpp"
+
+#include <atomic>
+#include <cmath>
+#include <cstdlib>
+#include <new>
+#include <random>
+#include <thread>
+#include <vector>
+
+// Heap allocations through operator new while counting is on. The cluster and TFCE
+// kernels do not use Eigen, so every allocation of theirs goes through here.
+namespace {
+std::atomic<bool> counting{false};
+std::atomic<long> n_allocations{0};
+}  // namespace
+
+void* operator new(size_t size) {
+    if (counting.load(std::memory_order_relaxed)) {
+        n_allocations.fetch_add(1, std::memory_order_relaxed);
+    }
+    if (void* ptr = std::malloc(size == 0 ? 1 : size)) {
+        return ptr;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* ptr) noexcept { std::free(ptr); }
+void operator delete(void* ptr, size_t) noexcept { std::free(ptr); }
+
+namespace {
+
+void test_growth() {
+    prisme::Workspace ws;
+    ws.ints(0, 100);
+    CHECK(ws.take_grown_bytes() >= 100 * sizeof(int));
+    CHECK(ws.take_grown_bytes() == 0);
+
+    // Smaller or equal requests reuse the buffer
+    int* first = ws.ints(0, 100);
+    ws.ints(0, 10);
+    CHECK(ws.ints(0, 100) == first);
+    CHECK(ws.take_grown_bytes() == 0);
+
+    ws.doubles(1, 50);
+    ws.flags(2, 8);
+    CHECK(ws.capacity_bytes() >= 100 * sizeof(int) + 50 * sizeof(double) + 8);
+    ws.release();
+    CHECK(ws.capacity_bytes() == 0);
+}
+
+void test_power_tables() {
+    prisme::Workspace ws;
+    const double* heights = ws.powers(0, 5, 0.1, 3.0);
+    for (int k = 0; k < 5; k++) {
+        CHECK(heights[k] == std::pow(k * 0.1, 3.0));
+    }
+    ws.take_grown_bytes();
+
+    // Same parameters: the table is kept, and extended when more entries are asked for
+    heights = ws.powers(0, 3, 0.1, 3.0);
+    CHECK(ws.take_grown_bytes() == 0);
+    heights = ws.powers(0, 8, 0.1, 3.0);
+    CHECK(heights[7] == std::pow(7 * 0.1, 3.0));
+
+    // Other parameters recompute it
+    heights = ws.powers(0, 8, 0.25, 2.0);
+    CHECK(heights[7] == std::pow(7 * 0.25, 2.0));
+    const double* extents = ws.powers(1, 4, 1.0, 0.4);
+    CHECK(extents[0] == 0 && extents[3] == std::pow(3, 0.4));
+}
+
+void test_scope() {
+    prisme::Workspace* thread_default = &prisme::thread_workspace();
+    prisme::Workspace outer_ws;
+    prisme::Workspace inner_ws;
+    {
+        prisme::WorkspaceScope outer(&outer_ws);
+        CHECK(&prisme::thread_workspace() == &outer_ws);
+        {
+            prisme::WorkspaceScope inner(&inner_ws);
+            CHECK(&prisme::thread_workspace() == &inner_ws);
+        }
+        CHECK(&prisme::thread_workspace() == &outer_ws);
+
+        // Kernels size the installed workspace
+        std::vector<double> adj = {0, 1, 1, 0};
+        prisme::find_components(adj, 2);
+        CHECK(outer_ws.capacity_bytes() > 0);
+    }
+    CHECK(&prisme::thread_workspace() == thread_default);
+}
+
+void test_threads_are_separate() {
+    prisme::Workspace* main_ws = &prisme::thread_workspace();
+    prisme::Workspace* worker_ws = nullptr;
+    std::thread worker([&] { worker_ws = &prisme::thread_workspace(); });
+    worker.join();
+    CHECK(worker_ws != main_ws);
+    CHECK(&prisme::thread_workspace() == main_ws);
+}
+
+void test_kernels_reuse_buffers() {
+    const int N = 30;
+    const int K = 20;
+    std::mt19937_64 rng(3);
+    std::uniform_real_distribution<double> weight(-1.0, 4.0);
+    std::vector<double> img(N * N, 0.0);
+    for (int j = 0; j < N; j++) {
+        for (int i = 0; i < j; i++) {
+            img[i + j * N] = weight(rng);
+            img[j + i * N] = img[i + j * N];
+        }
+    }
+    std::vector<double> permuted;
+    for (int k = 0; k < K; k++) {
+        for (double value : img) {
+            permuted.push_back(value > 1.0 + 0.1 * k ? 1.0 : 0.0);
+        }
+    }
+    std::vector<double> null_dist(K);
+    std::vector<double> tfced(N * N);
+
+    auto run = [&] {
+        prisme::size_null_distribution(permuted, N, null_dist);
+        prisme::apply_tfce(img, N, 0.1, 3.0, 0.4, tfced);
+        prisme::exact_tfce(img, N, 3.0, 0.4, tfced);
+    };
+
+    // The first call sizes the workspace, later calls of the same size do not allocate
+    prisme::StageProfile warm_up;
+    {
+        prisme::ProfileScope scope(&warm_up);
+        run();
+    }
+    CHECK(warm_up[prisme::Stage::ClusterFinding].bytes_allocated > 0);
+
+    prisme::StageProfile profile;
+    {
+        prisme::ProfileScope scope(&profile);
+        run();
+    }
+    CHECK(profile[prisme::Stage::ClusterFinding].calls == K + 2);
+    CHECK(profile[prisme::Stage::ClusterFinding].bytes_allocated == 0);
+    CHECK(profile[prisme::Stage::NullConstruction].bytes_allocated == 0);
+
+    // Not only the workspace: nothing in the kernels touches the heap
+    n_allocations = 0;
+    counting = true;
+    run();
+    counting = false;
+    CHECK(n_allocations == 0);
+}
+
+}  // namespace
+
+int main() {
+    test_growth();
+    test_power_tables();
+    test_scope();
+    test_threads_are_separate();
+    test_kernels_reuse_buffers();
+    return TEST_RESULT();
+}
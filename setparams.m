@@ -69,11 +69,22 @@ Params.tests_to_skip = @(x) any(cellfun(@(r) (x >= r(1)) && (x <= r(2)), ranges)
 
 %% List of subjects per subset
 Params.list_of_nsubset = {20, 80, 200}; % To change this, add more when necessary
+Params.nested_subsets = false;      % draw subjects once per repetition for the largest size, smaller sizes use the first ones
                     % size of subset is full group size (N=n*2 for two sample t-test or N=n for one-sample)
 
                             % Current model (see above design matrix) only designed for t-test
 Params.force_permute = true;               
 Params.n_perms = 1000;               % recommend n_perms=5000 to appreciably reduce uncertainty of p-value estimation (https://fsl.fmrib.ox.ac.uk/fsl/fslwiki/Randomise/Theory)
+Params.permutation_block_size = 0;   % 0 keeps all permutations in memory; >0 streams blocks of this many permutations
+Params.closed_form_permutations = false; % streamed t, t2 and r only - one GEMM per permutation block instead of one GLM solve per permutation
+Params.use_column_store = false;     % full_file only - store per-repetition edge/network stats in .pcol files
+Params.use_result_journal = false;   % compact_file only - append batch results to a journal, folded into the file at the end
+Params.result_cache_dir = '';        % cache edge stats and permutations of each repetition here, reruns on the same data and design read them back ('' disables)
+Params.result_cache_max_gb = 10;     % size of the result cache, least recently used entries are evicted beyond it
+Params.native_runner_dir = '';       % compact_file + result journal only - export pending repetitions for the prisme_power runner here
+Params.shared_data_store = false;    % parallel only - workers read their subject columns of Y from one memory-mapped .pcol file instead of per-repetition copies
+Params.batch_edge_stats = false;     % t, pt and t2 only - edge statistics of a whole batch in one NBSglm_cpp call instead of one GLM fit per repetition
+Params.record_stage_profile = true;  % append per-stage times of each batch to <results>_stages.csv next to the results file
 Params.tthresh_first_level = 3.1;    % t=3.1 corresponds with p=0.005-0.001 (DOF=10-1000)
                             % Only used if cluster_stat_type='Size'
 Params.pthresh_second_level = 0.05;  % FWER or FDR rate 
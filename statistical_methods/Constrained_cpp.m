@@ -6,7 +6,7 @@ classdef Constrained_cpp
     end
 
     methods
-        function pvals = run_method(~, varargin)
+        function pvals = run_method(obj, varargin)
             % Applies the Constrained (cNBS) method and computes p-values using permutation-based inference.
             %
             % Inputs:
@@ -26,10 +26,81 @@ classdef Constrained_cpp
 
             flat_edge_groups = double(STATS.flatten_matrix(STATS.edge_groups));
             
-            pvals = struct();
             [p_FWER, p_FDR] = constrained_pval_cpp(edge_stats, permuted_edge_stats, ...
                 flat_edge_groups, STATS.alpha);
 
+            pvals = obj.select_submethods(STATS, p_FWER, p_FDR);
+
+        end
+
+        function null_acc = init_null(~, varargin)
+            % Starts empty per-network exceedance counts for a permutation stream.
+            %
+            % Inputs: same name-value pairs as run_method, without permuted_edge_data.
+            %
+            % Outputs:
+            %   - null_acc: Structure with the network assignment of each edge, the
+            %               exceedance counts and the number of permutations seen.
+
+            params = struct(varargin{:});
+            STATS = params.statistical_parameters;
+
+            null_acc = struct();
+            null_acc.STATS = STATS;
+            null_acc.edge_stats = params.edge_stats;
+            null_acc.flat_edge_groups = double(STATS.flatten_matrix(STATS.edge_groups));
+            null_acc.counts = [];
+            null_acc.n_perms = 0;
+        end
+
+        function null_acc = update_null(~, null_acc, permuted_edge_stats)
+            % Adds the exceedances of a permutation block to the running counts.
+            if isempty(null_acc.counts)
+                [~, ~, null_acc.counts] = constrained_pval_cpp(null_acc.edge_stats, ...
+                    permuted_edge_stats, null_acc.flat_edge_groups, null_acc.STATS.alpha);
+            else
+                [~, ~, null_acc.counts] = constrained_pval_cpp(null_acc.edge_stats, ...
+                    permuted_edge_stats, null_acc.flat_edge_groups, null_acc.STATS.alpha, ...
+                    null_acc.counts, null_acc.n_perms);
+            end
+
+            null_acc.n_perms = null_acc.n_perms + size(permuted_edge_stats, 2);
+        end
+
+        function [null_acc, null_acc_neg] = update_null_two_tailed(~, null_acc, null_acc_neg, permuted_edge_stats)
+            % Adds the exceedances of the block and of the negated block (null_acc_neg,
+            % started from -edge_stats) from one set of network sums per permutation.
+            if isempty(null_acc.counts)
+                [~, ~, null_acc.counts, ~, ~, null_acc_neg.counts] = constrained_pval_cpp( ...
+                    null_acc.edge_stats, permuted_edge_stats, null_acc.flat_edge_groups, null_acc.STATS.alpha);
+            else
+                [~, ~, null_acc.counts, ~, ~, null_acc_neg.counts] = constrained_pval_cpp( ...
+                    null_acc.edge_stats, permuted_edge_stats, null_acc.flat_edge_groups, null_acc.STATS.alpha, ...
+                    null_acc.counts, null_acc.n_perms, null_acc_neg.counts);
+            end
+
+            null_acc.n_perms = null_acc.n_perms + size(permuted_edge_stats, 2);
+            null_acc_neg.n_perms = null_acc.n_perms;
+        end
+
+        function pvals = pvals_from_null(obj, null_acc)
+            % FWER and FDR p-values from the accumulated exceedance counts.
+            if null_acc.n_perms == 0
+                error('Permutation data is missing. Ensure precomputed permutations are provided.');
+            end
+
+            no_perms = zeros(numel(null_acc.edge_stats), 0);
+            [p_FWER, p_FDR] = constrained_pval_cpp(null_acc.edge_stats, no_perms, ...
+                null_acc.flat_edge_groups, null_acc.STATS.alpha, null_acc.counts, null_acc.n_perms);
+
+            pvals = obj.select_submethods(null_acc.STATS, p_FWER, p_FDR);
+        end
+    end
+
+    methods (Static, Access = private)
+        function pvals = select_submethods(STATS, p_FWER, p_FDR)
+            pvals = struct();
+
             if STATS.submethods.FWER
                 pvals.FWER = p_FWER;
             end
@@ -37,7 +108,6 @@ classdef Constrained_cpp
             if STATS.submethods.FDR
                 pvals.FDR = p_FDR;
             end
-
         end
     end
-end
\ No newline at end of file
+end
@@ -32,44 +32,81 @@
                 %   - pval: TFCE-corrected p-values.
             
                 params = struct(varargin{:});
-            
-                % Extract relevant inputs
+
+                null_acc = obj.init_null(varargin{:});
+                null_acc = obj.update_null(null_acc, params.permuted_edge_data);
+                pval = obj.pvals_from_null(null_acc);
+    
+            end
+
+            function null_acc = init_null(obj, varargin)
+                % Starts an empty TFCE null distribution for a permutation stream.
+                %
+                % Inputs: same name-value pairs as run_method, without permuted_edge_data.
+                %
+                % Outputs:
+                %   - null_acc: Structure with the flattened TFCE target and the maximum
+                %               TFCE values collected so far.
+
+                params = struct(varargin{:});
                 STATS = params.statistical_parameters;
-                edge_stats = params.edge_stats;
-                permuted_edge_stats = params.permuted_edge_data; % Explicitly using the new argument
-            
-                % Convert the edge statistics back into a matrix
-                test_stat_mat = STATS.unflatten_matrix(edge_stats);
-            
-                % Apply TFCE transformation to the observed test statistics
-                cluster_stats_target = apply_tfce_cpp(test_stat_mat, obj.method_params.dh, ...
-                    obj.method_params.H, obj.method_params.E);
-                cluster_stats_target = STATS.flatten_matrix(cluster_stats_target);
-            
-                % Ensure permutation data is provided
-                if isempty(permuted_edge_stats)
-                    error('Permutation data is missing. Ensure precomputed permutations are provided.');
+
+                % Apply TFCE transformation to the observed test statistics. The MEX
+                % runs on the flat statistics through the node pairs of the mask.
+                null_acc = struct();
+                null_acc.STATS = STATS;
+                null_acc.mask_index = find(STATS.mask);
+                null_acc.n_nodes = size(STATS.mask, 1);
+                null_acc.cluster_stats_target = apply_tfce_cpp(double(params.edge_stats(:)), ...
+                    null_acc.mask_index, null_acc.n_nodes, obj.method_params.dh, obj.method_params.H, ...
+                    obj.method_params.E);
+                null_acc.null_dist = zeros(0, 1);
+            end
+
+            function null_acc = update_null(obj, null_acc, permuted_edge_stats)
+                % Appends the maximum TFCE value of each permutation, up to obj.permutations.
+                K = min(size(permuted_edge_stats, 2), obj.permutations - numel(null_acc.null_dist));
+                if K <= 0
+                    return;
                 end
-            
-                % Number of permutations
-                if size(permuted_edge_stats, 2) < obj.permutations
-                    K = size(permuted_edge_stats, 2);
-                else
-                    K = obj.permutations;
+
+                % One call for the whole block, max TFCE value of each permutation
+                tfce_null = apply_tfce_cpp(double(permuted_edge_stats(:, 1:K)), null_acc.mask_index, ...
+                    null_acc.n_nodes, obj.method_params.dh, obj.method_params.H, obj.method_params.E);
+                block_null = max(tfce_null, [], 1)';
+
+                null_acc.null_dist = [null_acc.null_dist; block_null];
+            end
+
+            function [null_acc, null_acc_neg] = update_null_two_tailed(obj, null_acc, null_acc_neg, ...
+                    permuted_edge_stats)
+                % Appends the maximum TFCE values of the block and of the negated block
+                % (null_acc_neg, started from -edge_stats) from one read of the block.
+                K = min(size(permuted_edge_stats, 2), obj.permutations - numel(null_acc.null_dist));
+                if K <= 0
+                    return;
                 end
-                null_dist = zeros(K, 1);
-            
-                % Apply TFCE transformation to each permutation
-                for i = 1:K
-                    perm_stat_mat = STATS.unflatten_matrix(permuted_edge_stats(:, i));
-                    tfce_null = apply_tfce_cpp(perm_stat_mat, obj.method_params.dh, ...
-                        obj.method_params.H, obj.method_params.E);
-                    null_dist(i) = max(tfce_null(:)); % Store max TFCE value for permutation
+
+                [tfce_null, tfce_null_neg] = apply_tfce_cpp(double(permuted_edge_stats(:, 1:K)), ...
+                    null_acc.mask_index, null_acc.n_nodes, obj.method_params.dh, obj.method_params.H, ...
+                    obj.method_params.E);
+
+                null_acc.null_dist = [null_acc.null_dist; max(tfce_null, [], 1)'];
+                null_acc_neg.null_dist = [null_acc_neg.null_dist; max(tfce_null_neg, [], 1)'];
+            end
+
+            function pval = pvals_from_null(~, null_acc)
+                % TFCE-corrected p-values against the collected null distribution.
+                null_dist = null_acc.null_dist;
+
+                % Ensure permutation data is provided
+                if isempty(null_dist)
+                    error('Permutation data is missing. Ensure precomputed permutations are provided.');
                 end
-            
+
                 % Compute p-values using permutation-based FWER correction
-                pval = arrayfun(@(stat) (sum(stat <= null_dist)) /K, cluster_stats_target(:));
-    
+                K = numel(null_dist);
+                pval = arrayfun(@(stat) (sum(stat <= null_dist)) /K, null_acc.cluster_stats_target(:));
             end
             
         end
@@ -6,7 +6,7 @@ classdef Size_cpp
 
     methods
 
-        function pval = run_method(~,varargin)
+        function pval = run_method(obj,varargin)
             % Performs cluster-based inference using the "Size" method in Network-Based Statistics (NBS).
             %
             % Inputs:
@@ -18,30 +18,56 @@ classdef Size_cpp
             %   - pval: FWER-corrected p-values for each network component.
         
             % Parse input arguments
+            params = struct(varargin{:});
+
+            null_acc = obj.init_null(varargin{:});
+            null_acc = obj.update_null(null_acc, params.permuted_edge_data);
+            pval = obj.pvals_from_null(null_acc);
+            
+        end
+
+        function null_acc = init_null(~, varargin)
+            % Starts an empty null distribution for a permutation stream.
+            %
+            % Inputs: same name-value pairs as run_method, without permuted_edge_data.
+            %
+            % Outputs:
+            %   - null_acc: Structure with the target statistics, the mask index and
+            %               the maximum component sizes collected so far.
 
             params = struct(varargin{:});
             STATS = params.statistical_parameters;
-            edge_stats_target = params.edge_stats;
-            permuted_edge_stats = params.permuted_edge_data;
-        
-            % Get number of nodes and edges
-            %N = STATS.N;
-            %J = N * (N - 1) / 2;  % Number of edges in an upper-triangular matrix
 
-            edge_stats_mask = STATS.unflatten_matrix(edge_stats_target) > STATS.thresh;
-            
-            % Pre-allocate the output array
-            N = size(STATS.mask, 1);
-            permuted_edge_stats_mask = false(N, N, size(permuted_edge_stats, 2));
-
-            for p = 1:size(permuted_edge_stats, 2)
-                permuted_edge_stats_mask(:, :, p) = STATS.unflatten_matrix(permuted_edge_stats(:, p)) ...
-                    > STATS.thresh;
-            end
-            
-            pval = size_pval_cpp(double(edge_stats_mask), double(permuted_edge_stats_mask));
-            pval = flat_matrix(pval, STATS.mask);
-            
+            % The MEX thresholds the flat statistics through the node pairs of the
+            % mask, no N x N matrix is built per permutation
+            null_acc = struct();
+            null_acc.STATS = STATS;
+            null_acc.edge_stats = double(params.edge_stats(:));
+            null_acc.mask_index = find(STATS.mask);
+            null_acc.n_nodes = size(STATS.mask, 1);
+            null_acc.null_dist = [];
+        end
+
+        function null_acc = update_null(~, null_acc, permuted_edge_stats)
+            % Appends the maximum component size of each permutation in the block.
+            block_null = size_pval_cpp([], double(permuted_edge_stats), null_acc.mask_index, ...
+                null_acc.n_nodes, null_acc.STATS.thresh);
+            null_acc.null_dist = [null_acc.null_dist, block_null];
+        end
+
+        function [null_acc, null_acc_neg] = update_null_two_tailed(~, null_acc, null_acc_neg, permuted_edge_stats)
+            % Appends the maximum component sizes of the block and of the negated
+            % block (null_acc_neg, started from -edge_stats) from one read of the block.
+            [block_null, block_null_neg] = size_pval_cpp([], double(permuted_edge_stats), ...
+                null_acc.mask_index, null_acc.n_nodes, null_acc.STATS.thresh);
+            null_acc.null_dist = [null_acc.null_dist, block_null];
+            null_acc_neg.null_dist = [null_acc_neg.null_dist, block_null_neg];
+        end
+
+        function pval = pvals_from_null(~, null_acc)
+            % FWER-corrected p-values of the target components against the collected null.
+            pval = size_pval_cpp(null_acc.edge_stats, [], null_acc.null_dist, null_acc.mask_index, ...
+                null_acc.n_nodes, null_acc.STATS.thresh);
         end
         
     end
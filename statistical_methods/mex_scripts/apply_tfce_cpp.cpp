@@ -6,210 +6,88 @@
  * - Updates clusters incrementally instead of recomputing from scratch.
  * - Avoids redundant operations for better efficiency.
  *
+ * MATLAB adapter of prisme::apply_tfce (prisme_core/include/prisme/tfce.hpp).
+ *
  * Usage:
  *   tfced = apply_tfce(img, dh, H, E)
  *   tfced = apply_tfce(img) - uses default parameters (dh=0.1, H=3.0, E=0.4)
+ *   tfced = apply_tfce(edge_stats, mask_index, N, dh, H, E)
+ *   [tfced, tfced_neg] = apply_tfce(edge_stats, mask_index, N, dh, H, E)
+ *
+ * The last forms run on the flat edge variables of each column of edge_stats
+ * (n_var x K) with mask_index = find(STATS.mask) of an N x N mask, without
+ * unflattening. tfced (n_var x K) holds the value of each variable in img.
+ * tfced_neg is the TFCE of -edge_stats, computed with tfced from one read of
+ * each column (prisme::apply_tfce_two_tailed).
  *
  *========================================================*/
 
 #include "mex.h"
-#include <vector>
-#include <algorithm>
-#include <cmath>
-#include <string>
-#include <unordered_map>
+#include "mex_workspace.hpp"
+#include "prisme/tfce.hpp"
 
-// Structure to represent edges
-struct Edge {
-    int row;
-    int col;
-};
-
-// Structure to represent clusters
-struct Cluster {
-    std::vector<bool> nodes;
-    int node_size;
-    int size;
-    bool active;
-    bool has_edges;
-};
+#include <exception>
+#include <stdexcept>
+#include <string>
 
-// Core implementation function with explicit parameters
-void apply_tfce_impl(double *img, int num_nodes, double dh, double H, double E, double *tfced) {
-    // Preprocessing
-    // Thresholding to avoid extreme values
-    for (int i = 0; i < num_nodes * num_nodes; i++) {
-        if (img[i] > 1000) {
-            img[i] = 100;
-        }
-    }
-    
-    // Set diagonal to zero (for graphs)
-    for (int i = 0; i < num_nodes; i++) {
-        img[i * num_nodes + i] = 0;
-    }
-    
-    // Find maximum value in the image
-    double max_val = 0;
-    for (int i = 0; i < num_nodes; i++) {
-        for (int j = i + 1; j < num_nodes; j++) {
-            if (img[i + j * num_nodes] > max_val) {
-                max_val = img[i + j * num_nodes];
-            }
+// [tfced, tfced_neg] = apply_tfce(edge_stats, mask_index, N, dh, H, E)
+void apply_tfce_edges(int nlhs, mxArray *plhs[], const mxArray *prhs[]) {
+    for (int k = 0; k < 6; k++) {
+        if (!mxIsDouble(prhs[k])) {
+            mexErrMsgIdAndTxt("MATLAB:apply_tfce:invalidInput",
+                    "All inputs must be of type double.");
         }
     }
-    
-    // Create thresholds
-    std::vector<double> threshs;
-    for (double t = 0; t <= max_val + dh; t += dh) {
-        threshs.push_back(t);
-    }
-    int num_thresh = static_cast<int>(threshs.size());
-    
-    // Precompute edge introduction rounds
-    std::vector<std::vector<Edge>> edges_by_thresh(num_thresh);
-    
-    // Extract edges from adjacency matrix (upper triangle only)
-    for (int i = 0; i < num_nodes; i++) {
-        for (int j = i + 1; j < num_nodes; j++) {
-            double edge_weight = img[i + j * num_nodes];
-            if (edge_weight <= 0) {
-                continue;
-            }
-            
-            // Add small perturbation so edges are always correctly placed
-            int round_idx = static_cast<int>(floor(edge_weight / dh + 1e-10));
-            if (round_idx < num_thresh) {
-                Edge edge = {i, j};
-                edges_by_thresh[round_idx].push_back(edge);
-            }
-        }
-    }
-    
-    // Initialize clusters
-    std::vector<int> cluster_labels(num_nodes);
-    std::vector<Cluster> clusters(num_nodes);
-    
-    for (int n = 0; n < num_nodes; n++) {
-        cluster_labels[n] = n;
-        clusters[n].nodes.resize(num_nodes, false);
-        clusters[n].nodes[n] = true;
-        clusters[n].node_size = 1;
-        clusters[n].size = 0;
-        clusters[n].active = true;
-        clusters[n].has_edges = false;
+    const int num_nodes = static_cast<int>(mxGetScalar(prhs[2]));
+    const double dh = mxGetScalar(prhs[3]);
+    const double H = mxGetScalar(prhs[4]);
+    const double E = mxGetScalar(prhs[5]);
+
+    plhs[0] = mxCreateDoubleMatrix(mxGetM(prhs[0]), mxGetN(prhs[0]), mxREAL);
+    if (nlhs == 2) {
+        plhs[1] = mxCreateDoubleMatrix(mxGetM(prhs[0]), mxGetN(prhs[0]), mxREAL);
     }
-    
-    std::vector<std::vector<bool>> active_edges(num_nodes, std::vector<bool>(num_nodes, false));
-    std::vector<std::vector<int>> cluster_size_per_node(num_thresh, std::vector<int>(num_nodes, 0));
-    
-    // Iterate over thresholds and incrementally merge clusters
-    for (int h = num_thresh - 1; h >= 1; h--) {
-        // Get edges introduced at this threshold
-        std::vector<Edge>& new_edges = edges_by_thresh[h];
-        
-        // Merge clusters based on new edges
-        for (size_t k = 0; k < new_edges.size(); k++) {
-            int i = new_edges[k].row;
-            int j = new_edges[k].col;
-            active_edges[i][j] = true;
-            active_edges[j][i] = true;
-            
-            int cluster_i = cluster_labels[i];
-            int cluster_j = cluster_labels[j];
-            
-            if (cluster_i != cluster_j) {
-                // Merge smaller cluster into the larger one
-                int target_cluster, absorbed_cluster;
-                if (clusters[cluster_i].node_size >= clusters[cluster_j].node_size) {
-                    target_cluster = cluster_i;
-                    absorbed_cluster = cluster_j;
-                } else {
-                    target_cluster = cluster_j;
-                    absorbed_cluster = cluster_i;
-                }
-                
-                // Combine clusters
-                for (int n = 0; n < num_nodes; n++) {
-                    if (clusters[absorbed_cluster].nodes[n]) {
-                        clusters[target_cluster].nodes[n] = true;
-                    }
-                }
-                clusters[target_cluster].node_size += clusters[absorbed_cluster].node_size;
-                clusters[target_cluster].size += 1;
-                
-                // Update cluster size
-                clusters[target_cluster].size += clusters[absorbed_cluster].size;
-                
-                // Mark absorbed cluster as merged
-                clusters[absorbed_cluster].active = false;
-                
-                // Update cluster labels
-                for (int n = 0; n < num_nodes; n++) {
-                    if (clusters[absorbed_cluster].nodes[n]) {
-                        cluster_labels[n] = target_cluster;
-                    }
-                }
-            } else {
-                clusters[cluster_i].size += 1;
-                clusters[cluster_i].has_edges = true;
-            }
+    const size_t n_elements = mxGetNumberOfElements(prhs[0]);
+
+    std::string error;
+    try {
+        MexWorkspace& workspace = mex_workspace(num_nodes);
+        prisme::WorkspaceScope scope(&workspace.kernels);
+        const prisme::EdgeIndex& index = mex_edge_index(workspace, prhs[1]);
+        if (mxGetM(prhs[0]) != index.size()) {
+            throw std::invalid_argument("edge_stats must have one row per mask index");
         }
-        
-        for (int j = 0; j < num_nodes; j++) {
-            if (clusters[j].active) {
-                for (int n = 0; n < num_nodes; n++) {
-                    if (clusters[j].nodes[n]) {
-                        cluster_size_per_node[h][n] = clusters[j].size;                      
-                    }
-                }
-            }
+        if (nlhs == 2) {
+            prisme::apply_tfce_two_tailed({mxGetPr(prhs[0]), n_elements}, index, dh, H, E,
+                                          {mxGetPr(plhs[0]), n_elements}, {mxGetPr(plhs[1]), n_elements});
+        } else {
+            prisme::apply_tfce({mxGetPr(prhs[0]), n_elements}, index, dh, H, E,
+                               {mxGetPr(plhs[0]), n_elements});
         }
+    } catch (const std::exception& e) {
+        error = e.what();
     }
-    
-    // Calculate and accumulate TFCE contributions directly
-    std::vector<std::vector<double>> cumulative_node_tfce(num_thresh, std::vector<double>(num_nodes, 0.0));
-    
-    // For subsequent thresholds, add to the previous accumulated values
-    for (int h = 1; h < num_thresh; h++) {
-        double th = threshs[h];
-        for (int n = 0; n < num_nodes; n++) {
-            cumulative_node_tfce[h][n] = cumulative_node_tfce[h-1][n] + 
-                                        pow(cluster_size_per_node[h][n], E) * pow(th, H) * dh;
-        }
-    }
-
-    // Zero-initialize the output matrix
-    for (int i = 0; i < num_nodes * num_nodes; i++) {
-        tfced[i] = 0.0;
-    }
-    
-    // Fill in TFCE values
-    for (int h = 1; h < num_thresh; h++) {
-        std::vector<Edge>& edges = edges_by_thresh[h];
-        
-        for (size_t i = 0; i < edges.size(); i++) {
-            int node_1 = edges[i].row;
-            int node_2 = edges[i].col;
-            
-            // MATLAB uses column-major order
-            tfced[node_1 + node_2 * num_nodes] = cumulative_node_tfce[h][node_1];
-            tfced[node_2 + node_1 * num_nodes] = cumulative_node_tfce[h][node_1];
-        }
+    if (!error.empty()) {
+        mexErrMsgIdAndTxt("MATLAB:apply_tfce:invalidInput", "%s", error.c_str());
     }
 }
 
 void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[]) {
     // Check for proper number of arguments
-    if (nrhs < 1) {
+    if (nrhs < 1 || nrhs == 5 || nrhs > 6) {
         mexErrMsgIdAndTxt("MATLAB:apply_tfce:invalidNumInputs",
-                "At least one input required.");
+                "Use apply_tfce(img, [dh, H, E]) or apply_tfce(edge_stats, mask_index, N, dh, H, E).");
     }
     
-    if (nlhs > 1) {
+    if (nlhs > (nrhs == 6 ? 2 : 1)) {
         mexErrMsgIdAndTxt("MATLAB:apply_tfce:maxlhs",
                 "Too many output arguments.");
     }
+
+    if (nrhs == 6) {
+        apply_tfce_edges(nlhs, plhs, prhs);
+        return;
+    }
     
     // Get the input adjacency matrix
     if (!mxIsDouble(prhs[0])) {
@@ -217,7 +95,6 @@ void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[]) {
                 "Input matrix must be of type double.");
     }
     
-    double *img = mxGetPr(prhs[0]);
     mwSize m = mxGetM(prhs[0]);
     mwSize n = mxGetN(prhs[0]);
     int num_nodes = static_cast<int>(n);
@@ -227,7 +104,6 @@ void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[]) {
                 "Input matrix must be square.");
     }
 
-
     // Check optional parameters are of proper type
     if (nrhs >= 2 && !mxIsDouble(prhs[1])) {
         mexErrMsgIdAndTxt("MATLAB:apply_tfce:invalidInput",
@@ -247,7 +123,6 @@ void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[]) {
     double H = 3.0;
     double E = 0.4;
     
-    // Process all arguments directly (no name-value pairs)
     if (nrhs >= 2) {
         dh = mxGetScalar(prhs[1]);
     }
@@ -260,11 +135,17 @@ void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[]) {
     
     // Create output matrix
     plhs[0] = mxCreateDoubleMatrix(num_nodes, num_nodes, mxREAL);
-    double *tfced = mxGetPr(plhs[0]);
+    const size_t n_elements = static_cast<size_t>(num_nodes) * num_nodes;
 
-    //plhs[0] = mxCreateDoubleMatrix(8, 4, mxREAL);
-    //double *tfced = mxGetPr(plhs[0]);
-    
-    // Call the implementation function with explicit parameters
-    apply_tfce_impl(img, num_nodes, dh, H, E, tfced);
-}
\ No newline at end of file
+    std::string error;
+    try {
+        // Buffers and power tables are kept between the calls of a permutation loop
+        prisme::WorkspaceScope workspace(&mex_workspace(num_nodes).kernels);
+        prisme::apply_tfce({mxGetPr(prhs[0]), n_elements}, num_nodes, dh, H, E, {mxGetPr(plhs[0]), n_elements});
+    } catch (const std::exception& e) {
+        error = e.what();
+    }
+    if (!error.empty()) {
+        mexErrMsgIdAndTxt("MATLAB:apply_tfce:invalidInput", "%s", error.c_str());
+    }
+}
@@ -6,67 +6,59 @@
  * 
  * Syntax:
  *   [pvals_fwer, pvals_fdr] = constrained_pval_mex(edge_stats, permuted_edge_stats, network_indices, alpha)
+ *   [pvals_fwer, pvals_fdr, exceed_count] = constrained_pval_mex(edge_stats, permuted_edge_stats, ...
+ *                                              network_indices, alpha, prior_count, prior_perms)
+ *   [pvals_fwer, pvals_fdr, exceed_count, pvals_fwer_neg, pvals_fdr_neg, exceed_count_neg] = ...
+ *       constrained_pval_mex(edge_stats, permuted_edge_stats, network_indices, alpha, ...
+ *                            [prior_count, prior_perms, prior_count_neg])
  * 
  * Inputs:
  *   edge_stats         - Raw test statistics for edges (vector)
  *   permuted_edge_stats - Precomputed permutation edge statistics (matrix: edges x permutations)
  *   network_indices    - Network indices for each edge (vector same length as edge_stats)
  *   alpha              - Significance level (scalar, default: 0.05)
+ *   prior_count        - Exceedance counts from previous permutation blocks (one per network)
+ *   prior_perms        - Number of permutations behind prior_count
+ *   prior_count_neg    - Exceedance counts of the negative tail from previous blocks
  * 
  * Outputs:
  *   pvals_fwer         - P-values with FWER (Bonferroni) correction
  *   pvals_fdr          - Binary indicator of significance after FDR correction
+ *   exceed_count       - Permutations whose network statistic reached the observed one,
+ *                        including prior_count, so blocks of a permutation stream can be chained
+ *   *_neg              - The same outputs for -edge_stats and -permuted_edge_stats. With six
+ *                        outputs both tails come from one set of network sums per permutation
+ *
+ * The algorithm lives in prisme::constrained_pvals (prisme_core/include/prisme/constrained.hpp).
  */
 
 #include "mex.h"
 #include "matrix.h"
+#include "prisme/constrained.hpp"
+
 #include <algorithm>
+#include <exception>
+#include <string>
 #include <vector>
-#include <cmath>
-#include <set>
 
-// Apply FWER correction (Bonferroni)
-void applyFWERCorrection(const double* pval_uncorr, double* pval_fwer, mwSize num_networks) {
-    for (mwSize i = 0; i < num_networks; i++) {
-        pval_fwer[i] = std::min(pval_uncorr[i] * num_networks, 1.0);
-    }
-}
-
-// Apply FDR correction (Simes procedure)
-void applyFDRCorrection(const double* pval_uncorr, double* pval_fdr, double alpha, mwSize num_networks) {
-    // Create sorted indices for p-values
-    std::vector<std::pair<double, mwSize>> p_indexed(num_networks);
-    for (mwSize i = 0; i < num_networks; i++) {
-        p_indexed[i] = std::make_pair(pval_uncorr[i], i);
-    }
-    
-    // Sort by p-value
-    std::sort(p_indexed.begin(), p_indexed.end());
-    
-    // Initialize all values to 1 (not significant)
-    for (mwSize i = 0; i < num_networks; i++) {
-        pval_fdr[i] = 1.0;
-    }
-    
-    // Apply FDR procedure
-    for (mwSize j = 0; j < num_networks; j++) {
-        double threshold = (j + 1.0) / num_networks * alpha;
-        if (p_indexed[j].first <= threshold) {
-            // Mark as significant (p-value of 0)
-            pval_fdr[p_indexed[j].second] = 0.0;
-        } else {
-            // Once we exceed the threshold, we can stop
-            break;
-        }
-    }
+mxArray* make_row(const std::vector<double>& values) {
+    mxArray* row = mxCreateDoubleMatrix(1, values.size(), mxREAL);
+    std::copy(values.begin(), values.end(), mxGetPr(row));
+    return row;
 }
 
 // Main MEX function
 void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[]) {
     // Check inputs
-    if (nrhs < 3 || nrhs > 4) {
+    const bool two_tailed = nlhs > 3;
+    if (nrhs < 3 || nrhs == 5 || nrhs > 7 || (nrhs == 7) != (two_tailed && nrhs > 4)) {
         mexErrMsgIdAndTxt("MATLAB:constrained_pval_mex:invalidNumInputs",
-                "Three or four inputs required: edge_stats, permuted_edge_stats, network_indices, [alpha]");
+                "Three, four, six or seven inputs required: edge_stats, permuted_edge_stats, network_indices, "
+                "[alpha], [prior_count, prior_perms], [prior_count_neg] (with six outputs)");
+    }
+    if (nlhs != 2 && nlhs != 3 && nlhs != 6 && nlhs != 0) {
+        mexErrMsgIdAndTxt("MATLAB:constrained_pval_mex:invalidNumOutputs",
+                "Two, three or six outputs required");
     }
     
     // Get edge_stats
@@ -74,7 +66,6 @@ void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[]) {
         mexErrMsgIdAndTxt("MATLAB:constrained_pval_mex:invalidInput",
                 "edge_stats must be a real double vector");
     }
-    const double* edge_stats = mxGetPr(prhs[0]);
     mwSize num_edges = mxGetNumberOfElements(prhs[0]);
     
     // Get permuted_edge_stats
@@ -82,8 +73,6 @@ void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[]) {
         mexErrMsgIdAndTxt("MATLAB:constrained_pval_mex:invalidInput",
                 "permuted_edge_stats must be a real double matrix");
     }
-    const double* permuted_edge_stats = mxGetPr(prhs[1]);
-    mwSize num_perms = mxGetN(prhs[1]);  // Permutations are columns
     
     // Check dimensions
     if (mxGetM(prhs[1]) != num_edges) {
@@ -96,7 +85,6 @@ void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[]) {
         mexErrMsgIdAndTxt("MATLAB:constrained_pval_mex:invalidInput",
                 "network_indices must be a real double vector");
     }
-    const double* network_indices = mxGetPr(prhs[2]);
     
     // Check that network_indices has the same length as edge_stats
     if (mxGetNumberOfElements(prhs[2]) != num_edges) {
@@ -113,92 +101,47 @@ void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[]) {
         }
         alpha = mxGetScalar(prhs[3]);
     }
-    
-    // Find unique network indices and the maximum index
-    std::set<int> network_set;
-    int max_network_idx = 0;
-    for (mwSize i = 0; i < num_edges; i++) {
-        int idx = static_cast<int>(network_indices[i]);
-        
-        // Zero is not a network
-        if(idx == 0) continue;
 
-        network_set.insert(idx);
-        if (idx > max_network_idx) {
-            max_network_idx = idx;
-        }
+    // Counts carried over from previous permutation blocks
+    prisme::span<const double> prior_count;
+    prisme::span<const double> prior_count_neg;
+    double prior_perms = 0;
+    if (nrhs >= 6) {
+        prior_count = {mxGetPr(prhs[4]), mxGetNumberOfElements(prhs[4])};
+        prior_perms = mxGetScalar(prhs[5]);
     }
-    mwSize num_networks = network_set.size();
-    
-    // Create array of unique networks (sorted)
-    std::vector<int> unique_networks(network_set.begin(), network_set.end());
-    
-    // Allocate memory for calculations - using max_network_idx + 1 for direct indexing
-    double* network_stats = new double[max_network_idx + 1]();  // () initializes to zero
-    double* perm_network_stats = new double[max_network_idx + 1]();  // () initializes to zero
-    mwSize* count = new mwSize[max_network_idx + 1]();  // () initializes to zero
-    
-    // Calculate network statistics for observed data
-    for (mwSize e = 0; e < num_edges; e++) {
-        int network_idx = static_cast<int>(network_indices[e]);
-        
-        if(network_idx == 0) continue;
-
-        network_stats[network_idx] += edge_stats[e];
+    if (nrhs == 7) {
+        prior_count_neg = {mxGetPr(prhs[6]), mxGetNumberOfElements(prhs[6])};
     }
-    
-    // For each permutation
-    for (mwSize p = 0; p < num_perms; p++) {
-        // Reset permutation stats to zero
-        for (size_t i = 0; i < unique_networks.size(); i++) {
-            int idx = unique_networks[i];
-            perm_network_stats[idx] = 0.0;
-        }
-        
-        // Get permutation data (column-major indexing)
-        const double* perm_data = &permuted_edge_stats[p * num_edges];
-        
-        // Calculate network statistics for this permutation
-        for (mwSize e = 0; e < num_edges; e++) {
-            int network_idx = static_cast<int>(network_indices[e]);
-            
-            if(network_idx == 0) continue;
 
-            perm_network_stats[network_idx] += perm_data[e];
-        }
-        
-        // Compare with observed statistics
-        for (size_t i = 0; i < unique_networks.size(); i++) {
-            int idx = unique_networks[i];
-            if (perm_network_stats[idx] >= network_stats[idx]) {
-                count[idx]++;
-            }
+    std::string error;
+    prisme::ConstrainedTwoTailed result;
+    try {
+        const prisme::span<const double> edge_stats(mxGetPr(prhs[0]), num_edges);
+        const prisme::span<const double> permuted(mxGetPr(prhs[1]), mxGetNumberOfElements(prhs[1]));
+        const prisme::span<const double> network_indices(mxGetPr(prhs[2]), num_edges);
+        if (two_tailed) {
+            result = prisme::constrained_pvals_two_tailed(edge_stats, permuted, network_indices, alpha,
+                                                          prior_count, prior_count_neg, prior_perms);
+        } else {
+            result.positive = prisme::constrained_pvals(edge_stats, permuted, network_indices, alpha, prior_count,
+                                                        prior_perms);
         }
+    } catch (const std::exception& e) {
+        error = e.what();
     }
-    
-    // Allocate output arrays
-    plhs[0] = mxCreateDoubleMatrix(1, num_networks, mxREAL);
-    double* pval_fwer = mxGetPr(plhs[0]);
-    
-    plhs[1] = mxCreateDoubleMatrix(1, num_networks, mxREAL);
-    double* pval_fdr = mxGetPr(plhs[1]);
-    
-    // Calculate uncorrected p-values
-    double* pval_uncorr = new double[num_networks];
-    for (size_t i = 0; i < unique_networks.size(); i++) {
-        int idx = unique_networks[i];
-        pval_uncorr[i] = static_cast<double>(count[idx]) / num_perms;
+    if (!error.empty()) {
+        mexErrMsgIdAndTxt("MATLAB:constrained_pval_mex:invalidDimensions", "%s", error.c_str());
     }
-    
-    // Apply FWER correction
-    applyFWERCorrection(pval_uncorr, pval_fwer, num_networks);
-    
-    // Apply FDR correction
-    applyFDRCorrection(pval_uncorr, pval_fdr, alpha, num_networks);
-    
-    // Clean up
-    delete[] network_stats;
-    delete[] perm_network_stats;
-    delete[] count;
-    delete[] pval_uncorr;
-}
\ No newline at end of file
+
+    plhs[0] = make_row(result.positive.pvals_fwer);
+    plhs[1] = make_row(result.positive.pvals_fdr);
+    if (nlhs > 2) {
+        plhs[2] = make_row(result.positive.exceed_count);
+    }
+    if (two_tailed) {
+        plhs[3] = make_row(result.negative.pvals_fwer);
+        plhs[4] = make_row(result.negative.pvals_fdr);
+        plhs[5] = make_row(result.negative.exceed_count);
+    }
+}
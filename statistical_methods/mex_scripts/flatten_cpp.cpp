@@ -0,0 +1,48 @@
+/**
+ * flatten_cpp.cpp - MEX adapter of the edge variable flattening
+ *
+ * Usage in MATLAB:
+ *   flat = flatten_cpp(unflat, mask_index)
+ *
+ * Same result as flat_matrix.m (flat = unflat(mask)) with mask_index = find(mask)
+ * for an N x N matrix unflat. The index table is kept between calls with the same mask.
+ *
+ * The algorithm lives in prisme::flatten_edges (prisme_core/include/prisme/edge_index.hpp).
+ */
+
+#include "mex.h"
+#include "matrix.h"
+#include "mex_workspace.hpp"
+#include "prisme/edge_index.hpp"
+
+#include <exception>
+#include <string>
+
+// Main MEX function
+void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[]) {
+    if (nrhs != 2) {
+        mexErrMsgIdAndTxt("flatten:invalidNumInputs",
+                          "Two inputs required: flatten_cpp(unflat, mask_index)");
+    }
+    if (nlhs > 1) {
+        mexErrMsgIdAndTxt("flatten:maxlhs", "Too many output arguments.");
+    }
+    if (!mxIsDouble(prhs[0]) || mxIsComplex(prhs[0]) || mxGetM(prhs[0]) != mxGetN(prhs[0])) {
+        mexErrMsgIdAndTxt("flatten:invalidInput", "unflat must be a real square double matrix");
+    }
+
+    const int N = static_cast<int>(mxGetM(prhs[0]));
+    const size_t n_var = mxGetNumberOfElements(prhs[1]);
+    plhs[0] = mxCreateDoubleMatrix(n_var, 1, mxREAL);
+
+    std::string error;
+    try {
+        const prisme::EdgeIndex& index = mex_edge_index(mex_workspace(N), prhs[1]);
+        prisme::flatten_edges({mxGetPr(prhs[0]), static_cast<size_t>(N) * N}, index, {mxGetPr(plhs[0]), n_var});
+    } catch (const std::exception& e) {
+        error = e.what();
+    }
+    if (!error.empty()) {
+        mexErrMsgIdAndTxt("flatten:invalidInput", "%s", error.c_str());
+    }
+}
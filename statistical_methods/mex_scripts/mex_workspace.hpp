@@ -0,0 +1,86 @@
+/**
+ * mex_workspace.hpp - prisme_core workspace kept by a MEX file between calls
+ *
+ * Fast_TFCE_cpp.m and the Size methods call their MEX file once per permutation.
+ * The kernel buffers, the TFCE power tables (keyed on dh, H and E) and the index
+ * conversions of the adapter survive between these calls, so repeated calls of the
+ * same shape skip setup and allocation. The EdgeIndex of the mask index passed to
+ * the edge variable modes is rebuilt only when the mask changes. A call with another
+ * number of nodes frees the buffers first, and mexAtExit frees everything on clear mex.
+ *
+ * Usage in an adapter:
+ *   MexWorkspace& workspace = mex_workspace(num_nodes);
+ *   prisme::WorkspaceScope scope(&workspace.kernels);
+ *   const prisme::EdgeIndex& index = mex_edge_index(workspace, prhs[1]);
+ */
+
+#ifndef PRISME_MEX_WORKSPACE_HPP
+#define PRISME_MEX_WORKSPACE_HPP
+
+#include "mex.h"
+#include "prisme/edge_index.hpp"
+#include "prisme/workspace.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+
+struct MexWorkspace {
+    prisme::Workspace kernels;
+    std::vector<int> rows;  // 0-based sparse indices converted by the adapter
+    std::vector<int> cols;
+    std::vector<double> mask_index;  // 1-based find(mask) the edge index was built from
+    prisme::EdgeIndex edges;
+    int n_nodes = -1;
+};
+
+// Workspace of this MEX file, created on the first call
+inline MexWorkspace& mex_workspace(int n_nodes) {
+    static MexWorkspace* workspace = nullptr;
+    if (workspace == nullptr) {
+        workspace = new MexWorkspace();
+        mexAtExit([] {
+            delete workspace;
+            workspace = nullptr;
+        });
+    }
+    if (workspace->n_nodes != n_nodes) {
+        workspace->kernels.release();
+        std::vector<int>().swap(workspace->rows);
+        std::vector<int>().swap(workspace->cols);
+        std::vector<double>().swap(workspace->mask_index);
+        workspace->edges = prisme::EdgeIndex();
+        workspace->n_nodes = n_nodes;
+    }
+    return *workspace;
+}
+
+// Node pairs of the 1-based linear mask indices find(mask), kept while the indices
+// match the previous call. Throws std::invalid_argument for indices outside the mask.
+inline const prisme::EdgeIndex& mex_edge_index(MexWorkspace& workspace, const mxArray* mask_index) {
+    if (!mxIsDouble(mask_index) || mxIsComplex(mask_index)) {
+        throw std::invalid_argument("mask_index must be a real double vector");
+    }
+    const double* index = mxGetPr(mask_index);
+    const size_t n_var = mxGetNumberOfElements(mask_index);
+    if (std::equal(index, index + n_var, workspace.mask_index.begin(), workspace.mask_index.end()) &&
+        workspace.edges.n_nodes == workspace.n_nodes) {
+        return workspace.edges;
+    }
+
+    const double n_entries = static_cast<double>(workspace.n_nodes) * workspace.n_nodes;
+    std::vector<uint64_t> linear_index(n_var);
+    for (size_t e = 0; e < n_var; e++) {
+        if (!(index[e] >= 1 && index[e] <= n_entries) || index[e] != std::floor(index[e])) {
+            throw std::invalid_argument("mask_index must hold linear indices between 1 and N^2");
+        }
+        linear_index[e] = static_cast<uint64_t>(index[e]) - 1;
+    }
+    workspace.edges = prisme::make_edge_index(linear_index, workspace.n_nodes);
+    workspace.mask_index.assign(index, index + n_var);
+    return workspace.edges;
+}
+
+#endif
@@ -3,291 +3,174 @@
  *
  * Usage in MATLAB:
  *   pval = size_pval_cpp(adj_matrix, permuted_adj_matrices)
+ *   null_dist = size_pval_cpp([], permuted_adj_matrices)
+ *   pval = size_pval_cpp(adj_matrix, [], null_dist)
+ *   null_dist = size_pval_cpp([], permuted_edge_stats, mask_index, N, thresh)
+ *   [null_dist, null_dist_neg] = size_pval_cpp([], permuted_edge_stats, mask_index, N, thresh)
+ *   pval = size_pval_cpp(edge_stats, [], null_dist, mask_index, N, thresh)
  *
  * Inputs:
  *   adj_matrix - Binary adjacency matrix of significant connections (N x N matrix)
  *   permuted_adj_matrices - Binary adjacency matrices from permutations (N x N x K matrix)
+ *   null_dist - Maximum component sizes accumulated over previous permutation blocks
+ *   permuted_edge_stats, edge_stats - Flat edge statistics (n_var x K, n_var x 1) of
+ *               an N x N mask with mask_index = find(mask), thresholded at thresh
+ *               in the kernel instead of unflattened in MATLAB
  *
  * Outputs:
- *   pval - FWER-corrected p-values for each edge (N x N matrix)
+ *   pval - FWER-corrected p-values for each edge (N x N matrix, n_var x 1 for edge
+ *          statistics)
+ *   null_dist - Maximum component size of each permutation (1 x K), used when the
+ *               permutations are streamed in blocks
+ *   null_dist_neg - Null of -permuted_edge_stats from the same read of the block
+ *               (both tails of the Size method, no negated copy in MATLAB)
+ *
+ * The algorithm lives in prisme_core/include/prisme/cluster_size.hpp.
  */
 
 #include "mex.h"
 #include "matrix.h"
-#include <vector>
-#include <queue>
-#include <cmath>
-#include <algorithm>
+#include "mex_workspace.hpp"
+#include "prisme/cluster_size.hpp"
 
-// Structure to store node and component info
-struct ComponentInfo {
-    std::vector<int> nodes;
-    double size;
-    int id;
-};
+#include <exception>
+#include <stdexcept>
+#include <string>
+#include <vector>
 
-// Combined function to find connected components and calculate their sizes
-std::vector<ComponentInfo> get_components_with_sizes(const double* adj_matrix, int N) {
-    std::vector<ComponentInfo> components;
-    std::vector<bool> visited(N, false);
-    int component_id = 1;
+// Number of permutations in an N x N x K array, MATLAB drops the third dimension when K == 1
+int get_number_of_permutations(const mxArray* permuted_adj_matrices, int N) {
+    const mwSize* dims_perm = mxGetDimensions(permuted_adj_matrices);
+    mwSize n_dims = mxGetNumberOfDimensions(permuted_adj_matrices);
     
-    for (int start = 0; start < N; start++) {
-        if (visited[start]) continue;
-        
-        // Check if this node has any connections
-        bool has_connections = false;
-        for (int i = 0; i < N; i++) {
-            if (adj_matrix[start*N + i] > 0) {
-                has_connections = true;
-                break;
-            }
-        }
-        
-        if (!has_connections) {
-            visited[start] = true;
-            continue;  // Skip isolated nodes
-        }
-        
-        // Start a new component
-        ComponentInfo component;
-        component.id = component_id++;
-        component.size = 0; // Initialize size to 0
-        
-        std::queue<int> q;
-        q.push(start);
-        visited[start] = true;
-        component.nodes.push_back(start);
-        
-        // BFS to find all connected nodes and count edges
-        while (!q.empty()) {
-            int node = q.front();
-            q.pop();
-            
-            for (int neighbor = 0; neighbor < N; neighbor++) {
-                if (adj_matrix[node*N + neighbor] > 0) {
-                    // Count this edge (but avoid double counting)
-                    if (node < neighbor) {
-                        component.size += 1.0;
-                    }
-                    
-                    // Continue BFS if neighbor hasn't been visited
-                    if (!visited[neighbor]) {
-                        visited[neighbor] = true;
-                        q.push(neighbor);
-                        component.nodes.push_back(neighbor);
-                    }
-                }
-            }
-        }
-        
-        // Only keep components with more than one node
-        if (component.nodes.size() > 1) {
-            components.push_back(component);
-        }
+    if (n_dims > 3 || dims_perm[0] != static_cast<mwSize>(N) || dims_perm[1] != static_cast<mwSize>(N)) {
+        mexErrMsgIdAndTxt("Size:invalidDimensions", 
+                         "permuted_adj_matrices must be a 3D array (N×N×K) matching adj_matrix");
     }
     
-    return components;
+    return (n_dims == 3) ? static_cast<int>(dims_perm[2]) : 1;
 }
 
+prisme::span<const double> as_span(const mxArray* arr) {
+    return {mxGetPr(arr), mxGetNumberOfElements(arr)};
+}
 
-// Function to create cluster statistics map
-void create_cluster_stats_map(double* cluster_stats_map, 
-                            const double* adj_matrix,
-                            const std::vector<ComponentInfo>& components, 
-                            int N) {
-    // Initialize with zeros
-    for (int i = 0; i < N*N; i++) {
-        cluster_stats_map[i] = 0;
+// Null distribution or p-values of flat edge statistics, the last three inputs are
+// mask_index, N and thresh
+void size_pval_edges(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[]) {
+    const mxArray* stats = nrhs == 5 ? prhs[1] : prhs[0];
+    const int N = static_cast<int>(mxGetScalar(prhs[nrhs - 2]));
+    const double thresh = mxGetScalar(prhs[nrhs - 1]);
+    if (!mxIsDouble(stats)) {
+        mexErrMsgIdAndTxt("Size:invalidInput", "Edge statistics must be of type double");
     }
-    
-    // Fill in component sizes
-    for (size_t comp_idx = 0; comp_idx < components.size(); comp_idx++) {
-        const ComponentInfo& component = components[comp_idx];
 
-        for (size_t i = 0; i < component.nodes.size(); i++) {
-            int node_i = component.nodes[i];
-            
-            for (size_t j = i+1; j < component.nodes.size(); j++) {
-                int node_j = component.nodes[j];
-                
-                if (adj_matrix[node_i*N + node_j] > 0) {
-                    cluster_stats_map[node_i*N + node_j] = component.size;
-                    cluster_stats_map[node_j*N + node_i] = component.size;
-                }
-            }
+    std::string error;
+    try {
+        MexWorkspace& workspace = mex_workspace(N);
+        prisme::WorkspaceScope scope(&workspace.kernels);
+        const prisme::EdgeIndex& index = mex_edge_index(workspace, prhs[nrhs - 3]);
+        if (!mxIsEmpty(stats) && mxGetM(stats) != index.size()) {
+            throw std::invalid_argument("Edge statistics must have one row per mask index");
+        }
+
+        if (nrhs == 5 && nlhs == 2) {
+            const size_t K = mxIsEmpty(stats) ? 0 : mxGetN(stats);
+            plhs[0] = mxCreateDoubleMatrix(1, K, mxREAL);
+            plhs[1] = mxCreateDoubleMatrix(1, K, mxREAL);
+            prisme::size_null_distribution_two_tailed(as_span(stats), index, thresh, {mxGetPr(plhs[0]), K},
+                                                      {mxGetPr(plhs[1]), K});
+        } else if (nrhs == 5) {
+            const size_t K = mxIsEmpty(stats) ? 0 : mxGetN(stats);
+            plhs[0] = mxCreateDoubleMatrix(1, K, mxREAL);
+            prisme::size_null_distribution(as_span(stats), index, thresh, {mxGetPr(plhs[0]), K});
+        } else {
+            plhs[0] = mxCreateDoubleMatrix(index.size(), 1, mxREAL);
+            prisme::size_pvals(as_span(stats), index, thresh, as_span(prhs[2]), {mxGetPr(plhs[0]), index.size()});
         }
+    } catch (const std::exception& e) {
+        error = e.what();
+    }
+    if (!error.empty()) {
+        mexErrMsgIdAndTxt("Size:invalidDimensions", "%s", error.c_str());
     }
 }
 
 // Main MEX function
 void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[]) {
     // Check input arguments
-    if (nrhs != 2) {
+    if (nrhs < 2 || nrhs > 6 || nrhs == 4 || (nrhs == 5 && !mxIsEmpty(prhs[0]))) {
         mexErrMsgIdAndTxt("Size:invalidNumInputs",
-                         "Two inputs required: adj_matrix, permuted_adj_matrices");
+                         "Inputs: adj_matrix, permuted_adj_matrices, [null_dist], or edge statistics "
+                         "followed by mask_index, N and thresh");
     }
     
-    // Check output arguments
-    if (nlhs != 1) {
+    // Check output arguments, the null of edge statistics may return both tails
+    if (nlhs != 1 && !(nlhs == 2 && nrhs == 5)) {
         mexErrMsgIdAndTxt("Size:invalidNumOutputs",
-                         "One output required: p-values");
-    }
-    
-    // Get inputs
-    double* adj_matrix = mxGetPr(prhs[0]);
-    double* permuted_adj_matrices = mxGetPr(prhs[1]);
-    
-    // Get dimensions
-    const mwSize* dims_adj = mxGetDimensions(prhs[0]);
-    int N = static_cast<int>(dims_adj[0]);  // Number of nodes
-    
-    const mwSize* dims_perm = mxGetDimensions(prhs[1]);
-    int K = static_cast<int>(dims_perm[2]);  // Number of permutations
-    
-    if (dims_adj[0] != dims_adj[1] || dims_perm[0] != dims_perm[1] || 
-        dims_adj[0] != dims_perm[0]) {
-        mexErrMsgIdAndTxt("Size:invalidDimensions",
-                         "Dimensions of adj_matrix and permuted_adj_matrices must be consistent");
+                         "One output required: p-values or null distribution");
     }
 
-    // Verify dimensions of permuted matrices
-    if (mxGetNumberOfDimensions(prhs[1]) != 3) {
-        mexErrMsgIdAndTxt("Size:invalidDimensions", 
-                         "permuted_adj_matrices must be a 3D array (N×N×K)");
+    if (nrhs >= 5) {
+        size_pval_edges(nlhs, plhs, nrhs, prhs);
+        return;
     }
 
-    if (dims_perm[0] != N || dims_perm[1] != N) {
-        mexErrMsgIdAndTxt("Size:invalidDimensions", 
-                         "Dimensions of permuted_adj_matrices must match adj_matrix");
-    }
-    
-    // Find connected components in target data
-    std::vector<ComponentInfo> components = get_components_with_sizes(adj_matrix, N);
-    
-    /*
-    mexPrintf("Number of components: %zu\n", components.size());
-    for (size_t comp_idx = 0; comp_idx < components.size(); comp_idx++) {
-        const ComponentInfo& component = components[comp_idx];
-        mexPrintf("Component %d: ID=%d, Size=%.1f, Nodes=%zu\n", 
-                  (int)comp_idx, 
-                  component.id, 
-                  component.size, 
-                  component.nodes.size());
-                  
-        // Optionally print the nodes in each component
-        mexPrintf("  Nodes: ");
-        for (size_t i = 0; i < component.nodes.size(); i++) {
-            mexPrintf("%d ", component.nodes[i]);
-            if (i > 0 && i % 10 == 0) {
-                mexPrintf("\n         "); // For better formatting of long node lists
-            }
+    std::string error;
+
+    // Null distribution only - one block of a permutation stream
+    if (mxIsEmpty(prhs[0])) {
+        const mwSize* dims_perm = mxGetDimensions(prhs[1]);
+        if (dims_perm[0] != dims_perm[1]) {
+            mexErrMsgIdAndTxt("Size:invalidDimensions",
+                             "permuted_adj_matrices must be a 3D array (N×N×K)");
         }
-        mexPrintf("\n");
-    } */
-    
-    // After getting the adjacency matrix
-    /*
-    mexPrintf("Input adjacency matrix:\n");
-    for (int i = 0; i < N; i++) {
-        for (int j = 0; j < N; j++) {
-            mexPrintf("%.1f ", adj_matrix[i*N + j]);
+        int N = static_cast<int>(dims_perm[0]);
+        int K = mxIsEmpty(prhs[1]) ? 0 : get_number_of_permutations(prhs[1], N);
+        
+        plhs[0] = mxCreateDoubleMatrix(1, K, mxREAL);
+        try {
+            prisme::WorkspaceScope workspace(&mex_workspace(N).kernels);
+            prisme::size_null_distribution(as_span(prhs[1]), N, {mxGetPr(plhs[0]), static_cast<size_t>(K)});
+        } catch (const std::exception& e) {
+            error = e.what();
         }
-        mexPrintf("\n");
-    }
-    
-    // Print permutation matrices before the loop
-    mexPrintf("Permutation matrices:\n");
-    for (int k = 0; k < K; k++) {
-        mexPrintf("Permutation %d:\n", k);
-        for (int i = 0; i < N; i++) {
-            for (int j = 0; j < N; j++) {
-                mexPrintf("%.1f ", permuted_adj_matrices[(k*N*N) + (i*N) + j]);
-            }
-            mexPrintf("\n");
+        if (!error.empty()) {
+            mexErrMsgIdAndTxt("Size:invalidDimensions", "%s", error.c_str());
         }
-    } */
-    
-    // Create cluster statistics map
-    double* cluster_stats_map = new double[N*N]();
-    create_cluster_stats_map(cluster_stats_map, adj_matrix, components, N);
+        return;
+    }
     
-    // Compute null distribution
-    std::vector<double> null_dist(K);
-    double* perm_adj_matrix = new double[N*N]();
+    // Get dimensions
+    const mwSize* dims_adj = mxGetDimensions(prhs[0]);
+    int N = static_cast<int>(dims_adj[0]);  // Number of nodes
     
-    for (int k = 0; k < K; k++) {
-        // Copy permutation data to properly formed adjacency matrix
-        for (int i = 0; i < N*N; i++) {
-            perm_adj_matrix[i] = permuted_adj_matrices[i + (k * N * N)];
-        }
-        
-        // Find connected components in permutation
-        std::vector<ComponentInfo> perm_components = get_components_with_sizes(perm_adj_matrix, N);
-        
-        // Get maximum component size for this permutation
-        double perm_max_sz = 1;
-        for (size_t comp_idx = 0; comp_idx < perm_components.size(); comp_idx++) {
-            const ComponentInfo& component = perm_components[comp_idx];
-            if (component.size > perm_max_sz) {
-                perm_max_sz = component.size;
-            }
-        }
-        
-        // Store in null distribution
-        null_dist[k] = perm_max_sz;
+    if (dims_adj[0] != dims_adj[1]) {
+        mexErrMsgIdAndTxt("Size:invalidDimensions",
+                         "adj_matrix must be square");
     }
+    
+    int K = (nrhs == 3) ? 0 : get_number_of_permutations(prhs[1], N);
 
     // Compute p-values
     mwSize dims_out[2] = {static_cast<mwSize>(N), static_cast<mwSize>(N)};
     plhs[0] = mxCreateNumericArray(2, dims_out, mxDOUBLE_CLASS, mxREAL);
-    double* pval = mxGetPr(plhs[0]);
-    
-    // Initialize with 1s
-    for (int i = 0; i < N*N; i++) {
-        pval[i] = 1.0;
-    }
-    
-    // Calculate p-values for each edge
-    for (int i = 0; i < N; i++) {
-        for (int j = 0; j < N; j++) {
-            double stat = cluster_stats_map[i*N + j];
-            
-            if (stat > 0) {
-                double p_count = 0;
-                
-                // Count how many values in null distribution are >= the statistic
-                for (int k = 0; k < K; k++) {
-                    if (null_dist[k] >= stat) {
-                        p_count += 1.0;
-                    }
-                }
-
-                // Compute p-value (minimum 0, maximum 1)
-                pval[i*N + j] = std::min(p_count / K, 1.0);
-            }
+    try {
+        prisme::WorkspaceScope workspace(&mex_workspace(N).kernels);
+        std::vector<double> null_dist;
+        if (nrhs == 3) {
+            // Null distribution accumulated over permutation blocks
+            null_dist.assign(mxGetPr(prhs[2]), mxGetPr(prhs[2]) + mxGetNumberOfElements(prhs[2]));
+        } else {
+            null_dist.resize(K);
+            prisme::size_null_distribution(as_span(prhs[1]), N, null_dist);
         }
+        prisme::size_pvals(as_span(prhs[0]), N, null_dist,
+                           {mxGetPr(plhs[0]), static_cast<size_t>(N) * N});
+    } catch (const std::exception& e) {
+        error = e.what();
     }
-
-    // Add this after calculating null_dist
-    /*
-    mexPrintf("Null distribution values:\n");
-    for (int k = 0; k < K; k++) {
-        mexPrintf("  %d: %.1f\n", k, null_dist[k]);
+    if (!error.empty()) {
+        mexErrMsgIdAndTxt("Size:invalidDimensions", "%s", error.c_str());
     }
-    
-    // Add this after creating the cluster_stats_map
-    mexPrintf("Cluster stats map (non-zero entries):\n");
-    for (int i = 0; i < N; i++) {
-        for (int j = 0; j < N; j++) {
-            double stat = cluster_stats_map[i*N + j];
-            if (stat > 0) {
-                mexPrintf("  (%d,%d): %.1f\n", i, j, stat);
-            }
-        }
-    } */
-    
-    // Clean up
-    delete[] cluster_stats_map;
-    delete[] perm_adj_matrix;
-}
\ No newline at end of file
+}
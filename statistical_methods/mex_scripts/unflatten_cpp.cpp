@@ -0,0 +1,52 @@
+/**
+ * unflatten_cpp.cpp - MEX adapter of the edge variable unflattening
+ *
+ * Usage in MATLAB:
+ *   unflat = unflatten_cpp(flat, mask_index, N)
+ *
+ * Same result as the edge path of unflatten_matrix.m (temp(mask) = flat;
+ * unflat = temp + temp') with mask_index = find(mask) of an N x N mask. The index
+ * table is kept between calls with the same mask.
+ *
+ * The algorithm lives in prisme::unflatten_edges (prisme_core/include/prisme/edge_index.hpp).
+ */
+
+#include "mex.h"
+#include "matrix.h"
+#include "mex_workspace.hpp"
+#include "prisme/edge_index.hpp"
+
+#include <exception>
+#include <string>
+
+// Main MEX function
+void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[]) {
+    if (nrhs != 3) {
+        mexErrMsgIdAndTxt("unflatten:invalidNumInputs",
+                          "Three inputs required: unflatten_cpp(flat, mask_index, N)");
+    }
+    if (nlhs > 1) {
+        mexErrMsgIdAndTxt("unflatten:maxlhs", "Too many output arguments.");
+    }
+    if (!mxIsDouble(prhs[0]) || mxIsComplex(prhs[0])) {
+        mexErrMsgIdAndTxt("unflatten:invalidInput", "flat must be a real double vector");
+    }
+
+    const int N = static_cast<int>(mxGetScalar(prhs[2]));
+    if (N < 0) {
+        mexErrMsgIdAndTxt("unflatten:invalidInput", "N must not be negative");
+    }
+    plhs[0] = mxCreateDoubleMatrix(N, N, mxREAL);
+
+    std::string error;
+    try {
+        const prisme::EdgeIndex& index = mex_edge_index(mex_workspace(N), prhs[1]);
+        prisme::unflatten_edges({mxGetPr(prhs[0]), mxGetNumberOfElements(prhs[0])}, index,
+                                {mxGetPr(plhs[0]), static_cast<size_t>(N) * N});
+    } catch (const std::exception& e) {
+        error = e.what();
+    }
+    if (!error.empty()) {
+        mexErrMsgIdAndTxt("unflatten:invalidInput", "%s", error.c_str());
+    }
+}
@@ -0,0 +1,31 @@
+function column_store_test()
+%% column_store_test
+% Checks that the column store used for full file repetition stats returns the
+% columns it was given, grows by appending and NaN fills skipped columns.
+%
+% Outputs:
+%   - None (assertion errors are thrown if validation fails).
+
+    store_file = [tempname '.pcol'];
+    cleanup = onCleanup(@() delete(store_file));
+
+    columns = rand(5, 3);
+    n_cols = write_column_store(store_file, 1, columns);
+    assert(n_cols == 3, 'Column store should hold 3 columns');
+    assert(isequal(read_column_store(store_file), columns), 'Column store round trip failed');
+
+    % Overwrite in place and write past the end
+    new_column = rand(5, 1);
+    write_column_store(store_file, 2, new_column);
+    n_cols = write_column_store(store_file, 6, new_column);
+    assert(n_cols == 6, 'Column store should grow to 6 columns');
+
+    stored = read_column_store(store_file, [1, 2, 4, 6]);
+    assert(isequaln(stored, [columns(:, 1), new_column, NaN(5, 1), new_column]), ...
+        'Column store selected column read failed');
+
+    n_cols = column_store_cpp('append', store_file, columns);
+    assert(n_cols == 9, 'Column store append failed');
+    assert(isequal(column_store_cpp('read', store_file, 7:9), columns), 'Column store MEX read failed');
+
+end
@@ -0,0 +1,36 @@
+function ftest_df_effect_test()
+%% ftest_df_effect_test
+% Checks the numerator degrees of freedom of F statistics against NBSglm_smn,
+% including a contrast whose nuisance already spans the column of ones. They come
+% from NBSglm_cpp when it is compiled and from MATLAB otherwise.
+%
+% Outputs:
+%   - None (assertion errors are thrown if validation fails).
+
+    rng(7);
+    n = 20;
+    X = [ones(n, 1), randn(n, 2)];
+
+    % No nuisance: the predictors beyond the intercept
+    GLM = ftest_glm(X, [1 1 1]);
+    assert(ftest_df_effect(GLM) == 2, 'Wrong df without nuisance');
+
+    % The intercept is the nuisance, the reduced model is rank deficient
+    GLM = ftest_glm(X, [0 1 1]);
+    assert(ftest_df_effect(GLM) == 2, 'Wrong df with a rank-deficient reduced model');
+
+    % A covariate is the nuisance, the reduced model keeps its column of ones
+    GLM = ftest_glm(X, [1 1 0]);
+    assert(ftest_df_effect(GLM) == 1, 'Wrong df with a covariate as nuisance');
+
+end
+
+
+function GLM = ftest_glm(X, contrast)
+    GLM.X = X;
+    GLM.y = randn(size(X, 1), 3);
+    GLM.contrast = contrast;
+    GLM.test = 'ftest';
+    GLM.perms = 0;
+    GLM = NBSglm_setup_smn(GLM);
+end
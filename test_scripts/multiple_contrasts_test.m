@@ -0,0 +1,53 @@
+function multiple_contrasts_test()
+%% multiple_contrasts_test
+% Checks the documented multiple contrast call of NBSglm_cpp: a GLM set up by
+% NBSglm_setup_smn with both contrast signs gives the statistics and permutation
+% nulls of one call per contrast, which match NBSglm_smn.
+%
+% Outputs:
+%   - None (assertion errors are thrown if validation fails).
+
+    rng(11);
+    n = 24;
+    group = mod((1:n)', 3) == 0;
+
+    % onesample: a single predictor, the contrast is a column
+    check_both_signs(ones(n, 1), 1, 'onesample', n);
+    % ttest of two groups
+    check_both_signs(double([group, ~group]), [1 -1], 'ttest', n);
+    % ttest of a slope with the intercept and a covariate as nuisance
+    check_both_signs([ones(n, 1), randn(n, 1), randn(n, 1)], [0 1 0], 'ttest', n);
+
+end
+
+
+function check_both_signs(X, nbs_contrast, test, n)
+    n_perms = 20;
+    seed = 5;
+    nbs_contrast_neg = -nbs_contrast;
+
+    GLM.X = X;
+    GLM.y = randn(n, 6);
+    GLM.test = test;
+    GLM.perms = n_perms;
+    GLM.contrast = [nbs_contrast; nbs_contrast_neg];
+    GLM = NBSglm_setup_smn(GLM);
+    assert(GLM.n_predictors == size(X, 2), 'Wrong number of predictors for a contrast matrix');
+    assert(isequal(GLM.ind_nuisance, find(~nbs_contrast)), 'Wrong nuisance for a contrast matrix');
+
+    test_stat = NBSglm_cpp(GLM);
+    perm_stats = NBSglm_cpp(GLM, n_perms, seed);
+    assert(isequal(size(test_stat), [2, GLM.n_GLMs]), 'Wrong size of the statistics');
+
+    contrasts = {nbs_contrast, nbs_contrast_neg};
+    for c = 1:2
+        GLM_single = GLM;
+        GLM_single.contrast = contrasts{c};
+        GLM_single = NBSglm_setup_smn(GLM_single);
+        expected = NBSglm_smn(GLM_single);
+        assert(max(abs(test_stat(c, :) - expected(:)')) < 1e-8, 'Statistics differ from NBSglm_smn');
+        expected_perms = NBSglm_cpp(GLM_single, n_perms, seed);
+        assert(max(abs(reshape(perm_stats(:, :, c) - expected_perms, [], 1))) < 1e-10, ...
+            'Permutations differ from one call per contrast');
+    end
+end
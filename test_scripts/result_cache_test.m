@@ -0,0 +1,43 @@
+function result_cache_test()
+%% result_cache_test
+% Checks that result cache keys depend on the class, size and contents of their
+% parts, that cached matrices come back unchanged and that the least recently used
+% entries are evicted beyond the size budget.
+%
+% Outputs:
+%   - None (assertion errors are thrown if validation fails).
+
+    cache_dir = tempname;
+    cleanup = onCleanup(@() rmdir(cache_dir, 's'));
+
+    ids = [3; 17; 4; 9];
+    key = result_cache_cpp('key', 'dataset', ids, [1 -1]);
+    assert(strcmp(key, result_cache_cpp('key', 'dataset', ids, [1 -1])), 'Keys are not deterministic');
+    assert(~strcmp(key, result_cache_cpp('key', 'dataset', ids', [1 -1])), 'Key ignores the size of a part');
+    assert(~strcmp(key, result_cache_cpp('key', 'dataset', int32(ids), [1 -1])), 'Key ignores the class of a part');
+
+    [values, found] = result_cache_cpp('get', cache_dir, key);
+    assert(~found && isempty(values), 'Missing entry was found');
+
+    block = randn(50, 7);
+    result_cache_cpp('put', cache_dir, key, block, 1e6);
+    [values, found] = result_cache_cpp('get', cache_dir, key);
+    assert(found && isequal(values, block), 'Cached matrix changed');
+
+    % Room for two blocks: reading the first makes the second the one to evict
+    entry_bytes = 32 + numel(block) * 8;
+    keys = arrayfun(@(i) result_cache_cpp('key', key, i), 1:3, 'UniformOutput', false);
+    result_cache_cpp('put', cache_dir, keys{1}, block, 2 * entry_bytes);
+    pause(0.05);
+    result_cache_cpp('put', cache_dir, keys{2}, block, 2 * entry_bytes);
+    pause(0.05);
+    [~, found] = result_cache_cpp('get', cache_dir, keys{1});
+    assert(found, 'Entry was evicted too early');
+    pause(0.05);
+    result_cache_cpp('put', cache_dir, keys{3}, block, 2 * entry_bytes);
+    [~, found] = result_cache_cpp('get', cache_dir, keys{2});
+    assert(~found, 'Least recently used entry was not evicted');
+    [~, found] = result_cache_cpp('get', cache_dir, keys{1});
+    assert(found, 'Recently read entry was evicted');
+
+end
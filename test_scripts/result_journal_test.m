@@ -0,0 +1,36 @@
+function result_journal_test()
+%% result_journal_test
+% Checks that journaled batches are folded into the method structs of a compact
+% results file, that a repeated repetition only counts once and that compaction
+% can run again without counting anything twice.
+%
+% Outputs:
+%   - None (assertion errors are thrown if validation fails).
+
+    output_file = [tempname '.mat'];
+    journal_file = get_result_journal_file(output_file);
+    cleanup = onCleanup(@() cellfun(@(f) delete(f), {output_file, journal_file}));
+
+    meta_data = struct();
+    meta_data.method_current_rep = struct('Size', 0);
+    save(output_file, 'meta_data');
+
+    result_journal_cpp('append', journal_file, {'Size', 'Size'}, [1, 2], [0.5, 0.25], ...
+        {[1; 0; 1], [0; 0; 1]}, {[0; 1; 0], [0; 0; 0]});
+    % Repetition 2 journaled again (e.g. recalculated) replaces the first record
+    result_journal_cpp('append', journal_file, {'Size'}, 2, 0.75, {[1; 0; 0]}, {[0; 0; 1]});
+
+    compact_result_journal(output_file);
+    compact_result_journal(output_file);
+
+    loaded = load(output_file);
+    assert(isequal(loaded.Size.positives, [2; 0; 1]), 'Journal positives were not folded correctly');
+    assert(isequal(loaded.Size.negatives, [0; 1; 1]), 'Journal negatives were not folded correctly');
+    assert(loaded.Size.total_calculations == 2, 'Journal repetitions were counted twice');
+    assert(abs(loaded.Size.total_time - 1.25) < 1e-12, 'Journal timing was not folded correctly');
+    assert(loaded.meta_data.method_current_rep.Size == 2, 'method_current_rep was not updated');
+
+    journal = result_journal_cpp('read', journal_file);
+    assert(journal.n_records == 0, 'Journal should be empty after compaction');
+
+end
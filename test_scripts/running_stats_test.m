@@ -0,0 +1,38 @@
+function running_stats_test()
+%% running_stats_test
+% Checks the streaming moments accumulator used for compact file edge and network
+% statistics against direct computations, folding in batches and merging
+% accumulators built separately.
+%
+% Outputs:
+%   - None (assertion errors are thrown if validation fails).
+
+    data = randn(20, 37) .* (1:20)' + 5;
+
+    acc = init_running_stats(20, 'higher_moments', true);
+    acc = accumulate_running_stats(acc, data(:, 1:10));
+    acc = accumulate_running_stats(acc, data(:, 11:end));
+
+    other = accumulate_running_stats(init_running_stats(20, 'higher_moments', true), data(:, 1:25));
+    other = accumulate_running_stats(other, ...
+        accumulate_running_stats(init_running_stats(20, 'higher_moments', true), data(:, 26:end)));
+
+    deviation = data - mean(data, 2);
+    for result = {acc, other}
+        r = result{1};
+        assert(r.n == 37, 'Running stats count is wrong');
+        assert(max(abs(r.mean - mean(data, 2))) < 1e-10, 'Running mean is wrong');
+        assert(max(abs(r.m2 / (r.n - 1) - var(data, 0, 2))) < 1e-8, 'Running variance is wrong');
+        assert(max(abs(r.m3 - sum(deviation.^3, 2)) ./ sum(deviation.^4, 2)) < 1e-8, 'Running M3 is wrong');
+        assert(max(abs(r.m4 - sum(deviation.^4, 2)) ./ sum(deviation.^4, 2)) < 1e-8, 'Running M4 is wrong');
+    end
+
+    % Median sketch stays within the sample range and close to the median
+    if exist('welford_accumulate_cpp', 'file') == 3
+        sketch = init_running_stats(1, 'quantile', 0.5);
+        sample = randn(1, 2000);
+        sketch = accumulate_running_stats(sketch, sample);
+        assert(abs(sketch.p2_heights(3) - median(sample)) < 0.1, 'Median sketch is off');
+    end
+
+end